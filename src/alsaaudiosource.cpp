@@ -0,0 +1,246 @@
+// alsaaudiosource.cpp
+// Implementation file for the AlsaAudioSource class.
+
+#include "alsaaudiosource.h"
+#include "latencytracer.h"
+#include "logger.h"
+#include <cstring> // For std::memcpy
+#include <string>
+
+AlsaAudioSource::AlsaAudioSource(bool use_mmap)
+    : m_use_mmap(use_mmap),
+      m_handle(nullptr)
+{
+}
+
+AlsaAudioSource::~AlsaAudioSource() {
+    close();
+}
+
+bool AlsaAudioSource::open(const AudioSourceConfig& config) {
+    close();
+    int err;
+    std::string pcm_device = config.device.empty() ? "default" : config.device; // Or "plughw:1,0" etc.
+
+    // Open PCM device for recording
+    if ((err = snd_pcm_open(&m_handle, pcm_device.c_str(), SND_PCM_STREAM_CAPTURE, 0)) < 0) {
+        VK_LOG_ERROR("Cannot open audio device " << pcm_device << ": " << snd_strerror(err));
+        m_handle = nullptr;
+        return false;
+    }
+
+    // Set PCM parameters
+    snd_pcm_hw_params_t *hw_params;
+    snd_pcm_hw_params_alloca(&hw_params);
+    snd_pcm_hw_params_any(m_handle, hw_params);
+
+    // Set interleaved mode
+    snd_pcm_access_t access = m_use_mmap ? SND_PCM_ACCESS_MMAP_INTERLEAVED : SND_PCM_ACCESS_RW_INTERLEAVED;
+    if ((err = snd_pcm_hw_params_set_access(m_handle, hw_params, access)) < 0) {
+        VK_LOG_ERROR("Audio device " << pcm_device << " does not support " << name() << " access: " << snd_strerror(err));
+        close();
+        return false;
+    }
+
+    // Set sample format (Vosk expects 16-bit signed integers)
+    snd_pcm_hw_params_set_format(m_handle, hw_params, SND_PCM_FORMAT_S16_LE);
+
+    unsigned int rate = config.sample_rate;
+    if (config.native_format) {
+        // Take a rate and channel count the hardware really runs at instead of having the plug
+        // layer convert; the service downmixes and resamples to the model's format itself
+        snd_pcm_hw_params_set_rate_resample(m_handle, hw_params, 0);
+        unsigned int channels = config.channels;
+        snd_pcm_hw_params_set_channels_near(m_handle, hw_params, &channels);
+    } else {
+        // Set channels (Vosk expects mono)
+        snd_pcm_hw_params_set_channels(m_handle, hw_params, config.channels);
+    }
+
+    // Set sample rate
+    snd_pcm_hw_params_set_rate_near(m_handle, hw_params, &rate, 0);
+
+    // Period and buffer sizes are requested in time, so scale them to the rate we got
+    snd_pcm_uframes_t period_size = config.period_frames * rate / config.sample_rate;
+    snd_pcm_hw_params_set_period_size_near(m_handle, hw_params, &period_size, 0);
+
+    // Set buffer size
+    snd_pcm_uframes_t buffer_size = config.buffer_frames * rate / config.sample_rate;
+    snd_pcm_hw_params_set_buffer_size_near(m_handle, hw_params, &buffer_size);
+
+    // Apply parameters
+    if ((err = snd_pcm_hw_params(m_handle, hw_params)) < 0) {
+        VK_LOG_ERROR("Cannot set parameters: " << snd_strerror(err));
+        close();
+        return false;
+    }
+
+    // Get actual parameters
+    unsigned int actual_rate;
+    snd_pcm_hw_params_get_rate(hw_params, &actual_rate, 0);
+    unsigned int actual_channels;
+    snd_pcm_hw_params_get_channels(hw_params, &actual_channels);
+    snd_pcm_uframes_t actual_buffer_size;
+    snd_pcm_hw_params_get_buffer_size(hw_params, &actual_buffer_size);
+    snd_pcm_uframes_t actual_period_size;
+    snd_pcm_hw_params_get_period_size(hw_params, &actual_period_size, 0);
+
+    m_sample_rate = actual_rate;
+    m_channels = actual_channels;
+    m_period_frames = actual_period_size;
+    m_buffer_frames = actual_buffer_size;
+
+    VK_LOG_INFO("AlsaAudioSource: " << pcm_device << " (" << name() << ") - Requested Rate: " << config.sample_rate
+             << "Hz, Actual Rate: " << actual_rate
+             << "Hz, Requested Channels: " << config.channels << ", Actual Channels: " << actual_channels
+             << ", Buffer Size (frames): " << actual_buffer_size
+             << ", Period Size (frames): " << actual_period_size);
+
+    // Ask for CLOCK_MONOTONIC hardware timestamps so latency tracing can date each period
+    snd_pcm_sw_params_t *sw_params;
+    snd_pcm_sw_params_alloca(&sw_params);
+    if (snd_pcm_sw_params_current(m_handle, sw_params) == 0) {
+        snd_pcm_sw_params_set_tstamp_mode(m_handle, sw_params, SND_PCM_TSTAMP_ENABLE);
+        snd_pcm_sw_params_set_tstamp_type(m_handle, sw_params, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+        if ((err = snd_pcm_sw_params(m_handle, sw_params)) < 0) {
+            VK_LOG_WARNING("Cannot enable ALSA timestamps: " << snd_strerror(err));
+        }
+    }
+
+    // Prepare PCM device
+    if ((err = snd_pcm_prepare(m_handle)) < 0) {
+        VK_LOG_ERROR("Cannot prepare audio interface for use: " << snd_strerror(err));
+        close();
+        return false;
+    }
+    return true;
+}
+
+void AlsaAudioSource::close() {
+    if (m_handle) {
+        VK_LOG_INFO("AlsaAudioSource: Closing ALSA capture device.");
+        snd_pcm_close(m_handle);
+        m_handle = nullptr;
+    }
+}
+
+bool AlsaAudioSource::recover(int err) {
+    if (err == -EPIPE) {
+        VK_LOG_WARNING("ALSA overrun occurred, attempting to recover.");
+    }
+    if ((err = snd_pcm_recover(m_handle, err, 1)) < 0) {
+        VK_LOG_ERROR("Cannot recover ALSA capture: " << snd_strerror(err));
+        return false;
+    }
+    return true;
+}
+
+AudioSource::ReadStatus AlsaAudioSource::read(int16_t* out, size_t& frames) {
+    frames = 0;
+    if (!m_handle) {
+        return ReadStatus::Error;
+    }
+    if (m_use_mmap) {
+        return read_mmap(out, frames);
+    }
+
+    snd_pcm_sframes_t err = snd_pcm_readi(m_handle, out, m_period_frames);
+    if (err == -EPIPE || err == -ESTRPIPE) {
+        return recover(static_cast<int>(err)) ? ReadStatus::Overrun : ReadStatus::Error;
+    } else if (err < 0) {
+        VK_LOG_ERROR("Error from ALSA read: " << snd_strerror(static_cast<int>(err)));
+        return ReadStatus::Error;
+    } else if (err != static_cast<snd_pcm_sframes_t>(m_period_frames)) {
+        VK_LOG_WARNING("Short read from ALSA, expected " << m_period_frames << " frames, got " << err);
+    }
+    frames = static_cast<size_t>(err);
+    return ReadStatus::Ok;
+}
+
+AudioSource::ReadStatus AlsaAudioSource::read_mmap(int16_t* out, size_t& frames) {
+    while (frames < m_period_frames) {
+        // Capture doesn't start by itself in mmap mode
+        snd_pcm_state_t state = snd_pcm_state(m_handle);
+        if (state == SND_PCM_STATE_PREPARED) {
+            int err = snd_pcm_start(m_handle);
+            if (err < 0) {
+                VK_LOG_ERROR("Cannot start ALSA capture: " << snd_strerror(err));
+                return ReadStatus::Error;
+            }
+        } else if (state == SND_PCM_STATE_XRUN || state == SND_PCM_STATE_SUSPENDED) {
+            frames = 0;
+            return recover(state == SND_PCM_STATE_XRUN ? -EPIPE : -ESTRPIPE) ? ReadStatus::Overrun : ReadStatus::Error;
+        }
+
+        snd_pcm_sframes_t avail = snd_pcm_avail_update(m_handle);
+        if (avail < 0) {
+            frames = 0;
+            return recover(static_cast<int>(avail)) ? ReadStatus::Overrun : ReadStatus::Error;
+        }
+        snd_pcm_uframes_t wanted = m_period_frames - frames;
+        if (static_cast<snd_pcm_uframes_t>(avail) < wanted) {
+            int ready = snd_pcm_wait(m_handle, 1000);
+            if (ready < 0) {
+                frames = 0;
+                return recover(ready) ? ReadStatus::Overrun : ReadStatus::Error;
+            } else if (ready == 0) {
+                VK_LOG_ERROR("ALSA capture stalled: no audio for 1 s.");
+                return ReadStatus::Error;
+            }
+            continue;
+        }
+
+        // The mapped area may be shorter than asked for when it wraps; loop for the rest
+        const snd_pcm_channel_area_t* areas;
+        snd_pcm_uframes_t offset;
+        snd_pcm_uframes_t chunk = wanted;
+        int err = snd_pcm_mmap_begin(m_handle, &areas, &offset, &chunk);
+        if (err < 0) {
+            frames = 0;
+            return recover(err) ? ReadStatus::Overrun : ReadStatus::Error;
+        }
+        // Interleaved S16: 'first' and 'step' are in bits, all channels share area 0
+        const char* base = static_cast<const char*>(areas[0].addr) + (areas[0].first + offset * areas[0].step) / 8;
+        std::memcpy(out + frames * m_channels, base, chunk * m_channels * sizeof(int16_t));
+        snd_pcm_sframes_t committed = snd_pcm_mmap_commit(m_handle, offset, chunk);
+        if (committed < 0 || static_cast<snd_pcm_uframes_t>(committed) != chunk) {
+            frames = 0;
+            return recover(committed < 0 ? static_cast<int>(committed) : -EPIPE) ? ReadStatus::Overrun : ReadStatus::Error;
+        }
+        frames += chunk;
+    }
+    return ReadStatus::Ok;
+}
+
+void AlsaAudioSource::pause() {
+    if (m_handle) {
+        snd_pcm_drop(m_handle); // Stops the stream without closing the device
+    }
+}
+
+bool AlsaAudioSource::resume() {
+    if (!m_handle) {
+        return false;
+    }
+    // Back to PREPARED; the next read starts the stream again
+    int err = snd_pcm_prepare(m_handle);
+    if (err < 0) {
+        VK_LOG_ERROR("Cannot prepare audio interface after standby: " << snd_strerror(err));
+        return false;
+    }
+    return true;
+}
+
+uint64_t AlsaAudioSource::last_period_end_ns() {
+    uint64_t now = LatencyTracer::now_ns();
+    snd_pcm_uframes_t avail = 0;
+    snd_htimestamp_t tstamp;
+    if (!m_handle || snd_pcm_htimestamp(m_handle, &avail, &tstamp) < 0 || (tstamp.tv_sec == 0 && tstamp.tv_nsec == 0)) {
+        return now; // No hardware timestamp: the read returning is the best we know
+    }
+    // tstamp is when the hardware pointer was last updated, 'avail' frames past what we just read
+    uint64_t hw_ns = static_cast<uint64_t>(tstamp.tv_sec) * 1000000000ull + static_cast<uint64_t>(tstamp.tv_nsec);
+    uint64_t queued_ns = static_cast<uint64_t>(avail) * 1000000000ull / m_sample_rate;
+    uint64_t end_ns = hw_ns > queued_ns ? hw_ns - queued_ns : hw_ns;
+    return end_ns < now ? end_ns : now;
+}
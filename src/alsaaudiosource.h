@@ -0,0 +1,37 @@
+// alsaaudiosource.h
+// Header file for the AlsaAudioSource class.
+// Captures from an ALSA PCM device. With read/write access each period is one blocking
+// snd_pcm_readi(); with mmap access the capture thread waits on the device and copies the
+// period straight out of the mapped ring buffer into the caller's buffer
+// (snd_pcm_mmap_begin/commit), without a read system call per period.
+
+#ifndef ALSA_AUDIO_SOURCE_H
+#define ALSA_AUDIO_SOURCE_H
+
+#include "audiosource.h"
+#include <alsa/asoundlib.h>
+
+class AlsaAudioSource : public AudioSource {
+public:
+    explicit AlsaAudioSource(bool use_mmap);
+    ~AlsaAudioSource() override;
+
+    const char* name() const override { return m_use_mmap ? "alsa-mmap" : "alsa"; }
+
+    bool open(const AudioSourceConfig& config) override;
+    void close() override;
+    ReadStatus read(int16_t* out, size_t& frames) override;
+    void pause() override;
+    bool resume() override;
+    uint64_t last_period_end_ns() override;
+
+private:
+    ReadStatus read_mmap(int16_t* out, size_t& frames);
+    // Recovers from an xrun or suspend; false if the device is unusable
+    bool recover(int err);
+
+    bool m_use_mmap;
+    snd_pcm_t* m_handle;
+};
+
+#endif // ALSA_AUDIO_SOURCE_H
@@ -0,0 +1,228 @@
+// audioconverter.cpp
+// Implementation file for the AudioConverter class.
+
+#include "audioconverter.h"
+#include "logger.h"
+#include <algorithm> // For std::min, std::copy
+#include <cmath>     // For std::sin, std::cos, std::ceil, std::lrint
+#include <numeric>   // For std::gcd
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Zero crossings of the sinc on each side of the centre tap. 16 keeps the stopband well
+// below what the recognizer's features can see, at ~100 taps per output for 48 kHz -> 16 kHz.
+constexpr double kZeroCrossings = 16.0;
+// Passband edge as a fraction of the output Nyquist frequency
+constexpr double kCutoff = 0.95;
+// Rate ratios needing more phases than this (e.g. 44100 -> 16001) are rejected
+constexpr unsigned kMaxPhases = 4096;
+constexpr double kPi = 3.14159265358979323846;
+
+inline int16_t to_sample(float value) {
+    long rounded = std::lrint(value);
+    return static_cast<int16_t>(std::min(32767L, std::max(-32768L, rounded)));
+}
+
+inline float dot_product(const float* x, const float* h, size_t taps) {
+#if defined(__SSE2__)
+    // taps is a multiple of four (see configure)
+    __m128 acc = _mm_setzero_ps();
+    for (size_t k = 0; k < taps; k += 4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(x + k), _mm_loadu_ps(h + k)));
+    }
+    __m128 high = _mm_movehl_ps(acc, acc);
+    acc = _mm_add_ps(acc, high);
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc);
+#else
+    float acc = 0.0f;
+    for (size_t k = 0; k < taps; ++k) {
+        acc += x[k] * h[k];
+    }
+    return acc;
+#endif
+}
+
+} // namespace
+
+AudioConverter::AudioConverter()
+    : m_in_rate(16000),
+      m_in_channels(1),
+      m_out_rate(16000),
+      m_passthrough(true),
+      m_resample(false),
+      m_up(1),
+      m_down(1),
+      m_taps(0),
+      m_history_used(0),
+      m_position(0),
+      m_phase(0)
+{
+}
+
+bool AudioConverter::configure(unsigned in_rate, unsigned in_channels, unsigned out_rate, size_t max_in_frames) {
+    if (in_rate == 0 || in_channels == 0 || out_rate == 0 || max_in_frames == 0) {
+        VK_LOG_ERROR("AudioConverter: Invalid format " << in_rate << "Hz/" << in_channels << "ch -> " << out_rate << "Hz.");
+        return false;
+    }
+    unsigned divisor = std::gcd(in_rate, out_rate);
+    if (out_rate / divisor > kMaxPhases) {
+        VK_LOG_ERROR("AudioConverter: Cannot resample " << in_rate << "Hz to " << out_rate << "Hz (ratio too fine).");
+        return false;
+    }
+
+    m_in_rate = in_rate;
+    m_in_channels = in_channels;
+    m_out_rate = out_rate;
+    m_passthrough = (in_rate == out_rate && in_channels == 1);
+    m_resample = (in_rate != out_rate);
+    m_up = out_rate / divisor;
+    m_down = in_rate / divisor;
+    m_taps = 0;
+    m_coefficients.clear();
+
+    if (m_resample) {
+        // Low-pass at the lower of the two Nyquist frequencies, in input-sample time
+        double bandwidth = kCutoff * std::min(1.0, static_cast<double>(m_up) / m_down);
+        double half_width = kZeroCrossings / bandwidth;
+        m_taps = static_cast<size_t>(2.0 * std::ceil(half_width));
+        m_taps = (m_taps + 3) & ~static_cast<size_t>(3); // Whole SIMD steps
+        m_coefficients.assign(static_cast<size_t>(m_up) * m_taps, 0.0f);
+
+        // Tap k of phase p weighs the input sample (taps/2 - 1 - k + p/up) samples before the output instant
+        for (unsigned phase = 0; phase < m_up; ++phase) {
+            float* h = &m_coefficients[static_cast<size_t>(phase) * m_taps];
+            double sum = 0.0;
+            for (size_t k = 0; k < m_taps; ++k) {
+                double t = static_cast<double>(m_taps / 2) - 1.0 - static_cast<double>(k)
+                         + static_cast<double>(phase) / m_up;
+                if (std::abs(t) >= half_width) {
+                    continue;
+                }
+                double x = kPi * bandwidth * t;
+                double sinc = (x == 0.0) ? 1.0 : std::sin(x) / x;
+                double w = t / half_width; // Blackman window over [-1, 1]
+                double window = 0.42 + 0.5 * std::cos(kPi * w) + 0.08 * std::cos(2.0 * kPi * w);
+                h[k] = static_cast<float>(sinc * window);
+                sum += h[k];
+            }
+            // Unity gain at DC for every phase
+            for (size_t k = 0; k < m_taps; ++k) {
+                h[k] = static_cast<float>(h[k] / sum);
+            }
+        }
+    }
+
+    // Never more than taps - 1 samples are carried over between periods
+    m_history.assign(m_taps + max_in_frames, 0.0f);
+    reset();
+
+    if (!m_passthrough) {
+        VK_LOG_INFO("AudioConverter: " << in_rate << "Hz/" << in_channels << "ch -> " << out_rate << "Hz/1ch"
+                 << (m_resample ? ", " + std::to_string(m_up) + "/" + std::to_string(m_down)
+                                  + " polyphase, " + std::to_string(m_taps) + " taps" : std::string()));
+    }
+    return true;
+}
+
+size_t AudioConverter::max_output_frames(size_t in_frames) const {
+    if (!m_resample) {
+        return in_frames;
+    }
+    return (in_frames * m_up + m_down - 1) / m_down + 1;
+}
+
+void AudioConverter::reset() {
+    // Zeros before the first sample put it at the centre tap of the first output
+    m_history_used = m_taps > 0 ? m_taps / 2 - 1 : 0;
+    std::fill(m_history.begin(), m_history.begin() + m_history_used, 0.0f);
+    m_position = 0;
+    m_phase = 0;
+}
+
+void AudioConverter::downmix(const int16_t* in, size_t frames) {
+    float* out = m_history.data() + m_history_used;
+    size_t i = 0;
+
+    if (m_in_channels == 1) {
+#if defined(__SSE2__)
+        for (; i + 8 <= frames; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            // Sign-extend to 32 bits by unpacking against itself and shifting arithmetically
+            __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+            __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+            _mm_storeu_ps(out + i, _mm_cvtepi32_ps(lo));
+            _mm_storeu_ps(out + i + 4, _mm_cvtepi32_ps(hi));
+        }
+#endif
+        for (; i < frames; ++i) {
+            out[i] = in[i];
+        }
+    } else if (m_in_channels == 2) {
+#if defined(__SSE2__)
+        // madd against ones adds each left/right pair into one 32-bit lane: four frames per step
+        const __m128i ones = _mm_set1_epi16(1);
+        const __m128 half = _mm_set1_ps(0.5f);
+        for (; i + 4 <= frames; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2));
+            __m128 sums = _mm_cvtepi32_ps(_mm_madd_epi16(v, ones));
+            _mm_storeu_ps(out + i, _mm_mul_ps(sums, half));
+        }
+#endif
+        for (; i < frames; ++i) {
+            out[i] = 0.5f * (static_cast<float>(in[i * 2]) + in[i * 2 + 1]);
+        }
+    } else {
+        const float scale = 1.0f / m_in_channels;
+        for (; i < frames; ++i) {
+            int32_t sum = 0;
+            for (unsigned c = 0; c < m_in_channels; ++c) {
+                sum += in[i * m_in_channels + c];
+            }
+            out[i] = sum * scale;
+        }
+    }
+    m_history_used += frames;
+}
+
+size_t AudioConverter::process(const int16_t* in, size_t frames, int16_t* out) {
+    if (m_passthrough) {
+        std::copy(in, in + frames, out);
+        return frames;
+    }
+
+    size_t written = 0;
+    while (frames > 0) {
+        size_t chunk = std::min(frames, m_history.size() - m_history_used);
+        downmix(in, chunk);
+        in += chunk * m_in_channels;
+        frames -= chunk;
+
+        if (!m_resample) {
+            for (size_t i = 0; i < m_history_used; ++i) {
+                out[written++] = to_sample(m_history[i]);
+            }
+            m_history_used = 0;
+            continue;
+        }
+
+        while (m_position + m_taps <= m_history_used) {
+            const float* h = &m_coefficients[static_cast<size_t>(m_phase) * m_taps];
+            out[written++] = to_sample(dot_product(&m_history[m_position], h, m_taps));
+            m_phase += m_down;
+            m_position += m_phase / m_up;
+            m_phase %= m_up;
+        }
+        // Keep the samples the next outputs still need at the front
+        size_t consumed = std::min(m_position, m_history_used);
+        std::copy(m_history.begin() + consumed, m_history.begin() + m_history_used, m_history.begin());
+        m_history_used -= consumed;
+        m_position -= consumed;
+    }
+    return written;
+}
@@ -0,0 +1,65 @@
+// audioconverter.h
+// Header file for the AudioConverter class.
+// Turns periods captured at the device's native format into the mono stream at the model's
+// sample rate that the recognizer is created with: interleaved S16 is downmixed (SSE2 where
+// available) and resampled by a polyphase windowed-sinc FIR, writing straight into the
+// caller's buffer (normally a capture ring slot). Filter state carries across periods.
+// All buffers are sized in configure(), so process() never allocates.
+
+#ifndef AUDIO_CONVERTER_H
+#define AUDIO_CONVERTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class AudioConverter {
+public:
+    AudioConverter();
+
+    // in_rate/in_channels: capture format; out_rate: mono output rate.
+    // max_in_frames: the largest period process() will be given.
+    bool configure(unsigned in_rate, unsigned in_channels, unsigned out_rate, size_t max_in_frames);
+
+    // True when the capture format is already the output format and process() need not be called
+    bool passthrough() const { return m_passthrough; }
+
+    // Upper bound on the frames process() writes for 'in_frames' input frames
+    size_t max_output_frames(size_t in_frames) const;
+
+    // Converts 'frames' interleaved input frames into 'out' (room for max_output_frames(frames)).
+    // Returns the number of mono frames written.
+    size_t process(const int16_t* in, size_t frames, int16_t* out);
+
+    // Forgets the filter history, e.g. after the stream was stopped
+    void reset();
+
+    unsigned input_rate() const { return m_in_rate; }
+    unsigned input_channels() const { return m_in_channels; }
+    unsigned output_rate() const { return m_out_rate; }
+
+private:
+    // Appends 'frames' downmixed input frames to m_history as floats
+    void downmix(const int16_t* in, size_t frames);
+
+    unsigned m_in_rate;
+    unsigned m_in_channels;
+    unsigned m_out_rate;
+    bool m_passthrough;
+    bool m_resample;
+
+    // Polyphase filter: output sample n sits at input position n * m_down / m_up.
+    // m_taps coefficients per phase, m_up phases stored back to back.
+    unsigned m_up;
+    unsigned m_down;
+    size_t m_taps;
+    std::vector<float> m_coefficients;
+
+    // Downmixed input not yet fully consumed by the filter, m_history_used samples valid
+    std::vector<float> m_history;
+    size_t m_history_used;
+    size_t m_position; // Index in m_history of the first tap of the next output sample
+    unsigned m_phase;  // Filter phase of the next output sample
+};
+
+#endif // AUDIO_CONVERTER_H
@@ -0,0 +1,240 @@
+// audiofilereader.cpp
+// Implementation file for the AudioFileReader class.
+
+#include "audiofilereader.h"
+#include "logger.h"
+#include <algorithm> // For std::min
+#include <cerrno>
+#include <cstring>   // For std::memcmp, std::memcpy
+#include <fcntl.h>
+#include <limits>
+#include <poll.h>
+#include <sys/stat.h>
+
+// Little-endian field helpers for the RIFF header
+static uint16_t read_le16(const unsigned char* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t read_le32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+AudioFileReader::AudioFileReader()
+    : m_file(nullptr),
+      m_owns_file(false),
+      m_is_wav(false),
+      m_sample_rate(16000),
+      m_channels(1),
+      m_data_left(std::numeric_limits<uint64_t>::max()),
+      m_interrupt_fd(-1),
+      m_saved_flags(-1),
+      m_pending_pos(0)
+{
+}
+
+AudioFileReader::~AudioFileReader() {
+    close();
+}
+
+bool AudioFileReader::open(const std::string& path, unsigned raw_rate, unsigned raw_channels) {
+    if (path == "-") {
+        return open_stream(stdin, path, false, raw_rate, raw_channels);
+    }
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        close();
+        VK_LOG_ERROR("Cannot open audio file: " << path);
+        return false;
+    }
+    return open_stream(file, path, true, raw_rate, raw_channels);
+}
+
+bool AudioFileReader::open_stream(FILE* file, const std::string& name, bool take_ownership,
+                                  unsigned raw_rate, unsigned raw_channels) {
+    close();
+    m_path = name;
+    m_file = file;
+    m_owns_file = take_ownership;
+    const std::string& path = m_path;
+
+    m_sample_rate = raw_rate;
+    m_channels = raw_channels > 0 ? raw_channels : 1;
+    m_data_left = std::numeric_limits<uint64_t>::max();
+    m_is_wav = false;
+
+    // Regular files always have input (or EOF); anything else may block indefinitely
+    struct stat info;
+    int fd = fileno(file);
+    if (m_interrupt_fd >= 0 && fd >= 0 && fstat(fd, &info) == 0 && !S_ISREG(info.st_mode)) {
+        int flags = fcntl(fd, F_GETFL);
+        if (flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0) {
+            m_saved_flags = flags;
+        }
+    }
+
+    // Probe for "RIFF....WAVE". Without it the probed bytes are the first raw samples.
+    unsigned char riff[12];
+    size_t got = read_bytes(riff, sizeof(riff));
+    if (got == sizeof(riff) && std::memcmp(riff, "RIFF", 4) == 0 && std::memcmp(riff + 8, "WAVE", 4) == 0) {
+        m_is_wav = true;
+        if (!parse_wav_header()) {
+            VK_LOG_ERROR("Unsupported or malformed WAV file: " << path);
+            close();
+            return false;
+        }
+    } else {
+        m_pending.assign(riff, riff + got);
+        m_pending_pos = 0;
+    }
+    return true;
+}
+
+void AudioFileReader::close() {
+    if (m_file && m_saved_flags >= 0) {
+        // The descriptor may be shared (stdin, a dup'ed socket): leave it blocking as it was
+        fcntl(fileno(m_file), F_SETFL, m_saved_flags);
+    }
+    m_saved_flags = -1;
+    if (m_file && m_owns_file) {
+        std::fclose(m_file);
+    }
+    m_file = nullptr;
+    m_owns_file = false;
+    m_pending.clear();
+    m_pending_pos = 0;
+}
+
+bool AudioFileReader::parse_wav_header() {
+    bool have_format = false;
+    while (true) {
+        unsigned char chunk[8];
+        if (!read_exact(chunk, sizeof(chunk))) {
+            return false; // No data chunk
+        }
+        uint32_t size = read_le32(chunk + 4);
+        uint64_t padded = size + (size & 1); // Chunks are word-aligned
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0) {
+            unsigned char fmt[16];
+            if (size < sizeof(fmt) || !read_exact(fmt, sizeof(fmt)) || !skip_bytes(padded - sizeof(fmt))) {
+                return false;
+            }
+            uint16_t audio_format = read_le16(fmt);
+            uint16_t bits = read_le16(fmt + 14);
+            // 1 = PCM, 0xFFFE = WAVE_FORMAT_EXTENSIBLE (PCM subformat on every file we've seen)
+            if ((audio_format != 1 && audio_format != 0xFFFE) || bits != 16) {
+                VK_LOG_ERROR("Only 16-bit PCM WAV is supported (format " << audio_format
+                          << ", " << bits << " bits).");
+                return false;
+            }
+            m_channels = read_le16(fmt + 2);
+            m_sample_rate = read_le32(fmt + 4);
+            have_format = m_channels > 0 && m_sample_rate > 0;
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            // Streaming writers leave the size at 0 or 0xFFFFFFFF: read to end of stream
+            if (size != 0 && size != 0xFFFFFFFFu) {
+                m_data_left = size;
+            }
+            return have_format;
+        } else if (!skip_bytes(padded)) {
+            return false;
+        }
+    }
+}
+
+size_t AudioFileReader::read_bytes(unsigned char* buffer, size_t bytes) {
+    size_t copied = 0;
+    if (m_pending_pos < m_pending.size()) {
+        copied = std::min(bytes, m_pending.size() - m_pending_pos);
+        std::memcpy(buffer, m_pending.data() + m_pending_pos, copied);
+        m_pending_pos += copied;
+    }
+    while (copied < bytes && m_file) {
+        copied += std::fread(buffer + copied, 1, bytes - copied, m_file);
+        if (copied == bytes || m_saved_flags < 0 || !std::ferror(m_file) ||
+            (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            break; // Done, end of stream, or a real error
+        }
+        // Non-blocking stream without input for now
+        std::clearerr(m_file);
+        if (!wait_for_input()) {
+            break;
+        }
+    }
+    return copied;
+}
+
+bool AudioFileReader::wait_for_input() {
+    pollfd fds[2] = {
+        { fileno(m_file), POLLIN, 0 },
+        { m_interrupt_fd, POLLIN, 0 },
+    };
+    while (true) {
+        int ready = poll(fds, 2, -1);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready < 0 || (fds[1].revents & POLLIN)) {
+            return false;
+        }
+        return true; // Input, or a hangup the next fread() reports as the end
+    }
+}
+
+bool AudioFileReader::read_exact(void* buffer, size_t bytes) {
+    return read_bytes(static_cast<unsigned char*>(buffer), bytes) == bytes;
+}
+
+bool AudioFileReader::skip_bytes(uint64_t bytes) {
+    unsigned char scratch[256];
+    while (bytes > 0) {
+        size_t step = static_cast<size_t>(std::min<uint64_t>(bytes, sizeof(scratch)));
+        if (!read_exact(scratch, step)) {
+            return false;
+        }
+        bytes -= step;
+    }
+    return true;
+}
+
+size_t AudioFileReader::read(int16_t* out, size_t max_frames) {
+    if (!m_file || max_frames == 0) {
+        return 0;
+    }
+    const size_t frame_bytes = m_channels * sizeof(int16_t);
+    uint64_t want_bytes = std::min<uint64_t>(static_cast<uint64_t>(max_frames) * frame_bytes, m_data_left);
+    want_bytes -= want_bytes % frame_bytes;
+    if (want_bytes == 0) {
+        return 0;
+    }
+
+    size_t samples = static_cast<size_t>(want_bytes / sizeof(int16_t));
+    if (m_channels == 1) {
+        size_t got = read_bytes(reinterpret_cast<unsigned char*>(out), samples * sizeof(int16_t));
+        size_t frames = got / frame_bytes; // A trailing odd byte is dropped
+        if (m_data_left != std::numeric_limits<uint64_t>::max()) {
+            m_data_left -= got;
+        }
+        return frames;
+    }
+
+    if (m_interleaved.size() < samples) {
+        m_interleaved.resize(samples);
+    }
+    size_t got = read_bytes(reinterpret_cast<unsigned char*>(m_interleaved.data()), samples * sizeof(int16_t));
+    if (m_data_left != std::numeric_limits<uint64_t>::max()) {
+        m_data_left -= got;
+    }
+    size_t frames = got / frame_bytes;
+    const int16_t* in = m_interleaved.data();
+    for (size_t f = 0; f < frames; ++f) {
+        int32_t sum = 0;
+        for (unsigned c = 0; c < m_channels; ++c) {
+            sum += *in++;
+        }
+        out[f] = static_cast<int16_t>(sum / static_cast<int32_t>(m_channels));
+    }
+    return frames;
+}
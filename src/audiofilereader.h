@@ -0,0 +1,69 @@
+// audiofilereader.h
+// Header file for the AudioFileReader class.
+// Reads 16-bit PCM audio from a file or stdin for offline transcription. RIFF/WAV input
+// is detected from its header; anything else is taken as raw S16LE at a given rate and
+// channel count. Multi-channel audio is downmixed to the mono stream Vosk expects.
+// Samples are assumed to be little-endian on the host, as on every platform we ship.
+
+#ifndef AUDIO_FILE_READER_H
+#define AUDIO_FILE_READER_H
+
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class AudioFileReader {
+public:
+    AudioFileReader();
+    ~AudioFileReader();
+
+    AudioFileReader(const AudioFileReader&) = delete;
+    AudioFileReader& operator=(const AudioFileReader&) = delete;
+
+    // Opens 'path' ("-" reads stdin). raw_rate/raw_channels describe headerless input.
+    bool open(const std::string& path, unsigned raw_rate = 16000, unsigned raw_channels = 1);
+    // Same for an already open stream (e.g. fmemopen()); 'name' is used in messages.
+    // The reader fcloses it on close() when take_ownership is set.
+    bool open_stream(FILE* file, const std::string& name, bool take_ownership,
+                     unsigned raw_rate = 16000, unsigned raw_channels = 1);
+    void close();
+
+    // Before open(): pipes, sockets and terminals are then read without blocking and waited
+    // on with poll() next to 'fd' (an eventfd). Once another thread makes 'fd' readable, a
+    // read that waits for input returns what it has. -1 turns it off.
+    void set_interrupt_fd(int fd) { m_interrupt_fd = fd; }
+
+    // Reads up to max_frames mono frames into 'out'. Returns 0 at end of stream or on error.
+    size_t read(int16_t* out, size_t max_frames);
+
+    const std::string& path() const { return m_path; }
+    unsigned sample_rate() const { return m_sample_rate; }
+    unsigned channels() const { return m_channels; }
+    bool is_wav() const { return m_is_wav; }
+
+private:
+    std::string m_path;
+    FILE* m_file;
+    bool m_owns_file; // False for stdin
+    bool m_is_wav;
+    unsigned m_sample_rate;
+    unsigned m_channels;
+    uint64_t m_data_left; // Bytes left in the WAV data chunk, UINT64_MAX when unbounded
+    int m_interrupt_fd;
+    int m_saved_flags;    // File status flags to put back on close(), -1 if untouched
+
+    std::vector<unsigned char> m_pending; // Bytes consumed while probing the header that are audio
+    size_t m_pending_pos;
+    std::vector<int16_t> m_interleaved;   // Read buffer before downmixing
+
+    bool parse_wav_header();
+    bool read_exact(void* buffer, size_t bytes);
+    bool skip_bytes(uint64_t bytes); // Works on pipes, where fseek doesn't
+    size_t read_bytes(unsigned char* buffer, size_t bytes);
+    // Waits until the stream has input again; false if the interrupt fd fired first
+    bool wait_for_input();
+};
+
+#endif // AUDIO_FILE_READER_H
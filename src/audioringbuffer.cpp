@@ -0,0 +1,61 @@
+// audioringbuffer.cpp
+// Implementation file for the AudioRingBuffer class.
+
+#include "audioringbuffer.h"
+
+AudioRingBuffer::AudioRingBuffer(size_t depth, size_t period_samples)
+    : m_depth(depth > 0 ? depth : 1),
+      m_period_samples(period_samples),
+      m_samples(m_depth * period_samples),
+      m_slot_samples(m_depth, 0),
+      m_slot_timestamps(m_depth, 0),
+      m_write_count(0),
+      m_read_count(0)
+{
+}
+
+int16_t* AudioRingBuffer::acquire_write_slot() {
+    size_t write = m_write_count.load(std::memory_order_relaxed);
+    size_t read = m_read_count.load(std::memory_order_acquire);
+    if (write - read >= m_depth) {
+        return nullptr; // Full: the decoder has not released any slot yet
+    }
+    return m_samples.data() + (write % m_depth) * m_period_samples;
+}
+
+void AudioRingBuffer::commit_write_slot(size_t samples, uint64_t timestamp_ns) {
+    size_t write = m_write_count.load(std::memory_order_relaxed);
+    m_slot_timestamps[write % m_depth] = timestamp_ns;
+    m_slot_samples[write % m_depth] = samples < m_period_samples ? samples : m_period_samples;
+    m_write_count.store(write + 1, std::memory_order_release);
+}
+
+const int16_t* AudioRingBuffer::acquire_read_slot(size_t& samples, uint64_t* timestamp_ns) {
+    size_t read = m_read_count.load(std::memory_order_relaxed);
+    size_t write = m_write_count.load(std::memory_order_acquire);
+    if (read == write) {
+        samples = 0;
+        return nullptr; // Empty
+    }
+    size_t slot = read % m_depth;
+    samples = m_slot_samples[slot];
+    if (timestamp_ns) {
+        *timestamp_ns = m_slot_timestamps[slot];
+    }
+    return m_samples.data() + slot * m_period_samples;
+}
+
+void AudioRingBuffer::release_read_slot() {
+    size_t read = m_read_count.load(std::memory_order_relaxed);
+    m_read_count.store(read + 1, std::memory_order_release);
+}
+
+void AudioRingBuffer::reset() {
+    m_read_count.store(m_write_count.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+size_t AudioRingBuffer::size() const {
+    size_t write = m_write_count.load(std::memory_order_acquire);
+    size_t read = m_read_count.load(std::memory_order_acquire);
+    return write - read;
+}
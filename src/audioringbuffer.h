@@ -0,0 +1,58 @@
+// audioringbuffer.h
+// Header file for the AudioRingBuffer class.
+// A lock-free single-producer/single-consumer ring of fixed-size audio periods.
+// The capture thread writes S16 samples straight into a free slot and commits it,
+// the decoder thread reads committed slots in order and releases them.
+// All storage is allocated up front, so nothing is allocated per period.
+
+#ifndef AUDIO_RING_BUFFER_H
+#define AUDIO_RING_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class AudioRingBuffer {
+public:
+    // depth: number of period slots, period_samples: capacity of one slot in samples
+    AudioRingBuffer(size_t depth, size_t period_samples);
+
+    // --- Producer side (capture thread only) ---
+
+    // Returns a pointer to the next free slot, or nullptr if the ring is full.
+    int16_t* acquire_write_slot();
+    // Publishes the slot returned by acquire_write_slot() holding 'samples' samples.
+    // timestamp_ns is carried along with the period (capture time, for latency tracing).
+    void commit_write_slot(size_t samples, uint64_t timestamp_ns = 0);
+
+    // --- Consumer side (decoder thread only) ---
+
+    // Returns a pointer to the oldest committed slot and its sample count, or nullptr if empty.
+    // timestamp_ns, if given, receives the timestamp passed to commit_write_slot().
+    const int16_t* acquire_read_slot(size_t& samples, uint64_t* timestamp_ns = nullptr);
+    // Returns the slot obtained from acquire_read_slot() to the producer.
+    void release_read_slot();
+
+    // Drops all queued periods. Only call while neither thread is using the ring.
+    void reset();
+
+    // Number of committed periods waiting to be read (approximate when called concurrently)
+    size_t size() const;
+    size_t depth() const { return m_depth; }
+    size_t period_samples() const { return m_period_samples; }
+
+private:
+    const size_t m_depth;
+    const size_t m_period_samples;
+    std::vector<int16_t> m_samples;      // depth * period_samples contiguous samples
+    std::vector<size_t> m_slot_samples;  // valid samples per slot, written by the producer
+    std::vector<uint64_t> m_slot_timestamps;
+
+    // Monotonic counters; slot index is counter % depth.
+    // Kept on separate cache lines so producer and consumer don't false-share.
+    alignas(64) std::atomic<size_t> m_write_count;
+    alignas(64) std::atomic<size_t> m_read_count;
+};
+
+#endif // AUDIO_RING_BUFFER_H
@@ -0,0 +1,58 @@
+// audiosource.cpp
+// Implementation file for the AudioSource interface and its factory.
+
+#include "audiosource.h"
+#include "alsaaudiosource.h"
+#include "fileaudiosource.h"
+#include "latencytracer.h"
+#include "logger.h"
+#ifdef VK_HAVE_PULSE
+#include "pulseaudiosource.h"
+#endif
+#include <cstdlib> // For std::getenv, std::strtoul
+
+void AudioSourceConfig::load_from_environment() {
+    if (const char* backend_env = std::getenv("VK_AUDIO_BACKEND")) {
+        backend = backend_env;
+    }
+    if (const char* device_env = std::getenv("VK_AUDIO_DEVICE")) {
+        device = device_env;
+    }
+    if (const char* period_env = std::getenv("VK_AUDIO_PERIOD")) {
+        size_t frames = std::strtoul(period_env, nullptr, 10);
+        period_frames = frames > 0 ? frames : period_frames;
+    }
+    if (const char* buffer_env = std::getenv("VK_AUDIO_BUFFER")) {
+        size_t frames = std::strtoul(buffer_env, nullptr, 10);
+        buffer_frames = frames > 0 ? frames : buffer_frames;
+    }
+    if (const char* native_env = std::getenv("VK_AUDIO_NATIVE")) {
+        native_format = std::string(native_env) != "0";
+    }
+}
+
+uint64_t AudioSource::last_period_end_ns() {
+    return LatencyTracer::now_ns(); // The read returning is the best a source without timestamps knows
+}
+
+std::unique_ptr<AudioSource> create_audio_source(const std::string& backend) {
+    if (backend == "alsa") {
+        return std::make_unique<AlsaAudioSource>(false);
+    }
+    if (backend == "alsa-mmap") {
+        return std::make_unique<AlsaAudioSource>(true);
+    }
+    if (backend == "file") {
+        return std::make_unique<FileAudioSource>();
+    }
+    if (backend == "pulse" || backend == "pipewire") {
+#ifdef VK_HAVE_PULSE
+        return std::make_unique<PulseAudioSource>();
+#else
+        VK_LOG_ERROR("Audio backend '" << backend << "' is not built in (PulseAudio development files were missing).");
+        return nullptr;
+#endif
+    }
+    VK_LOG_ERROR("Unknown audio backend: " << backend);
+    return nullptr;
+}
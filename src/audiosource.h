@@ -0,0 +1,82 @@
+// audiosource.h
+// Header file for the AudioSource interface.
+// A capture backend that SpeechToTextService reads fixed-size periods of S16 audio from, on
+// its capture thread. Implementations: ALSA with read/write or mmap access, PulseAudio (which
+// is also how PipeWire desktops are reached, through pipewire-pulse) and file/stdin.
+
+#ifndef AUDIO_SOURCE_H
+#define AUDIO_SOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// What to open. Sizes are requests; the source reports what it actually got after open().
+struct AudioSourceConfig {
+    std::string backend = "alsa";   // alsa, alsa-mmap, pulse or file
+    std::string device;             // ALSA PCM, Pulse source or file path ("-" = stdin); empty = default
+    unsigned sample_rate = 16000;   // With native_format, only a hint: the device's own rate wins
+    unsigned channels = 1;
+    bool native_format = true;      // Capture what the hardware delivers; the service downmixes/resamples
+    size_t period_frames = 320;     // 20 ms at sample_rate; scaled if the device runs at another rate
+    size_t buffer_frames = 4000;    // 250 ms at sample_rate
+    bool realtime = true;           // File source: deliver periods at the rate they would be captured
+    int fd = -1;                    // File source: read this descriptor (e.g. a client socket) instead of 'device'
+
+    // Reads VK_AUDIO_BACKEND, VK_AUDIO_DEVICE, VK_AUDIO_PERIOD, VK_AUDIO_BUFFER (frames)
+    // and VK_AUDIO_NATIVE (0 lets the backend convert to sample_rate/channels itself)
+    void load_from_environment();
+};
+
+class AudioSource {
+public:
+    enum class ReadStatus {
+        Ok,          // 'frames' frames were read
+        Overrun,     // Audio was lost, the stream has been recovered; read again
+        EndOfStream, // File sources only
+        Error
+    };
+
+    virtual ~AudioSource() = default;
+
+    virtual const char* name() const = 0;
+
+    virtual bool open(const AudioSourceConfig& config) = 0;
+    virtual void close() = 0;
+
+    // Blocks until up to period_frames() frames are available and reads them into 'out',
+    // which must have room for period_frames() * channels() samples.
+    virtual ReadStatus read(int16_t* out, size_t& frames) = 0;
+
+    // Makes a read() that waits for input on another thread return EndOfStream, as does every
+    // later one that would wait, until the source is opened again. Lets capture be stopped on
+    // a source that may never deliver another period, like a pipe or a client socket. Safe
+    // from any thread while open. Device backends return within one period anyway and keep
+    // the default, which does nothing.
+    virtual void interrupt() {}
+
+    // Hot standby: stop the stream but keep the device open, and start it again
+    virtual void pause() {}
+    virtual bool resume() { return true; }
+
+    // CLOCK_MONOTONIC time at which the last period read ended (for latency tracing)
+    virtual uint64_t last_period_end_ns();
+
+    // Negotiated format, valid after open()
+    unsigned sample_rate() const { return m_sample_rate; }
+    unsigned channels() const { return m_channels; }
+    size_t period_frames() const { return m_period_frames; }
+    size_t buffer_frames() const { return m_buffer_frames; }
+
+protected:
+    unsigned m_sample_rate = 16000;
+    unsigned m_channels = 1;
+    size_t m_period_frames = 320;
+    size_t m_buffer_frames = 4000;
+};
+
+// Creates the source for config.backend, or nullptr if that backend is unknown or not built in
+std::unique_ptr<AudioSource> create_audio_source(const std::string& backend);
+
+#endif // AUDIO_SOURCE_H
@@ -0,0 +1,162 @@
+// batchrecognizer.cpp
+// Implementation file for the BatchRecognizer class.
+
+#include "batchrecognizer.h"
+#include "logger.h"
+#include <chrono>
+#include <cstdlib> // For std::getenv
+#include <mutex>   // For std::call_once
+#include <thread>
+
+// Include Vosk API header
+#include <vosk_api.h>
+
+DecoderBackend decoder_backend_from_environment() {
+    const char* decoder_env = std::getenv("VK_DECODER");
+    return (decoder_env && std::string(decoder_env) == "gpu") ? DecoderBackend::Gpu : DecoderBackend::Cpu;
+}
+
+BatchRecognizer::BatchRecognizer()
+    : m_model(nullptr),
+      m_recognizer(nullptr),
+      m_sample_rate(16000.0f),
+      m_has_audio(false)
+{
+}
+
+BatchRecognizer::~BatchRecognizer() {
+    close();
+}
+
+void BatchRecognizer::init_gpu() {
+    static std::once_flag once;
+    std::call_once(once, []() {
+        vosk_gpu_init(); // No-op in CPU builds of libvosk
+    });
+}
+
+void BatchRecognizer::init_thread() {
+    thread_local bool initialised = false;
+    if (!initialised) {
+        vosk_gpu_thread_init();
+        initialised = true;
+    }
+}
+
+bool BatchRecognizer::open(VoskBatchModel* model, float sample_rate) {
+    close();
+    if (!model) {
+        return false;
+    }
+    m_recognizer = vosk_batch_recognizer_new(model, sample_rate);
+    if (!m_recognizer) {
+        VK_LOG_ERROR("BatchRecognizer: Failed to create Vosk batch recognizer.");
+        return false;
+    }
+    m_model = model;
+    m_sample_rate = sample_rate;
+    m_has_audio = false;
+    return true;
+}
+
+void BatchRecognizer::close() {
+    drain_and_free();
+    m_model = nullptr;
+    m_finished_results.clear();
+}
+
+void BatchRecognizer::accept_waveform(const int16_t* samples, size_t count) {
+    m_has_audio = m_has_audio || count > 0;
+    vosk_batch_recognizer_accept_waveform(m_recognizer, reinterpret_cast<const char*>(samples),
+                                          static_cast<int>(count * sizeof(int16_t)));
+}
+
+const char* BatchRecognizer::next_result() {
+    if (!m_finished_results.empty()) {
+        m_result = std::move(m_finished_results.front());
+        m_finished_results.pop_front();
+        return m_result.c_str();
+    }
+    if (!m_recognizer) {
+        return nullptr;
+    }
+    const char* front = vosk_batch_recognizer_front_result(m_recognizer);
+    if (!front || front[0] == '\0') {
+        return nullptr;
+    }
+    m_result = front;
+    vosk_batch_recognizer_pop(m_recognizer);
+    return m_result.c_str();
+}
+
+void BatchRecognizer::finish() {
+    if (!m_recognizer) {
+        return;
+    }
+    drain_and_free();
+    restart();
+}
+
+void BatchRecognizer::reset() {
+    if (!m_recognizer) {
+        return;
+    }
+    drain_and_free();
+    m_finished_results.clear();
+    restart();
+}
+
+void BatchRecognizer::drain_and_free() {
+    if (!m_recognizer) {
+        return;
+    }
+    // Results that came back before the end of the stream
+    collect_results();
+    // The GPU pipeline delivers results into the recognizer from its own threads, so it may
+    // only be freed once its stream is closed and its final result has come back. Only this
+    // stream is waited for: vosk_batch_model_wait() would also wait out every other stream
+    // on the model, stalling this worker's other streams behind them.
+    vosk_batch_recognizer_finish_stream(m_recognizer);
+
+    const auto poll = std::chrono::milliseconds(1);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (true) {
+        // Results collected while chunks are still pending can be mid-utterance ones that were
+        // in the pipeline; only one that arrives after the last chunk is the end of the stream
+        bool drained = vosk_batch_recognizer_get_pending_chunks(m_recognizer) == 0;
+        size_t collected = collect_results();
+        if (drained && (collected > 0 || !m_has_audio)) {
+            break; // A stream that got no audio has no result to wait for
+        }
+        if (std::chrono::steady_clock::now() > deadline) {
+            // Better to wait for the whole model than free a recognizer the GPU still writes to
+            VK_LOG_WARNING("BatchRecognizer: GPU did not drain the stream in time; waiting for the model.");
+            vosk_batch_model_wait(m_model);
+            break;
+        }
+        std::this_thread::sleep_for(poll);
+    }
+    collect_results();
+    vosk_batch_recognizer_free(m_recognizer);
+    m_recognizer = nullptr;
+}
+
+size_t BatchRecognizer::collect_results() {
+    size_t collected = 0;
+    for (const char* front = vosk_batch_recognizer_front_result(m_recognizer); front && front[0] != '\0';
+         front = vosk_batch_recognizer_front_result(m_recognizer)) {
+        m_finished_results.emplace_back(front);
+        vosk_batch_recognizer_pop(m_recognizer);
+        collected++;
+    }
+    return collected;
+}
+
+void BatchRecognizer::restart() {
+    // A finished batch stream can't take more audio; the next utterance gets a new one
+    m_recognizer = vosk_batch_recognizer_new(m_model, m_sample_rate);
+    m_has_audio = false;
+    if (!m_recognizer) {
+        VK_LOG_ERROR("BatchRecognizer: Failed to restart the Vosk batch recognizer.");
+    }
+}
@@ -0,0 +1,82 @@
+// batchrecognizer.h
+// Header file for the BatchRecognizer class.
+// One audio stream decoded on the GPU through a shared VoskBatchModel (CUDA builds of
+// libvosk only). Unlike a VoskRecognizer, accepting audio only queues it for the GPU
+// pipeline; final results come back asynchronously and are collected with next_result().
+// There are no partial hypotheses and no grammars, so command mode and live preview keep
+// using the CPU recognizer.
+//
+// The process must call init_gpu() once from the main thread, and every thread that feeds
+// a BatchRecognizer must call init_thread() first. When no GPU can be used,
+// ModelCache::acquire_batch() returns nullptr and callers stay on the CPU path.
+
+#ifndef BATCH_RECOGNIZER_H
+#define BATCH_RECOGNIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+struct VoskBatchModel;
+struct VoskBatchRecognizer;
+
+// Which recognizer decodes dictation
+enum class DecoderBackend {
+    Cpu, // VoskRecognizer per stream (the default)
+    Gpu  // BatchRecognizer when a GPU batch model loads, the CPU otherwise
+};
+
+// VK_DECODER=gpu selects the GPU backend; anything else (or unset) keeps the CPU
+DecoderBackend decoder_backend_from_environment();
+
+class BatchRecognizer {
+public:
+    BatchRecognizer();
+    ~BatchRecognizer();
+
+    BatchRecognizer(const BatchRecognizer&) = delete;
+    BatchRecognizer& operator=(const BatchRecognizer&) = delete;
+
+    // vosk_gpu_init(), once per process (later calls do nothing). Main thread only.
+    static void init_gpu();
+    // vosk_gpu_thread_init(), once per calling thread
+    static void init_thread();
+
+    // Starts a stream on 'model' at 'sample_rate'. Returns false if the recognizer can't be created.
+    bool open(VoskBatchModel* model, float sample_rate);
+    void close();
+    bool is_open() const { return m_recognizer != nullptr; }
+
+    // Queues samples for decoding
+    void accept_waveform(const int16_t* samples, size_t count);
+
+    // Next final result JSON the GPU has produced for this stream, or nullptr if there is none
+    // yet. The pointer stays valid until the next call.
+    const char* next_result();
+
+    // Ends the utterance: waits until the GPU has decoded everything accepted so far and
+    // starts a fresh stream. Its remaining results are then returned by next_result().
+    void finish();
+
+    // Drops the utterance in progress and its pending results, and starts a fresh stream
+    void reset();
+
+private:
+    // Closes the stream, waits for the GPU to return its results (kept in m_finished_results)
+    // and frees the recognizer
+    void drain_and_free();
+    // Moves the results the GPU has returned so far to m_finished_results; returns how many
+    size_t collect_results();
+    // Opens a new stream on the same model and rate
+    void restart();
+
+    VoskBatchModel* m_model;
+    VoskBatchRecognizer* m_recognizer;
+    float m_sample_rate;
+    bool m_has_audio;                           // The current stream has accepted samples
+    std::deque<std::string> m_finished_results; // Collected from streams that finish() closed
+    std::string m_result;                       // Backs the pointer returned by next_result()
+};
+
+#endif // BATCH_RECOGNIZER_H
@@ -0,0 +1,215 @@
+// batchtranscriber.cpp
+// Implementation file for the BatchTranscriber class.
+
+#include "batchtranscriber.h"
+#include "audiofilereader.h"
+#include "modelcache.h"
+#include "recognitionresult.h"
+#include "logger.h"
+#include <algorithm> // For std::min
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+// Include Vosk API header
+#include <vosk_api.h>
+
+// Decodes one result JSON and keeps its text if it isn't empty
+static void collect_segment(const char* json, RecognitionResultDecoder& decoder, RecognitionResult& result,
+                            std::vector<std::string>& segments) {
+    if (!json || !*json) {
+        return;
+    }
+    if (!decoder.decode(json, result)) {
+        VK_LOG_WARNING("Could not parse Vosk result JSON: " << json);
+        return;
+    }
+    std::string_view text = result.best_text();
+    if (!text.empty()) {
+        segments.emplace_back(text);
+    }
+}
+
+BatchTranscriber::BatchTranscriber(const Options& options)
+    : m_options(options),
+      m_backend_used(Backend::Auto)
+{
+}
+
+unsigned BatchTranscriber::job_count() const {
+    if (m_options.jobs > 0) {
+        return m_options.jobs;
+    }
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores > 0 ? cores : 1;
+}
+
+bool BatchTranscriber::run(const std::vector<std::string>& inputs, std::vector<StreamResult>& results) {
+    results.assign(inputs.size(), StreamResult());
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        results[i].path = inputs[i];
+    }
+
+    vosk_set_log_level(-1); // Disable Vosk logging to console
+
+    if (m_options.backend != Backend::CpuThreads) {
+        vosk_gpu_init(); // No effect unless libvosk was built with CUDA
+        VoskBatchModel* model = vosk_batch_model_new(m_options.model_path.c_str());
+        if (model) {
+            m_backend_used = Backend::Batch;
+            bool ok = run_batch(model, inputs, results);
+            vosk_batch_model_free(model);
+            return ok;
+        }
+        if (m_options.backend == Backend::Batch) {
+            VK_LOG_ERROR("Failed to create Vosk batch model (is libvosk built with CUDA?): "
+                      << m_options.model_path);
+            return false;
+        }
+        VK_LOG_WARNING("Vosk batch model unavailable, falling back to " << job_count()
+                       << " CPU recognizer threads.");
+    }
+    m_backend_used = Backend::CpuThreads;
+    return run_cpu(inputs, results);
+}
+
+bool BatchTranscriber::run_batch(VoskBatchModel* model, const std::vector<std::string>& inputs,
+                                 std::vector<StreamResult>& results) {
+    struct Stream {
+        size_t index;
+        AudioFileReader reader;
+        VoskBatchRecognizer* recognizer = nullptr;
+        bool finished = false;
+    };
+
+    const size_t max_in_flight = job_count() * 8; // GPU batching wants many concurrent streams
+    std::vector<std::unique_ptr<Stream>> streams; // Finished streams stay until the final wait
+    std::vector<int16_t> chunk;
+    RecognitionResultDecoder decoder;
+    RecognitionResult result;
+    size_t next_input = 0;
+    size_t unfinished = 0;
+
+    auto drain_results = [&](Stream& stream) {
+        while (true) {
+            const char* json = vosk_batch_recognizer_front_result(stream.recognizer);
+            if (!json || !*json) {
+                break;
+            }
+            collect_segment(json, decoder, result, results[stream.index].segments);
+            vosk_batch_recognizer_pop(stream.recognizer);
+        }
+    };
+
+    while (next_input < inputs.size() || unfinished > 0) {
+        // Keep up to max_in_flight streams feeding
+        while (unfinished < max_in_flight && next_input < inputs.size()) {
+            auto stream = std::make_unique<Stream>();
+            stream->index = next_input++;
+            if (!stream->reader.open(inputs[stream->index], m_options.raw_rate, m_options.raw_channels)) {
+                continue;
+            }
+            stream->recognizer = vosk_batch_recognizer_new(model, static_cast<float>(stream->reader.sample_rate()));
+            if (!stream->recognizer) {
+                VK_LOG_ERROR("Failed to create Vosk batch recognizer for " << inputs[stream->index]);
+                continue;
+            }
+            streams.push_back(std::move(stream));
+            ++unfinished;
+        }
+
+        bool fed = false;
+        for (auto& stream : streams) {
+            drain_results(*stream);
+            if (stream->finished ||
+                vosk_batch_recognizer_get_pending_chunks(stream->recognizer) >= m_options.max_pending_chunks) {
+                continue;
+            }
+            size_t chunk_frames = static_cast<size_t>(stream->reader.sample_rate()) * m_options.chunk_ms / 1000;
+            if (chunk.size() < chunk_frames) {
+                chunk.resize(chunk_frames);
+            }
+            size_t frames = stream->reader.read(chunk.data(), chunk_frames);
+            if (frames > 0) {
+                vosk_batch_recognizer_accept_waveform(stream->recognizer, reinterpret_cast<const char*>(chunk.data()),
+                                                      static_cast<int>(frames * sizeof(int16_t)));
+                results[stream->index].audio_seconds += static_cast<double>(frames) / stream->reader.sample_rate();
+                fed = true;
+            } else {
+                vosk_batch_recognizer_finish_stream(stream->recognizer);
+                stream->reader.close();
+                stream->finished = true;
+                --unfinished;
+            }
+        }
+        if (!fed && unfinished > 0) {
+            // Every feeding stream is throttled: give the GPU pipeline time to catch up
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    vosk_batch_model_wait(model);
+    for (auto& stream : streams) {
+        drain_results(*stream);
+        vosk_batch_recognizer_free(stream->recognizer);
+        results[stream->index].ok = true;
+    }
+    return true;
+}
+
+bool BatchTranscriber::run_cpu(const std::vector<std::string>& inputs, std::vector<StreamResult>& results) {
+    VoskModel* model = ModelCache::instance().acquire(m_options.model_path);
+    if (!model) {
+        VK_LOG_ERROR("Failed to create Vosk model from path: " << m_options.model_path);
+        return false;
+    }
+
+    std::atomic<size_t> next_input(0);
+    auto worker = [&]() {
+        RecognitionResultDecoder decoder;
+        RecognitionResult result;
+        std::vector<int16_t> chunk;
+        AudioFileReader reader;
+
+        for (size_t index = next_input++; index < inputs.size(); index = next_input++) {
+            StreamResult& stream = results[index]; // Only this worker touches it
+            if (!reader.open(inputs[index], m_options.raw_rate, m_options.raw_channels)) {
+                continue;
+            }
+            VoskRecognizer* recognizer = vosk_recognizer_new(model, static_cast<float>(reader.sample_rate()));
+            if (!recognizer) {
+                VK_LOG_ERROR("Failed to create Vosk recognizer for " << inputs[index]);
+                continue;
+            }
+            size_t chunk_frames = static_cast<size_t>(reader.sample_rate()) * m_options.chunk_ms / 1000;
+            chunk.resize(chunk_frames > 0 ? chunk_frames : 1);
+
+            size_t frames;
+            while ((frames = reader.read(chunk.data(), chunk.size())) > 0) {
+                stream.audio_seconds += static_cast<double>(frames) / reader.sample_rate();
+                if (vosk_recognizer_accept_waveform(recognizer, reinterpret_cast<const char*>(chunk.data()),
+                                                    static_cast<int>(frames * sizeof(int16_t))) == 1) {
+                    collect_segment(vosk_recognizer_result(recognizer), decoder, result, stream.segments);
+                }
+            }
+            collect_segment(vosk_recognizer_final_result(recognizer), decoder, result, stream.segments);
+            vosk_recognizer_free(recognizer);
+            reader.close();
+            stream.ok = true;
+        }
+    };
+
+    size_t thread_count = std::min<size_t>(job_count(), inputs.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < thread_count; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker(); // The calling thread works too
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    ModelCache::instance().release(model);
+    return true;
+}
@@ -0,0 +1,60 @@
+// batchtranscriber.h
+// Header file for the BatchTranscriber class.
+// Transcribes recorded audio (files or stdin) without the GUI or ALSA, with many streams
+// in flight at once. Uses the Vosk batch API (VoskBatchModel/VoskBatchRecognizer) when
+// libvosk was built with CUDA, and otherwise one VoskRecognizer per worker thread on a
+// shared model from the ModelCache.
+
+#ifndef BATCH_TRANSCRIBER_H
+#define BATCH_TRANSCRIBER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct VoskBatchModel;
+
+class BatchTranscriber {
+public:
+    enum class Backend {
+        Auto,      // Batch API if available, otherwise CPU threads
+        Batch,     // Batch API only; fails if vosk_batch_model_new() fails
+        CpuThreads
+    };
+
+    struct Options {
+        std::string model_path;
+        Backend backend = Backend::Auto;
+        unsigned jobs = 0;          // CPU worker threads / batch streams in flight; 0 = hardware concurrency
+        unsigned raw_rate = 16000;  // Format of headerless input
+        unsigned raw_channels = 1;
+        unsigned chunk_ms = 200;    // Audio fed per accept_waveform call
+        int max_pending_chunks = 8; // Batch backend: per-stream backlog before feeding pauses
+    };
+
+    struct StreamResult {
+        std::string path;
+        std::vector<std::string> segments; // Final result texts, in order
+        double audio_seconds = 0.0;
+        bool ok = false;
+    };
+
+    explicit BatchTranscriber(const Options& options);
+
+    // Transcribes every input ("-" = stdin). results[i] belongs to inputs[i].
+    // Returns false if the model could not be loaded; per-stream failures are reported in StreamResult::ok.
+    bool run(const std::vector<std::string>& inputs, std::vector<StreamResult>& results);
+
+    // Backend that actually ran (Batch or CpuThreads), valid after run()
+    Backend backend_used() const { return m_backend_used; }
+
+private:
+    Options m_options;
+    Backend m_backend_used;
+
+    bool run_batch(VoskBatchModel* model, const std::vector<std::string>& inputs, std::vector<StreamResult>& results);
+    bool run_cpu(const std::vector<std::string>& inputs, std::vector<StreamResult>& results);
+    unsigned job_count() const;
+};
+
+#endif // BATCH_TRANSCRIBER_H
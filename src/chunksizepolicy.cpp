@@ -0,0 +1,93 @@
+// chunksizepolicy.cpp
+// Implementation file for the ChunkSizePolicy class.
+
+#include "chunksizepolicy.h"
+#include <algorithm> // For std::min, std::max
+#include <cstdlib>   // For std::getenv, std::strtoul
+
+namespace {
+
+// Weight of the newest chunk in the smoothed load
+constexpr float kLoadSmoothing = 0.2f;
+// Quiet chunks in a row before shrinking, so one fast chunk doesn't undo a grow
+constexpr size_t kCalmChunksToShrink = 8;
+
+} // namespace
+
+ChunkSizePolicy::ChunkSizePolicy()
+    : m_config{10, 200, 0, 0.6f, 0.25f, 2},
+      m_period_ms(50),
+      m_min_periods(1),
+      m_max_periods(1),
+      m_periods(1),
+      m_load(0.0f),
+      m_calm_chunks(0),
+      m_adjustments(0)
+{
+}
+
+void ChunkSizePolicy::set_config(const Config& config) {
+    m_config = config;
+}
+
+void ChunkSizePolicy::load_from_environment() {
+    auto read_ms = [](const char* name, unsigned& value) {
+        if (const char* env = std::getenv(name)) {
+            value = static_cast<unsigned>(std::strtoul(env, nullptr, 10));
+        }
+    };
+    read_ms("VK_CHUNK_MS", m_config.fixed_ms);
+    read_ms("VK_CHUNK_MIN_MS", m_config.min_ms);
+    read_ms("VK_CHUNK_MAX_MS", m_config.max_ms);
+}
+
+size_t ChunkSizePolicy::periods_for_ms(unsigned ms) const {
+    return std::max<size_t>(1, (ms + m_period_ms / 2) / m_period_ms); // Nearest whole period
+}
+
+void ChunkSizePolicy::reset(unsigned period_ms, size_t max_periods) {
+    m_period_ms = period_ms > 0 ? period_ms : 1;
+    max_periods = std::max<size_t>(1, max_periods);
+    if (m_config.fixed_ms > 0) {
+        m_min_periods = m_max_periods = std::min(periods_for_ms(m_config.fixed_ms), max_periods);
+    } else {
+        m_max_periods = std::min(periods_for_ms(m_config.max_ms), max_periods);
+        m_min_periods = std::min(periods_for_ms(m_config.min_ms), m_max_periods);
+    }
+    m_periods = m_min_periods;
+    m_load = 0.0f;
+    m_calm_chunks = 0;
+    m_adjustments = 0;
+}
+
+bool ChunkSizePolicy::record(size_t periods, uint64_t decode_ns, size_t queued_periods) {
+    if (periods == 0) {
+        return false;
+    }
+    uint64_t audio_ns = static_cast<uint64_t>(periods) * m_period_ms * 1000000ull;
+    float load = static_cast<float>(static_cast<double>(decode_ns) / audio_ns);
+    m_load = m_load == 0.0f ? load : m_load + kLoadSmoothing * (load - m_load);
+    if (m_min_periods == m_max_periods) {
+        return false; // Fixed chunk size
+    }
+
+    size_t previous = m_periods;
+    if (m_load > m_config.grow_load || queued_periods > m_periods + m_config.grow_backlog) {
+        // Falling behind: fewer, larger calls
+        m_periods = std::min(m_max_periods, m_periods * 2);
+        m_calm_chunks = 0;
+    } else if (m_load < m_config.shrink_load && queued_periods == 0) {
+        // Plenty of headroom: win latency back gradually
+        if (++m_calm_chunks >= kCalmChunksToShrink && m_periods > m_min_periods) {
+            m_periods--;
+            m_calm_chunks = 0;
+        }
+    } else {
+        m_calm_chunks = 0;
+    }
+    if (m_periods != previous) {
+        m_adjustments++;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,63 @@
+// chunksizepolicy.h
+// Header file for the ChunkSizePolicy class.
+// Decides how much audio the decoder thread hands to vosk_recognizer_accept_waveform at a
+// time, in whole capture periods. Small chunks keep latency down; large chunks amortise the
+// per-call cost, which is what slow CPUs need to keep up. The policy watches the decode
+// load (decode time / audio time, smoothed) and the ring backlog: sustained load or backlog
+// doubles the chunk, an idle decoder with an empty ring shrinks it one period at a time.
+// A fixed chunk (VK_CHUNK_MS) or tighter bounds (VK_CHUNK_MIN_MS/VK_CHUNK_MAX_MS) override it.
+
+#ifndef CHUNK_SIZE_POLICY_H
+#define CHUNK_SIZE_POLICY_H
+
+#include <cstddef>
+#include <cstdint>
+
+class ChunkSizePolicy {
+public:
+    struct Config {
+        unsigned min_ms;      // Smallest chunk (never below one period)
+        unsigned max_ms;      // Largest chunk
+        unsigned fixed_ms;    // Non-zero: always use this chunk size, no adaptation
+        float grow_load;      // Smoothed load above which chunks grow
+        float shrink_load;    // Smoothed load below which chunks shrink (with an empty ring)
+        size_t grow_backlog;  // Queued periods beyond one chunk that also make chunks grow
+    };
+
+    ChunkSizePolicy();
+
+    void set_config(const Config& config);
+    const Config& config() const { return m_config; }
+    // Reads VK_CHUNK_MS, VK_CHUNK_MIN_MS and VK_CHUNK_MAX_MS
+    void load_from_environment();
+
+    // Starts over for a stream with periods of period_ms, at the smallest allowed chunk
+    void reset(unsigned period_ms, size_t max_periods);
+
+    // Periods to gather into the next accept_waveform call
+    size_t periods_per_chunk() const { return m_periods; }
+    size_t max_periods() const { return m_max_periods; }
+    unsigned chunk_ms() const { return static_cast<unsigned>(m_periods * m_period_ms); }
+    // Smoothed decode load (1.0 = decoding takes as long as the audio lasts)
+    float load() const { return m_load; }
+    // Number of times the chunk size changed since reset()
+    uint64_t adjustments() const { return m_adjustments; }
+
+    // Reports one accept_waveform call: 'periods' periods decoded in decode_ns,
+    // with queued_periods still waiting in the ring. Returns true if the chunk size changed.
+    bool record(size_t periods, uint64_t decode_ns, size_t queued_periods);
+
+private:
+    size_t periods_for_ms(unsigned ms) const;
+
+    Config m_config;
+    unsigned m_period_ms;
+    size_t m_min_periods;
+    size_t m_max_periods;
+    size_t m_periods;
+    float m_load;
+    size_t m_calm_chunks; // Consecutive chunks below shrink_load with an empty ring
+    uint64_t m_adjustments;
+};
+
+#endif // CHUNK_SIZE_POLICY_H
@@ -0,0 +1,211 @@
+// commandgrammar.cpp
+// Implementation file for the CommandGrammar class.
+
+#include "commandgrammar.h"
+#include <cctype>
+#include <cstdlib> // For std::atoi
+
+const char* const CommandGrammar::ENTER_PHRASE = "command mode";
+
+namespace {
+
+const char* const NATO_ALPHABET[26] = {
+    "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel", "india",
+    "juliett", "kilo", "lima", "mike", "november", "oscar", "papa", "quebec", "romeo",
+    "sierra", "tango", "uniform", "victor", "whiskey", "x-ray", "yankee", "zulu"
+};
+
+const char* const DIGIT_NAMES[10] = {
+    "zero", "one", "two", "three", "four", "five", "six", "seven", "eight", "nine"
+};
+
+const char* const NUMBER_NAMES[13] = {
+    "", "one", "two", "three", "four", "five", "six", "seven", "eight", "nine", "ten", "eleven", "twelve"
+};
+
+struct NamedLabel {
+    const char* label;
+    const char* phrases[3]; // Up to three spoken forms, nullptr-terminated
+};
+
+// Everything on the layout that isn't a letter, digit or F-key
+const NamedLabel NAMED_LABELS[] = {
+    { "BACK",    { "backspace", "delete back", nullptr } },
+    { "SPACE",   { "space", nullptr, nullptr } },
+    { "ENTER",   { "enter", "return", nullptr } },
+    { "TAB",     { "tab", nullptr, nullptr } },
+    { "ESC",     { "escape", nullptr, nullptr } },
+    { "CAPS",    { "caps lock", nullptr, nullptr } },
+    { "SHIFT",   { "shift", nullptr, nullptr } },
+    { "CTRL",    { "control", nullptr, nullptr } },
+    { "ALT",     { "alt", nullptr, nullptr } },
+    { "ALTGR",   { "alt gr", nullptr, nullptr } },
+    { "COMPOSE", { "compose", nullptr, nullptr } },
+    { "HIDE",    { "hide keyboard", nullptr, nullptr } },
+    { "RETYPE",  { "retype", "retype last", nullptr } },
+    { "STATS",   { "stats", nullptr, nullptr } },
+    { "←",       { "left", nullptr, nullptr } },
+    { "↑",       { "up", nullptr, nullptr } },
+    { "↓",       { "down", nullptr, nullptr } },
+    { "→",       { "right", nullptr, nullptr } },
+    { "DEL",     { "delete", nullptr, nullptr } },
+    { "Home",    { "home", nullptr, nullptr } },
+    { "End",     { "end", nullptr, nullptr } },
+    { "PgUp",    { "page up", nullptr, nullptr } },
+    { "PgDn",    { "page down", nullptr, nullptr } },
+    { "`",       { "backtick", "grave", nullptr } },
+    { "-",       { "minus", "dash", nullptr } },
+    { "=",       { "equals", nullptr, nullptr } },
+    { "[",       { "left bracket", nullptr, nullptr } },
+    { "]",       { "right bracket", nullptr, nullptr } },
+    { "\\",      { "backslash", nullptr, nullptr } },
+    { ";",       { "semicolon", nullptr, nullptr } },
+    { "'",       { "apostrophe", "quote", nullptr } },
+    { ",",       { "comma", nullptr, nullptr } },
+    { ".",       { "period", "dot", nullptr } },
+    { "/",       { "slash", nullptr, nullptr } },
+};
+
+// Sticky modifier buttons: pressing one, then a key, then the modifier again sends the chord
+// and leaves the modifier as it was
+const char* const MODIFIER_LABELS[] = { "CTRL", "ALT", "SHIFT", "ALTGR" };
+
+bool is_modifier(const std::string& label) {
+    for (const char* modifier : MODIFIER_LABELS) {
+        if (label == modifier) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Keys that can't be part of a chord (toggles without a key of their own, window actions)
+bool is_chordable(const std::string& label) {
+    return !is_modifier(label) && label != "CAPS" && label != "COMPOSE" && label != "HIDE" &&
+           label != "RETYPE" && label != "STATS";
+}
+
+std::vector<std::string> spoken_forms(const std::string& label) {
+    std::vector<std::string> forms;
+    if (label.size() == 1 && std::isalpha(static_cast<unsigned char>(label[0]))) {
+        char letter = static_cast<char>(std::tolower(static_cast<unsigned char>(label[0])));
+        forms.push_back(std::string(1, letter));
+        forms.push_back(NATO_ALPHABET[letter - 'a']);
+        return forms;
+    }
+    if (label.size() == 1 && std::isdigit(static_cast<unsigned char>(label[0]))) {
+        forms.push_back(DIGIT_NAMES[label[0] - '0']);
+        return forms;
+    }
+    if (label.size() > 1 && label[0] == 'F' && std::isdigit(static_cast<unsigned char>(label[1]))) {
+        int number = std::atoi(label.c_str() + 1);
+        if (number >= 1 && number <= 12) {
+            forms.push_back(std::string("f ") + NUMBER_NAMES[number]);
+        }
+        return forms;
+    }
+    for (const NamedLabel& named : NAMED_LABELS) {
+        if (label == named.label) {
+            for (const char* phrase : named.phrases) {
+                if (phrase) {
+                    forms.push_back(phrase);
+                }
+            }
+            break;
+        }
+    }
+    return forms;
+}
+
+void append_json_string(std::string& json, const std::string& text) {
+    json += '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            json += '\\';
+        }
+        json += c;
+    }
+    json += '"';
+}
+
+} // namespace
+
+void CommandGrammar::add_phrase(const std::string& phrase, Command command) {
+    // First label wins when two buttons share a phrase (e.g. the two SHIFT keys)
+    m_commands.emplace(phrase, std::move(command));
+}
+
+void CommandGrammar::build(const std::vector<std::string>& labels) {
+    m_commands.clear();
+
+    std::vector<std::string> modifiers;
+    std::vector<std::string> keys;
+    for (const std::string& label : labels) {
+        std::vector<std::string> forms = spoken_forms(label);
+        if (forms.empty()) {
+            continue; // KILL, the MIC button and anything we have no words for
+        }
+        for (const std::string& form : forms) {
+            add_phrase(form, Command { Action::PressButtons, { label } });
+        }
+        if (is_modifier(label)) {
+            modifiers.push_back(label);
+        } else if (is_chordable(label)) {
+            keys.push_back(label);
+        }
+    }
+
+    // "control c", "alt f four", and "control shift t" for the common two-modifier chords
+    for (const std::string& modifier : modifiers) {
+        std::string modifier_phrase = spoken_forms(modifier).front();
+        for (const std::string& key : keys) {
+            for (const std::string& form : spoken_forms(key)) {
+                add_phrase(modifier_phrase + " " + form, Command { Action::PressButtons, { modifier, key, modifier } });
+            }
+        }
+    }
+    bool has_ctrl = m_commands.count("control") > 0;
+    bool has_shift = m_commands.count("shift") > 0;
+    if (has_ctrl && has_shift) {
+        for (const std::string& key : keys) {
+            for (const std::string& form : spoken_forms(key)) {
+                add_phrase("control shift " + form,
+                           Command { Action::PressButtons, { "CTRL", "SHIFT", key, "SHIFT", "CTRL" } });
+            }
+        }
+    }
+
+    // RETYPE itself types the last transcript; these go further back
+    if (m_commands.count("retype") > 0) {
+        for (size_t count = 2; count <= 10; ++count) {
+            add_phrase(std::string("retype last ") + NUMBER_NAMES[count], Command { Action::Retype, {}, count });
+        }
+    }
+
+    // STATS toggles the overlay like its key; these say which way
+    if (m_commands.count("stats") > 0) {
+        add_phrase("show stats", Command { Action::StatsOverlay, {}, 1 });
+        add_phrase("hide stats", Command { Action::StatsOverlay, {}, 0 });
+    }
+
+    add_phrase("dictation mode", Command { Action::DictationMode, {} });
+    add_phrase("dictation", Command { Action::DictationMode, {} });
+
+    m_grammar_json = "[";
+    for (const auto& entry : m_commands) {
+        append_json_string(m_grammar_json, entry.first);
+        m_grammar_json += ", ";
+    }
+    m_grammar_json += "\"[unk]\"]"; // Absorbs speech that is no command instead of forcing a match
+}
+
+const CommandGrammar::Command* CommandGrammar::lookup(const std::string& phrase) const {
+    // Vosk pads results with spaces in places; compare the trimmed text
+    size_t start = phrase.find_first_not_of(' ');
+    size_t end = phrase.find_last_not_of(' ');
+    if (start == std::string::npos) {
+        return nullptr;
+    }
+    auto it = m_commands.find(phrase.substr(start, end - start + 1));
+    return it != m_commands.end() ? &it->second : nullptr;
+}
@@ -0,0 +1,55 @@
+// commandgrammar.h
+// Header file for the CommandGrammar class.
+// The vocabulary of voice command mode, generated from the keyboard's live button labels
+// (and their FN-shifted alternatives): each label gets one or more spoken phrases ("enter",
+// "backspace", "left", "alpha"/"a", "seven", "f five", ...), and every non-modifier key can
+// be prefixed by the modifiers ("control c", "alt f four", "shift tab"). A layout with a
+// RETYPE key also gets "retype last two" ... "retype last ten", one with a STATS key "show
+// stats" and "hide stats".
+// grammar_json() is the JSON phrase array handed to vosk_recognizer_new_grm/set_grm;
+// lookup() turns a recognized phrase back into the button presses it stands for.
+
+#ifndef COMMAND_GRAMMAR_H
+#define COMMAND_GRAMMAR_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+class CommandGrammar {
+public:
+    enum class Action {
+        PressButtons,   // Feed 'labels' to Keyboard::handle_button_press in order
+        DictationMode,  // Leave command mode
+        Retype,         // Type the last 'count' journaled transcripts again
+        StatsOverlay    // Show the stats overlay ('count' 1) or hide it (0)
+    };
+
+    struct Command {
+        Action action;
+        std::vector<std::string> labels;
+        size_t count = 0; // Action::Retype, Action::StatsOverlay
+    };
+
+    // Phrase that switches from dictation to command mode when it is a whole transcript
+    static const char* const ENTER_PHRASE;
+
+    // Rebuilds the phrase table for the given button labels. Labels without a spoken form
+    // (and buttons that must not be voice-operated, like KILL and the MIC button) are skipped.
+    void build(const std::vector<std::string>& labels);
+
+    const std::string& grammar_json() const { return m_grammar_json; }
+    size_t phrase_count() const { return m_commands.size(); }
+
+    // The command for a recognized phrase, or nullptr if it isn't one
+    const Command* lookup(const std::string& phrase) const;
+
+private:
+    void add_phrase(const std::string& phrase, Command command);
+
+    std::map<std::string, Command> m_commands;
+    std::string m_grammar_json;
+};
+
+#endif // COMMAND_GRAMMAR_H
@@ -0,0 +1,193 @@
+// controlsocket.cpp
+// Implementation file for the ControlSocket class.
+
+#include "controlsocket.h"
+#include "logger.h"
+#include <cerrno>
+#include <cstdlib> // For std::getenv
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h> // For umask
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t MAX_CLIENTS = 8;
+const size_t MAX_LINE_BYTES = 4096;
+
+bool fill_address(const std::string& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        VK_LOG_ERROR("ControlSocket: Bad socket path '" << path << "'.");
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Sends all of 'data' unless the client's socket buffer is full
+bool send_all(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+ControlSocket::ControlSocket()
+    : m_listen_fd(-1)
+{
+}
+
+ControlSocket::~ControlSocket() {
+    close();
+}
+
+std::string ControlSocket::path_from_environment() {
+    if (const char* socket_env = std::getenv("VK_CONTROL_SOCKET")) {
+        return socket_env;
+    }
+    const char* control_env = std::getenv("VK_CONTROL");
+    if (!control_env || std::string(control_env) != "1") {
+        return "";
+    }
+    if (const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR")) {
+        return std::string(runtime_dir) + "/vk-keyboard.sock";
+    }
+    return "/tmp/vk-keyboard-" + std::to_string(getuid()) + ".sock";
+}
+
+bool ControlSocket::open(const std::string& path, Handler handler) {
+    close();
+    sockaddr_un address;
+    if (!fill_address(path, address)) {
+        return false;
+    }
+    // Refuse to take over the socket of a keyboard that is still running; replace a stale one
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe >= 0) {
+        bool in_use = connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        ::close(probe);
+        if (in_use) {
+            VK_LOG_ERROR("ControlSocket: Another keyboard is already serving " << path << ".");
+            return false;
+        }
+    }
+    unlink(path.c_str());
+
+    m_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (m_listen_fd < 0) {
+        VK_LOG_ERROR("ControlSocket: socket failed: " << std::strerror(errno));
+        return false;
+    }
+    mode_t old_mask = umask(0077); // Owner-only: the knobs change what gets typed
+    int bound = bind(m_listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    umask(old_mask);
+    if (bound != 0 || listen(m_listen_fd, 4) != 0) {
+        VK_LOG_ERROR("ControlSocket: Cannot listen on " << path << ": " << std::strerror(errno));
+        ::close(m_listen_fd);
+        m_listen_fd = -1;
+        return false;
+    }
+    m_path = path;
+    m_handler = std::move(handler);
+    m_accept_watch = Glib::signal_io().connect(sigc::mem_fun(*this, &ControlSocket::on_accept),
+                                               m_listen_fd, Glib::IO_IN);
+    VK_LOG_INFO("ControlSocket: Listening on " << m_path << ".");
+    return true;
+}
+
+void ControlSocket::close() {
+    for (auto& entry : m_clients) {
+        entry.second.watch.disconnect();
+        ::close(entry.first);
+    }
+    m_clients.clear();
+    if (m_listen_fd >= 0) {
+        m_accept_watch.disconnect();
+        ::close(m_listen_fd);
+        m_listen_fd = -1;
+        unlink(m_path.c_str());
+    }
+}
+
+bool ControlSocket::on_accept(Glib::IOCondition) {
+    int fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (fd < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            VK_LOG_WARNING("ControlSocket: accept failed: " << std::strerror(errno));
+        }
+        return true;
+    }
+    if (m_clients.size() >= MAX_CLIENTS) {
+        send_all(fd, "error: too many control clients\n");
+        ::close(fd);
+        return true;
+    }
+    Client& client = m_clients[fd];
+    client.watch = Glib::signal_io().connect(
+        [this, fd](Glib::IOCondition condition) { return on_client_io(fd, condition); },
+        fd, Glib::IO_IN | Glib::IO_HUP | Glib::IO_ERR);
+    return true;
+}
+
+bool ControlSocket::on_client_io(int fd, Glib::IOCondition) {
+    auto it = m_clients.find(fd);
+    if (it == m_clients.end()) {
+        return false;
+    }
+    char buffer[1024];
+    ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return true;
+    }
+    if (n > 0) {
+        it->second.input.append(buffer, static_cast<size_t>(n));
+        if (process_lines(fd, it->second)) {
+            return true;
+        }
+    }
+    // End of input, an error, or a client that doesn't take its replies. Returning false
+    // removes the watch, so only the socket and the entry are left to release.
+    ::close(fd);
+    m_clients.erase(fd);
+    return false;
+}
+
+bool ControlSocket::process_lines(int fd, Client& client) {
+    size_t start = 0;
+    size_t end;
+    while ((end = client.input.find('\n', start)) != std::string::npos) {
+        std::string command = client.input.substr(start, end - start);
+        start = end + 1;
+        if (!command.empty() && command.back() == '\r') {
+            command.pop_back();
+        }
+        if (command.empty()) {
+            continue;
+        }
+        std::string reply = m_handler ? m_handler(command) : "error: not handled";
+        reply += '\n';
+        if (!send_all(fd, reply)) {
+            VK_LOG_WARNING("ControlSocket: Client is not reading its replies; disconnecting.");
+            return false;
+        }
+    }
+    client.input.erase(0, start);
+    if (client.input.size() > MAX_LINE_BYTES) {
+        VK_LOG_WARNING("ControlSocket: Command line too long; disconnecting.");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,62 @@
+// controlsocket.h
+// Header file for the ControlSocket class.
+// Line-based control channel of a running keyboard on an owner-only Unix domain socket, so
+// scripts (or `socat - UNIX-CONNECT:<path>`) can read the runtime stats and adjust tuning
+// knobs without a restart. Each line a client sends is one command; the handler's answer
+// goes back as one line. The listening socket and every client are watched from the GTK
+// main loop through Glib::signal_io, so the handler runs on the main thread and may touch
+// widgets and the speech service like any other event handler. Replies are written
+// without blocking: a client that stops reading them is disconnected.
+
+#ifndef CONTROL_SOCKET_H
+#define CONTROL_SOCKET_H
+
+#include <functional>
+#include <map>
+#include <string>
+#include <glibmm/main.h> // For Glib::IOCondition
+#include <sigc++/sigc++.h> // For sigc::connection
+
+class ControlSocket {
+public:
+    // Gets one command line (without the newline), returns the reply line
+    using Handler = std::function<std::string(const std::string& command)>;
+
+    ControlSocket();
+    ~ControlSocket(); // close()
+
+    ControlSocket(const ControlSocket&) = delete;
+    ControlSocket& operator=(const ControlSocket&) = delete;
+
+    // Path from VK_CONTROL_SOCKET when VK_CONTROL=1 or VK_CONTROL_SOCKET is set, empty otherwise.
+    // Defaults to $XDG_RUNTIME_DIR/vk-keyboard.sock, else /tmp/vk-keyboard-<uid>.sock.
+    static std::string path_from_environment();
+
+    // Listens on 'path' from the default main context. Fails if another keyboard is already
+    // serving it; a stale socket file is replaced.
+    bool open(const std::string& path, Handler handler);
+    // Disconnects every client and removes the socket
+    void close();
+
+    bool is_open() const { return m_listen_fd >= 0; }
+    const std::string& path() const { return m_path; }
+
+private:
+    struct Client {
+        std::string input; // Bytes received after the last complete line
+        sigc::connection watch;
+    };
+
+    bool on_accept(Glib::IOCondition condition);
+    bool on_client_io(int fd, Glib::IOCondition condition);
+    // Runs the handler on every complete line; false if the client has to be dropped
+    bool process_lines(int fd, Client& client);
+
+    std::string m_path;
+    int m_listen_fd;
+    Handler m_handler;
+    sigc::connection m_accept_watch;
+    std::map<int, Client> m_clients; // By socket
+};
+
+#endif // CONTROL_SOCKET_H
@@ -0,0 +1,86 @@
+// fileaudiosource.cpp
+// Implementation file for the FileAudioSource class.
+
+#include "fileaudiosource.h"
+#include "logger.h"
+#include <cstdio>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h> // For dup
+
+FileAudioSource::FileAudioSource()
+    : m_interrupt_fd(-1),
+      m_realtime(true)
+{
+}
+
+bool FileAudioSource::open(const AudioSourceConfig& config) {
+    close();
+    std::string path = config.device.empty() ? "-" : config.device;
+    m_interrupt_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_interrupt_fd < 0) {
+        VK_LOG_WARNING("FileAudioSource: No eventfd; stopping will wait for input to end.");
+    }
+    m_reader.set_interrupt_fd(m_interrupt_fd);
+    if (config.fd >= 0) {
+        int fd = dup(config.fd);
+        FILE* file = fd >= 0 ? fdopen(fd, "rb") : nullptr;
+        if (!file) {
+            VK_LOG_ERROR("FileAudioSource: Cannot read descriptor " << config.fd);
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            return false;
+        }
+        path = config.device.empty() ? "fd " + std::to_string(config.fd) : config.device;
+        if (!m_reader.open_stream(file, path, true, config.sample_rate, config.channels)) {
+            return false;
+        }
+    } else if (!m_reader.open(path, config.sample_rate, config.channels)) {
+        return false;
+    }
+    m_sample_rate = m_reader.sample_rate();
+    m_channels = 1; // AudioFileReader downmixes
+    m_period_frames = config.period_frames;
+    m_buffer_frames = config.buffer_frames;
+    m_realtime = config.realtime;
+    m_next_period = std::chrono::steady_clock::now();
+    VK_LOG_INFO("FileAudioSource: Replaying " << path << " at " << m_sample_rate << "Hz"
+             << (m_realtime ? " in real time" : "") << ", Period Size (frames): " << m_period_frames);
+    return true;
+}
+
+void FileAudioSource::close() {
+    m_reader.close();
+    if (m_interrupt_fd >= 0) {
+        ::close(m_interrupt_fd);
+        m_interrupt_fd = -1;
+    }
+}
+
+void FileAudioSource::interrupt() {
+    if (m_interrupt_fd >= 0) {
+        uint64_t one = 1;
+        if (write(m_interrupt_fd, &one, sizeof(one)) < 0) {
+            VK_LOG_WARNING("FileAudioSource: Cannot interrupt the read.");
+        }
+    }
+}
+
+AudioSource::ReadStatus FileAudioSource::read(int16_t* out, size_t& frames) {
+    frames = m_reader.read(out, m_period_frames);
+    if (frames == 0) {
+        return ReadStatus::EndOfStream;
+    }
+    if (m_realtime) {
+        // A microphone delivers a period only once it has been recorded
+        m_next_period += std::chrono::microseconds(frames * 1000000ull / m_sample_rate);
+        std::this_thread::sleep_until(m_next_period);
+    }
+    return ReadStatus::Ok;
+}
+
+bool FileAudioSource::resume() {
+    m_next_period = std::chrono::steady_clock::now(); // Don't catch up on the time spent paused
+    return true;
+}
@@ -0,0 +1,35 @@
+// fileaudiosource.h
+// Header file for the FileAudioSource class.
+// Replays a WAV or raw S16LE file (or stdin) as if it were being captured, optionally paced
+// at the rate the audio would arrive from a microphone. Useful for reproducing recognition
+// problems and for running the live pipeline on machines without a sound card.
+
+#ifndef FILE_AUDIO_SOURCE_H
+#define FILE_AUDIO_SOURCE_H
+
+#include "audiosource.h"
+#include "audiofilereader.h"
+#include <chrono>
+
+class FileAudioSource : public AudioSource {
+public:
+    FileAudioSource();
+
+    const char* name() const override { return "file"; }
+
+    // config.device is the path ("-" = stdin), or config.fd an open descriptor (which is
+    // duplicated, the caller keeps its own); sample_rate/channels describe raw input
+    bool open(const AudioSourceConfig& config) override;
+    void close() override;
+    ReadStatus read(int16_t* out, size_t& frames) override;
+    void interrupt() override;
+    bool resume() override;
+
+private:
+    AudioFileReader m_reader;
+    int m_interrupt_fd; // eventfd the reader polls next to a pipe or socket
+    bool m_realtime;
+    std::chrono::steady_clock::time_point m_next_period; // When the next period is "captured"
+};
+
+#endif // FILE_AUDIO_SOURCE_H
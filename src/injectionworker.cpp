@@ -0,0 +1,216 @@
+// injectionworker.cpp
+// Implementation file for the InjectionWorker class.
+
+#include "injectionworker.h"
+#include "latencytracer.h"
+#include "logger.h"
+#include "runtimestats.h"
+#include <X11/keysym.h>
+
+namespace {
+
+// Characters typed per flush; cancel() takes effect between slices
+constexpr size_t kSliceChars = 16;
+
+// Byte length of the first 'chars' UTF-8 code points of text[from..]
+size_t utf8_prefix_bytes(const std::string& text, size_t from, size_t chars) {
+    size_t end = from;
+    size_t count = 0;
+    while (end < text.size()) {
+        if ((static_cast<unsigned char>(text[end]) & 0xC0) != 0x80) {
+            if (count == chars) {
+                break;
+            }
+            count++;
+        }
+        end++;
+    }
+    return end - from;
+}
+
+} // namespace
+
+InjectionWorker::InjectionWorker()
+    : m_active(false),
+      m_running(false),
+      m_generation(0),
+      m_jobs_cancelled(0)
+{
+}
+
+InjectionWorker::~InjectionWorker() {
+    stop();
+}
+
+bool InjectionWorker::start(const char* display_name) {
+    if (running()) {
+        return true;
+    }
+    // Opened here but only used by the worker from now on
+    if (!m_injector.open(display_name)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = true;
+    }
+    m_thread = std::thread(&InjectionWorker::worker_loop, this);
+    return true;
+}
+
+void InjectionWorker::stop() {
+    if (!running()) {
+        return;
+    }
+    std::deque<Job> dropped;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        dropped.swap(m_jobs);
+    }
+    m_job_cv.notify_all();
+    m_thread.join();
+    m_injector.close();
+    for (Job& job : dropped) {
+        if (job.on_done) {
+            job.on_done(false);
+        }
+    }
+}
+
+void InjectionWorker::submit(Job job) {
+    if (!running()) {
+        VK_LOG_ERROR("InjectionWorker: Not running; output dropped.");
+        if (job.on_done) {
+            job.on_done(false);
+        }
+        return;
+    }
+    job.submitted_ns = LatencyTracer::now_ns();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_job_cv.notify_one();
+}
+
+void InjectionWorker::cancel() {
+    std::deque<Job> dropped;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        dropped.swap(m_jobs);
+        m_generation.fetch_add(1, std::memory_order_acq_rel);
+        // The running job notices within one slice
+        m_idle_cv.wait(lock, [this] { return !m_active; });
+    }
+    m_jobs_cancelled.fetch_add(dropped.size(), std::memory_order_relaxed);
+    for (Job& job : dropped) {
+        if (job.on_done) {
+            job.on_done(false);
+        }
+    }
+}
+
+void InjectionWorker::wait_idle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle_cv.wait(lock, [this] { return (!m_active && m_jobs.empty()) || !m_running; });
+}
+
+bool InjectionWorker::busy() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_active || !m_jobs.empty();
+}
+
+void InjectionWorker::worker_loop() {
+    LatencyTracer::instance().set_thread_name("inject");
+    while (true) {
+        Job job;
+        uint64_t generation;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_job_cv.wait(lock, [this] { return !m_jobs.empty() || !m_running; });
+            if (!m_running) {
+                break;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            m_active = true;
+            generation = m_generation.load(std::memory_order_acquire);
+        }
+
+        bool completed = run_job(job, generation);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_active = false;
+        }
+        m_idle_cv.notify_all();
+        if (!completed) {
+            m_jobs_cancelled.fetch_add(1, std::memory_order_relaxed);
+            VK_LOG_DEBUG("InjectionWorker: Output cancelled.");
+        }
+        if (job.on_done) {
+            job.on_done(completed);
+        }
+    }
+    m_idle_cv.notify_all(); // wait_idle() callers give up once the worker is gone
+}
+
+bool InjectionWorker::run_job(const Job& job, uint64_t generation) {
+    auto cancelled = [this, generation]() {
+        return m_generation.load(std::memory_order_acquire) != generation;
+    };
+    if (cancelled()) {
+        return false;
+    }
+    if (job.erase == 0 && job.text.empty() && job.key == NoSymbol) {
+        return true; // A barrier: only its on_done matters
+    }
+
+    if (job.erase > 0) {
+        m_injector.begin_batch();
+        m_injector.erase_chars(job.erase);
+        m_injector.end_batch();
+    }
+
+    // Each slice is its own batch: it is flushed (and spare keycodes released) before the
+    // next cancellation check, so a cancelled job never leaves a key or remapping behind
+    for (size_t offset = 0; offset < job.text.size();) {
+        if (cancelled()) {
+            return false;
+        }
+        size_t bytes = utf8_prefix_bytes(job.text, offset, kSliceChars);
+        m_injector.type_text(job.text.substr(offset, bytes));
+        offset += bytes;
+    }
+
+    if (job.key != NoSymbol) {
+        if (cancelled()) {
+            return false;
+        }
+        m_injector.begin_batch();
+        if (job.modifiers & CTRL) m_injector.send_keysym(XK_Control_L, true);
+        if (job.modifiers & ALT) m_injector.send_keysym(XK_Alt_L, true);
+        if (job.modifiers & ALTGR) m_injector.send_keysym(XK_ISO_Level3_Shift, true);
+        if (job.modifiers & SHIFT) m_injector.send_keysym(XK_Shift_L, true);
+        m_injector.send_keysym(job.key, true);
+        m_injector.send_keysym(job.key, false);
+        if (job.modifiers & SHIFT) m_injector.send_keysym(XK_Shift_L, false);
+        if (job.modifiers & ALTGR) m_injector.send_keysym(XK_ISO_Level3_Shift, false);
+        if (job.modifiers & ALT) m_injector.send_keysym(XK_Alt_L, false);
+        if (job.modifiers & CTRL) m_injector.send_keysym(XK_Control_L, false);
+        m_injector.end_batch();
+    }
+
+    // The last slice's batch has flushed its final XTestFakeKeyEvent
+    uint64_t typed_ns = LatencyTracer::now_ns();
+    RuntimeStats::instance().record_injection(typed_ns - job.submitted_ns);
+    if (job.dispatched_ns != 0) {
+        LatencyTracer& tracer = LatencyTracer::instance();
+        tracer.record(TraceStage::KeyInjection, job.dispatched_ns, typed_ns - job.dispatched_ns);
+        if (job.origin_ns != 0) {
+            tracer.record(TraceStage::SpeechToText, job.origin_ns, typed_ns - job.origin_ns);
+        }
+    }
+    return true;
+}
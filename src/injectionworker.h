@@ -0,0 +1,91 @@
+// injectionworker.h
+// Header file for the InjectionWorker class.
+// Types transcripts on a thread of its own, so long dictations don't stall the GTK main loop
+// (redraws, the MIC blink timer, on-screen key presses). The worker owns a separate
+// XKeyInjector and with it its own X display connection; Xlib connections must not be
+// shared between threads, so the Keyboard's injector stays with on-screen keys.
+// Jobs run in submission order. cancel() drops the queued ones and stops the running one
+// at the next slice of text, e.g. when the user presses a key mid-dictation. A job with
+// nothing to send is a barrier: its on_done runs once everything submitted before it is done.
+
+#ifndef INJECTION_WORKER_H
+#define INJECTION_WORKER_H
+
+#include <X11/Xlib.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "xkeyinjector.h"
+
+class InjectionWorker {
+public:
+    // Modifiers held around Job::key
+    enum Modifier : unsigned {
+        SHIFT = 1u << 0,
+        CTRL = 1u << 1,
+        ALT = 1u << 2,
+        ALTGR = 1u << 3
+    };
+
+    struct Job {
+        size_t erase = 0;        // BackSpaces sent first (not cancellable once started)
+        std::string text;        // Then typed, always without modifiers, in cancellable slices
+        KeySym key = NoSymbol;   // Then pressed once, e.g. a paste key
+        unsigned modifiers = 0;  // Snapshot of the modifiers to hold around 'key'
+        uint64_t origin_ns = 0;     // Capture timestamp of the audio (latency tracing)
+        uint64_t dispatched_ns = 0; // When the main loop dispatched the result (latency tracing)
+        uint64_t submitted_ns = 0;  // Set by submit(), for the injection latency in RuntimeStats
+        // Runs on the worker thread once the job is over, or on the caller of cancel() for
+        // jobs that never started; 'completed' is false if the job was cancelled
+        std::function<void(bool completed)> on_done;
+    };
+
+    InjectionWorker();
+    ~InjectionWorker(); // stop()
+
+    InjectionWorker(const InjectionWorker&) = delete;
+    InjectionWorker& operator=(const InjectionWorker&) = delete;
+
+    // Opens the worker's display connection and starts the thread
+    bool start(const char* display_name = nullptr);
+    // Finishes the running job, drops the rest and joins the thread
+    void stop();
+    bool running() const { return m_thread.joinable(); }
+
+    void submit(Job job);
+
+    // Drops queued jobs, stops the running one at the next slice and returns once the
+    // worker is idle, so the caller's own key events can't interleave with its output
+    void cancel();
+    // Blocks until every submitted job is done
+    void wait_idle();
+    // A job is running or queued
+    bool busy() const;
+
+    uint64_t jobs_cancelled() const { return m_jobs_cancelled.load(std::memory_order_relaxed); }
+
+private:
+    void worker_loop();
+    // Runs one job; false if it was cancelled part-way
+    bool run_job(const Job& job, uint64_t generation);
+
+    XKeyInjector m_injector; // Worker thread only while it runs
+
+    std::thread m_thread;
+    mutable std::mutex m_mutex; // Guards m_jobs, m_active and m_running
+    std::condition_variable m_job_cv;  // Work queued or stop requested
+    std::condition_variable m_idle_cv; // m_active cleared
+    std::deque<Job> m_jobs;
+    bool m_active;  // The worker is running a job
+    bool m_running;
+    std::atomic<uint64_t> m_generation; // Bumped by cancel(); a running job stops when it changes
+    std::atomic<uint64_t> m_jobs_cancelled;
+};
+
+#endif // INJECTION_WORKER_H
@@ -0,0 +1,97 @@
+// journal_main.cpp
+// Entry point of vk-journal, the transcript journal reader.
+// Prints the entries of a journal written by the keyboard (VK_JOURNAL), oldest first, one
+// line each: local time, then the text. With --words each word follows on its own line
+// with its start and end in the recognizer's stream. Safe to run while the keyboard is
+// still appending.
+//
+// Usage: vk-journal [--last N] [--words] [FILE]
+
+#include "transcriptjournal.h"
+#include "logger.h"
+#include <cstdint>
+#include <cstdlib> // For std::getenv, std::atol
+#include <ctime>   // For localtime_r, strftime
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--last N] [--words] [FILE]\n"
+              << "Reads $VK_JOURNAL when no file is given. Prints every entry unless --last is given."
+              << std::endl;
+}
+
+static std::string format_wall_time(int64_t wall_time_ns) {
+    time_t seconds = static_cast<time_t>(wall_time_ns / 1000000000);
+    tm local;
+    char buffer[32];
+    if (!localtime_r(&seconds, &local) || strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &local) == 0) {
+        return std::to_string(seconds);
+    }
+    return buffer;
+}
+
+int main(int argc, char* argv[]) {
+    // stdout carries the transcripts: keep informational log lines out of it unless asked for
+    if (!std::getenv("VK_LOG_LEVEL")) {
+        Logger::instance().set_level(LogLevel::Warning);
+    }
+
+    const char* journal_env = std::getenv("VK_JOURNAL");
+    std::string path = journal_env ? journal_env : "";
+    size_t last = SIZE_MAX;
+    bool show_words = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg == "--last" && has_value) {
+            long count = std::atol(argv[++i]);
+            last = count > 0 ? static_cast<size_t>(count) : 0;
+        } else if (arg == "--words") {
+            show_words = true;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "ERROR: Unknown or incomplete option: " << arg << std::endl;
+            print_usage(argv[0]);
+            return 2;
+        } else {
+            path = arg;
+        }
+    }
+    if (path.empty()) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    TranscriptJournalReader reader;
+    std::vector<JournalEntry> entries;
+    if (!reader.open(path) || !reader.read_last(last, entries)) {
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    for (const JournalEntry& entry : entries) {
+        std::cout << format_wall_time(entry.wall_time_ns) << "  " << entry.text << '\n';
+        if (!show_words) {
+            continue;
+        }
+        // Timings follow the space-separated words of the text
+        size_t word = 0;
+        size_t start = entry.text.find_first_not_of(' ');
+        while (start != std::string::npos && word < entry.words.size()) {
+            size_t end = entry.text.find(' ', start);
+            std::string_view text = std::string_view(entry.text).substr(start, end == std::string::npos ? std::string::npos : end - start);
+            std::cout << "    " << std::setw(7) << entry.words[word].start << ' ' << std::setw(7) << entry.words[word].end
+                      << "  " << text << '\n';
+            word++;
+            start = entry.text.find_first_not_of(' ', end == std::string::npos ? entry.text.size() : end);
+        }
+    }
+    std::cout.flush();
+    return 0;
+}
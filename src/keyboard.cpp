@@ -1,6 +1,8 @@
 #include "keyboard.h"
 #include "keyboardbutton.h"
-#include <iostream>
+#include "latencytracer.h"
+#include "logger.h"
+#include "runtimestats.h"
 #include <string>
 #include <cctype>
 #include <vector>
@@ -8,11 +10,18 @@
 #include <chrono>
 #include <glibmm/main.h> // For Glib::signal_timeout
 #include <algorithm> // For std::find
+#include <utility>   // For std::move
+#include <cstdlib>   // For std::getenv
+#include <sstream>   // For std::istringstream (control commands)
 
 // X11 headers for global input
 #include <X11/keysym.h>
 #include <X11/extensions/XTest.h>
 #include <X11/Xutil.h>
+#include <X11/Xatom.h>
+
+#include <gtkmm/clipboard.h>
+#include <gdkmm/display.h>
 
 std::string keysym_to_string_local(KeySym ks) {
     char *name = XKeysymToString(ks);
@@ -26,17 +35,30 @@ const std::string VOSK_MODEL_PATH = "/home/android/dev/gtkmm-virtual-keyboard/vo
 
 // --- Keyboard Class Implementation ---
 Keyboard::Keyboard()
-    : m_x_display(nullptr), m_xtest_available(false),
-      m_caps_active(false), // Initialize CAPS lock state to false
+    : m_caps_active(false), // Initialize CAPS lock state to false
       m_shift_active(false), // Initialize modifier states
       m_ctrl_active(false),
       m_alt_active(false),
       m_altgr_active(false),
+      m_fn_active(false),
+      m_compose_active(false),
+      m_stats_overlay(false),
       m_stt_service(nullptr), m_mic_button(nullptr),
-      m_last_mic_click_time(std::chrono::steady_clock::now()) // Initialize debounce timer
+      m_last_mic_click_time(std::chrono::steady_clock::now()), // Initialize debounce timer
+      m_shown_layer(KeyLayout::BASE),
+      m_paste_restore_pending(false),
+      m_saved_clipboard_valid(false),
+      m_saved_primary_valid(false),
+      m_paste_in_progress(false),
+      m_paste_generation(0),
+      m_lifetime(std::make_shared<bool>(true))
 {
-    std::cout << "DEBUG: Keyboard constructor called." << std::endl;
-    init_x_display_and_xtest();
+    VK_LOG_DEBUG("Keyboard constructor called.");
+    m_injector.open();
+    // Transcripts are typed on a worker thread with its own display connection
+    if (!m_injection.start()) {
+        VK_LOG_ERROR("Could not start the injection worker. Transcripts will not be typed.");
+    }
 
     set_row_spacing(4);
     set_column_spacing(4);
@@ -46,92 +68,226 @@ Keyboard::Keyboard()
     set_margin_right(10);
 
     // Initialize SpeechToTextService with a callback to this keyboard's on_transcribed_text method
+    // Results reach the main loop through one eventfd watch instead of an idle source each
+    // (VK_RESULT_PRIORITY sets its GLib priority, default Glib::PRIORITY_DEFAULT)
+    if (!m_result_queue.attach([this]() { on_results_ready(); }, ResultQueue::priority_from_environment())) {
+        VK_LOG_ERROR("Cannot watch the results queue; transcripts will not be typed.");
+    }
+
     m_stt_service = std::make_unique<SpeechToTextService>(
         sigc::mem_fun(this, &Keyboard::on_transcribed_text)
     );
 
-    // Attempt to initialize STT service
-    if (!m_stt_service->init(VOSK_MODEL_PATH)) {
-        std::cerr << "ERROR: Failed to initialize SpeechToTextService. Offline transcription may not work." << std::endl;
+    m_stt_service->set_partial_text_callback(
+        sigc::mem_fun(this, &Keyboard::on_partial_text)
+    );
+
+    m_stt_service->set_command_callback(
+        sigc::mem_fun(this, &Keyboard::on_command_text)
+    );
+
+    // Capture backend and buffering (VK_AUDIO_BACKEND, VK_AUDIO_DEVICE, VK_AUDIO_PERIOD, VK_AUDIO_BUFFER)
+    AudioSourceConfig audio_config;
+    audio_config.load_from_environment();
+    m_stt_service->set_audio_source_config(audio_config);
+
+    // Decode chunk size adapts to the CPU between VK_CHUNK_MIN_MS and VK_CHUNK_MAX_MS;
+    // VK_CHUNK_MS pins it (e.g. 200 on slow ARM boards, 20 for the lowest latency)
+    ChunkSizePolicy chunk_policy;
+    chunk_policy.load_from_environment();
+    m_stt_service->set_chunk_policy_config(chunk_policy.config());
+
+    // VK_DECODER=gpu decodes dictation on an NVIDIA GPU (CUDA libvosk), falling back to the CPU
+    m_stt_service->set_decoder_backend(decoder_backend_from_environment());
+
+    // Words below VK_MIN_WORD_CONF (default 0.5, 0 types everything) are dropped before typing;
+    // VK_VOCABULARY=<word list> rescores VK_MAX_ALTERNATIVES n-best results towards its words
+    ResultPostProcessor post_processor;
+    post_processor.load_from_environment();
+    m_stt_service->set_post_processor_config(post_processor.config());
+
+    // Shared terminals: VK_SPEAKER_MODEL=<vosk-model-spk> only types what enrolled speakers say
+    // (profiles in VK_SPEAKER_PROFILES; VK_SPEAKER_ENROLL=<name> enrolls instead of filtering,
+    // VK_SPEAKER_THRESHOLD sets the cosine similarity a voice needs, default 0.5)
+    SpeakerFilterConfig speaker_config;
+    speaker_config.load_from_environment();
+    m_stt_service->set_speaker_filter(speaker_config);
+
+    // VK_JOURNAL=<file> keeps every final transcript (with word timings) in a memory-mapped
+    // journal, so the RETYPE key can type it again and vk-journal can print it; the file is
+    // grown VK_JOURNAL_RECORDS (default 4096) 1 KiB records at a time
+    TranscriptJournalConfig journal_config;
+    journal_config.load_from_environment();
+    if (journal_config.enabled() && m_stt_service->set_transcript_journal(journal_config)) {
+        m_journal_path = journal_config.path;
     }
 
-    // Build the fixed alphabetic layout directly
-    build_alphabetic_layout();
-}
+    // Typing vs. clipboard paste for long transcripts (VK_PASTE_THRESHOLD, VK_OUTPUT_MODES)
+    m_output_policy.load_from_environment();
 
-Keyboard::~Keyboard() {
-    std::cout << "DEBUG: Keyboard destructor called." << std::endl;
-    if (m_x_display) {
-        XCloseDisplay(m_x_display);
-        std::cout << "DEBUG: X display closed." << std::endl;
+    // Hot standby keeps the PCM device and recognizer warm between MIC toggles
+    // (VK_HOT_STANDBY=0 releases them on every stop). Warm starts are cheap, so the
+    // debounce only needs to catch accidental double clicks.
+    const char* standby_env = std::getenv("VK_HOT_STANDBY");
+    if (!standby_env || std::string(standby_env) != "0") {
+        m_stt_service->set_hot_standby(true);
+        m_mic_debounce_interval = std::chrono::milliseconds(150);
     }
-    // The unique_ptr m_stt_service will automatically be destructed here,
-    // which will stop its threads and clean up resources.
+
+    // Voice activity gate is opt-in: VK_VAD=1 skips decoding silent periods,
+    // VK_VAD_MIN_RMS overrides the absolute speech threshold
+    const char* vad_env = std::getenv("VK_VAD");
+    if (vad_env && std::string(vad_env) == "1") {
+        if (const char* min_rms_env = std::getenv("VK_VAD_MIN_RMS")) {
+            VoiceActivityDetector::Config vad_config = VoiceActivityDetector().config(); // Defaults
+            vad_config.min_rms = static_cast<float>(std::atof(min_rms_env));
+            m_stt_service->set_vad_config(vad_config);
+        }
+        m_stt_service->set_vad_enabled(true);
+    }
+
+    // Live preview is opt-in: VK_LIVE_PREVIEW=1 types stable words while still speaking
+    const char* live_preview_env = std::getenv("VK_LIVE_PREVIEW");
+    if (live_preview_env && std::string(live_preview_env) == "1") {
+        set_live_preview(true);
+    }
+
+    // Keys come from the layout file named by VK_LAYOUT (see keylayout.h for the format),
+    // or the built-in QWERTY layout
+    m_layout.load_from_environment();
+    build_layout();
+
+    // Voice commands start enabled with VK_COMMAND_MODE=1 (otherwise say "command mode")
+    const char* command_mode_env = std::getenv("VK_COMMAND_MODE");
+    if (command_mode_env && std::string(command_mode_env) == "1") {
+        set_command_mode(true);
+    }
+
+    // VK_STATS_OVERLAY=1 starts with the runtime stats shown under the keys
+    const char* stats_overlay_env = std::getenv("VK_STATS_OVERLAY");
+    m_stats_overlay = stats_overlay_env && std::string(stats_overlay_env) == "1";
+
+    // VK_CONTROL=1 (or VK_CONTROL_SOCKET=<path>) serves stats and live tuning on a Unix
+    // socket, by default $XDG_RUNTIME_DIR/vk-keyboard.sock (see handle_control_command)
+    std::string control_path = ControlSocket::path_from_environment();
+    if (!control_path.empty()) {
+        m_control.open(control_path, [this](const std::string& command) {
+            return handle_control_command(command);
+        });
+    }
+
+    // Load the model in the background so the window appears immediately;
+    // the MIC button stays in its "loading" state until the model is ready.
+    set_mic_loading(true);
+    // The idle can outlive the Keyboard if it is destroyed while the model is still loading
+    std::weak_ptr<bool> alive = m_lifetime;
+    m_stt_service->init_async(VOSK_MODEL_PATH, [this, alive](bool ok) {
+        Glib::signal_idle().connect_once([this, alive, ok]() {
+            if (alive.expired()) {
+                return;
+            }
+            on_model_loaded(ok);
+        });
+    });
 }
 
-void Keyboard::init_x_display_and_xtest() {
-    m_x_display = XOpenDisplay(nullptr);
-    if (!m_x_display) {
-        std::cerr << "ERROR: Could not open X display. Global key events will not work." << std::endl;
-        m_xtest_available = false;
+void Keyboard::set_mic_loading(bool loading) {
+    if (!m_mic_button) {
         return;
     }
-
-    int major_opcode, first_event, first_error;
-    if (!XQueryExtension(m_x_display, "XTEST", &major_opcode, &first_event, &first_error)) {
-        std::cerr << "WARNING: XTest extension not available. Global key events may not work as expected." << std::endl;
-        m_xtest_available = false;
+    if (loading) {
+        m_mic_button->get_style_context()->add_class("mic-loading");
+        m_mic_button->set_tooltip_text("Loading speech model...");
     } else {
-        m_xtest_available = true;
-        std::cout << "DEBUG: XTest extension available." << std::endl;
+        m_mic_button->get_style_context()->remove_class("mic-loading");
+        m_mic_button->set_tooltip_text("");
     }
+    m_mic_button->set_sensitive(!loading);
 }
 
-void Keyboard::send_global_key_event(KeySym keysym, bool is_press) {
-    if (!m_xtest_available || !m_x_display) {
-        std::cerr << "ERROR: Cannot send global key event - XTest not available or display not open." << std::endl;
-        return;
+void Keyboard::on_model_loaded(bool ok) {
+    set_mic_loading(false);
+    if (!ok) {
+        VK_LOG_ERROR("Failed to initialize SpeechToTextService. Offline transcription may not work.");
+        m_mic_button->get_style_context()->add_class("mic-unavailable");
+        m_mic_button->set_tooltip_text("Speech model failed to load");
+    } else {
+        VK_LOG_DEBUG("Speech model ready.");
     }
+}
 
-    // Convert KeySym to KeyCode
-    KeyCode keycode = XKeysymToKeycode(m_x_display, keysym);
-    if (keycode == 0) {
-        std::cerr << "WARNING: No KeyCode for KeySym: " << keysym_to_string_local(keysym) << std::endl;
-        return;
+Keyboard::~Keyboard() {
+    VK_LOG_DEBUG("Keyboard destructor called.");
+    if (m_paste_restore_connection.connected()) {
+        m_paste_restore_connection.disconnect();
     }
+    // m_injector closes the X display.
+    // The unique_ptr m_stt_service will automatically be destructed here,
+    // which will stop its threads and clean up resources.
+}
 
-    // Send the event
-    XTestFakeKeyEvent(m_x_display, keycode, is_press, CurrentTime);
-    XFlush(m_x_display); // Ensure the event is sent immediately
-    std::cout << "DEBUG: Sent global key event: " << keysym_to_string_local(keysym) << " (KeyCode: " << (int)keycode << "), " << (is_press ? "Press" : "Release") << std::endl;
+void Keyboard::send_global_key_event(KeySym keysym, bool is_press) {
+    m_injector.send_keysym(keysym, is_press);
+}
+
+void Keyboard::begin_key_batch() {
+    m_injector.begin_batch();
+}
+
+void Keyboard::end_key_batch() {
+    m_injector.end_batch();
 }
 
 void Keyboard::send_key_with_active_modifiers(KeySym base_keysym, bool needs_shift_for_base_char) {
+    KeyStroke stroke;
+    Display* display = m_injector.display();
+    if (!m_injector.keycode_table().lookup_keysym(base_keysym, stroke)) {
+        stroke = KeyStroke { display ? XKeysymToKeycode(display, base_keysym) : KeyCode(0), KeyStroke::NONE };
+    }
+    if (stroke.keycode == 0) {
+        VK_LOG_WARNING("No KeyCode for KeySym: " << keysym_to_string_local(base_keysym));
+        return;
+    }
+    if (needs_shift_for_base_char) {
+        stroke.modifiers |= KeyStroke::SHIFT;
+    }
+    send_stroke_with_active_modifiers(stroke);
+}
+
+void Keyboard::send_stroke_with_active_modifiers(const KeyStroke& stroke) {
+    // A key press interrupts transcript output; it must not land in the middle of it
+    cancel_pending_output();
+
+    // Modifiers and the key go out together in one flush
+    begin_key_batch();
+
+    bool needs_shift = (stroke.modifiers & KeyStroke::SHIFT) || m_shift_active;
+    bool needs_altgr = (stroke.modifiers & KeyStroke::ALTGR) || m_altgr_active;
+
     // Press active modifiers
-    // Note: XK_Shift_L is handled by needs_shift_for_base_char and m_shift_active
     if (m_ctrl_active) {
         send_global_key_event(XK_Control_L, true);
     }
     if (m_alt_active) {
         send_global_key_event(XK_Alt_L, true);
     }
-    if (m_altgr_active) {
+    if (needs_altgr) {
         send_global_key_event(XK_ISO_Level3_Shift, true);
     }
-    // Handle shift if required by the base character or if SHIFT button is active
-    if (needs_shift_for_base_char || m_shift_active) {
+    // Handle shift if required by the key's level or if SHIFT button is active
+    if (needs_shift) {
         send_global_key_event(XK_Shift_L, true);
     }
 
     // Send the base key
-    send_global_key_event(base_keysym, true);
-    send_global_key_event(base_keysym, false);
+    m_injector.send_keycode(stroke.keycode, true);
+    m_injector.send_keycode(stroke.keycode, false);
 
     // Release all modifiers that were pressed for this sequence (reverse order is safer)
-    if (needs_shift_for_base_char || m_shift_active) {
+    if (needs_shift) {
         send_global_key_event(XK_Shift_L, false);
     }
-    if (m_altgr_active) {
+    if (needs_altgr) {
         send_global_key_event(XK_ISO_Level3_Shift, false);
     }
     if (m_alt_active) {
@@ -140,267 +296,638 @@ void Keyboard::send_key_with_active_modifiers(KeySym base_keysym, bool needs_shi
     if (m_ctrl_active) {
         send_global_key_event(XK_Control_L, false);
     }
-}
 
+    end_key_batch();
+}
 
 void Keyboard::handle_button_press(const Glib::ustring& label) {
-    std::cout << "DEBUG: Keyboard received key label: " << label << std::endl;
+    // Voice commands name keys by label; on-screen buttons go straight to handle_key_press
+    bool fn = false;
+    int index = m_layout.find(label, fn);
+    if (index < 0) {
+        VK_LOG_WARNING("No key labelled '" << label << "' on layout '" << m_layout.name() << "'");
+        return;
+    }
+    press_key(static_cast<size_t>(index), fn);
+}
 
-    if (label == "SHIFT") {
-        m_shift_active = !m_shift_active;
-        update_modifier_button_visuals(label, m_shift_active);
-        // Update alpha keys based on new shift state (if CAPS is off)
-        if (!m_caps_active) {
-            apply_caps_state_to_buttons();
+void Keyboard::handle_key_press(size_t index) {
+    press_key(index, m_fn_active);
+}
+
+void Keyboard::press_key(size_t index, bool fn) {
+    if (index >= m_layout.size()) {
+        VK_LOG_WARNING("Key index out of range: " << index);
+        return;
+    }
+    const KeyDescriptor& key = m_layout.key(index);
+    VK_LOG_DEBUG("Keyboard received key: " << m_layout.label(index, fn ? KeyLayout::FN : KeyLayout::BASE));
+
+    // Keys with an FN function send it instead while FN is on
+    if (fn && key.fn_keysym != NoSymbol) {
+        send_key_with_active_modifiers(key.fn_keysym);
+        return;
+    }
+
+    switch (key.action) {
+    case KeyDescriptor::Action::Char: {
+        // For regular character buttons (alphabetic, numeric, common symbols)
+        unsigned long c = key.character;
+        // Letters are typed as capitals while CAPS or SHIFT is active
+        if (key.is_letter() && (m_caps_active || m_shift_active)) {
+            c = std::toupper(static_cast<int>(c));
         }
-    } else if (label == "CAPS") {
+        KeyStroke stroke;
+        if (m_injector.keycode_table().lookup_char(c, stroke)) {
+            send_stroke_with_active_modifiers(stroke);
+        } else {
+            VK_LOG_WARNING("No key on the current keymap for character: '" << key.label << "'");
+        }
+        break;
+    }
+    case KeyDescriptor::Action::Key:
+        send_key_with_active_modifiers(key.keysym);
+        break;
+    case KeyDescriptor::Action::Shift:
+        m_shift_active = !m_shift_active;
+        update_modifier_button_visuals();
+        break;
+    case KeyDescriptor::Action::Caps:
         m_caps_active = !m_caps_active;
-        apply_caps_state_to_buttons(); // This updates alpha key labels and CAPS button visual
-        update_modifier_button_visuals(label, m_caps_active); // Ensure CAPS button visual is correct
-    } else if (label == "CTRL") {
+        update_modifier_button_visuals();
+        break;
+    case KeyDescriptor::Action::Ctrl:
         m_ctrl_active = !m_ctrl_active;
-        update_modifier_button_visuals(label, m_ctrl_active);
-    } else if (label == "ALT") {
+        update_modifier_button_visuals();
+        break;
+    case KeyDescriptor::Action::Alt:
         m_alt_active = !m_alt_active;
-        update_modifier_button_visuals(label, m_alt_active);
-    } else if (label == "ALTGR") {
+        update_modifier_button_visuals();
+        break;
+    case KeyDescriptor::Action::AltGr:
         m_altgr_active = !m_altgr_active;
-        update_modifier_button_visuals(label, m_altgr_active);
-    } else if (label == "COMPOSE") { // NEW: Handle COMPOSE button
-        std::cout << "DEBUG: Compose button pressed. Sending XK_Multi_key." << std::endl;
+        update_modifier_button_visuals();
+        break;
+    case KeyDescriptor::Action::Compose:
+        VK_LOG_DEBUG("Compose button pressed. Sending XK_Multi_key.");
+        cancel_pending_output(); // Multi_key must not land in the middle of a transcript
         send_global_key_event(XK_Multi_key, true); // Press Compose key
         send_global_key_event(XK_Multi_key, false); // Release Compose key
         // Compose key is typically momentary, not a toggle. No internal state needed.
-    }
-    else if (label == "BACK") {
-        send_key_with_active_modifiers(XK_BackSpace);
-    } else if (label == "SPACE") {
-        send_key_with_active_modifiers(XK_space);
-    } else if (label == "ENTER") {
-        send_key_with_active_modifiers(XK_Return);
-    } else if (label == "HIDE") {
+        break;
+    case KeyDescriptor::Action::Fn: // No global key event sent for FN
+        m_fn_active = !m_fn_active;
+        update_modifier_button_visuals();
+        break;
+    case KeyDescriptor::Action::Mic:
+        toggle_listening();
+        break;
+    case KeyDescriptor::Action::Hide:
         m_signal_hide_show.emit(); // Emit signal to hide/show window
-    } else if (label == "KILL") {
+        break;
+    case KeyDescriptor::Action::Kill:
         m_signal_quit_app.emit(); // Emit signal to quit application
-    } else if (label == "FN") { // Handle FN key - no global character send
-        std::cout << "DEBUG: FN key pressed. No global action for this key in current configuration." << std::endl;
-        // No global key event sent for FN
-    } else if (label == "←") {
-        send_key_with_active_modifiers(XK_Left);
-    } else if (label == "↑") {
-        send_key_with_active_modifiers(XK_Up);
-    } else if (label == "↓") {
-        send_key_with_active_modifiers(XK_Down);
-    } else if (label == "→") {
-        send_key_with_active_modifiers(XK_Right);
-    } else if (label.find("F") == 0 && label.length() > 1 && std::isdigit(label[1])) { // F1-F12 keys
-        int f_num = std::stoi(label.substr(1));
-        if (f_num >= 1 && f_num <= 12) {
-            send_key_with_active_modifiers(XK_F1 + (f_num - 1));
-        } else {
-            std::cerr << "WARNING: Unhandled F-key: " << label << std::endl;
-        }
+        break;
+    case KeyDescriptor::Action::Retype:
+        retype_transcripts(1);
+        break;
+    case KeyDescriptor::Action::Stats:
+        set_stats_overlay(!m_stats_overlay);
+        break;
     }
-    else if (label == "🎙️") { // MIC button
-        auto now = std::chrono::steady_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_last_mic_click_time);
-        if (duration < m_mic_debounce_interval) {
-            std::cout << "DEBUG: MIC button debounced. Ignoring rapid click." << std::endl;
-            return; // Ignore the click if it's too soon
-        }
-        m_last_mic_click_time = now; // Update last click time
+}
 
-        std::cout << "DEBUG: Microphone button pressed. Toggling STT listening." << std::endl;
-        if (m_stt_service->is_listening()) {
-            m_stt_service->stop_listening();
-            // Stop blinking
-            if (m_mic_blink_connection.connected()) {
-                m_mic_blink_connection.disconnect();
-            }
+void Keyboard::toggle_listening() {
+    auto now = std::chrono::steady_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_last_mic_click_time);
+    if (duration < m_mic_debounce_interval) {
+        VK_LOG_DEBUG("MIC button debounced. Ignoring rapid click.");
+        return; // Ignore the click if it's too soon
+    }
+    m_last_mic_click_time = now; // Update last click time
+
+    VK_LOG_DEBUG("Microphone button pressed. Toggling STT listening.");
+    if (m_stt_service->is_listening()) {
+        m_stt_service->stop_listening();
+        // Stop blinking
+        if (m_mic_blink_connection.connected()) {
+            m_mic_blink_connection.disconnect();
+        }
+        if (m_mic_button) {
             m_mic_button->get_style_context()->remove_class("mic-active");
             m_mic_button->get_style_context()->remove_class("mic-blinking"); // Ensure blinking class is removed
-            m_mic_button->set_label("🎙️"); // Reset label if it was changed
-        } else {
-            // Start listening
-            m_stt_service->start_listening();
+            m_mic_button->set_label(m_mic_button->get_original_label()); // Reset label if it was changed
+        }
+    } else {
+        // Start listening
+        if (!m_stt_service->start_listening()) {
+            VK_LOG_ERROR("Could not start listening.");
+            return;
+        }
+        if (m_mic_button) {
             m_mic_button->get_style_context()->add_class("mic-active");
-            // Start blinking
-            m_mic_blink_connection = Glib::signal_timeout().connect(
-                sigc::mem_fun(this, &Keyboard::on_mic_button_blink_timeout), 500
-            );
         }
+        // Start blinking
+        m_mic_blink_connection = Glib::signal_timeout().connect(
+            sigc::mem_fun(this, &Keyboard::on_mic_button_blink_timeout), 500
+        );
     }
-    else {
-        // For regular character buttons (alphabetic, numeric, common symbols)
-        KeySym keysym = 0;
-        bool needs_shift_for_char = false; // This is for characters that inherently require shift (e.g., '!', '@')
-
-        if (label.length() == 1) {
-            char c = label[0];
-            if (std::isalpha(c)) {
-                keysym = XStringToKeysym(Glib::ustring(1, static_cast<char>(std::tolower(c))).c_str());
-                // If CAPS is active, or SHIFT button is active, treat as needing shift for this character
-                if (m_caps_active || m_shift_active) {
-                    needs_shift_for_char = true;
-                }
-            } else if (std::isdigit(c)) {
-                keysym = XStringToKeysym(Glib::ustring(1, c).c_str());
-            } else {
-                // Handle symbols that might require shift or different keysyms
-                switch (c) {
-                    case '!': keysym = XK_exclam; needs_shift_for_char = true; break;
-                    case '@': keysym = XK_at; needs_shift_for_char = true; break;
-                    case '#': keysym = XK_numbersign; needs_shift_for_char = true; break;
-                    case '$': keysym = XK_dollar; needs_shift_for_char = true; break;
-                    case '%': keysym = XK_percent; needs_shift_for_char = true; break;
-                    case '^': keysym = XK_asciicircum; needs_shift_for_char = true; break;
-                    case '&': keysym = XK_ampersand; needs_shift_for_char = true; break;
-                    case '*': keysym = XK_asterisk; needs_shift_for_char = true; break;
-                    case '(': keysym = XK_parenleft; needs_shift_for_char = true; break;
-                    case ')': keysym = XK_parenright; needs_shift_for_char = true; break;
-                    case '-': keysym = XK_minus; break;
-                    case '_': keysym = XK_underscore; needs_shift_for_char = true; break;
-                    case '=': keysym = XK_equal; break;
-                    case '+': keysym = XK_plus; needs_shift_for_char = true; break;
-                    case '[': keysym = XK_bracketleft; break;
-                    case '{': keysym = XK_braceleft; needs_shift_for_char = true; break;
-                    case ']': keysym = XK_bracketright; break;
-                    case '}': keysym = XK_braceright; needs_shift_for_char = true; break;
-                    case ';': keysym = XK_semicolon; break;
-                    case ':': keysym = XK_colon; needs_shift_for_char = true; break;
-                    case '\'': keysym = XK_apostrophe; break;
-                    case '\"': keysym = XK_quotedbl; needs_shift_for_char = true; break;
-                    case '`': keysym = XK_grave; break;
-                    case '~': keysym = XK_asciitilde; needs_shift_for_char = true; break;
-                    case ',': keysym = XK_comma; break;
-                    case '<': keysym = XK_less; needs_shift_for_char = true; break;
-                    case '.': keysym = XK_period; break;
-                    case '>': keysym = XK_greater; needs_shift_for_char = true; break;
-                    case '/': keysym = XK_slash; break;
-                    case '?': keysym = XK_question; needs_shift_for_char = true; break;
-                    case '\\': keysym = XK_backslash; break;
-                    case '|': keysym = XK_bar; needs_shift_for_char = true; break;
-                    default:
-                        std::cerr << "WARNING: Unhandled character for global send: '" << c << "'" << std::endl;
-                        return;
-                }
-            }
+}
 
-            if (keysym != 0) {
-                send_key_with_active_modifiers(keysym, needs_shift_for_char);
-            } else {
-                std::cerr << "WARNING: Could not determine KeySym for character: '" << c << "'" << std::endl;
-            }
-        } else {
-             std::cerr << "WARNING: Button label too long or unsupported for direct global send: " << label << std::endl;
+// Splits a transcript into words on single spaces (Vosk separates words with one space)
+static std::vector<std::string> split_transcript_words(const std::string& text) {
+    std::vector<std::string> words;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find(' ', start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        if (end > start) {
+            words.push_back(text.substr(start, end - start));
         }
+        start = end + 1;
     }
+    return words;
 }
 
-void Keyboard::on_transcribed_text(const std::string& text) {
-    Glib::signal_idle().connect([this, text]() -> bool {
-        if (!text.empty() && text != " ") {
-            std::cout << "DEBUG: Transcribed text received: '" << text << "'" << std::endl;
-            
-            // Ensure all modifier states are off before sending transcribed text
-            // This prevents transcribed text from being sent with active Ctrl/Alt etc.
-            // We store their original state to restore them after transcription.
-            bool was_shift_active = m_shift_active;
-            bool was_ctrl_active = m_ctrl_active;
-            bool was_alt_active = m_alt_active;
-            bool was_altgr_active = m_altgr_active;
-
-            // Deactivate modifiers for STT output
-            if (m_shift_active) { m_shift_active = false; update_modifier_button_visuals("SHIFT", false); }
-            if (m_ctrl_active) { m_ctrl_active = false; update_modifier_button_visuals("CTRL", false); }
-            if (m_alt_active) { m_alt_active = false; update_modifier_button_visuals("ALT", false); }
-            if (m_altgr_active) { m_altgr_active = false; update_modifier_button_visuals("ALTGR", false); }
-            // CAPS state is a visual toggle on the keyboard, not a momentary modifier for STT output
-
-            for (char c : text) {
-                KeySym keysym = 0;
-                bool needs_shift_for_char = false; // This is for characters inherently needing shift (e.g., 'A', '!')
-
-                if (std::isupper(c)) {
-                    needs_shift_for_char = true;
-                    keysym = XStringToKeysym(Glib::ustring(1, static_cast<char>(std::tolower(c))).c_str());
-                } else if (std::islower(c) || std::isdigit(c)) {
-                    keysym = XStringToKeysym(Glib::ustring(1, c).c_str());
-                } else {
-                    // Handle symbols that might require shift or different keysyms
-                    switch (c) {
-                        case '!': keysym = XK_exclam; needs_shift_for_char = true; break;
-                        case '@': keysym = XK_at; needs_shift_for_char = true; break;
-                        case '#': keysym = XK_numbersign; needs_shift_for_char = true; break;
-                        case '$': keysym = XK_dollar; needs_shift_for_char = true; break;
-                        case '%': keysym = XK_percent; needs_shift_for_char = true; break;
-                        case '^': keysym = XK_asciicircum; needs_shift_for_char = true; break;
-                        case '&': keysym = XK_ampersand; needs_shift_for_char = true; break;
-                        case '*': keysym = XK_asterisk; needs_shift_for_char = true; break;
-                        case '(': keysym = XK_parenleft; needs_shift_for_char = true; break;
-                        case ')': keysym = XK_parenright; needs_shift_for_char = true; break;
-                        case '-': keysym = XK_minus; break;
-                        case '_': keysym = XK_underscore; needs_shift_for_char = true; break;
-                        case '=': keysym = XK_equal; break;
-                        case '+': keysym = XK_plus; needs_shift_for_char = true; break;
-                        case '[': keysym = XK_bracketleft; break;
-                        case '{': keysym = XK_braceleft; needs_shift_for_char = true; break;
-                        case ']': keysym = XK_bracketright; break;
-                        case '}': keysym = XK_braceright; needs_shift_for_char = true; break;
-                        case ';': keysym = XK_semicolon; break;
-                        case ':': keysym = XK_colon; needs_shift_for_char = true; break;
-                        case '\'': keysym = XK_apostrophe; break;
-                        case '\"': keysym = XK_quotedbl; needs_shift_for_char = true; break;
-                        case '`': keysym = XK_grave; break;
-                        case '~': keysym = XK_asciitilde; needs_shift_for_char = true; break;
-                        case ',': keysym = XK_comma; break;
-                        case '<': keysym = XK_less; needs_shift_for_char = true; break;
-                        case '.': keysym = XK_period; break;
-                        case '>': keysym = XK_greater; needs_shift_for_char = true; break;
-                        case '/': keysym = XK_slash; break;
-                        case '?': keysym = XK_question; needs_shift_for_char = true; break;
-                        case '\\': keysym = XK_backslash; break;
-                        case '|': keysym = XK_bar; needs_shift_for_char = true; break;
-                        case '\b': keysym = XK_BackSpace; break;
-                        case 127: keysym = XK_Delete; break;
-                        case ' ': keysym = XK_space; break;
-                        case '\t': keysym = XK_Tab; break;
-                        case '\n': keysym = XK_Return; break;
-                        default:
-                            std::cerr << "WARNING: Unhandled transcribed character: '" << c << "'" << std::endl;
-                            keysym = 0; // Reset keysym if unhandled
-                            break;
-                    }
-                }
+// Number of characters (UTF-8 code points) in a string, i.e. how many backspaces erase it
+static size_t utf8_char_count(const std::string& text) {
+    size_t count = 0;
+    for (unsigned char c : text) {
+        if ((c & 0xC0) != 0x80) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void Keyboard::type_text_globally(const std::string& text) {
+    if (text.empty()) {
+        return;
+    }
+    InjectionWorker::Job job;
+    job.text = text;
+    submit_output(std::move(job));
+}
+
+void Keyboard::output_text_globally(const std::string& text, size_t erase, uint64_t origin_ns,
+                                    uint64_t dispatched_ns) {
+    // The worker types without modifiers, whatever the latched SHIFT/CTRL/ALT/ALTGR buttons say
+    InjectionWorker::Job job;
+    job.erase = erase;
+    job.origin_ns = origin_ns;
+    job.dispatched_ns = dispatched_ns;
+    if (!text.empty()) {
+        TextOutputMode mode = m_output_policy.choose(active_window_class(), utf8_char_count(text));
+        if (mode != TextOutputMode::Type) {
+            paste_text_globally(text, mode, std::move(job));
+            return;
+        }
+        job.text = text;
+    }
+    if (job.erase > 0 || !job.text.empty()) {
+        submit_output(std::move(job));
+    }
+}
+
+void Keyboard::submit_output(InjectionWorker::Job job) {
+    if (m_paste_in_progress) {
+        m_held_output.push_back(PendingOutput{ std::move(job), std::string(), TextOutputMode::Type });
+        return;
+    }
+    m_injection.submit(std::move(job));
+}
+
+void Keyboard::cancel_pending_output() {
+    if (!m_injection.busy() && !m_paste_in_progress) {
+        return;
+    }
+    m_injection.cancel();
+    m_held_output.clear();
+    if (m_paste_in_progress) {
+        // The steps it has posted find the generation changed and stop
+        m_paste_in_progress = false;
+        m_paste_generation++;
+        if (m_paste_restore_pending) {
+            schedule_selection_restore();
+        }
+    }
+    // Whatever preview typed may be partly missing now; don't reconcile the final against it
+    m_preview_typed_words.clear();
+    m_preview_last_words.clear();
+    VK_LOG_DEBUG("Transcript output cancelled by a key press.");
+}
+
+std::string Keyboard::active_window_class() {
+    Display* display = m_injector.display();
+    if (!display) {
+        return std::string();
+    }
+    // The focused top-level window as published by the window manager (EWMH)
+    Atom active_atom = XInternAtom(display, "_NET_ACTIVE_WINDOW", True);
+    if (active_atom == None) {
+        return std::string();
+    }
+    Atom actual_type;
+    int actual_format;
+    unsigned long item_count, bytes_after;
+    unsigned char* data = nullptr;
+    Window active = None;
+    if (XGetWindowProperty(display, DefaultRootWindow(display), active_atom, 0, 1, False, XA_WINDOW,
+                           &actual_type, &actual_format, &item_count, &bytes_after, &data) == Success && data) {
+        if (item_count == 1) {
+            active = *reinterpret_cast<Window*>(data);
+        }
+        XFree(data);
+    }
+    if (active == None) {
+        return std::string();
+    }
+
+    std::string window_class;
+    XClassHint class_hint;
+    if (XGetClassHint(display, active, &class_hint)) {
+        if (class_hint.res_class) {
+            window_class = class_hint.res_class;
+            XFree(class_hint.res_class);
+        }
+        if (class_hint.res_name) {
+            XFree(class_hint.res_name);
+        }
+    }
+    return window_class;
+}
+
+void Keyboard::paste_text_globally(const std::string& text, TextOutputMode mode, InjectionWorker::Job job) {
+    auto paste = std::make_shared<PendingOutput>(PendingOutput{ std::move(job), text, mode });
+    if (m_paste_in_progress) {
+        m_held_output.push_back(std::move(*paste));
+        return;
+    }
+    begin_paste(std::move(paste));
+}
+
+void Keyboard::begin_paste(std::shared_ptr<PendingOutput> paste) {
+    m_paste_in_progress = true;
+    if (!m_injection.busy()) {
+        save_selections_and_paste(std::move(paste));
+        return;
+    }
+    // The selections hold one text at a time: let queued output (and earlier pastes) finish
+    // before taking them over. An empty job is a barrier; its on_done runs after all of it.
+    InjectionWorker::Job barrier;
+    barrier.on_done = paste_step([this, paste]() { save_selections_and_paste(paste); });
+    m_injection.submit(std::move(barrier));
+}
 
-                if (keysym != 0) {
-                    // Temporarily press shift if needed for this character
-                    if (needs_shift_for_char) {
-                        send_global_key_event(XK_Shift_L, true);
+void Keyboard::save_selections_and_paste(std::shared_ptr<PendingOutput> paste) {
+    // Remember what the user had, unless a previous paste is still waiting to restore it
+    if (m_paste_restore_pending) {
+        claim_selections_and_paste(std::move(paste));
+        return;
+    }
+    m_paste_restore_pending = true;
+    // Read asynchronously: the owner may be slow to answer, and the blocking wait_for_text()
+    // would run a nested main loop that dispatches further results in the middle of this one
+    uint64_t generation = m_paste_generation;
+    std::weak_ptr<bool> alive = m_lifetime;
+    Gtk::Clipboard::get(GDK_SELECTION_CLIPBOARD)->request_text(
+        [this, paste, generation, alive](const Glib::ustring& clipboard_text) {
+            if (alive.expired()) {
+                return;
+            }
+            m_saved_clipboard_valid = !clipboard_text.empty();
+            m_saved_clipboard_text = clipboard_text;
+            Gtk::Clipboard::get(GDK_SELECTION_PRIMARY)->request_text(
+                [this, paste, generation, alive](const Glib::ustring& primary_text) {
+                    if (alive.expired()) {
+                        return;
                     }
-                    send_global_key_event(keysym, true);
-                    send_global_key_event(keysym, false);
-                    if (needs_shift_for_char) {
-                        send_global_key_event(XK_Shift_L, false);
+                    m_saved_primary_valid = !primary_text.empty();
+                    m_saved_primary_text = primary_text;
+                    if (generation == m_paste_generation) {
+                        claim_selections_and_paste(paste);
                     }
-                }
+                });
+        });
+}
+
+void Keyboard::claim_selections_and_paste(std::shared_ptr<PendingOutput> paste) {
+    // Own both selections so Ctrl+V and Shift+Insert paste the same text in any application,
+    // and make sure the server has processed the ownership change before the paste key arrives.
+    Gtk::Clipboard::get(GDK_SELECTION_CLIPBOARD)->set_text(paste->paste_text);
+    Gtk::Clipboard::get(GDK_SELECTION_PRIMARY)->set_text(paste->paste_text);
+    Gdk::Display::get_default()->sync();
+    if (m_paste_restore_connection.connected()) {
+        m_paste_restore_connection.disconnect(); // This paste restores once its key is out
+    }
+
+    VK_LOG_DEBUG("Pasting " << paste->paste_text.size() << " bytes with "
+              << (paste->mode == TextOutputMode::PasteShiftInsert ? "Shift+Insert" : "Ctrl+V") << ".");
+    InjectionWorker::Job job = std::move(paste->job);
+    if (paste->mode == TextOutputMode::PasteShiftInsert) {
+        job.key = XK_Insert;
+        job.modifiers = InjectionWorker::SHIFT;
+    } else {
+        job.key = XK_v;
+        job.modifiers = InjectionWorker::CTRL;
+    }
+    job.on_done = paste_step([this]() { finish_paste(); });
+    m_injection.submit(std::move(job)); // Runs right away: the worker is idle
+}
+
+void Keyboard::finish_paste() {
+    // The target fetches the selection asynchronously, so restore the old contents a bit later
+    schedule_selection_restore();
+    m_paste_in_progress = false;
+
+    // Output that arrived meanwhile goes out in order, up to the next paste
+    while (!m_held_output.empty() && !m_paste_in_progress) {
+        PendingOutput output = std::move(m_held_output.front());
+        m_held_output.pop_front();
+        if (output.paste_text.empty()) {
+            m_injection.submit(std::move(output.job));
+        } else {
+            begin_paste(std::make_shared<PendingOutput>(std::move(output)));
+        }
+    }
+}
+
+std::function<void(bool)> Keyboard::paste_step(std::function<void()> step) {
+    // Taken here, on the main thread: the worker must not read Keyboard state
+    uint64_t generation = m_paste_generation;
+    std::weak_ptr<bool> alive = m_lifetime;
+    return [this, step, generation, alive](bool) {
+        Glib::signal_idle().connect_once([this, step, generation, alive]() {
+            if (!alive.expired() && generation == m_paste_generation) {
+                step();
             }
-            // Add a space after transcription for readability, if it's a new word/phrase
-            send_global_key_event(XK_space, true);
-            send_global_key_event(XK_space, false);
+        });
+    };
+}
+
+void Keyboard::schedule_selection_restore() {
+    if (m_paste_restore_connection.connected()) {
+        m_paste_restore_connection.disconnect();
+    }
+    m_paste_restore_connection = Glib::signal_timeout().connect([this]() -> bool {
+        restore_saved_selections();
+        return false;
+    }, m_paste_restore_delay_ms);
+}
+
+void Keyboard::restore_saved_selections() {
+    // Only text can be put back; other clipboard contents (e.g. images) are lost by pasting
+    if (m_saved_clipboard_valid) {
+        Gtk::Clipboard::get(GDK_SELECTION_CLIPBOARD)->set_text(m_saved_clipboard_text);
+    }
+    if (m_saved_primary_valid) {
+        Gtk::Clipboard::get(GDK_SELECTION_PRIMARY)->set_text(m_saved_primary_text);
+    }
+    m_saved_clipboard_valid = false;
+    m_saved_primary_valid = false;
+    m_paste_restore_pending = false;
+    VK_LOG_DEBUG("Restored previous selection contents after paste.");
+}
+
+void Keyboard::erase_chars_globally(size_t count) {
+    if (count == 0) {
+        return;
+    }
+    InjectionWorker::Job job;
+    job.erase = count;
+    submit_output(std::move(job));
+}
+
+void Keyboard::set_live_preview(bool enabled) {
+    m_stt_service->set_live_preview(enabled);
+    VK_LOG_DEBUG("Live preview " << (enabled ? "enabled" : "disabled") << ".");
+}
+
+void Keyboard::on_partial_text(const std::string& text) {
+    // Runs on the decoder thread
+    m_result_queue.push(ResultQueue::Kind::Partial, text, 0);
+}
+
+void Keyboard::handle_partial_text(const std::string& text) {
+    m_signal_preview.emit(text);
+
+    // A word is stable once two consecutive hypotheses agree on it and it is not the
+    // last (still changing) word. Only stable words beyond what we already typed are sent.
+    std::vector<std::string> words = split_transcript_words(text);
+    size_t stable = 0;
+    while (stable < words.size() && stable < m_preview_last_words.size() &&
+           words[stable] == m_preview_last_words[stable]) {
+        stable++;
+    }
+    if (stable == words.size() && stable > 0) {
+        stable--; // Never commit the newest word; Vosk often revises it
+    }
+    m_preview_last_words = words;
+
+    if (stable > m_preview_typed_words.size()) {
+        // Typed words are never re-checked against later partials here; the final
+        // result reconciles any divergence with backspaces.
+        std::string newly_stable;
+        for (size_t i = m_preview_typed_words.size(); i < stable; ++i) {
+            newly_stable += words[i];
+            newly_stable += ' ';
+            m_preview_typed_words.push_back(words[i]);
+        }
+        type_text_globally(newly_stable);
+    }
+}
+
+void Keyboard::set_command_mode(bool enabled) {
+    m_stt_service->set_command_mode(enabled);
+    if (!m_mic_button) {
+        return;
+    }
+    if (enabled) {
+        m_mic_button->get_style_context()->add_class("mic-command");
+        m_mic_button->set_tooltip_text("Command mode (say \"dictation\" to type again)");
+    } else {
+        m_mic_button->get_style_context()->remove_class("mic-command");
+        m_mic_button->set_tooltip_text("");
+    }
+}
+
+void Keyboard::update_command_grammar() {
+    // Base labels, so the grammar doesn't depend on CAPS; FN functions are pressable too
+    std::vector<std::string> labels;
+    for (size_t i = 0; i < m_layout.size(); ++i) {
+        labels.push_back(m_layout.label(i, KeyLayout::BASE));
+    }
+    for (size_t i = 0; i < m_layout.size(); ++i) {
+        if (m_layout.key(i).fn_keysym != NoSymbol) {
+            labels.push_back(m_layout.label(i, KeyLayout::FN));
+        }
+    }
+    m_command_grammar.build(labels);
+    m_stt_service->set_command_grammar(m_command_grammar.grammar_json());
+    VK_LOG_DEBUG("Command grammar: " << m_command_grammar.phrase_count() << " phrases.");
+}
+
+void Keyboard::on_command_text(const std::string& text) {
+    // Runs on the decoder thread
+    m_result_queue.push(ResultQueue::Kind::Command, text, 0);
+}
 
-            // Restore modifier states after sending transcribed text
-            if (was_shift_active) { m_shift_active = true; update_modifier_button_visuals("SHIFT", true); }
-            if (was_ctrl_active) { m_ctrl_active = true; update_modifier_button_visuals("CTRL", true); }
-            if (was_alt_active) { m_alt_active = true; update_modifier_button_visuals("ALT", true); }
-            if (was_altgr_active) { m_altgr_active = true; update_modifier_button_visuals("ALTGR", true); }
+void Keyboard::handle_command_text(const std::string& text) {
+    const CommandGrammar::Command* command = m_command_grammar.lookup(text);
+    if (!command) {
+        VK_LOG_DEBUG("Not a command: '" << text << "'");
+        return;
+    }
+    VK_LOG_DEBUG("Voice command: '" << text << "'");
+    m_signal_preview.emit(text);
+    if (command->action == CommandGrammar::Action::DictationMode) {
+        set_command_mode(false);
+    } else if (command->action == CommandGrammar::Action::Retype) {
+        retype_transcripts(command->count);
+    } else if (command->action == CommandGrammar::Action::StatsOverlay) {
+        set_stats_overlay(command->count != 0);
+    } else {
+        // Exactly as if the buttons had been clicked, chords included, in one flush
+        begin_key_batch();
+        for (const std::string& label : command->labels) {
+            handle_button_press(label);
+        }
+        end_key_batch();
+    }
+}
+
+void Keyboard::on_transcribed_text(const std::string& text) {
+    // Runs on the decoder thread: the queue notes when the result was posted and which audio it came from
+    m_result_queue.push(ResultQueue::Kind::Final, text, LatencyTracer::current_origin());
+}
+
+void Keyboard::on_results_ready() {
+    // One main loop dispatch for everything the decoder queued since the last one
+    m_result_queue.drain([this](const ResultQueue::Entry& entry) {
+        switch (entry.kind) {
+            case ResultQueue::Kind::Final:
+                handle_transcribed_text(entry.text, entry.origin_ns, entry.posted_ns);
+                break;
+            case ResultQueue::Kind::Partial:
+                handle_partial_text(entry.text);
+                break;
+            case ResultQueue::Kind::Command:
+                handle_command_text(entry.text);
+                break;
         }
-        return false; // Return false to disconnect the handler after one call
     });
 }
 
-void Keyboard::build_alphabetic_layout() {
-    std::cout << "DEBUG: build_alphabetic_layout called." << std::endl;
+void Keyboard::handle_transcribed_text(const std::string& text, uint64_t origin_ns, uint64_t posted_ns) {
+    uint64_t dispatched_ns = 0;
+    if (posted_ns != 0) {
+        dispatched_ns = LatencyTracer::now_ns();
+        LatencyTracer::instance().record(TraceStage::IdleDispatch, posted_ns, dispatched_ns - posted_ns);
+    }
+    if (text == CommandGrammar::ENTER_PHRASE && m_command_grammar.phrase_count() > 0) {
+        // Switch instead of typing; take back whatever live preview typed of the phrase
+        size_t erase = 0;
+        for (const std::string& word : m_preview_typed_words) {
+            erase += utf8_char_count(word) + 1;
+        }
+        erase_chars_globally(erase);
+        m_preview_typed_words.clear();
+        m_preview_last_words.clear();
+        m_signal_preview.emit(text);
+        set_command_mode(true);
+    } else if (text.empty() || text == " ") {
+        // The service dropped the final of an utterance live preview has been typing:
+        // take those words back so the next utterance starts clean
+        size_t erase = 0;
+        for (const std::string& word : m_preview_typed_words) {
+            erase += utf8_char_count(word) + 1;
+        }
+        if (erase > 0) {
+            VK_LOG_DEBUG("Final result dropped; erasing " << m_preview_typed_words.size() << " previewed word(s).");
+            erase_chars_globally(erase);
+        }
+        m_preview_typed_words.clear();
+        m_preview_last_words.clear();
+    } else {
+        VK_LOG_DEBUG("Transcribed text received: '" << text << "'");
+        m_signal_preview.emit(text);
+
+        // If live preview already typed part of this utterance, keep the prefix that the
+        // final result agrees with, erase the rest and type only what is missing.
+        std::vector<std::string> words = split_transcript_words(text);
+        size_t keep = 0;
+        while (keep < words.size() && keep < m_preview_typed_words.size() &&
+               words[keep] == m_preview_typed_words[keep]) {
+            keep++;
+        }
+        size_t erase = 0;
+        for (size_t i = keep; i < m_preview_typed_words.size(); ++i) {
+            erase += utf8_char_count(m_preview_typed_words[i]) + 1; // Word plus its trailing space
+        }
+
+        std::string remaining;
+        for (size_t i = keep; i < words.size(); ++i) {
+            remaining += words[i];
+            remaining += ' '; // Add a space after transcription for readability
+        }
+        // One job: the erase and the text follow each other without any key press in between.
+        // The worker records the KeyInjection/SpeechToText stages once it is typed.
+        output_text_globally(remaining, erase, origin_ns, dispatched_ns);
+
+        m_preview_typed_words.clear();
+        m_preview_last_words.clear();
+    }
+}
+
+void Keyboard::retype_transcripts(size_t count) {
+    if (m_journal_path.empty()) {
+        VK_LOG_WARNING("Nothing to retype: the transcript journal is off (set VK_JOURNAL=<file>).");
+        return;
+    }
+    // Its own read-only mapping: the decoder thread may be appending (and remapping) meanwhile
+    TranscriptJournalReader reader;
+    std::vector<JournalEntry> entries;
+    if (!reader.open(m_journal_path) || !reader.read_last(count, entries) || entries.empty()) {
+        VK_LOG_WARNING("Nothing to retype from " << m_journal_path << ".");
+        return;
+    }
+    std::string text;
+    for (const JournalEntry& entry : entries) {
+        text += entry.text;
+        text += ' '; // As typed the first time
+    }
+    VK_LOG_DEBUG("Retyping " << entries.size() << " transcript(s).");
+    cancel_pending_output();
+    output_text_globally(text, 0, 0, 0);
+}
+
+void Keyboard::set_layout(KeyLayout layout) {
+    // Same cells and the MIC button (which carries the listening state) in the same place:
+    // rebind the existing buttons instead of rebuilding the grid
+    bool rebind = !m_buttons.empty() && m_layout.same_geometry(layout);
+    for (size_t i = 0; rebind && i < layout.size(); ++i) {
+        bool was_mic = m_layout.key(i).action == KeyDescriptor::Action::Mic;
+        rebind = was_mic == (layout.key(i).action == KeyDescriptor::Action::Mic);
+    }
+    m_layout = std::move(layout);
+    if (!rebind) {
+        build_layout();
+        return;
+    }
+    VK_LOG_DEBUG("Rebinding buttons to layout '" << m_layout.name() << "'.");
+    for (size_t i = 0; i < m_buttons.size(); ++i) {
+        m_buttons[i]->bind(i, m_layout.key(i));
+    }
+    m_shown_layer = KeyLayout::BASE; // bind() shows the base labels
+    index_layout_buttons();
+    update_modifier_button_visuals();
+    update_command_grammar();
+}
+
+void Keyboard::build_layout() {
+    VK_LOG_DEBUG("build_layout called for '" << m_layout.name() << "'.");
     // Disconnect MIC button blink connection if active
     if (m_mic_blink_connection.connected()) {
         m_mic_blink_connection.disconnect();
@@ -413,168 +940,76 @@ void Keyboard::build_alphabetic_layout() {
     // Reset pointers to special buttons to avoid dangling pointers
     m_mic_button = nullptr;
 
-    int row = 0;
-    int col = 0;
-
-    // Row 0: Function keys, Hide, Kill (Total 15 columns)
-    add_button("ESC", row, col++);
-    add_button("F1", row, col++);
-    add_button("F2", row, col++);
-    add_button("F3", row, col++);
-    add_button("F4", row, col++);
-    add_button("F5", row, col++);
-    add_button("F6", row, col++);
-    add_button("F7", row, col++);
-    add_button("F8", row, col++);
-    add_button("F9", row, col++);
-    add_button("F10", row, col++);
-    add_button("F11", row, col++);
-    add_button("F12", row, col++);
-    add_button("HIDE", row, col++);
-    add_button("KILL", row, col++);
-
-    row++; col = 0; // Next row
-
-    // Row 1: Numbers and symbols (Total 15 columns, BACK is 2 units wide)
-    m_buttons.push_back(add_button_and_return_ptr("`", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("1", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("2", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("3", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("4", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("5", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("6", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("7", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("8", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("9", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("0", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("-", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("=", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("BACK", row, col, 2)); col += 2; // Backspace is 2 units wide
-
-    row++; col = 0; // Next row
-
-    // Row 2: QWERTY (Total 14 columns, TAB and \ are 1 unit wide for simplicity)
-    m_buttons.push_back(add_button_and_return_ptr("TAB", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("q", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("w", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("e", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("r", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("t", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("y", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("u", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("i", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("o", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("p", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("[", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("]", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("\\", row, col++));
-
-    row++; col = 0; // Next row
-
-    // Row 3: ASDF (Total 15 columns, CAPS and ENTER are 2 units wide)
-    m_buttons.push_back(add_button_and_return_ptr("CAPS", row, col, 2)); col += 2;
-    m_buttons.push_back(add_button_and_return_ptr("a", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("s", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("d", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("f", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("g", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("h", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("j", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("k", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("l", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr(";", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("'", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("ENTER", row, col, 2)); col += 2;
-
-    row++; col = 0; // Next row
-
-    // Row 4: ZXCV (Total 14 columns, SHIFT is 2 units wide on both sides)
-    m_buttons.push_back(add_button_and_return_ptr("SHIFT", row, col, 2)); col += 2;
-    m_buttons.push_back(add_button_and_return_ptr("z", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("x", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("c", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("v", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("b", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("n", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("m", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr(",", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr(".", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("/", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("SHIFT", row, col, 2)); col += 2;
-
-    row++; col = 0; // Next row
-
-    // Row 5: Bottom row (Total 15 columns, SPACE is 6 units wide)
-    m_buttons.push_back(add_button_and_return_ptr("CTRL", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("FN", row, col++)); // Simple FN key, no layout switch
-    m_buttons.push_back(add_button_and_return_ptr("ALT", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("SPACE", row, col, 6)); col += 6;
-    m_buttons.push_back(add_button_and_return_ptr("ALTGR", row, col++)); // AltGr button
-    m_buttons.push_back(add_button_and_return_ptr("COMPOSE", row, col++)); // NEW: Compose button
-    m_buttons.push_back(add_button_and_return_ptr("←", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("↑", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("↓", row, col++));
-    m_buttons.push_back(add_button_and_return_ptr("→", row, col++));
-    
-    // MIC button
-    m_mic_button = add_button_and_return_ptr("🎙️", row, col++);
-    m_mic_button->get_style_context()->add_class("mic-button");
+    // One button per descriptor; m_buttons[i] shows m_layout.key(i)
+    m_buttons.reserve(m_layout.size());
+    for (size_t i = 0; i < m_layout.size(); ++i) {
+        m_buttons.push_back(add_key_button(i));
+    }
+    m_shown_layer = KeyLayout::BASE;
+    index_layout_buttons();
 
     show_all_children(); // Ensure all newly added buttons are shown
+    update_modifier_button_visuals();
+    update_command_grammar();
 }
 
-void Keyboard::add_button(const Glib::ustring& label, int row, int col, int width, int height) {
-    KeyboardButton* button = Gtk::manage(new KeyboardButton(label, this));
-    attach(*button, col, row, width, height);
-    button->signal_keypress().connect(sigc::mem_fun(this, &Keyboard::handle_button_press));
-    // Add all buttons to m_buttons vector for CAPS state management
-    m_buttons.push_back(button);
-}
-
-KeyboardButton* Keyboard::add_button_and_return_ptr(const Glib::ustring& label, int row, int col, int width, int height) {
-    KeyboardButton* button = Gtk::manage(new KeyboardButton(label, this));
-    attach(*button, col, row, width, height);
-    button->signal_keypress().connect(sigc::mem_fun(this, &Keyboard::handle_button_press));
-    m_buttons.push_back(button); // Add to vector
+KeyboardButton* Keyboard::add_key_button(size_t index) {
+    const KeyDescriptor& key = m_layout.key(index);
+    KeyboardButton* button = Gtk::manage(new KeyboardButton(index, key, this));
+    attach(*button, key.col, key.row, key.width, key.height);
+    button->signal_keypress().connect(sigc::mem_fun(this, &Keyboard::handle_key_press));
     return button; // Return the pointer
 }
 
-void Keyboard::apply_caps_state_to_buttons() {
-    std::cout << "DEBUG: Applying CAPS state. Current caps_active: " << (m_caps_active ? "true" : "false") << std::endl;
-    for (KeyboardButton* button : m_buttons) {
-        Glib::ustring label = button->get_label();
-        if (label.length() == 1 && std::isalpha(label[0])) {
-            if (m_caps_active) {
-                button->set_label(Glib::ustring(1, static_cast<char>(std::toupper(label[0]))));
-            } else {
-                button->set_label(Glib::ustring(1, static_cast<char>(std::tolower(label[0]))));
-            }
-        } else if (label == "CAPS") { // Apply visual state to CAPS button
-            if (m_caps_active) {
-                button->get_style_context()->add_class("toggle-active");
-            } else {
-                button->get_style_context()->remove_class("toggle-active");
-            }
+void Keyboard::index_layout_buttons() {
+    m_toggle_buttons.clear();
+    m_mic_button = nullptr;
+    for (size_t i = 0; i < m_buttons.size(); ++i) {
+        const KeyDescriptor& key = m_layout.key(i);
+        if (key.is_toggle()) {
+            m_toggle_buttons.push_back(i);
+        } else if (key.action == KeyDescriptor::Action::Mic && !m_mic_button) {
+            m_mic_button = m_buttons[i];
         }
     }
-    // Also update SHIFT button if it's currently active, as CAPS affects its behavior
-    // This is handled by update_modifier_button_visuals for SHIFT itself.
 }
 
-void Keyboard::update_modifier_button_visuals(const Glib::ustring& label, bool is_active) {
-    for (KeyboardButton* button : m_buttons) {
-        if (button->get_label() == label) {
-            Glib::RefPtr<Gtk::StyleContext> context = button->get_style_context();
-            if (is_active) {
-                context->add_class("toggle-active");
-            } else {
-                context->remove_class("toggle-active");
-            }
-            // If SHIFT state changes, and CAPS is not active, update alpha keys
-            if (label == "SHIFT" && !m_caps_active) {
-                apply_caps_state_to_buttons(); // Re-apply to change case of alpha keys
-            }
-            break; // Found the button, no need to continue
+void Keyboard::update_layer_labels() {
+    KeyLayout::Layer layer = KeyLayout::layer_for(m_shift_active, m_caps_active, m_fn_active, m_altgr_active);
+    if (layer == m_shown_layer) {
+        return; // e.g. SHIFT while CAPS is on, or CTRL: no label changes
+    }
+    // One pass over the keys whose label differs between the two layers; the resizes queued
+    // by set_label() are coalesced into a single relayout on the next frame
+    for (size_t index : m_layout.relabelled(m_shown_layer, layer)) {
+        m_buttons[index]->set_label(m_layout.label(index, layer));
+    }
+    VK_LOG_DEBUG("Showing layer " << static_cast<int>(layer) << " ("
+                 << m_layout.relabelled(m_shown_layer, layer).size() << " labels changed).");
+    m_shown_layer = layer;
+}
+
+bool Keyboard::is_modifier_active(KeyDescriptor::Action action) const {
+    switch (action) {
+    case KeyDescriptor::Action::Shift: return m_shift_active;
+    case KeyDescriptor::Action::Caps:  return m_caps_active;
+    case KeyDescriptor::Action::Ctrl:  return m_ctrl_active;
+    case KeyDescriptor::Action::Alt:   return m_alt_active;
+    case KeyDescriptor::Action::AltGr: return m_altgr_active;
+    case KeyDescriptor::Action::Fn:    return m_fn_active;
+    default:                           return false;
+    }
+}
+
+void Keyboard::update_modifier_button_visuals() {
+    update_layer_labels();
+    // Every copy of a modifier (both SHIFTs) follows the state
+    for (size_t index : m_toggle_buttons) {
+        Glib::RefPtr<Gtk::StyleContext> context = m_buttons[index]->get_style_context();
+        if (is_modifier_active(m_layout.key(index).action)) {
+            context->add_class("toggle-active");
+        } else {
+            context->remove_class("toggle-active");
         }
     }
 }
@@ -596,8 +1031,8 @@ Keyboard::type_signal_input Keyboard::signal_input() {
     return m_signal_input;
 }
 
-Keyboard::type_signal_upper Keyboard::signal_upper() {
-    return m_signal_upper;
+Keyboard::type_signal_preview Keyboard::signal_preview() {
+    return m_signal_preview;
 }
 
 Keyboard::type_signal_hide_show Keyboard::signal_hide_show() {
@@ -607,3 +1042,109 @@ Keyboard::type_signal_hide_show Keyboard::signal_hide_show() {
 Keyboard::type_signal_quit_app Keyboard::signal_quit_app() {
     return m_signal_quit_app;
 }
+
+Keyboard::type_signal_stats_overlay Keyboard::signal_stats_overlay() {
+    return m_signal_stats_overlay;
+}
+
+void Keyboard::set_stats_overlay(bool shown) {
+    m_stats_overlay = shown;
+    m_signal_stats_overlay.emit(shown);
+}
+
+std::string Keyboard::handle_control_command(const std::string& command) {
+    std::istringstream words(command);
+    std::string verb, name, value, extra;
+    words >> verb >> name >> value >> extra;
+
+    if (verb == "stats" && name.empty()) {
+        return RuntimeStats::instance().snapshot().to_json();
+    }
+    if (verb == "get" && value.empty()) {
+        if (!name.empty()) {
+            std::string current = control_knob(name);
+            return current.empty() ? "error: unknown knob '" + name + "'" : name + "=" + current;
+        }
+        std::string all;
+        for (const char* knob : { "chunk_ms", "chunk_min_ms", "chunk_max_ms", "vad", "vad_min_rms",
+                                  "vad_noise_ratio", "live_preview", "command_mode", "overlay" }) {
+            all += all.empty() ? "" : " ";
+            all += std::string(knob) + "=" + control_knob(knob);
+        }
+        return all;
+    }
+    if (verb == "set" && !value.empty() && extra.empty()) {
+        std::string error;
+        if (!set_control_knob(name, value, error)) {
+            return "error: " + error;
+        }
+        VK_LOG_INFO("Control: " << name << " set to " << value << ".");
+        return "ok " + name + "=" + control_knob(name);
+    }
+    if (verb == "help") {
+        return "commands: stats | get [knob] | set <knob> <value> | help; knobs: chunk_ms chunk_min_ms "
+               "chunk_max_ms vad vad_min_rms vad_noise_ratio live_preview command_mode overlay";
+    }
+    return "error: bad command '" + command + "' (try help)";
+}
+
+std::string Keyboard::control_knob(const std::string& name) const {
+    auto number = [](double value) {
+        std::ostringstream text;
+        text << value;
+        return text.str();
+    };
+    if (name == "chunk_ms") return std::to_string(m_stt_service->chunk_policy_config().fixed_ms);
+    if (name == "chunk_min_ms") return std::to_string(m_stt_service->chunk_policy_config().min_ms);
+    if (name == "chunk_max_ms") return std::to_string(m_stt_service->chunk_policy_config().max_ms);
+    if (name == "vad") return m_stt_service->vad_enabled() ? "1" : "0";
+    if (name == "vad_min_rms") return number(m_stt_service->vad_config().min_rms);
+    if (name == "vad_noise_ratio") return number(m_stt_service->vad_config().noise_ratio);
+    if (name == "live_preview") return m_stt_service->live_preview() ? "1" : "0";
+    if (name == "command_mode") return m_stt_service->command_mode() ? "1" : "0";
+    if (name == "overlay") return m_stats_overlay ? "1" : "0";
+    return "";
+}
+
+bool Keyboard::set_control_knob(const std::string& name, const std::string& value, std::string& error) {
+    char* end = nullptr;
+    double number = std::strtod(value.c_str(), &end);
+    if (end == value.c_str() || *end != '\0' || number < 0.0) {
+        error = "'" + value + "' is not a non-negative number";
+        return false;
+    }
+    bool on = number != 0.0;
+
+    if (name == "chunk_ms" || name == "chunk_min_ms" || name == "chunk_max_ms") {
+        ChunkSizePolicy::Config config = m_stt_service->chunk_policy_config();
+        unsigned ms = static_cast<unsigned>(number);
+        if (name == "chunk_ms") {
+            config.fixed_ms = ms;
+        } else if (name == "chunk_min_ms") {
+            config.min_ms = ms;
+        } else {
+            config.max_ms = ms;
+        }
+        if (config.min_ms > config.max_ms) {
+            error = "chunk_min_ms can't exceed chunk_max_ms";
+            return false;
+        }
+        m_stt_service->set_chunk_policy_config(config);
+    } else if (name == "vad") {
+        m_stt_service->set_vad_enabled(on);
+    } else if (name == "vad_min_rms" || name == "vad_noise_ratio") {
+        VoiceActivityDetector::Config config = m_stt_service->vad_config();
+        (name == "vad_min_rms" ? config.min_rms : config.noise_ratio) = static_cast<float>(number);
+        m_stt_service->set_vad_config(config);
+    } else if (name == "live_preview") {
+        set_live_preview(on);
+    } else if (name == "command_mode") {
+        set_command_mode(on);
+    } else if (name == "overlay") {
+        set_stats_overlay(on);
+    } else {
+        error = "unknown knob '" + name + "'";
+        return false;
+    }
+    return true;
+}
@@ -4,9 +4,13 @@
 #include <gtkmm/grid.h>         // For Gtk::Grid base class
 #include <glibmm/ustring.h>     // For Glib::ustring
 #include <sigc++/sigc++.h>      // For signals (sigc::signal, sigc::mem_fun)
-#include <memory>               // For std::unique_ptr
+#include <memory>               // For std::unique_ptr, std::shared_ptr
+#include <deque>
+#include <functional>
+#include <cstdint>
 #include <chrono>               // For std::chrono::steady_clock, std::chrono::milliseconds
-#include <map>                  // For std::map to track modifier states and FN mappings
+#include <vector>
+#include <string>
 
 // --- X11 headers for KeySym and Display types ---
 #include <X11/Xlib.h>          // For Display* type
@@ -20,6 +24,14 @@
 // --- NEW: Include SpeechToTextService header ---
 #include "speechtotextservice.h"
 #include "keyboardbutton.h" // Include KeyboardButton for the pointer declarations
+#include "commandgrammar.h"
+#include "controlsocket.h"
+#include "injectionworker.h"
+#include "resultqueue.h"
+#include "keycodetable.h"
+#include "keylayout.h"
+#include "textoutputpolicy.h"
+#include "xkeyinjector.h"
 
 class Keyboard : public Gtk::Grid {
 public:
@@ -30,41 +42,83 @@ public:
     void send_global_key_event(KeySym keysym, bool is_press);
     // New function to send a key with currently active modifiers
     void send_key_with_active_modifiers(KeySym base_keysym, bool needs_shift_for_base_char = false);
+    // Sends a pre-resolved key (from the injector's keycode table) with currently active modifiers
+    void send_stroke_with_active_modifiers(const KeyStroke& stroke);
+
+    // Key events sent between begin_key_batch() and the matching end_key_batch() are queued
+    // and flushed to the X server together. Calls may nest; the outermost end flushes.
+    void begin_key_batch();
+    void end_key_batch();
 
     // Signal definitions
     using type_signal_input = sigc::signal<void, const std::string&>;
-    using type_signal_upper = sigc::signal<void, bool>; // Signal to update button labels for CAPS
+    using type_signal_preview = sigc::signal<void, const std::string&>; // Live transcript preview text
     using type_signal_hide_show = sigc::signal<void>; // This will now trigger minimize/restore
     using type_signal_quit_app = sigc::signal<void>;
+    using type_signal_stats_overlay = sigc::signal<void, bool>; // Show or hide the stats overlay
 
     type_signal_input signal_input();
-    type_signal_upper signal_upper();
+    type_signal_preview signal_preview();
     type_signal_hide_show signal_hide_show();
     type_signal_quit_app signal_quit_app();
-
-    // Button adding helpers
-    void add_button(const Glib::ustring& label, int row, int col, int width = 1, int height = 1);
-    KeyboardButton* add_button_and_return_ptr(const Glib::ustring& label, int row, int col, int width = 1, int height = 1);
-
-    // Handle button presses from KeyboardButton
+    type_signal_stats_overlay signal_stats_overlay();
+
+    // Runtime stats overlay (STATS key, "set overlay" on the control socket, VK_STATS_OVERLAY=1
+    // at startup). The keyboard only keeps the state; the window shows the overlay.
+    void set_stats_overlay(bool shown);
+    bool stats_overlay() const { return m_stats_overlay; }
+
+    // Runs one control socket command (main thread) and returns its reply line:
+    //   stats                  RuntimeStats as one JSON object
+    //   get [knob]             one knob, or all of them, as name=value
+    //   set <knob> <value>     chunk_ms (0 = adaptive), chunk_min_ms, chunk_max_ms, vad (0/1),
+    //                          vad_min_rms, vad_noise_ratio, live_preview, command_mode, overlay
+    //   help
+    std::string handle_control_command(const std::string& command);
+
+    // Switches to another layout. Buttons are rebound in place when the key cells match,
+    // the grid is rebuilt otherwise.
+    void set_layout(KeyLayout layout);
+
+    // Handle button presses from KeyboardButton: 'index' is the key's position in m_layout
+    void handle_key_press(size_t index);
+    // Presses the first key with this label, or with this FN label (voice commands)
     void handle_button_press(const Glib::ustring& label);
 
-    // Handle transcribed text from STT service
+    // Transcribed text from STT service (decoder thread; queued for the main loop)
     void on_transcribed_text(const std::string& text);
 
-    // Helper to apply CAPS state to all alpha buttons
-    void apply_caps_state_to_buttons();
+    // Partial hypotheses from STT service in live preview mode (decoder thread; queued)
+    void on_partial_text(const std::string& text);
+
+    // Phrases recognized in command mode (decoder thread; queued): they press buttons instead of being typed
+    void on_command_text(const std::string& text);
+
+    // Types the last 'count' transcripts from the journal again (RETYPE key, "retype last three")
+    void retype_transcripts(size_t count);
 
-    // Helper to apply visual state to modifier buttons
-    void update_modifier_button_visuals(const Glib::ustring& label, bool is_active);
+    // Switch between dictation and voice commands. Saying "command mode" while dictating
+    // enters command mode, "dictation" leaves it.
+    void set_command_mode(bool enabled);
 
-    // NEW: Function to update labels of FN-shifted keys
-    void update_fn_key_labels();
+    // Enable/disable live preview: partials are shown via signal_preview() and their
+    // stable word prefix is typed before the utterance is finalised
+    void set_live_preview(bool enabled);
 
+    // Helper to apply visual state to modifier buttons (toggle-active follows the modifier flags)
+    void update_modifier_button_visuals();
+    bool is_modifier_active(KeyDescriptor::Action action) const;
 
-    // Member variables that rely on X11 types
-    Display* m_x_display;
-    bool m_xtest_available;
+    // Relabels the buttons for the layer the modifier flags select
+    void update_layer_labels();
+
+    // X display, keycode table, remapper and event batching for on-screen key presses
+    XKeyInjector m_injector;
+    // Transcript output, typed on its own thread and display connection
+    InjectionWorker m_injection;
+
+    // How transcripts are delivered (typed vs. pasted), per target window class
+    TextOutputPolicy m_output_policy;
     
     bool m_caps_active; // Track CAPS lock state (visual toggle, also affects shift for letters)
 
@@ -77,33 +131,117 @@ public:
     bool m_compose_active; // NEW: Tracks if COMPOSE button is currently "held down" (toggled)
 
     type_signal_input m_signal_input;
-    type_signal_upper m_signal_upper;
+    type_signal_preview m_signal_preview;
     type_signal_hide_show m_signal_hide_show;
     type_signal_quit_app m_signal_quit_app;
+    type_signal_stats_overlay m_signal_stats_overlay;
+    bool m_stats_overlay;
+
+    // Results on their way from the decoder thread to the main loop. Declared before
+    // m_stt_service so it outlives the threads that push into it.
+    ResultQueue m_result_queue;
+    void on_results_ready(); // Drains m_result_queue (main thread)
+    void handle_transcribed_text(const std::string& text, uint64_t origin_ns, uint64_t posted_ns);
+    void handle_partial_text(const std::string& text);
+    void handle_command_text(const std::string& text);
 
     // SpeechToTextService instance
     std::unique_ptr<SpeechToTextService> m_stt_service;
+    std::string m_journal_path; // Transcript journal the service appends to, empty when off
 
     // Members for MIC button blinking
     KeyboardButton* m_mic_button; // Pointer to the actual MIC button
     sigc::connection m_mic_blink_connection; // Connection for the Glib::signal_timeout
+    void toggle_listening(); // MIC button action
     bool on_mic_button_blink_timeout(); // Timeout handler for blinking
 
+    // MIC button "loading" state while the model loads in the background
+    void set_mic_loading(bool loading);
+    void on_model_loaded(bool ok); // Runs on the GTK main thread
+
     // Debounce for MIC button
     std::chrono::steady_clock::time_point m_last_mic_click_time;
-    const std::chrono::milliseconds m_mic_debounce_interval = std::chrono::milliseconds(500); // 500ms debounce
+    std::chrono::milliseconds m_mic_debounce_interval = std::chrono::milliseconds(500); // 500ms debounce (150ms with hot standby)
+
+    // The keys on screen, loaded once; buttons refer to them by index
+    KeyLayout m_layout;
 
     // Keep track of all KeyboardButton instances to update their labels/styles
-    std::vector<KeyboardButton*> m_buttons; // Store pointers to all buttons
+    std::vector<KeyboardButton*> m_buttons; // m_buttons[i] shows m_layout.key(i)
+    std::vector<size_t> m_toggle_buttons;   // Indices of modifier buttons with a toggle-active state
+    KeyLayout::Layer m_shown_layer;         // Layer whose labels the buttons currently show
 
-    // NEW: Map to store FN-shifted key labels and their corresponding KeySyms
-    // Key: original button label (e.g., "BACK", "↑")
-    // Value: pair of (FN-shifted label, FN-shifted KeySym)
-    std::map<Glib::ustring, std::pair<Glib::ustring, KeySym>> m_fn_key_map;
 
 private:
-    void init_x_display_and_xtest();
-    void build_alphabetic_layout(); // New function for fixed layout
+    // Queue text to be typed, or backspaces to correct preview text, on the injection worker
+    void type_text_globally(const std::string& text);
+    void erase_chars_globally(size_t count);
+
+    // Erases 'erase' characters, then delivers text with the strategy m_output_policy picks for
+    // the focused window, as one injection job (dispatched_ns/origin_ns feed latency tracing)
+    void output_text_globally(const std::string& text, size_t erase, uint64_t origin_ns, uint64_t dispatched_ns);
+    // Stops queued and running output so an on-screen key press isn't mixed into it
+    void cancel_pending_output();
+    // WM_CLASS class name of the window manager's active window, empty if unknown
+    std::string active_window_class();
+
+    // Hands a job to the injection worker, or holds it behind a paste that is in progress
+    void submit_output(InjectionWorker::Job job);
+
+    // Clipboard fast path: own CLIPBOARD/PRIMARY, send one paste key, restore afterwards
+    // 'job' carries the erase and tracing of the transcript; the paste key is added to it.
+    // Nothing here waits on the main thread: the paste continues from the main loop once
+    // earlier output is typed and the user's selections have been read, and later output is
+    // held until its paste key has gone out.
+    void paste_text_globally(const std::string& text, TextOutputMode mode, InjectionWorker::Job job);
+    struct PendingOutput {
+        InjectionWorker::Job job;
+        std::string paste_text; // Empty: 'job' is submitted as it is
+        TextOutputMode mode;
+    };
+    void begin_paste(std::shared_ptr<PendingOutput> paste);
+    void save_selections_and_paste(std::shared_ptr<PendingOutput> paste);
+    void claim_selections_and_paste(std::shared_ptr<PendingOutput> paste);
+    void finish_paste();
+    // An InjectionWorker::Job::on_done that runs 'step' from the main loop, unless the
+    // Keyboard is gone or the paste it belongs to was cancelled by then
+    std::function<void(bool)> paste_step(std::function<void()> step);
+    void schedule_selection_restore();
+    void restore_saved_selections();
+    sigc::connection m_paste_restore_connection;
+    bool m_paste_restore_pending; // The user's selections are saved and not yet restored
+    const unsigned int m_paste_restore_delay_ms = 300;
+    bool m_saved_clipboard_valid;
+    bool m_saved_primary_valid;
+    Glib::ustring m_saved_clipboard_text;
+    Glib::ustring m_saved_primary_text;
+    std::deque<PendingOutput> m_held_output; // Output submitted while a paste is in progress
+    bool m_paste_in_progress;
+    uint64_t m_paste_generation; // Bumped when output is cancelled; stale paste steps stop
+    std::shared_ptr<bool> m_lifetime; // Posted paste steps hold a weak_ptr to it
+
+    // Live preview state for the current utterance (GTK main thread only)
+    std::vector<std::string> m_preview_last_words;  // Words of the previous partial hypothesis
+    std::vector<std::string> m_preview_typed_words; // Stable words already typed
+
+    // Creates one button per key of m_layout
+    void build_layout();
+    KeyboardButton* add_key_button(size_t index);
+    // Runs key 'index', its FN function if 'fn' is set and it has one
+    void press_key(size_t index, bool fn);
+    // Finds the toggle and MIC buttons of the current layout
+    void index_layout_buttons();
+
+    // Live tuning over VK_CONTROL_SOCKET (see handle_control_command)
+    ControlSocket m_control;
+    // Current value of a control knob as text, empty if there is no such knob
+    std::string control_knob(const std::string& name) const;
+    // Sets a control knob; on failure 'error' says why
+    bool set_control_knob(const std::string& name, const std::string& value, std::string& error);
+
+    // Command mode vocabulary, regenerated whenever the button set changes
+    CommandGrammar m_command_grammar;
+    void update_command_grammar();
 };
 
 #endif // KEYBOARD_H
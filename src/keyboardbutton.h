@@ -4,15 +4,17 @@
 #include <gtkmm/button.h>
 #include <glibmm/ustring.h>
 #include <sigc++/sigc++.h>
+#include <cstddef>
 #include <iostream> // For DEBUG output in inline destructor
+#include "keylayout.h"
 
 // Forward declaration of Keyboard class to avoid circular includes
 class Keyboard;
 
 class KeyboardButton : public Gtk::Button {
 public:
-    // Constructor: Takes the label for the button and a pointer to the parent Keyboard
-    KeyboardButton(const Glib::ustring& label, Keyboard* parent_keyboard);
+    // Constructor: Takes the index of the button's key in the layout, its descriptor and a pointer to the parent Keyboard
+    KeyboardButton(size_t index, const KeyDescriptor& key, Keyboard* parent_keyboard);
 
     // FIX: Define destructor inline in the header to ensure vtable generation
     // Removed debug print to avoid Gtk-CRITICAL warnings during shutdown
@@ -22,12 +24,13 @@ public:
         // std::cout << "DEBUG: KeyboardButton DESTROYED: " << get_label() << " (Address: " << this << ")" << std::endl;
     }
 
-    // Signal definition for when this button is pressed
-    using type_signal_keypress = sigc::signal<void, const Glib::ustring&>;
+    // Signal definition for when this button is pressed: carries the key's layout index
+    using type_signal_keypress = sigc::signal<void, size_t>;
     type_signal_keypress signal_keypress();
 
-    // Method to update the button's label based on CAPS lock state
-    void update_label_for_caps(bool caps_active);
+    // Shows another key in the same cell (layout switch): base label and CSS classes follow 'key'
+    void bind(size_t index, const KeyDescriptor& key);
+    size_t index() const { return m_index; }
 
     // NEW: Getter for the original label
     Glib::ustring get_original_label() const;
@@ -39,7 +42,9 @@ protected:
 private:
     Keyboard* m_parent_keyboard; // Pointer to the parent Keyboard instance
     type_signal_keypress m_signal_keypress;
+    size_t m_index; // Index of the bound key in the Keyboard's layout
     Glib::ustring m_original_label; // NEW: Store the original label of the button
+    std::vector<std::string> m_style_classes; // CSS classes added for the bound key
 };
 
 #endif // KEYBOARD_BUTTON_H
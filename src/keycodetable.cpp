@@ -0,0 +1,180 @@
+// keycodetable.cpp
+// Implementation file for the KeycodeTable class.
+
+#include "keycodetable.h"
+#include "logger.h"
+#include <X11/keysym.h>
+#include <X11/Xutil.h>
+
+// Positions in the core keyboard mapping, in order of preference.
+// Index 0/1 are group 1 levels 1/2; with XKB, indices 4/5 are group 1 levels 3/4 (AltGr).
+// Indices 2/3 belong to group 2 and would need a group switch, so they are not used.
+static const struct { int index; unsigned char modifiers; } KEYMAP_LEVELS[] = {
+    { 0, KeyStroke::NONE },
+    { 1, KeyStroke::SHIFT },
+    { 4, KeyStroke::ALTGR },
+    { 5, KeyStroke::SHIFT | KeyStroke::ALTGR },
+};
+
+unsigned long keysym_to_code_point(KeySym keysym) {
+    if ((keysym >= 0x20 && keysym <= 0x7e) || (keysym >= 0xa0 && keysym <= 0xff)) {
+        return keysym; // Latin-1 KeySyms equal their code point
+    }
+    if ((keysym & 0xff000000) == 0x01000000) {
+        return keysym & 0x00ffffff; // Unicode KeySyms
+    }
+    switch (keysym) {
+        case XK_BackSpace: return '\b';
+        case XK_Tab: return '\t';
+        case XK_Return: return '\n';
+        case XK_Delete: return 127;
+        default: return 0;
+    }
+}
+
+KeySym code_point_to_keysym(unsigned long code_point) {
+    if ((code_point >= 0x20 && code_point <= 0x7e) || (code_point >= 0xa0 && code_point <= 0xff)) {
+        return code_point;
+    }
+    switch (code_point) {
+        case '\b': return XK_BackSpace;
+        case '\t': return XK_Tab;
+        case '\n': return XK_Return;
+        case 127: return XK_Delete;
+        default: return 0x01000000 | code_point;
+    }
+}
+
+void decode_utf8(const std::string& text, std::vector<unsigned long>& out) {
+    out.clear();
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(text.data());
+    const unsigned char* end = p + text.size();
+    while (p < end) {
+        unsigned char lead = *p++;
+        unsigned long cp;
+        int continuation;
+        if (lead < 0x80) { out.push_back(lead); continue; }
+        else if ((lead & 0xE0) == 0xC0) { cp = lead & 0x1F; continuation = 1; }
+        else if ((lead & 0xF0) == 0xE0) { cp = lead & 0x0F; continuation = 2; }
+        else if ((lead & 0xF8) == 0xF0) { cp = lead & 0x07; continuation = 3; }
+        else { out.push_back(0xFFFD); continue; }
+
+        bool valid = true;
+        for (int i = 0; i < continuation; ++i) {
+            if (p >= end || (*p & 0xC0) != 0x80) {
+                valid = false;
+                break;
+            }
+            cp = (cp << 6) | (*p++ & 0x3F);
+        }
+        out.push_back(valid ? cp : 0xFFFD);
+    }
+}
+
+KeycodeTable::KeycodeTable() {
+    m_latin1.fill(KeyStroke { 0, KeyStroke::NONE });
+}
+
+bool KeycodeTable::build(Display* display) {
+    m_latin1.fill(KeyStroke { 0, KeyStroke::NONE });
+    m_unicode.clear();
+    m_keysyms.clear();
+    if (!display) {
+        return false;
+    }
+
+    int min_keycode = 0, max_keycode = 0;
+    XDisplayKeycodes(display, &min_keycode, &max_keycode);
+    int keysyms_per_keycode = 0;
+    KeySym* keysyms = XGetKeyboardMapping(display, static_cast<KeyCode>(min_keycode),
+                                          max_keycode - min_keycode + 1, &keysyms_per_keycode);
+    if (!keysyms) {
+        VK_LOG_ERROR("XGetKeyboardMapping failed, keycode table is empty.");
+        return false;
+    }
+
+    // Walk levels in order of preference so each symbol ends up with the fewest modifiers
+    for (const auto& level : KEYMAP_LEVELS) {
+        if (level.index >= keysyms_per_keycode) {
+            continue;
+        }
+        for (int keycode = min_keycode; keycode <= max_keycode; ++keycode) {
+            KeySym keysym = keysyms[(keycode - min_keycode) * keysyms_per_keycode + level.index];
+            if (keysym != NoSymbol) {
+                insert(keysym, static_cast<KeyCode>(keycode), level.modifiers);
+            }
+        }
+    }
+    XFree(keysyms);
+
+    // A keymap that lists letters only once (lowercase, no level 2) still types capitals with Shift
+    for (unsigned long c = 'a'; c <= 'z'; ++c) {
+        KeyStroke& upper = m_latin1[c - 'a' + 'A'];
+        if (upper.keycode == 0 && m_latin1[c].keycode != 0) {
+            upper = KeyStroke { m_latin1[c].keycode, static_cast<unsigned char>(m_latin1[c].modifiers | KeyStroke::SHIFT) };
+        }
+    }
+
+    VK_LOG_DEBUG("Keycode table built: " << m_keysyms.size() << " KeySyms, "
+              << m_unicode.size() << " non-Latin-1 characters.");
+    return true;
+}
+
+void KeycodeTable::insert(KeySym keysym, KeyCode keycode, unsigned char modifiers) {
+    KeyStroke stroke { keycode, modifiers };
+    m_keysyms.emplace(keysym, stroke); // emplace keeps the first (cheapest) entry
+
+    unsigned long code_point = keysym_to_code_point(keysym);
+    if (code_point == 0) {
+        return;
+    }
+    if (code_point < m_latin1.size()) {
+        if (m_latin1[code_point].keycode == 0) {
+            m_latin1[code_point] = stroke;
+        }
+    } else {
+        m_unicode.emplace(code_point, stroke);
+    }
+}
+
+bool KeycodeTable::refresh_if_changed(Display* display) {
+    if (!display) {
+        return false;
+    }
+    bool changed = false;
+    // We never select input on any window, so MappingNotify is the only event we receive
+    while (XPending(display) > 0) {
+        XEvent event;
+        XNextEvent(display, &event);
+        if (event.type == MappingNotify) {
+            XRefreshKeyboardMapping(&event.xmapping);
+            changed = true;
+        }
+    }
+    if (changed) {
+        build(display);
+    }
+    return changed;
+}
+
+bool KeycodeTable::lookup_char(unsigned long code_point, KeyStroke& stroke) const {
+    if (code_point < m_latin1.size()) {
+        stroke = m_latin1[code_point];
+        return stroke.keycode != 0;
+    }
+    auto it = m_unicode.find(code_point);
+    if (it == m_unicode.end()) {
+        return false;
+    }
+    stroke = it->second;
+    return true;
+}
+
+bool KeycodeTable::lookup_keysym(KeySym keysym, KeyStroke& stroke) const {
+    auto it = m_keysyms.find(keysym);
+    if (it == m_keysyms.end()) {
+        return false;
+    }
+    stroke = it->second;
+    return true;
+}
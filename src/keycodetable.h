@@ -0,0 +1,66 @@
+// keycodetable.h
+// Header file for the KeycodeTable class.
+// Maps characters and KeySyms straight to a KeyCode plus the Shift/AltGr level needed
+// to produce them, built once from the live X keymap with XGetKeyboardMapping.
+// ASCII/Latin-1 characters use a flat 256-entry array; other code points and
+// non-character KeySyms use hash maps. Rebuild after a MappingNotify.
+
+#ifndef KEYCODE_TABLE_H
+#define KEYCODE_TABLE_H
+
+#include <X11/Xlib.h>
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A key plus the modifiers that select the wanted level on it
+struct KeyStroke {
+    enum Modifier : unsigned char {
+        NONE  = 0,
+        SHIFT = 1 << 0, // Level 2
+        ALTGR = 1 << 1  // Level 3 (XK_ISO_Level3_Shift)
+    };
+
+    KeyCode keycode;          // 0 when the character is not on the keymap
+    unsigned char modifiers;  // Combination of Modifier flags
+};
+
+class KeycodeTable {
+public:
+    KeycodeTable();
+
+    // (Re)builds the table from the display's current keyboard mapping
+    bool build(Display* display);
+
+    // Drains pending events and rebuilds the table if a MappingNotify arrived.
+    // Returns true if the table was rebuilt.
+    bool refresh_if_changed(Display* display);
+
+    // Stroke that types the given Unicode code point, false if no key produces it
+    bool lookup_char(unsigned long code_point, KeyStroke& stroke) const;
+
+    // Stroke for a KeySym (function keys, modifiers, characters), false if unmapped
+    bool lookup_keysym(KeySym keysym, KeyStroke& stroke) const;
+
+    bool empty() const { return m_keysyms.empty(); }
+
+private:
+    std::array<KeyStroke, 256> m_latin1;                      // Code points 0-255
+    std::unordered_map<unsigned long, KeyStroke> m_unicode;   // Code points above 255
+    std::unordered_map<KeySym, KeyStroke> m_keysyms;
+
+    void insert(KeySym keysym, KeyCode keycode, unsigned char modifiers);
+};
+
+// Unicode code point produced by a KeySym, or 0 if it is not a character KeySym
+unsigned long keysym_to_code_point(KeySym keysym);
+
+// KeySym that represents a Unicode code point
+KeySym code_point_to_keysym(unsigned long code_point);
+
+// Decodes UTF-8 into code points (replacing invalid sequences with U+FFFD).
+// 'out' is cleared first; its capacity is reused.
+void decode_utf8(const std::string& text, std::vector<unsigned long>& out);
+
+#endif // KEYCODE_TABLE_H
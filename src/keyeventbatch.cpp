@@ -0,0 +1,70 @@
+// keyeventbatch.cpp
+// Implementation file for the KeyEventBatch class.
+
+#include "keyeventbatch.h"
+#include "runtimestats.h"
+#include <X11/extensions/XTest.h>
+
+KeyEventBatch::KeyEventBatch(size_t max_pending)
+    : m_display(nullptr),
+      m_max_pending(max_pending > 0 ? max_pending : 1),
+      m_sync_barrier(false),
+      m_flush_count(0),
+      m_sync_count(0),
+      m_event_count(0)
+{
+    m_events.reserve(m_max_pending);
+}
+
+void KeyEventBatch::set_display(Display* display) {
+    m_display = display;
+}
+
+void KeyEventBatch::queue(KeyCode keycode, bool is_press) {
+    m_events.push_back(Event { keycode, is_press });
+    if (m_events.size() >= m_max_pending) {
+        flush();
+    }
+}
+
+void KeyEventBatch::flush() {
+    if (m_events.empty()) {
+        return;
+    }
+    if (!m_display) {
+        m_events.clear();
+        return;
+    }
+    // XTestFakeKeyEvent only appends to Xlib's output buffer; the flush below is the round-trip
+    uint64_t presses = 0;
+    for (const Event& event : m_events) {
+        XTestFakeKeyEvent(m_display, event.keycode, event.is_press ? True : False, CurrentTime);
+        presses += event.is_press ? 1 : 0;
+    }
+    if (m_sync_barrier) {
+        XSync(m_display, False);
+        m_sync_count++;
+    } else {
+        XFlush(m_display);
+    }
+    m_event_count += m_events.size();
+    RuntimeStats::instance().keystrokes_sent.fetch_add(presses, std::memory_order_relaxed);
+    m_flush_count++;
+    m_events.clear();
+}
+
+void KeyEventBatch::discard() {
+    m_events.clear();
+}
+
+void KeyEventBatch::set_max_pending(size_t max_pending) {
+    m_max_pending = max_pending > 0 ? max_pending : 1;
+    m_events.reserve(m_max_pending);
+    if (m_events.size() >= m_max_pending) {
+        flush();
+    }
+}
+
+void KeyEventBatch::set_sync_barrier(bool enabled) {
+    m_sync_barrier = enabled;
+}
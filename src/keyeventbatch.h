@@ -0,0 +1,54 @@
+// keyeventbatch.h
+// Header file for the KeyEventBatch class.
+// Collects synthetic XTest key events and sends them to the X server in one go,
+// so typing a transcript costs one XFlush (or XSync) instead of one per keystroke.
+
+#ifndef KEY_EVENT_BATCH_H
+#define KEY_EVENT_BATCH_H
+
+#include <X11/Xlib.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class KeyEventBatch {
+public:
+    // max_pending: events queued before the batch flushes on its own
+    explicit KeyEventBatch(size_t max_pending = 256);
+
+    void set_display(Display* display);
+
+    // Queues one key press or release. Flushes automatically once max_pending events are queued.
+    void queue(KeyCode keycode, bool is_press);
+
+    // Sends all queued events, then XFlush, or XSync when the sync barrier is enabled
+    // (XSync waits until the server has processed every event).
+    void flush();
+
+    // Drops queued events without sending them
+    void discard();
+
+    void set_max_pending(size_t max_pending);
+    void set_sync_barrier(bool enabled);
+
+    size_t pending() const { return m_events.size(); }
+    uint64_t flush_count() const { return m_flush_count; }
+    uint64_t sync_count() const { return m_sync_count; } // The flushes that were XSync round-trips
+    uint64_t event_count() const { return m_event_count; }
+
+private:
+    struct Event {
+        KeyCode keycode;
+        bool is_press;
+    };
+
+    Display* m_display;
+    std::vector<Event> m_events; // Reserved to max_pending, never reallocates while typing
+    size_t m_max_pending;
+    bool m_sync_barrier;
+    uint64_t m_flush_count; // XFlush/XSync calls issued so far
+    uint64_t m_sync_count;  // ... of which XSync, each a round-trip to the server
+    uint64_t m_event_count; // Events sent so far
+};
+
+#endif // KEY_EVENT_BATCH_H
@@ -0,0 +1,348 @@
+// keylayout.cpp
+// Implementation file for the KeyLayout class.
+
+#include "keylayout.h"
+#include "keycodetable.h" // For decode_utf8
+#include "logger.h"
+#include <nlohmann/json.hpp>
+#include <array>
+#include <cctype>  // For std::toupper
+#include <cstdlib> // For std::getenv
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+namespace {
+
+// The layout the keyboard has always had, with navigation keys on the FN layer
+const char* const BUILTIN_LAYOUT = R"JSON({
+  "name": "qwerty",
+  "rows": [
+    [ { "label": "ESC", "action": "key", "keysym": "Escape" },
+      { "label": "F1", "action": "key", "keysym": "F1", "style": "symbol-key" },
+      { "label": "F2", "action": "key", "keysym": "F2", "style": "symbol-key" },
+      { "label": "F3", "action": "key", "keysym": "F3", "style": "symbol-key" },
+      { "label": "F4", "action": "key", "keysym": "F4", "style": "symbol-key" },
+      { "label": "F5", "action": "key", "keysym": "F5", "style": "symbol-key" },
+      { "label": "F6", "action": "key", "keysym": "F6", "style": "symbol-key" },
+      { "label": "F7", "action": "key", "keysym": "F7", "style": "symbol-key" },
+      { "label": "F8", "action": "key", "keysym": "F8", "style": "symbol-key" },
+      { "label": "F9", "action": "key", "keysym": "F9", "style": "symbol-key" },
+      { "label": "F10", "action": "key", "keysym": "F10", "style": "symbol-key" },
+      { "label": "F11", "action": "key", "keysym": "F11", "style": "symbol-key" },
+      { "label": "F12", "action": "key", "keysym": "F12", "style": "symbol-key" },
+      { "label": "RETYPE", "action": "retype" },
+      { "label": "STATS", "action": "stats" },
+      { "label": "HIDE", "action": "hide" },
+      { "label": "KILL", "action": "kill" } ],
+    [ { "label": "`" }, { "label": "1" }, { "label": "2" }, { "label": "3" }, { "label": "4" },
+      { "label": "5" }, { "label": "6" }, { "label": "7" }, { "label": "8" }, { "label": "9" },
+      { "label": "0" }, { "label": "-" }, { "label": "=" },
+      { "label": "BACK", "action": "key", "keysym": "BackSpace", "width": 2,
+        "fn": { "label": "DEL", "keysym": "Delete" } } ],
+    [ { "label": "TAB", "action": "key", "keysym": "Tab" },
+      { "label": "q" }, { "label": "w" }, { "label": "e" }, { "label": "r" }, { "label": "t" },
+      { "label": "y" }, { "label": "u" }, { "label": "i" }, { "label": "o" }, { "label": "p" },
+      { "label": "[" }, { "label": "]" }, { "label": "\\" } ],
+    [ { "label": "CAPS", "action": "caps", "width": 2 },
+      { "label": "a" }, { "label": "s" }, { "label": "d" }, { "label": "f" }, { "label": "g" },
+      { "label": "h" }, { "label": "j" }, { "label": "k" }, { "label": "l" },
+      { "label": ";" }, { "label": "'" },
+      { "label": "ENTER", "action": "key", "keysym": "Return", "width": 2 } ],
+    [ { "label": "SHIFT", "action": "shift", "width": 2 },
+      { "label": "z" }, { "label": "x" }, { "label": "c" }, { "label": "v" }, { "label": "b" },
+      { "label": "n" }, { "label": "m" }, { "label": "," }, { "label": "." }, { "label": "/" },
+      { "label": "SHIFT", "action": "shift", "width": 2 } ],
+    [ { "label": "CTRL", "action": "ctrl", "style": "func-key modifier-key" },
+      { "label": "FN", "action": "fn", "style": "fn-key" },
+      { "label": "ALT", "action": "alt", "style": "func-key modifier-key" },
+      { "label": "SPACE", "action": "key", "keysym": "space", "width": 6, "style": "space-key" },
+      { "label": "ALTGR", "action": "altgr", "style": "func-key modifier-key" },
+      { "label": "COMPOSE", "action": "compose", "style": "func-key modifier-key" },
+      { "label": "←", "action": "key", "keysym": "Left",
+        "fn": { "label": "Home", "keysym": "Home" }, "style": "arrow-key" },
+      { "label": "↑", "action": "key", "keysym": "Up",
+        "fn": { "label": "PgUp", "keysym": "Prior" }, "style": "arrow-key" },
+      { "label": "↓", "action": "key", "keysym": "Down",
+        "fn": { "label": "PgDn", "keysym": "Next" }, "style": "arrow-key" },
+      { "label": "→", "action": "key", "keysym": "Right",
+        "fn": { "label": "End", "keysym": "End" }, "style": "arrow-key" },
+      { "label": "🎙️", "action": "mic", "style": "symbol-key mic-button" } ]
+  ]
+})JSON";
+
+struct ActionName {
+    const char* name;
+    KeyDescriptor::Action action;
+};
+
+const ActionName ACTION_NAMES[] = {
+    { "char",    KeyDescriptor::Action::Char },
+    { "key",     KeyDescriptor::Action::Key },
+    { "shift",   KeyDescriptor::Action::Shift },
+    { "caps",    KeyDescriptor::Action::Caps },
+    { "ctrl",    KeyDescriptor::Action::Ctrl },
+    { "alt",     KeyDescriptor::Action::Alt },
+    { "altgr",   KeyDescriptor::Action::AltGr },
+    { "compose", KeyDescriptor::Action::Compose },
+    { "fn",      KeyDescriptor::Action::Fn },
+    { "mic",     KeyDescriptor::Action::Mic },
+    { "hide",    KeyDescriptor::Action::Hide },
+    { "kill",    KeyDescriptor::Action::Kill },
+    { "retype",  KeyDescriptor::Action::Retype },
+    { "stats",   KeyDescriptor::Action::Stats },
+};
+
+bool parse_action(const std::string& name, KeyDescriptor::Action& action) {
+    for (const ActionName& entry : ACTION_NAMES) {
+        if (name == entry.name) {
+            action = entry.action;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> split_classes(const std::string& style) {
+    std::vector<std::string> classes;
+    std::istringstream stream(style);
+    std::string css_class;
+    while (stream >> css_class) {
+        classes.push_back(css_class);
+    }
+    return classes;
+}
+
+using LayerLabels = std::array<std::string, KeyLayout::LAYER_COUNT>;
+
+// Fills 'key' and its labels from one entry of a row; 'error' says what is wrong with it otherwise
+bool parse_key(const nlohmann::json& entry, KeyDescriptor& key, LayerLabels& labels, std::string& error) {
+    if (!entry.is_object() || !entry.contains("label") || !entry["label"].is_string()) {
+        error = "every key needs a \"label\" string";
+        return false;
+    }
+    key.label = entry["label"].get<std::string>();
+
+    std::string action_name = entry.value("action", std::string("char"));
+    if (!parse_action(action_name, key.action)) {
+        error = "unknown action \"" + action_name + "\"";
+        return false;
+    }
+
+    if (key.action == KeyDescriptor::Action::Char) {
+        std::vector<unsigned long> code_points;
+        decode_utf8(key.label, code_points);
+        if (code_points.size() != 1) {
+            error = "a \"char\" key's label must be a single character";
+            return false;
+        }
+        key.character = code_points.front();
+    } else if (key.action == KeyDescriptor::Action::Key) {
+        std::string keysym_name = entry.value("keysym", std::string());
+        key.keysym = XStringToKeysym(keysym_name.c_str());
+        if (key.keysym == NoSymbol) {
+            error = "unknown keysym \"" + keysym_name + "\"";
+            return false;
+        }
+    }
+
+    key.width = entry.value("width", 1);
+    key.height = entry.value("height", 1);
+    if (key.width < 1 || key.height < 1) {
+        error = "\"width\" and \"height\" must be at least 1";
+        return false;
+    }
+
+    labels[KeyLayout::BASE] = key.label;
+    std::string capital = key.label;
+    if (key.is_letter()) {
+        capital[0] = static_cast<char>(std::toupper(static_cast<unsigned char>(capital[0])));
+    }
+    labels[KeyLayout::SHIFT] = entry.value("shift", capital);
+    labels[KeyLayout::CAPS] = entry.value("caps", capital);
+    labels[KeyLayout::ALTGR] = entry.value("altgr", key.label);
+    labels[KeyLayout::FN] = key.label;
+    if (entry.contains("fn")) {
+        const nlohmann::json& fn = entry["fn"];
+        std::string keysym_name = fn.value("keysym", std::string());
+        key.fn_keysym = XStringToKeysym(keysym_name.c_str());
+        if (key.fn_keysym == NoSymbol) {
+            error = "unknown FN keysym \"" + keysym_name + "\"";
+            return false;
+        }
+        labels[KeyLayout::FN] = fn.value("label", keysym_name);
+    }
+
+    if (entry.contains("style")) {
+        key.style_classes = split_classes(entry["style"].get<std::string>());
+    } else if (key.is_letter()) {
+        key.style_classes = { "alpha-key" };
+    } else if (key.action == KeyDescriptor::Action::Char) {
+        key.style_classes = { "symbol-key" };
+    } else {
+        key.style_classes = { "func-key" };
+    }
+    return true;
+}
+
+} // namespace
+
+bool KeyDescriptor::is_letter() const {
+    return action == Action::Char && character < 128 &&
+           ((character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z'));
+}
+
+bool KeyDescriptor::is_toggle() const {
+    switch (action) {
+    case Action::Shift:
+    case Action::Caps:
+    case Action::Ctrl:
+    case Action::Alt:
+    case Action::AltGr:
+    case Action::Fn:
+        return true;
+    default:
+        return false;
+    }
+}
+
+KeyLayout::KeyLayout() {
+}
+
+bool KeyLayout::load_file(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        VK_LOG_ERROR("KeyLayout: Cannot open " << path);
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return load_json(contents.str(), path);
+}
+
+bool KeyLayout::load_json(const std::string& text, const std::string& source_name) {
+    std::vector<KeyDescriptor> keys;
+    std::vector<LayerLabels> labels;
+    std::string name;
+    try {
+        nlohmann::json layout = nlohmann::json::parse(text);
+        name = layout.value("name", source_name);
+        const nlohmann::json& rows = layout.at("rows");
+        if (!rows.is_array()) {
+            VK_LOG_ERROR("KeyLayout: " << source_name << ": \"rows\" must be an array.");
+            return false;
+        }
+        for (size_t row = 0; row < rows.size(); ++row) {
+            int col = 0;
+            for (const nlohmann::json& entry : rows[row]) {
+                KeyDescriptor key;
+                LayerLabels key_labels;
+                std::string error;
+                if (!parse_key(entry, key, key_labels, error)) {
+                    VK_LOG_ERROR("KeyLayout: " << source_name << ", row " << row << ": " << error);
+                    return false;
+                }
+                col = entry.value("col", col);
+                key.row = static_cast<int>(row);
+                key.col = col;
+                col += key.width;
+                keys.push_back(std::move(key));
+                labels.push_back(std::move(key_labels));
+            }
+        }
+    } catch (const nlohmann::json::exception& ex) {
+        VK_LOG_ERROR("KeyLayout: " << source_name << ": " << ex.what());
+        return false;
+    }
+    if (keys.empty()) {
+        VK_LOG_ERROR("KeyLayout: " << source_name << " has no keys.");
+        return false;
+    }
+
+    m_name = std::move(name);
+    m_keys = std::move(keys);
+    build_label_tables(labels);
+    VK_LOG_DEBUG("KeyLayout: Loaded '" << m_name << "' (" << m_keys.size() << " keys).");
+    return true;
+}
+
+void KeyLayout::load_builtin() {
+    load_json(BUILTIN_LAYOUT, "built-in");
+}
+
+void KeyLayout::load_from_environment() {
+    if (const char* layout_env = std::getenv("VK_LAYOUT")) {
+        if (load_file(layout_env)) {
+            return;
+        }
+        VK_LOG_WARNING("KeyLayout: Falling back to the built-in layout.");
+    }
+    load_builtin();
+}
+
+KeyLayout::Layer KeyLayout::layer_for(bool shift, bool caps, bool fn, bool altgr) {
+    if (fn) {
+        return FN;
+    }
+    if (altgr) {
+        return ALTGR;
+    }
+    if (shift) {
+        return SHIFT;
+    }
+    return caps ? CAPS : BASE;
+}
+
+void KeyLayout::build_label_tables(const std::vector<LayerLabels>& labels) {
+    size_t count = labels.size();
+    m_layer_labels.assign(LAYER_COUNT * count, std::string());
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t layer = 0; layer < LAYER_COUNT; ++layer) {
+            m_layer_labels[layer * count + i] = labels[i][layer];
+        }
+    }
+    for (size_t from = 0; from < LAYER_COUNT; ++from) {
+        for (size_t to = 0; to < LAYER_COUNT; ++to) {
+            std::vector<size_t>& changed = m_relabelled[from * LAYER_COUNT + to];
+            changed.clear();
+            for (size_t i = 0; i < count; ++i) {
+                if (labels[i][from] != labels[i][to]) {
+                    changed.push_back(i);
+                }
+            }
+        }
+    }
+
+    m_index_by_label.clear();
+    for (size_t i = 0; i < count; ++i) {
+        m_index_by_label.emplace(labels[i][BASE], std::make_pair(static_cast<int>(i), false)); // Keeps the first duplicate
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (m_keys[i].fn_keysym != NoSymbol) {
+            m_index_by_label.emplace(labels[i][FN], std::make_pair(static_cast<int>(i), true));
+        }
+    }
+}
+
+int KeyLayout::find(const std::string& label, bool& fn) const {
+    auto it = m_index_by_label.find(label);
+    if (it == m_index_by_label.end()) {
+        return -1;
+    }
+    fn = it->second.second;
+    return it->second.first;
+}
+
+bool KeyLayout::same_geometry(const KeyLayout& other) const {
+    if (m_keys.size() != other.m_keys.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < m_keys.size(); ++i) {
+        const KeyDescriptor& a = m_keys[i];
+        const KeyDescriptor& b = other.m_keys[i];
+        if (a.row != b.row || a.col != b.col || a.width != b.width || a.height != b.height) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,128 @@
+// keylayout.h
+// Header file for the KeyLayout class.
+// The on-screen keys as data: a JSON layout file is parsed once into a contiguous array of
+// key descriptors (what the key does, the KeySym or character it sends, its CSS classes and
+// its cell in the grid). Buttons only remember their index into the array, so a press is a
+// table lookup plus a switch on the action instead of a chain of label comparisons.
+//
+// Layout format (VK_LAYOUT=<path>; the built-in QWERTY layout is used otherwise):
+//   { "name": "qwerty",
+//     "rows": [ [ { "label": "ESC", "action": "key", "keysym": "Escape", "style": "func-key" },
+//                 { "label": "q" },
+//                 { "label": "BACK", "action": "key", "keysym": "BackSpace", "width": 2 }, ... ],
+//               ... ] }
+// Keys are placed left to right, each row below the previous one. "action" defaults to
+// "char" (types the label's single character); the others are "key" (presses "keysym",
+// a name as accepted by XStringToKeysym), "shift", "caps", "ctrl", "alt", "altgr",
+// "compose", "fn", "mic", "hide", "kill", "retype" (types the last journaled transcript
+// again) and "stats" (shows/hides the runtime stats overlay). "style" is a space-separated
+// list of CSS classes (default: "alpha-key" for letters, "symbol-key" for other characters,
+// "func-key" for everything else).
+// "width"/"height" default to 1 cell, "col" skips ahead to an absolute column.
+// Labels for the other modifier layers are optional: "shift", "caps" and "altgr" are the
+// label shown while that modifier is active (letters default to their capital under SHIFT
+// and CAPS, everything else to the base label), and "fn": { "label": "Home", "keysym": "Home" }
+// gives the key a second function while FN is on.
+
+#ifndef KEY_LAYOUT_H
+#define KEY_LAYOUT_H
+
+#include <X11/Xlib.h> // For KeySym
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct KeyDescriptor {
+    enum class Action : uint8_t {
+        Char,    // Types 'character' (upper-cased letters under CAPS/SHIFT)
+        Key,     // Presses 'keysym' with the active modifiers
+        Shift,   // Sticky modifiers
+        Caps,
+        Ctrl,
+        Alt,
+        AltGr,
+        Compose, // Momentary XK_Multi_key press
+        Fn,      // Toggles the FN layer
+        Mic,     // Starts/stops listening
+        Hide,    // Hides/shows the window
+        Kill,    // Quits
+        Retype,  // Types the last journaled transcript again
+        Stats    // Shows/hides the runtime stats overlay
+    };
+
+    Action action = Action::Char;
+    KeySym keysym = NoSymbol;    // Action::Key
+    KeySym fn_keysym = NoSymbol; // Pressed instead while FN is on, NoSymbol if the key has no FN function
+    unsigned long character = 0; // Action::Char: Unicode code point
+    int row = 0;
+    int col = 0;
+    int width = 1;
+    int height = 1;
+    std::string label;                      // Base layer label; also the voice command name
+    std::vector<std::string> style_classes; // CSS classes of the button
+
+    // A letter: follows CAPS/SHIFT on screen
+    bool is_letter() const;
+    // Actions whose button shows the "toggle-active" state
+    bool is_toggle() const;
+};
+
+class KeyLayout {
+public:
+    // Label sets, one per modifier state shown on screen
+    enum Layer : uint8_t {
+        BASE,
+        SHIFT,
+        CAPS,
+        FN,
+        ALTGR,
+        LAYER_COUNT
+    };
+
+    KeyLayout();
+
+    // The layer shown for a modifier state (FN wins over AltGr, AltGr over SHIFT, SHIFT over CAPS)
+    static Layer layer_for(bool shift, bool caps, bool fn, bool altgr);
+
+    // Parses a layout; on failure the current keys are kept and false is returned
+    bool load_file(const std::string& path);
+    bool load_json(const std::string& text, const std::string& source_name);
+    // The QWERTY layout compiled into the binary
+    void load_builtin();
+    // VK_LAYOUT if it is set and parses, the built-in layout otherwise
+    void load_from_environment();
+
+    const std::string& name() const { return m_name; }
+    size_t size() const { return m_keys.size(); }
+    bool empty() const { return m_keys.empty(); }
+    const KeyDescriptor& key(size_t index) const { return m_keys[index]; }
+    const std::vector<KeyDescriptor>& keys() const { return m_keys; }
+
+    // Label of key 'index' on 'layer'
+    const std::string& label(size_t index, Layer layer) const { return m_layer_labels[layer * m_keys.size() + index]; }
+    // Keys whose label differs between two layers, so a modifier toggle only relabels those
+    const std::vector<size_t>& relabelled(Layer from, Layer to) const { return m_relabelled[from * LAYER_COUNT + to]; }
+
+    // Index of the first key with this label, or -1. For voice commands, which name keys by
+    // label; 'fn' is set if the label is the key's FN function.
+    int find(const std::string& label, bool& fn) const;
+
+    // Same number of keys in the same cells: switching to 'other' only needs the buttons rebound
+    bool same_geometry(const KeyLayout& other) const;
+
+private:
+    // Flattens the per-key labels into m_layer_labels and fills m_relabelled and m_index_by_label
+    void build_label_tables(const std::vector<std::array<std::string, LAYER_COUNT>>& labels);
+
+    std::string m_name;
+    std::vector<KeyDescriptor> m_keys;
+    std::vector<std::string> m_layer_labels;  // LAYER_COUNT rows of size() labels, layer-major
+    std::vector<size_t> m_relabelled[LAYER_COUNT * LAYER_COUNT];
+    std::unordered_map<std::string, std::pair<int, bool>> m_index_by_label; // Label -> (index, FN label)
+};
+
+#endif // KEY_LAYOUT_H
@@ -0,0 +1,105 @@
+// keysymremapper.cpp
+// Implementation file for the KeysymRemapper class.
+
+#include "keysymremapper.h"
+#include "logger.h"
+#include <algorithm> // For std::fill
+
+KeysymRemapper::KeysymRemapper()
+    : m_assigned_count(0),
+      m_bound(false)
+{
+}
+
+void KeysymRemapper::find_spare_keycodes(Display* display) {
+    m_spare_keycodes.clear();
+    if (!display) {
+        return;
+    }
+    int min_keycode = 0, max_keycode = 0;
+    XDisplayKeycodes(display, &min_keycode, &max_keycode);
+    int keysyms_per_keycode = 0;
+    KeySym* keysyms = XGetKeyboardMapping(display, static_cast<KeyCode>(min_keycode),
+                                          max_keycode - min_keycode + 1, &keysyms_per_keycode);
+    if (!keysyms) {
+        return;
+    }
+    for (int keycode = min_keycode; keycode <= max_keycode; ++keycode) {
+        bool unused = true;
+        for (int level = 0; level < keysyms_per_keycode && unused; ++level) {
+            unused = keysyms[(keycode - min_keycode) * keysyms_per_keycode + level] == NoSymbol;
+        }
+        if (unused) {
+            m_spare_keycodes.push_back(static_cast<KeyCode>(keycode));
+        }
+    }
+    XFree(keysyms);
+
+    m_assigned.assign(m_spare_keycodes.size(), 0);
+    m_committed.assign(m_spare_keycodes.size(), 0);
+    m_assigned_count = 0;
+    VK_LOG_DEBUG("Found " << m_spare_keycodes.size() << " spare keycodes for Unicode output.");
+}
+
+void KeysymRemapper::begin_batch() {
+    std::fill(m_assigned.begin(), m_assigned.end(), 0);
+    m_assigned_count = 0;
+}
+
+bool KeysymRemapper::assign(unsigned long code_point) {
+    for (size_t i = 0; i < m_assigned_count; ++i) {
+        if (m_assigned[i] == code_point) {
+            return true; // Already in this batch
+        }
+    }
+    if (full()) {
+        return false;
+    }
+    m_assigned[m_assigned_count++] = code_point;
+    return true;
+}
+
+bool KeysymRemapper::commit(Display* display) {
+    if (!display || m_assigned_count == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < m_assigned_count; ++i) {
+        if (m_committed[i] == m_assigned[i]) {
+            continue; // Still bound from the previous batch, no request needed
+        }
+        // Same KeySym on both levels so the Shift state can't change what gets typed
+        KeySym keysyms[2] = { code_point_to_keysym(m_assigned[i]), code_point_to_keysym(m_assigned[i]) };
+        XChangeKeyboardMapping(display, m_spare_keycodes[i], 2, keysyms, 1);
+        m_committed[i] = m_assigned[i];
+    }
+    m_bound = true;
+    return true;
+}
+
+bool KeysymRemapper::lookup(unsigned long code_point, KeyStroke& stroke) const {
+    if (!m_bound) {
+        return false;
+    }
+    for (size_t i = 0; i < m_assigned_count; ++i) {
+        if (m_committed[i] == code_point) {
+            stroke = KeyStroke { m_spare_keycodes[i], KeyStroke::NONE };
+            return true;
+        }
+    }
+    return false;
+}
+
+void KeysymRemapper::restore(Display* display) {
+    if (!m_bound || !display) {
+        return;
+    }
+    KeySym keysyms[2] = { NoSymbol, NoSymbol };
+    for (size_t i = 0; i < m_spare_keycodes.size(); ++i) {
+        if (m_committed[i] != 0) {
+            XChangeKeyboardMapping(display, m_spare_keycodes[i], 2, keysyms, 1);
+            m_committed[i] = 0;
+        }
+    }
+    begin_batch();
+    m_bound = false;
+}
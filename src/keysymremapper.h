@@ -0,0 +1,50 @@
+// keysymremapper.h
+// Header file for the KeysymRemapper class.
+// Types characters that are not on the current keymap by temporarily binding their
+// KeySyms to spare (unused) keycodes with XChangeKeyboardMapping. Characters are
+// assigned in batches of up to one per spare keycode, and the spares are reset to
+// NoSymbol once the text has been sent.
+
+#ifndef KEYSYM_REMAPPER_H
+#define KEYSYM_REMAPPER_H
+
+#include <X11/Xlib.h>
+#include <vector>
+#include "keycodetable.h"
+
+class KeysymRemapper {
+public:
+    KeysymRemapper();
+
+    // Finds keycodes that have no KeySym on any level. Must not be called while remapped.
+    void find_spare_keycodes(Display* display);
+
+    // Forgets the current assignment so a new batch can be built (keycodes stay bound
+    // until commit() or restore())
+    void begin_batch();
+
+    // Adds a code point to the batch being built. Returns false when no spare is left.
+    bool assign(unsigned long code_point);
+
+    // Sends the batch to the X server. Returns false if nothing could be bound.
+    bool commit(Display* display);
+
+    // Stroke for a code point bound by the last commit()
+    bool lookup(unsigned long code_point, KeyStroke& stroke) const;
+
+    // Resets all bound spares to NoSymbol
+    void restore(Display* display);
+
+    bool full() const { return m_assigned_count >= m_spare_keycodes.size(); }
+    bool active() const { return m_bound; }
+    size_t capacity() const { return m_spare_keycodes.size(); }
+
+private:
+    std::vector<KeyCode> m_spare_keycodes;
+    std::vector<unsigned long> m_assigned;   // Code point per spare keycode, 0 when free
+    std::vector<unsigned long> m_committed;  // What the server currently has bound
+    size_t m_assigned_count;
+    bool m_bound; // True while any spare is bound on the server
+};
+
+#endif // KEYSYM_REMAPPER_H
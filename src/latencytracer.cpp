@@ -0,0 +1,229 @@
+// latencytracer.cpp
+// Implementation file for the LatencyTracer class.
+
+#include "latencytracer.h"
+#include "logger.h"
+#include <algorithm> // For std::min, std::sort
+#include <cstdlib>   // For std::getenv
+#include <fstream>
+#include <time.h>    // For clock_gettime
+
+std::atomic<bool> LatencyTracer::s_enabled(false);
+
+// Name the calling thread asked for, and its buffers once registered
+static thread_local const char* t_thread_name = nullptr;
+
+namespace {
+struct ThreadHandle {
+    std::atomic<bool>* in_use = nullptr;
+    void* data = nullptr;
+    ~ThreadHandle() {
+        if (in_use) {
+            in_use->store(false, std::memory_order_release); // Buffers may be reused by name
+        }
+    }
+};
+thread_local ThreadHandle t_handle;
+thread_local uint64_t t_current_origin = 0;
+} // namespace
+
+LatencyTracer& LatencyTracer::instance() {
+    static LatencyTracer tracer;
+    return tracer;
+}
+
+LatencyTracer::LatencyTracer()
+    : m_start_ns(now_ns())
+{
+    const char* trace_env = std::getenv("VK_TRACE");
+    if (trace_env && std::string(trace_env) == "1") {
+        set_enabled(true);
+        VK_LOG_DEBUG("Latency tracing enabled (dump with SIGUSR1 to " << default_dump_prefix() << ".*).");
+    }
+}
+
+uint64_t LatencyTracer::now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+void LatencyTracer::set_thread_name(const char* name) {
+    t_thread_name = name;
+}
+
+void LatencyTracer::set_current_origin(uint64_t origin_ns) {
+    t_current_origin = origin_ns;
+}
+
+uint64_t LatencyTracer::current_origin() {
+    return t_current_origin;
+}
+
+LatencyTracer::ThreadData* LatencyTracer::thread_data() {
+    if (t_handle.data) {
+        return static_cast<ThreadData*>(t_handle.data);
+    }
+    std::string name = t_thread_name ? t_thread_name : "thread";
+    std::lock_guard<std::mutex> lock(m_registry_mutex);
+    ThreadData* data = nullptr;
+    for (auto& candidate : m_threads) {
+        if (candidate->name == name && !candidate->in_use.load(std::memory_order_acquire)) {
+            data = candidate.get(); // Same role as a thread that has exited: keep accumulating
+            break;
+        }
+    }
+    if (!data) {
+        m_threads.push_back(std::make_unique<ThreadData>());
+        data = m_threads.back().get();
+        data->id = static_cast<unsigned>(m_threads.size());
+        data->name = name;
+        data->written.store(0, std::memory_order_relaxed);
+    }
+    data->in_use.store(true, std::memory_order_release);
+    t_handle.in_use = &data->in_use;
+    t_handle.data = data;
+    return data;
+}
+
+void LatencyTracer::record(TraceStage stage, uint64_t start_ns, uint64_t duration_ns) {
+    if (!enabled()) {
+        return;
+    }
+    ThreadData* data = thread_data();
+
+    // Only this thread writes these, so relaxed read-modify-write without contention is enough;
+    // dump() may read slightly stale values.
+    Histogram& histogram = data->histograms[static_cast<size_t>(stage)];
+    histogram.buckets[Histogram::bucket_for(duration_ns)].fetch_add(1, std::memory_order_relaxed);
+    histogram.count.fetch_add(1, std::memory_order_relaxed);
+    histogram.sum_ns.fetch_add(duration_ns, std::memory_order_relaxed);
+    if (duration_ns > histogram.max_ns.load(std::memory_order_relaxed)) {
+        histogram.max_ns.store(duration_ns, std::memory_order_relaxed);
+    }
+
+    uint64_t index = data->written.load(std::memory_order_relaxed);
+    data->ring[index % ThreadData::kRingSize] = Event { stage, start_ns, duration_ns };
+    data->written.store(index + 1, std::memory_order_release);
+}
+
+LatencyTracer::Histogram::Histogram()
+    : count(0), sum_ns(0), max_ns(0)
+{
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t LatencyTracer::Histogram::bucket_for(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    if (us < 4) {
+        return static_cast<size_t>(us);
+    }
+    unsigned power = 63 - static_cast<unsigned>(__builtin_clzll(us)); // floor(log2(us)), >= 2
+    size_t sub = static_cast<size_t>((us >> (power - 2)) & 3);
+    return std::min<size_t>(4 * (power - 1) + sub, kBuckets - 1);
+}
+
+uint64_t LatencyTracer::Histogram::bucket_upper_ns(size_t bucket) {
+    if (bucket < 4) {
+        return (bucket + 1) * 1000ull;
+    }
+    unsigned power = static_cast<unsigned>(bucket / 4 + 1);
+    uint64_t sub = bucket % 4;
+    return ((5 + sub) << (power - 2)) * 1000ull;
+}
+
+const char* LatencyTracer::stage_name(TraceStage stage) {
+    switch (stage) {
+        case TraceStage::CaptureArrival: return "capture_arrival";
+        case TraceStage::RingWait: return "ring_wait";
+        case TraceStage::ChunkGather: return "chunk_gather";
+        case TraceStage::AcceptWaveform: return "accept_waveform";
+        case TraceStage::FinalResult: return "final_result";
+        case TraceStage::IdleDispatch: return "idle_dispatch";
+        case TraceStage::KeyInjection: return "key_injection";
+        case TraceStage::SpeechToText: return "speech_to_text";
+        case TraceStage::Count: break;
+    }
+    return "unknown";
+}
+
+std::string LatencyTracer::default_dump_prefix() const {
+    const char* file_env = std::getenv("VK_TRACE_FILE");
+    return file_env ? file_env : "/tmp/vk-latency";
+}
+
+bool LatencyTracer::dump(const std::string& prefix) const {
+    const size_t stage_count = static_cast<size_t>(TraceStage::Count);
+    std::lock_guard<std::mutex> lock(m_registry_mutex);
+
+    // --- Metrics: histograms of all threads merged per stage ---
+    std::ofstream metrics(prefix + ".metrics.txt");
+    if (!metrics) {
+        VK_LOG_ERROR("Cannot write latency metrics to " << prefix << ".metrics.txt");
+        return false;
+    }
+    metrics << "# stage count mean_us p50_us p90_us p99_us max_us\n";
+    for (size_t s = 0; s < stage_count; ++s) {
+        std::vector<uint64_t> merged(Histogram::kBuckets, 0);
+        uint64_t count = 0, sum_ns = 0, max_ns = 0;
+        for (const auto& thread : m_threads) {
+            const Histogram& histogram = thread->histograms[s];
+            for (size_t b = 0; b < Histogram::kBuckets; ++b) {
+                merged[b] += histogram.buckets[b].load(std::memory_order_relaxed);
+            }
+            count += histogram.count.load(std::memory_order_relaxed);
+            sum_ns += histogram.sum_ns.load(std::memory_order_relaxed);
+            max_ns = std::max(max_ns, histogram.max_ns.load(std::memory_order_relaxed));
+        }
+
+        auto percentile_us = [&](double q) -> double {
+            uint64_t target = static_cast<uint64_t>(q * count + 0.5);
+            uint64_t seen = 0;
+            for (size_t b = 0; b < Histogram::kBuckets; ++b) {
+                seen += merged[b];
+                if (seen >= target && seen > 0) {
+                    return std::min(Histogram::bucket_upper_ns(b), max_ns) / 1000.0;
+                }
+            }
+            return max_ns / 1000.0;
+        };
+
+        metrics << stage_name(static_cast<TraceStage>(s)) << ' ' << count << ' '
+                << (count ? sum_ns / 1000.0 / count : 0.0) << ' '
+                << percentile_us(0.50) << ' ' << percentile_us(0.90) << ' ' << percentile_us(0.99) << ' '
+                << max_ns / 1000.0 << '\n';
+    }
+    metrics.close();
+
+    // --- Chrome trace: the most recent events of every thread as complete ("X") events ---
+    std::ofstream trace(prefix + ".trace.json");
+    if (!trace) {
+        VK_LOG_ERROR("Cannot write latency trace to " << prefix << ".trace.json");
+        return false;
+    }
+    trace << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto& thread : m_threads) {
+        trace << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->id
+              << ",\"args\":{\"name\":\"" << thread->name << "\"}}";
+        first = false;
+
+        // Events written while we copy may be torn; acceptable for a diagnostic dump
+        uint64_t written = thread->written.load(std::memory_order_acquire);
+        uint64_t begin = written > ThreadData::kRingSize ? written - ThreadData::kRingSize : 0;
+        for (uint64_t i = begin; i < written; ++i) {
+            const Event& event = thread->ring[i % ThreadData::kRingSize];
+            double ts_us = event.start_ns >= m_start_ns ? (event.start_ns - m_start_ns) / 1000.0 : 0.0;
+            trace << ",\n{\"name\":\"" << stage_name(event.stage) << "\",\"cat\":\"latency\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                  << thread->id << ",\"ts\":" << ts_us << ",\"dur\":" << event.duration_ns / 1000.0 << '}';
+        }
+    }
+    trace << "\n]}\n";
+    bool ok = static_cast<bool>(trace);
+    trace.close();
+
+    VK_LOG_DEBUG("Latency metrics written to " << prefix << ".metrics.txt and " << prefix << ".trace.json");
+    return ok;
+}
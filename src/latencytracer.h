@@ -0,0 +1,121 @@
+// latencytracer.h
+// Header file for the LatencyTracer class.
+// Opt-in (VK_TRACE=1) timing of the stages between a captured audio period and the last
+// synthetic key event of the transcript it produced. Every thread records into its own
+// histograms and event ring, so recording takes no locks and never contends with other
+// threads. dump() merges everything into a metrics file (count/p50/p90/p99/max per stage)
+// and a Chrome trace (chrome://tracing, Perfetto) on demand.
+// All timestamps are CLOCK_MONOTONIC nanoseconds, the clock ALSA is asked to use for
+// snd_pcm_htimestamp().
+
+#ifndef LATENCY_TRACER_H
+#define LATENCY_TRACER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class TraceStage : unsigned {
+    CaptureArrival,  // End of the period in hardware (htimestamp) -> snd_pcm_readi returned it
+    RingWait,        // End of the period in hardware -> decoder picked it up (capture + ring queueing)
+    ChunkGather,     // End of the oldest period in a chunk -> chunk handed to the recognizer
+    AcceptWaveform,  // vosk_recognizer_accept_waveform duration
+    FinalResult,     // End of the audio that completed a result -> result decoded
+    IdleDispatch,    // Result queued by the decoder thread -> GTK main loop dispatched it
+    KeyInjection,    // Idle handler started -> last XTestFakeKeyEvent flushed
+    SpeechToText,    // End of the speech audio -> last key event flushed (end to end)
+    Count
+};
+
+class LatencyTracer {
+public:
+    static LatencyTracer& instance();
+
+    // Cheap check for call sites; everything below is a no-op while disabled
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void set_enabled(bool enabled) { s_enabled.store(enabled, std::memory_order_relaxed); }
+
+    static uint64_t now_ns();
+
+    // Names the calling thread in dumps. Call before its first record(); a new thread with
+    // the name of one that has exited reuses its buffers, so restarts don't leak.
+    void set_thread_name(const char* name);
+
+    // Records one interval on the calling thread
+    void record(TraceStage stage, uint64_t start_ns, uint64_t duration_ns);
+
+    // Result origin handed from the decoder thread to the result callback it invokes
+    static void set_current_origin(uint64_t origin_ns);
+    static uint64_t current_origin();
+
+    // Writes <prefix>.metrics.txt and <prefix>.trace.json. Returns false if either failed.
+    bool dump(const std::string& prefix) const;
+    // Prefix from VK_TRACE_FILE, default /tmp/vk-latency
+    std::string default_dump_prefix() const;
+
+    static const char* stage_name(TraceStage stage);
+
+private:
+    LatencyTracer();
+    LatencyTracer(const LatencyTracer&) = delete;
+    LatencyTracer& operator=(const LatencyTracer&) = delete;
+
+    // Log-linear histogram: four buckets per power of two of microseconds
+    struct Histogram {
+        static constexpr size_t kBuckets = 4 * 40;
+        std::atomic<uint64_t> buckets[kBuckets];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum_ns;
+        std::atomic<uint64_t> max_ns;
+        Histogram();
+        static size_t bucket_for(uint64_t ns);
+        static uint64_t bucket_upper_ns(size_t bucket);
+    };
+
+    struct Event {
+        TraceStage stage;
+        uint64_t start_ns;
+        uint64_t duration_ns;
+    };
+
+    struct ThreadData {
+        static constexpr size_t kRingSize = 4096; // Most recent events kept for the Chrome trace
+        unsigned id;
+        std::string name;
+        std::atomic<bool> in_use;
+        Histogram histograms[static_cast<size_t>(TraceStage::Count)];
+        Event ring[kRingSize];
+        std::atomic<uint64_t> written; // Events ever written; slot is written % kRingSize
+    };
+
+    ThreadData* thread_data(); // Registers the calling thread on first use
+
+    static std::atomic<bool> s_enabled;
+    const uint64_t m_start_ns; // Trace timestamps are relative to this
+    mutable std::mutex m_registry_mutex; // Guards m_threads (registration and dumps only)
+    std::vector<std::unique_ptr<ThreadData>> m_threads;
+};
+
+// Records the lifetime of the scope as one interval when tracing is enabled
+class ScopedTrace {
+public:
+    explicit ScopedTrace(TraceStage stage)
+        : m_stage(stage), m_start_ns(LatencyTracer::enabled() ? LatencyTracer::now_ns() : 0) {}
+    ~ScopedTrace() {
+        if (m_start_ns != 0) {
+            LatencyTracer::instance().record(m_stage, m_start_ns, LatencyTracer::now_ns() - m_start_ns);
+        }
+    }
+    ScopedTrace(const ScopedTrace&) = delete;
+    ScopedTrace& operator=(const ScopedTrace&) = delete;
+
+private:
+    TraceStage m_stage;
+    uint64_t m_start_ns;
+};
+
+#endif // LATENCY_TRACER_H
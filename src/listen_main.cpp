@@ -0,0 +1,169 @@
+// listen_main.cpp
+// Entry point of vk-listen, live transcription of several audio sources at once.
+// Runs every source through one RecognizerPool (one shared model, one pinned decode thread
+// per core) and prints each final result as "[stream] text" as soon as it is recognized.
+// Sources are BACKEND:DEVICE, e.g. alsa:hw:1,0, pulse:alsa_output.pci.monitor or
+// file:meeting.wav; a bare DEVICE uses VK_AUDIO_BACKEND (alsa by default).
+// Runs until interrupted, or until every source has ended.
+//
+// Usage: vk-listen [--model DIR] [--workers N] [--no-pin] [--gpu] [--partial] [--fast] SOURCE...
+
+#include "recognizerpool.h"
+#include "batchrecognizer.h"
+#include "logger.h"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib> // For std::getenv, std::atoi
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Same default as the keyboard; VK_MODEL_PATH or --model override it
+static const char* DEFAULT_MODEL_PATH = "/home/android/dev/gtkmm-virtual-keyboard/vosk-linux-x86_64-0.3.45/model";
+
+static std::atomic<bool> g_interrupted(false);
+
+static void on_signal(int) {
+    g_interrupted = true;
+}
+
+static void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--model DIR] [--workers N] [--no-pin] [--gpu] [--partial] [--fast] SOURCE...\n"
+              << "SOURCE is BACKEND:DEVICE (alsa, alsa-mmap, pulse, pipewire, file) or a device of VK_AUDIO_BACKEND.\n"
+              << "--gpu decodes on the GPU (as does VK_DECODER=gpu), or on the CPU if there is none.\n"
+              << "--fast replays file sources as fast as they decode instead of in real time."
+              << std::endl;
+}
+
+// Splits BACKEND:DEVICE; the device part may contain colons itself (hw:1,0)
+static AudioSourceConfig parse_source(const std::string& spec, bool realtime) {
+    AudioSourceConfig config;
+    config.load_from_environment();
+    config.realtime = realtime;
+    static const char* backends[] = { "alsa-mmap", "alsa", "pulse", "pipewire", "file" };
+    for (const char* backend : backends) {
+        std::string prefix = std::string(backend) + ":";
+        if (spec.compare(0, prefix.size(), prefix) == 0) {
+            config.backend = backend;
+            config.device = spec.substr(prefix.size());
+            return config;
+        }
+    }
+    config.device = spec;
+    return config;
+}
+
+int main(int argc, char* argv[]) {
+    // stdout carries the transcripts: keep informational log lines out of it unless asked for
+    if (!std::getenv("VK_LOG_LEVEL")) {
+        Logger::instance().set_level(LogLevel::Warning);
+    }
+
+    const char* model_env = std::getenv("VK_MODEL_PATH");
+    std::string model_path = model_env ? model_env : DEFAULT_MODEL_PATH;
+    RecognizerPool::Options options;
+    options.gpu = decoder_backend_from_environment() == DecoderBackend::Gpu;
+    bool partial = false;
+    bool realtime = true;
+    std::vector<std::string> specs;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg == "--model" && has_value) {
+            model_path = argv[++i];
+        } else if (arg == "--workers" && has_value) {
+            options.workers = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--no-pin") {
+            options.pin_workers = false;
+        } else if (arg == "--gpu") {
+            options.gpu = true;
+        } else if (arg == "--partial") {
+            partial = true;
+        } else if (arg == "--fast") {
+            realtime = false;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "ERROR: Unknown or incomplete option: " << arg << std::endl;
+            print_usage(argv[0]);
+            return 2;
+        } else {
+            specs.push_back(arg);
+        }
+    }
+    if (specs.empty()) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    RecognizerPool pool;
+    if (!pool.init(model_path, options)) {
+        return 1;
+    }
+
+    // Results arrive on the worker threads; keep lines whole
+    std::mutex output_mutex;
+    auto on_final = [&output_mutex](RecognizerPool::StreamId stream, const std::string& text) {
+        std::lock_guard<std::mutex> lock(output_mutex);
+        std::cout << "[" << stream << "] " << text << std::endl;
+    };
+    RecognizerPool::ResultCallback on_partial;
+    if (partial) {
+        on_partial = [&output_mutex](RecognizerPool::StreamId stream, const std::string& text) {
+            std::lock_guard<std::mutex> lock(output_mutex);
+            std::cerr << "[" << stream << "] ... " << text << std::endl;
+        };
+    }
+
+    for (const auto& spec : specs) {
+        RecognizerPool::StreamId id = pool.add_stream(parse_source(spec, realtime), on_final, on_partial);
+        if (id == 0) {
+            return 1;
+        }
+        std::cerr << "vk-listen: [" << id << "] " << spec << std::endl;
+    }
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+    auto start = std::chrono::steady_clock::now();
+    while (!g_interrupted) {
+        bool all_finished = true;
+        for (RecognizerPool::StreamId id : pool.stream_ids()) {
+            RecognizerPool::StreamStats stats;
+            all_finished = all_finished && pool.get_stream_stats(id, stats) && stats.finished;
+        }
+        if (all_finished) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double audio_seconds = 0.0;
+    for (RecognizerPool::StreamId id : pool.stream_ids()) {
+        RecognizerPool::StreamStats stats;
+        if (pool.get_stream_stats(id, stats)) {
+            audio_seconds += stats.audio_seconds;
+            std::cerr << "vk-listen: [" << id << "] worker " << stats.worker << ", " << stats.audio_seconds
+                      << " s decoded, " << stats.ring_overruns << " dropped, " << stats.source_overruns
+                      << " source overruns" << std::endl;
+        }
+    }
+    for (size_t w = 0; w < pool.worker_count(); ++w) {
+        RecognizerPool::WorkerStats stats = pool.get_worker_stats(w);
+        if (stats.streams > 0) {
+            std::cerr << "vk-listen: worker " << w << ": " << stats.streams << " stream(s), "
+                      << (wall_seconds > 0.0 ? 100.0 * stats.busy_ns / 1e9 / wall_seconds : 0.0) << "% busy"
+                      << std::endl;
+        }
+    }
+    std::cerr << "vk-listen: " << audio_seconds << " s of audio in " << wall_seconds << " s ("
+              << (wall_seconds > 0.0 ? audio_seconds / wall_seconds : 0.0) << "x real-time)" << std::endl;
+    pool.shutdown(); // Delivers the last result of every stream still running
+    return 0;
+}
@@ -0,0 +1,192 @@
+// logger.cpp
+// Implementation file for the Logger class.
+
+#include "logger.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib> // For std::getenv, std::atexit
+#include <cstring> // For std::memcpy, std::strcmp
+
+Logger& Logger::instance() {
+    // Never destroyed: objects with static storage may still log while the program exits.
+    // The writer thread is stopped from an atexit handler instead, after which lines are
+    // written synchronously.
+    static Logger* logger = [] {
+        Logger* created = new Logger();
+        std::atexit([] { Logger::instance().shutdown(); });
+        return created;
+    }();
+    return *logger;
+}
+
+Logger::Logger()
+    : m_level(static_cast<int>(LogLevel::Debug)),
+      m_sync(false),
+      m_slots(new Slot[kQueueCapacity]),
+      m_enqueue_pos(0),
+      m_dequeue_pos(0),
+      m_written(0),
+      m_queued(0),
+      m_dropped(0),
+      m_running(true)
+{
+    for (size_t i = 0; i < kQueueCapacity; ++i) {
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    LogLevel level;
+    const char* level_env = std::getenv("VK_LOG_LEVEL");
+    if (level_env && parse_level(level_env, level)) {
+        set_level(level);
+    }
+    const char* sync_env = std::getenv("VK_LOG_SYNC");
+    if (sync_env && std::strcmp(sync_env, "1") == 0) {
+        m_sync = true;
+        m_running = false;
+        return;
+    }
+    m_writer = std::thread(&Logger::writer_loop, this);
+}
+
+Logger::~Logger() {
+    shutdown();
+    delete[] m_slots;
+}
+
+void Logger::shutdown() {
+    if (m_running.exchange(false)) {
+        if (m_writer.joinable()) {
+            m_writer.join(); // Drains the queue before exiting
+        }
+    }
+    m_sync = true;
+}
+
+void Logger::set_level(LogLevel level) {
+    m_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+void Logger::submit(LogLevel level, const char* message, size_t length) {
+    if (length > kMaxMessage) {
+        length = kMaxMessage;
+    }
+    if (m_sync.load(std::memory_order_relaxed)) {
+        write_line(level, message, length);
+        std::fflush(level >= LogLevel::Warning ? stderr : stdout);
+        return;
+    }
+
+    // Claim a slot (Vyukov bounded queue). A full queue drops the line rather than blocking.
+    size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &m_slots[pos & (kQueueCapacity - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->level = level;
+    slot->length = static_cast<uint32_t>(length);
+    std::memcpy(slot->message, message, length);
+    slot->sequence.store(pos + 1, std::memory_order_release); // Publish to the writer
+    m_queued.fetch_add(1, std::memory_order_release);
+}
+
+bool Logger::try_pop(Slot*& slot) {
+    slot = &m_slots[m_dequeue_pos & (kQueueCapacity - 1)];
+    return slot->sequence.load(std::memory_order_acquire) == m_dequeue_pos + 1;
+}
+
+void Logger::release_slot(Slot* slot) {
+    slot->sequence.store(m_dequeue_pos + kQueueCapacity, std::memory_order_release);
+    ++m_dequeue_pos;
+}
+
+void Logger::writer_loop() {
+    uint64_t reported_drops = 0;
+    while (true) {
+        bool running = m_running.load(std::memory_order_acquire);
+        uint64_t written = 0;
+        Slot* slot;
+        while (try_pop(slot)) {
+            write_line(slot->level, slot->message, slot->length);
+            release_slot(slot);
+            ++written;
+        }
+
+        uint64_t drops = m_dropped.load(std::memory_order_relaxed);
+        if (drops != reported_drops) {
+            std::fprintf(stderr, "WARNING: Logger queue full, %llu line(s) dropped so far.\n",
+                         static_cast<unsigned long long>(drops));
+            reported_drops = drops;
+        }
+
+        if (written > 0) {
+            // One flush per batch instead of one per line (std::endl)
+            std::fflush(stdout);
+            std::fflush(stderr);
+            m_written.fetch_add(written, std::memory_order_release);
+        } else if (!running) {
+            break; // Stopped and drained
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+}
+
+void Logger::flush() {
+    if (m_sync.load(std::memory_order_relaxed)) {
+        return;
+    }
+    uint64_t target = m_queued.load(std::memory_order_acquire);
+    while (m_running.load(std::memory_order_acquire) && m_written.load(std::memory_order_acquire) < target) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void Logger::write_line(LogLevel level, const char* message, size_t length) {
+    FILE* out = level >= LogLevel::Warning ? stderr : stdout;
+    // Info lines keep the historical unprefixed "Component: message" form
+    if (level != LogLevel::Info) {
+        std::fputs(level_name(level), out);
+        std::fputs(": ", out);
+    }
+    std::fwrite(message, 1, length, out);
+    std::fputc('\n', out);
+}
+
+const char* Logger::level_name(LogLevel level) {
+    switch (level) {
+        case LogLevel::Trace: return "TRACE";
+        case LogLevel::Debug: return "DEBUG";
+        case LogLevel::Info: return "INFO";
+        case LogLevel::Warning: return "WARNING";
+        case LogLevel::Error: return "ERROR";
+        case LogLevel::Off: return "OFF";
+    }
+    return "?";
+}
+
+bool Logger::parse_level(const char* text, LogLevel& level) {
+    static const struct { const char* name; LogLevel level; } names[] = {
+        { "trace", LogLevel::Trace }, { "debug", LogLevel::Debug }, { "info", LogLevel::Info },
+        { "warning", LogLevel::Warning }, { "error", LogLevel::Error }, { "off", LogLevel::Off },
+    };
+    for (const auto& entry : names) {
+        if (std::strcmp(text, entry.name) == 0) {
+            level = entry.level;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,136 @@
+// logger.h
+// Header file for the Logger class and the VK_LOG_* macros.
+// Leveled logging that never writes to stdout/stderr from the calling thread: a log line is
+// formatted into a fixed-size buffer on the caller's stack and pushed onto a bounded lock-free
+// queue, and a background writer thread prints it. Nothing allocates, locks or flushes on the
+// audio and X11 paths; when the queue is full the line is dropped and counted instead.
+//
+// Levels below VK_LOG_COMPILED_LEVEL are removed at compile time (the arguments aren't even
+// evaluated). The runtime level comes from VK_LOG_LEVEL (trace, debug, info, warning, error, off);
+// VK_LOG_SYNC=1 writes synchronously instead, which helps when chasing a crash.
+//
+// Usage: VK_LOG_DEBUG("Sent key " << keycode << (is_press ? " press" : " release"));
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+
+enum class LogLevel : int {
+    Trace = 0,
+    Debug = 1,
+    Info = 2,
+    Warning = 3,
+    Error = 4,
+    Off = 5
+};
+
+// Minimum level compiled in, e.g. -DVK_LOG_COMPILED_LEVEL=2 for release builds without debug lines
+#ifndef VK_LOG_COMPILED_LEVEL
+#define VK_LOG_COMPILED_LEVEL 1
+#endif
+
+class Logger {
+public:
+    static constexpr size_t kMaxMessage = 480;  // Longer messages are truncated
+    static constexpr size_t kQueueCapacity = 1024; // Power of two
+
+    static Logger& instance();
+
+    bool is_enabled(LogLevel level) const {
+        return static_cast<int>(level) >= m_level.load(std::memory_order_relaxed);
+    }
+    void set_level(LogLevel level);
+    LogLevel level() const { return static_cast<LogLevel>(m_level.load(std::memory_order_relaxed)); }
+
+    // Queues one formatted message (or writes it directly in sync mode)
+    void submit(LogLevel level, const char* message, size_t length);
+
+    // Blocks until everything queued so far has been written
+    void flush();
+
+    // Lines dropped because the queue was full
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    static const char* level_name(LogLevel level);
+    static bool parse_level(const char* text, LogLevel& level);
+
+private:
+    Logger();
+    ~Logger();
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    // Bounded multi-producer/single-consumer ring. Each slot's sequence number says whether
+    // it is free for the producer of that round or holds a message for the consumer.
+    struct Slot {
+        std::atomic<size_t> sequence;
+        LogLevel level;
+        uint32_t length;
+        char message[kMaxMessage];
+    };
+
+    // Drains and stops the writer thread; later lines are written synchronously
+    void shutdown();
+    bool try_pop(Slot*& slot);
+    void release_slot(Slot* slot);
+    void writer_loop();
+    static void write_line(LogLevel level, const char* message, size_t length);
+
+    std::atomic<int> m_level;
+    std::atomic<bool> m_sync;
+    Slot* m_slots; // kQueueCapacity slots
+    alignas(64) std::atomic<size_t> m_enqueue_pos;
+    alignas(64) size_t m_dequeue_pos; // Writer thread only
+    std::atomic<uint64_t> m_written; // Messages written by the writer thread
+    std::atomic<uint64_t> m_queued;  // Messages accepted into the queue
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<bool> m_running;
+    std::thread m_writer;
+};
+
+// One log statement: formats into a stack buffer and submits it when destroyed
+class LogLine {
+public:
+    explicit LogLine(LogLevel level) : m_level(level), m_buffer(m_text, sizeof(m_text)), m_stream(&m_buffer) {}
+    ~LogLine() { Logger::instance().submit(m_level, m_text, m_buffer.length()); }
+    std::ostream& stream() { return m_stream; }
+
+private:
+    // streambuf over a fixed array; output beyond the end is silently discarded
+    class FixedBuffer : public std::streambuf {
+    public:
+        FixedBuffer(char* data, size_t size) { setp(data, data + size); }
+        size_t length() const { return static_cast<size_t>(pptr() - pbase()); }
+    protected:
+        int_type overflow(int_type ch) override { return traits_type::not_eof(ch); }
+    };
+
+    LogLevel m_level;
+    char m_text[Logger::kMaxMessage];
+    FixedBuffer m_buffer;
+    std::ostream m_stream;
+};
+
+#define VK_LOG(level, message)                                                               \
+    do {                                                                                     \
+        if constexpr (static_cast<int>(level) >= VK_LOG_COMPILED_LEVEL) {                    \
+            if (Logger::instance().is_enabled(level)) {                                      \
+                LogLine vk_log_line(level);                                                  \
+                vk_log_line.stream() << message;                                             \
+            }                                                                                \
+        }                                                                                    \
+    } while (0)
+
+#define VK_LOG_TRACE(message) VK_LOG(LogLevel::Trace, message)
+#define VK_LOG_DEBUG(message) VK_LOG(LogLevel::Debug, message)
+#define VK_LOG_INFO(message) VK_LOG(LogLevel::Info, message)
+#define VK_LOG_WARNING(message) VK_LOG(LogLevel::Warning, message)
+#define VK_LOG_ERROR(message) VK_LOG(LogLevel::Error, message)
+
+#endif // LOGGER_H
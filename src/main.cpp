@@ -2,7 +2,6 @@
 #include <gtkmm/window.h>
 #include <gtkmm/box.h>
 #include <gtkmm/label.h> // For the debug label
-#include <iostream>
 #include <thread>
 #include <chrono>
 
@@ -10,26 +9,40 @@
 #include <glibmm/main.h>
 #include <gtkmm/cssprovider.h>
 #include <gdkmm/window.h> // For Gdk::WINDOW_TYPE_HINT_*
+#include <glib-unix.h>     // For g_unix_signal_add
+#include <csignal>         // For SIGUSR1
 
 #include "keyboard.h" // Full include of Keyboard class definition
+#include "latencytracer.h"
+#include "logger.h"
+#include "statsoverlay.h"
 
 // Global pointer for debug label (for now, consider better alternatives for production)
 Gtk::Label* g_debug_label = nullptr;
 
-// Function to update the debug label from any thread
+// Function to update the debug label
 void update_debug_label(const Glib::ustring& text) {
+    // Only called from signal_preview(), which the keyboard emits on the GTK main thread
     if (g_debug_label) {
-        // Use Glib::signal_idle() to ensure the UI update happens on the main GTKmm thread
-        Glib::signal_idle().connect_once([text]() {
-            if (g_debug_label) {
-                g_debug_label->set_text(text);
-            }
-        });
+        g_debug_label->set_text(text);
     }
 }
 
+// SIGUSR1 handler, run from the main loop (not in signal context): dump latency metrics
+static gboolean on_dump_latency_signal(gpointer) {
+    LatencyTracer& tracer = LatencyTracer::instance();
+    tracer.dump(tracer.default_dump_prefix());
+    return G_SOURCE_CONTINUE;
+}
+
 int main(int argc, char* argv[]) {
-    std::cout << "DEBUG: main() started." << std::endl;
+    VK_LOG_DEBUG("main() started.");
+
+    // Reads VK_TRACE before any thread records; `kill -USR1 <pid>` dumps the metrics
+    LatencyTracer::instance().set_thread_name("gtk");
+    if (LatencyTracer::enabled()) {
+        g_unix_signal_add(SIGUSR1, on_dump_latency_signal, nullptr);
+    }
 
     auto app = Gtk::Application::create(argc, argv, "org.gtkmm.example.VirtualKeyboard");
 
@@ -39,9 +52,9 @@ int main(int argc, char* argv[]) {
         provider->load_from_path("style.css");
         Glib::RefPtr<Gtk::StyleContext> context = Gtk::StyleContext::create();
         context->add_provider_for_screen(Gdk::Screen::get_default(), provider, GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-        std::cout << "DEBUG: Loaded CSS from: style.css" << std::endl;
+        VK_LOG_DEBUG("Loaded CSS from: style.css");
     } catch (const Glib::Error& ex) {
-        std::cerr << "ERROR: Failed to load CSS: " << ex.what() << std::endl;
+        VK_LOG_ERROR("Failed to load CSS: " << ex.what());
     }
 
     Gtk::Window window;
@@ -55,9 +68,9 @@ int main(int argc, char* argv[]) {
     Gtk::VBox layout;
     window.add(layout);
 
-    std::cout << "DEBUG: Creating new Keyboard instance..." << std::endl;
+    VK_LOG_DEBUG("Creating new Keyboard instance...");
     Keyboard* keyboard = Gtk::manage(new Keyboard());
-    std::cout << "DEBUG: Keyboard instance created." << std::endl;
+    VK_LOG_DEBUG("Keyboard instance created.");
 
     layout.pack_start(*keyboard, Gtk::PACK_EXPAND_WIDGET, 0); // Pack keyboard to expand
 
@@ -70,31 +83,49 @@ int main(int argc, char* argv[]) {
     layout.pack_end(debug_label, Gtk::PACK_SHRINK, 0); // Pack at the end, don't expand
     g_debug_label = &debug_label; // Assign to global pointer
 
-    std::cout << "DEBUG: Packing keyboard into layout." << std::endl;
-    std::cout << "DEBUG: Keyboard packed." << std::endl;
+    // Runtime stats between the keys and the debug label, hidden until toggled
+    StatsOverlay stats_overlay;
+    layout.pack_end(stats_overlay, Gtk::PACK_SHRINK, 0);
+    keyboard->signal_stats_overlay().connect([&stats_overlay](bool shown) {
+        stats_overlay.set_active(shown);
+    });
+    stats_overlay.set_active(keyboard->stats_overlay()); // VK_STATS_OVERLAY=1
+
+    VK_LOG_DEBUG("Packing keyboard into layout.");
+    VK_LOG_DEBUG("Keyboard packed.");
 
     // Connect signals for hide/show and quit
     keyboard->signal_hide_show().connect([&window]() {
         if (window.is_visible()) {
             window.hide();
-            std::cout << "DEBUG: Window minimized." << std::endl;
+            VK_LOG_DEBUG("Window minimized.");
         } else {
             window.show_all(); // If hidden, show it
-            std::cout << "DEBUG: Window restored." << std::endl;
+            VK_LOG_DEBUG("Window restored.");
         }
     });
 
+    // Live preview hypotheses (and final results) are shown in the debug label
+    keyboard->signal_preview().connect([](const std::string& text) {
+        update_debug_label(text);
+    });
+
     keyboard->signal_quit_app().connect([&app]() {
-        std::cout << "DEBUG: Quitting application." << std::endl;
+        VK_LOG_DEBUG("Quitting application.");
         app->quit();
     });
 
     // CRITICAL FIX: Show all widgets in the window before running the main loop
     window.show_all(); 
 
-    std::cout << "DEBUG: Calling app->run()..." << std::endl;
+    VK_LOG_DEBUG("Calling app->run()...");
     int result = app->run(window);
-    std::cout << "DEBUG: app->run() finished. Result: " << result << std::endl;
+    VK_LOG_DEBUG("app->run() finished. Result: " << result);
+
+    if (LatencyTracer::enabled()) {
+        LatencyTracer& tracer = LatencyTracer::instance();
+        tracer.dump(tracer.default_dump_prefix());
+    }
 
     return result;
 }
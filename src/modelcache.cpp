@@ -0,0 +1,244 @@
+// modelcache.cpp
+// Implementation file for the ModelCache class.
+
+#include "modelcache.h"
+#include "logger.h"
+#include <vosk_api.h>
+#include <filesystem>
+#include <cstdlib> // For std::getenv, std::atof
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ModelCache& ModelCache::instance() {
+    static ModelCache cache;
+    return cache;
+}
+
+ModelCache::ModelCache()
+    : m_preload(false),
+      m_lock_pages(false)
+{
+    const char* preload_env = std::getenv("VK_MODEL_PRELOAD");
+    m_preload = preload_env && std::string(preload_env) == "1";
+    const char* mlock_env = std::getenv("VK_MODEL_MLOCK");
+    m_lock_pages = mlock_env && std::string(mlock_env) == "1";
+}
+
+void ModelCache::set_preload(bool enabled) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_preload = enabled;
+}
+
+void ModelCache::set_lock_pages(bool enabled) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lock_pages = enabled;
+}
+
+size_t ModelCache::resident_count() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_models.size();
+}
+
+unsigned ModelCache::model_sample_rate(const std::string& model_path) {
+    std::ifstream conf(std::filesystem::path(model_path) / "conf" / "mfcc.conf");
+    const std::string key = "--sample-frequency=";
+    std::string line;
+    while (std::getline(conf, line)) {
+        if (line.compare(0, key.size(), key) == 0) {
+            double rate = std::atof(line.c_str() + key.size());
+            if (rate > 0) {
+                return static_cast<unsigned>(rate);
+            }
+        }
+    }
+    return 16000;
+}
+
+std::string ModelCache::cache_key(const std::string& model_path) {
+    std::error_code ec;
+    std::string key = std::filesystem::weakly_canonical(model_path, ec).string();
+    return (ec || key.empty()) ? model_path : key;
+}
+
+VoskModel* ModelCache::acquire(const std::string& model_path) {
+    std::string key = cache_key(model_path);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // Another thread may already be loading this model; wait for it instead of loading twice
+    m_load_finished.wait(lock, [this, &key]() { return m_loading.count(key) == 0; });
+
+    auto it = m_models.find(key);
+    if (it != m_models.end()) {
+        it->second.references++;
+        VK_LOG_INFO("ModelCache: Reusing resident model " << key << " (" << it->second.references << " references).");
+        return it->second.model;
+    }
+
+    m_loading[key] = true;
+    bool preload = m_preload;
+    lock.unlock();
+
+    // Load without holding the lock; this takes seconds for large models
+    std::vector<MappedRegion> locked_regions;
+    if (preload) {
+        prefault_model_files(key, locked_regions);
+    }
+    VoskModel* model = vosk_model_new(key.c_str());
+
+    lock.lock();
+    m_loading.erase(key);
+    if (model) {
+        m_models[key] = Entry { model, 1, std::move(locked_regions) };
+        VK_LOG_INFO("ModelCache: Loaded model " << key << ".");
+    } else {
+        unmap_regions(locked_regions);
+        VK_LOG_ERROR("ModelCache failed to load model: " << key);
+    }
+    lock.unlock();
+    m_load_finished.notify_all();
+    return model;
+}
+
+void ModelCache::release(VoskModel* model) {
+    if (!model) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_models.begin(); it != m_models.end(); ++it) {
+        if (it->second.model != model) {
+            continue;
+        }
+        if (--it->second.references == 0) {
+            vosk_model_free(it->second.model);
+            unmap_regions(it->second.locked_regions);
+            VK_LOG_INFO("ModelCache: Freed model " << it->first << ".");
+            m_models.erase(it);
+        }
+        return;
+    }
+    VK_LOG_WARNING("ModelCache::release called with an unknown model.");
+}
+
+VoskBatchModel* ModelCache::acquire_batch(const std::string& model_path) {
+    std::string key = cache_key(model_path);
+    // Batch models are rare (one per process in practice), so loading under the lock is fine
+    std::lock_guard<std::mutex> lock(m_batch_mutex);
+    auto it = m_batch_models.find(key);
+    if (it != m_batch_models.end()) {
+        it->second.references++;
+        return it->second.model;
+    }
+    VoskBatchModel* model = vosk_batch_model_new(key.c_str());
+    if (!model) {
+        VK_LOG_WARNING("ModelCache: No GPU batch model for " << key << " (no CUDA device, or libvosk without CUDA).");
+        return nullptr;
+    }
+    m_batch_models[key] = BatchEntry { model, 1 };
+    VK_LOG_INFO("ModelCache: Loaded GPU batch model " << key << ".");
+    return model;
+}
+
+void ModelCache::release(VoskBatchModel* model) {
+    if (!model) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_batch_mutex);
+    for (auto it = m_batch_models.begin(); it != m_batch_models.end(); ++it) {
+        if (it->second.model != model) {
+            continue;
+        }
+        if (--it->second.references == 0) {
+            vosk_batch_model_free(it->second.model);
+            VK_LOG_INFO("ModelCache: Freed GPU batch model " << it->first << ".");
+            m_batch_models.erase(it);
+        }
+        return;
+    }
+    VK_LOG_WARNING("ModelCache::release called with an unknown batch model.");
+}
+
+VoskSpkModel* ModelCache::acquire_speaker(const std::string& model_path) {
+    std::string key = cache_key(model_path);
+    // Speaker models are small (a few MB), so loading under the lock is fine
+    std::lock_guard<std::mutex> lock(m_speaker_mutex);
+    auto it = m_speaker_models.find(key);
+    if (it != m_speaker_models.end()) {
+        it->second.references++;
+        return it->second.model;
+    }
+    VoskSpkModel* model = vosk_spk_model_new(key.c_str());
+    if (!model) {
+        VK_LOG_ERROR("ModelCache: Failed to load speaker model " << key << ".");
+        return nullptr;
+    }
+    m_speaker_models[key] = SpeakerEntry { model, 1 };
+    VK_LOG_INFO("ModelCache: Loaded speaker model " << key << ".");
+    return model;
+}
+
+void ModelCache::release(VoskSpkModel* model) {
+    if (!model) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_speaker_mutex);
+    for (auto it = m_speaker_models.begin(); it != m_speaker_models.end(); ++it) {
+        if (it->second.model != model) {
+            continue;
+        }
+        if (--it->second.references == 0) {
+            vosk_spk_model_free(it->second.model);
+            VK_LOG_INFO("ModelCache: Freed speaker model " << it->first << ".");
+            m_speaker_models.erase(it);
+        }
+        return;
+    }
+    VK_LOG_WARNING("ModelCache::release called with an unknown speaker model.");
+}
+
+void ModelCache::prefault_model_files(const std::string& directory, std::vector<MappedRegion>& locked_regions) {
+    bool lock_pages;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        lock_pages = m_lock_pages;
+    }
+
+    size_t total_bytes = 0;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(directory, ec)) {
+        if (!entry.is_regular_file(ec)) {
+            continue;
+        }
+        int fd = open(entry.path().c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            size_t length = static_cast<size_t>(st.st_size);
+            // MAP_POPULATE reads the whole file into the page cache up front
+            void* address = mmap(nullptr, length, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+            if (address != MAP_FAILED) {
+                total_bytes += length;
+                if (lock_pages && mlock(address, length) == 0) {
+                    locked_regions.push_back(MappedRegion { address, length });
+                } else {
+                    munmap(address, length);
+                }
+            }
+        }
+        close(fd);
+    }
+    VK_LOG_INFO("ModelCache: Pre-faulted " << (total_bytes / (1024 * 1024)) << " MiB of model files"
+             << (lock_pages ? " (" + std::to_string(locked_regions.size()) + " files locked)" : std::string()) << ".");
+}
+
+void ModelCache::unmap_regions(std::vector<MappedRegion>& regions) {
+    for (const MappedRegion& region : regions) {
+        munlock(region.address, region.length);
+        munmap(region.address, region.length);
+    }
+    regions.clear();
+}
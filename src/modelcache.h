@@ -0,0 +1,102 @@
+// modelcache.h
+// Header file for the ModelCache class.
+// Process-wide cache of loaded Vosk models, keyed by canonical model path and
+// reference counted, so every recognizer that uses the same model shares one copy
+// and a model that is already resident is never loaded again.
+// Optionally pre-faults the model files into the page cache (and mlock()s them)
+// before loading, so loading and the first decode don't wait on disk.
+
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct VoskModel;
+struct VoskBatchModel;
+struct VoskSpkModel;
+
+class ModelCache {
+public:
+    static ModelCache& instance();
+
+    // Returns the model for 'model_path', loading it if it is not resident yet.
+    // Each successful acquire() must be paired with release(). Returns nullptr on failure.
+    // Concurrent acquires of the same path wait for a single load.
+    VoskModel* acquire(const std::string& model_path);
+
+    // Drops one reference; the model is freed when the last reference goes away
+    void release(VoskModel* model);
+
+    // GPU batch model for 'model_path', shared and reference counted the same way.
+    // Returns nullptr when libvosk was built without CUDA or no GPU could be used;
+    // vosk_gpu_init() must have been called (BatchRecognizer::init_gpu()).
+    VoskBatchModel* acquire_batch(const std::string& model_path);
+    void release(VoskBatchModel* model);
+
+    // Speaker identification model (vosk-model-spk) for 'model_path', shared and reference
+    // counted the same way: every recognizer that reports x-vectors uses the one copy.
+    VoskSpkModel* acquire_speaker(const std::string& model_path);
+    void release(VoskSpkModel* model);
+
+    // Read every model file into the page cache before loading (VK_MODEL_PRELOAD=1)
+    void set_preload(bool enabled);
+    // Additionally mlock() the model files while the model is resident (VK_MODEL_MLOCK=1)
+    void set_lock_pages(bool enabled);
+
+    size_t resident_count() const;
+
+    // Sample rate the model at 'model_path' expects, from --sample-frequency in its
+    // conf/mfcc.conf (16000, the Vosk default, when it has none)
+    static unsigned model_sample_rate(const std::string& model_path);
+
+private:
+    ModelCache();
+    ModelCache(const ModelCache&) = delete;
+    ModelCache& operator=(const ModelCache&) = delete;
+
+    // Canonical form of 'model_path', so different spellings share one entry
+    static std::string cache_key(const std::string& model_path);
+
+    struct MappedRegion {
+        void* address;
+        size_t length;
+    };
+
+    struct Entry {
+        VoskModel* model;
+        size_t references;
+        std::vector<MappedRegion> locked_regions; // Kept mapped and mlock()ed while resident
+    };
+
+    // Maps each regular file under 'directory' with MAP_POPULATE; locked regions are returned
+    void prefault_model_files(const std::string& directory, std::vector<MappedRegion>& locked_regions);
+    static void unmap_regions(std::vector<MappedRegion>& regions);
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_load_finished;
+    std::map<std::string, Entry> m_models;
+    std::map<std::string, bool> m_loading; // Paths currently being loaded by some thread
+
+    struct BatchEntry {
+        VoskBatchModel* model;
+        size_t references;
+    };
+    std::mutex m_batch_mutex; // Guards m_batch_models; held while a batch model loads
+    std::map<std::string, BatchEntry> m_batch_models;
+
+    struct SpeakerEntry {
+        VoskSpkModel* model;
+        size_t references;
+    };
+    std::mutex m_speaker_mutex; // Guards m_speaker_models; held while a speaker model loads
+    std::map<std::string, SpeakerEntry> m_speaker_models;
+    bool m_preload;
+    bool m_lock_pages;
+};
+
+#endif // MODEL_CACHE_H
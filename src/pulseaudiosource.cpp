@@ -0,0 +1,92 @@
+// pulseaudiosource.cpp
+// Implementation file for the PulseAudioSource class.
+
+#include "pulseaudiosource.h"
+#include "latencytracer.h"
+#include "logger.h"
+#include <pulse/simple.h>
+#include <pulse/error.h>
+
+PulseAudioSource::PulseAudioSource()
+    : m_stream(nullptr)
+{
+}
+
+PulseAudioSource::~PulseAudioSource() {
+    close();
+}
+
+bool PulseAudioSource::open(const AudioSourceConfig& config) {
+    close();
+    pa_sample_spec spec;
+    spec.format = PA_SAMPLE_S16LE;
+    spec.rate = config.sample_rate;
+    spec.channels = static_cast<uint8_t>(config.channels);
+
+    const uint32_t frame_bytes = static_cast<uint32_t>(config.channels * sizeof(int16_t));
+    pa_buffer_attr attr;
+    attr.maxlength = static_cast<uint32_t>(config.buffer_frames) * frame_bytes;
+    attr.fragsize = static_cast<uint32_t>(config.period_frames) * frame_bytes; // Deliver every period
+    attr.tlength = static_cast<uint32_t>(-1); // Playback-only fields
+    attr.prebuf = static_cast<uint32_t>(-1);
+    attr.minreq = static_cast<uint32_t>(-1);
+
+    int error = 0;
+    const char* device = config.device.empty() ? nullptr : config.device.c_str();
+    m_stream = pa_simple_new(nullptr, "VirtualKeyboard", PA_STREAM_RECORD, device, "Speech input",
+                             &spec, nullptr, &attr, &error);
+    if (!m_stream) {
+        VK_LOG_ERROR("Cannot open PulseAudio source " << (device ? device : "(default)") << ": " << pa_strerror(error));
+        return false;
+    }
+    // The server converts to the requested spec, so the format is exactly what was asked for
+    m_sample_rate = config.sample_rate;
+    m_channels = config.channels;
+    m_period_frames = config.period_frames;
+    m_buffer_frames = config.buffer_frames;
+    VK_LOG_INFO("PulseAudioSource: " << (device ? device : "(default)") << " - Rate: " << m_sample_rate
+             << "Hz, Channels: " << m_channels << ", Fragment Size (frames): " << m_period_frames
+             << ", Max Buffer (frames): " << m_buffer_frames);
+    return true;
+}
+
+void PulseAudioSource::close() {
+    if (m_stream) {
+        pa_simple_free(m_stream);
+        m_stream = nullptr;
+    }
+}
+
+AudioSource::ReadStatus PulseAudioSource::read(int16_t* out, size_t& frames) {
+    frames = 0;
+    if (!m_stream) {
+        return ReadStatus::Error;
+    }
+    int error = 0;
+    if (pa_simple_read(m_stream, out, m_period_frames * m_channels * sizeof(int16_t), &error) < 0) {
+        VK_LOG_ERROR("Error from PulseAudio read: " << pa_strerror(error));
+        return ReadStatus::Error;
+    }
+    frames = m_period_frames;
+    return ReadStatus::Ok;
+}
+
+bool PulseAudioSource::resume() {
+    // The simple API can't cork the stream, so whatever queued up while paused is stale
+    int error = 0;
+    if (m_stream && pa_simple_flush(m_stream, &error) < 0) {
+        VK_LOG_WARNING("Cannot flush PulseAudio stream after standby: " << pa_strerror(error));
+    }
+    return m_stream != nullptr;
+}
+
+uint64_t PulseAudioSource::last_period_end_ns() {
+    uint64_t now = LatencyTracer::now_ns();
+    int error = 0;
+    pa_usec_t latency_us = m_stream ? pa_simple_get_latency(m_stream, &error) : 0;
+    if (latency_us == static_cast<pa_usec_t>(-1)) {
+        return now;
+    }
+    uint64_t latency_ns = latency_us * 1000ull; // Audio recorded but not yet read
+    return now > latency_ns ? now - latency_ns : now;
+}
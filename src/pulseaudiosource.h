@@ -0,0 +1,32 @@
+// pulseaudiosource.h
+// Header file for the PulseAudioSource class.
+// Records from a PulseAudio source, or from PipeWire through its pipewire-pulse server,
+// without going through the ALSA pulse plugin. The fragment size is set to one period so
+// the server hands over audio as soon as a period is complete instead of its default
+// (much larger) fragments. Only built when libpulse-simple is available (VK_HAVE_PULSE).
+
+#ifndef PULSE_AUDIO_SOURCE_H
+#define PULSE_AUDIO_SOURCE_H
+
+#include "audiosource.h"
+
+struct pa_simple;
+
+class PulseAudioSource : public AudioSource {
+public:
+    PulseAudioSource();
+    ~PulseAudioSource() override;
+
+    const char* name() const override { return "pulse"; }
+
+    bool open(const AudioSourceConfig& config) override;
+    void close() override;
+    ReadStatus read(int16_t* out, size_t& frames) override;
+    bool resume() override;
+    uint64_t last_period_end_ns() override;
+
+private:
+    pa_simple* m_stream;
+};
+
+#endif // PULSE_AUDIO_SOURCE_H
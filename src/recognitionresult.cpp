@@ -0,0 +1,326 @@
+// recognitionresult.cpp
+// Implementation file for RecognitionResult and the RecognitionResultDecoder class.
+// A minimal recursive-descent JSON reader that understands the fields Vosk emits
+// and skips everything else.
+
+#include "recognitionresult.h"
+#include <charconv> // For std::from_chars
+
+RecognitionResult::RecognitionResult()
+    : is_partial(false),
+      speaker_frames(0.0f)
+{
+}
+
+void RecognitionResult::clear() {
+    text = std::string_view();
+    is_partial = false;
+    words.clear();
+    alternatives.clear();
+    alternative_words.clear();
+    speaker_vector.clear();
+    speaker_frames = 0.0f;
+    unescaped.clear();
+}
+
+std::string_view RecognitionResult::best_text() const {
+    if (!text.empty() || alternatives.empty()) {
+        return text;
+    }
+    return alternatives.front().text;
+}
+
+template <typename KeyHandler>
+bool RecognitionResultDecoder::parse_object(KeyHandler&& on_key) {
+    if (!consume('{')) {
+        return false;
+    }
+    skip_whitespace();
+    if (consume('}')) {
+        return true;
+    }
+    while (true) {
+        std::string_view key;
+        if (!parse_string(key) || !consume(':') || !on_key(key)) {
+            return false;
+        }
+        if (consume(',')) {
+            continue;
+        }
+        return consume('}');
+    }
+}
+
+bool RecognitionResultDecoder::decode(std::string_view json, RecognitionResult& result) {
+    result.clear();
+    // Unescaped strings are never longer than their escaped form, so reserving the input size
+    // guarantees the buffer never reallocates and views into it stay valid.
+    result.unescaped.reserve(json.size());
+
+    m_pos = json.data();
+    m_end = json.data() + json.size();
+    m_result = &result;
+
+    return parse_object([this](std::string_view key) {
+        if (key == "text") {
+            return parse_string(m_result->text);
+        } else if (key == "partial") {
+            m_result->is_partial = true;
+            return parse_string(m_result->text);
+        } else if (key == "result" || key == "partial_result") {
+            return parse_words(m_result->words);
+        } else if (key == "alternatives") {
+            return parse_alternatives();
+        } else if (key == "spk") {
+            return parse_numbers(m_result->speaker_vector);
+        } else if (key == "spk_frames") {
+            return parse_number(m_result->speaker_frames);
+        }
+        return skip_value();
+    });
+}
+
+void RecognitionResultDecoder::skip_whitespace() {
+    while (m_pos < m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t')) {
+        ++m_pos;
+    }
+}
+
+bool RecognitionResultDecoder::consume(char c) {
+    skip_whitespace();
+    if (m_pos < m_end && *m_pos == c) {
+        ++m_pos;
+        return true;
+    }
+    return false;
+}
+
+// Appends a code point to 'out' as UTF-8
+static void append_utf8(std::string& out, unsigned long cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// Reads four hex digits of a \u escape
+static bool parse_hex4(const char*& pos, const char* end, unsigned long& out) {
+    if (end - pos < 4) {
+        return false;
+    }
+    unsigned long value = 0;
+    for (int i = 0; i < 4; ++i, ++pos) {
+        char c = *pos;
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= c - '0';
+        else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+        else return false;
+    }
+    out = value;
+    return true;
+}
+
+bool RecognitionResultDecoder::parse_string(std::string_view& out) {
+    if (!consume('"')) {
+        return false;
+    }
+    const char* start = m_pos;
+    while (m_pos < m_end && *m_pos != '"' && *m_pos != '\\') {
+        ++m_pos;
+    }
+    if (m_pos >= m_end) {
+        return false;
+    }
+    if (*m_pos == '"') {
+        // Common case: no escapes, point straight into the Vosk buffer
+        out = std::string_view(start, m_pos - start);
+        ++m_pos;
+        return true;
+    }
+
+    // Escaped string: decode into the result's unescape buffer
+    std::string& buffer = m_result->unescaped;
+    size_t offset = buffer.size();
+    buffer.append(start, m_pos - start);
+    while (m_pos < m_end && *m_pos != '"') {
+        if (*m_pos != '\\') {
+            buffer += *m_pos++;
+            continue;
+        }
+        if (++m_pos >= m_end) {
+            return false;
+        }
+        char escape = *m_pos++;
+        switch (escape) {
+            case '"': buffer += '"'; break;
+            case '\\': buffer += '\\'; break;
+            case '/': buffer += '/'; break;
+            case 'b': buffer += '\b'; break;
+            case 'f': buffer += '\f'; break;
+            case 'n': buffer += '\n'; break;
+            case 'r': buffer += '\r'; break;
+            case 't': buffer += '\t'; break;
+            case 'u': {
+                unsigned long cp;
+                if (!parse_hex4(m_pos, m_end, cp)) {
+                    return false;
+                }
+                // Combine UTF-16 surrogate pairs
+                if (cp >= 0xD800 && cp <= 0xDBFF && m_end - m_pos >= 6 && m_pos[0] == '\\' && m_pos[1] == 'u') {
+                    const char* low_pos = m_pos + 2;
+                    unsigned long low;
+                    if (parse_hex4(low_pos, m_end, low) && low >= 0xDC00 && low <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        m_pos = low_pos;
+                    }
+                }
+                append_utf8(buffer, cp);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    if (m_pos >= m_end) {
+        return false;
+    }
+    ++m_pos; // Closing quote
+    out = std::string_view(buffer.data() + offset, buffer.size() - offset);
+    return true;
+}
+
+bool RecognitionResultDecoder::parse_number(float& out) {
+    skip_whitespace();
+    auto [ptr, ec] = std::from_chars(m_pos, m_end, out);
+    if (ec != std::errc()) {
+        return false;
+    }
+    m_pos = ptr;
+    return true;
+}
+
+bool RecognitionResultDecoder::skip_value() {
+    skip_whitespace();
+    if (m_pos >= m_end) {
+        return false;
+    }
+    char c = *m_pos;
+    if (c == '"') {
+        std::string_view ignored;
+        return parse_string(ignored);
+    } else if (c == '{') {
+        return parse_object([this](std::string_view) { return skip_value(); });
+    } else if (c == '[') {
+        ++m_pos;
+        if (consume(']')) {
+            return true;
+        }
+        do {
+            if (!skip_value()) {
+                return false;
+            }
+        } while (consume(','));
+        return consume(']');
+    }
+    // Number, true, false or null: skip to the next delimiter
+    while (m_pos < m_end && *m_pos != ',' && *m_pos != '}' && *m_pos != ']' &&
+           *m_pos != ' ' && *m_pos != '\n' && *m_pos != '\r' && *m_pos != '\t') {
+        ++m_pos;
+    }
+    return true;
+}
+
+bool RecognitionResultDecoder::parse_numbers(std::vector<float>& numbers) {
+    if (!consume('[')) {
+        return false;
+    }
+    if (consume(']')) {
+        return true;
+    }
+    do {
+        float number;
+        if (!parse_number(number)) {
+            return false;
+        }
+        numbers.push_back(number);
+    } while (consume(','));
+    return consume(']');
+}
+
+bool RecognitionResultDecoder::parse_words(std::vector<RecognizedWord>& words) {
+    if (!consume('[')) {
+        return false;
+    }
+    if (consume(']')) {
+        return true;
+    }
+    do {
+        RecognizedWord word { std::string_view(), 0.0f, 0.0f, 1.0f };
+        if (!parse_word(word)) {
+            return false;
+        }
+        words.push_back(word);
+    } while (consume(','));
+    return consume(']');
+}
+
+bool RecognitionResultDecoder::parse_word(RecognizedWord& word) {
+    return parse_object([this, &word](std::string_view key) {
+        if (key == "word") {
+            return parse_string(word.word);
+        } else if (key == "start") {
+            return parse_number(word.start);
+        } else if (key == "end") {
+            return parse_number(word.end);
+        } else if (key == "conf") {
+            return parse_number(word.conf);
+        }
+        return skip_value();
+    });
+}
+
+bool RecognitionResultDecoder::parse_alternatives() {
+    if (!consume('[')) {
+        return false;
+    }
+    if (consume(']')) {
+        return true;
+    }
+    do {
+        RecognitionAlternative alternative { std::string_view(), 0.0f, m_result->alternative_words.size(), 0 };
+        if (!parse_alternative(alternative)) {
+            return false;
+        }
+        m_result->alternatives.push_back(alternative);
+    } while (consume(','));
+    return consume(']');
+}
+
+bool RecognitionResultDecoder::parse_alternative(RecognitionAlternative& alternative) {
+    return parse_object([this, &alternative](std::string_view key) {
+        if (key == "text") {
+            return parse_string(alternative.text);
+        } else if (key == "confidence") {
+            return parse_number(alternative.confidence);
+        } else if (key == "result") {
+            size_t before = m_result->alternative_words.size();
+            alternative.first_word = before;
+            bool ok = parse_words(m_result->alternative_words);
+            alternative.word_count = m_result->alternative_words.size() - before;
+            return ok;
+        }
+        return skip_value();
+    });
+}
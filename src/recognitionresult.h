@@ -0,0 +1,81 @@
+// recognitionresult.h
+// Header file for RecognitionResult and the RecognitionResultDecoder class.
+// The decoder parses the JSON strings returned by vosk_recognizer_result(),
+// vosk_recognizer_partial_result() and vosk_recognizer_final_result() in place.
+// Strings are returned as std::string_view into the Vosk buffer, so a result is only
+// valid until the next call on the same recognizer. Reusing one RecognitionResult
+// keeps its vectors' capacity, so steady-state decoding does not allocate.
+
+#ifndef RECOGNITION_RESULT_H
+#define RECOGNITION_RESULT_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+// One entry of a "result" array (requires vosk_recognizer_set_words)
+struct RecognizedWord {
+    std::string_view word;
+    float start; // Seconds from the start of the stream
+    float end;
+    float conf;  // 1.0 when the recognizer does not report word confidences
+};
+
+// One entry of an "alternatives" array (requires vosk_recognizer_set_max_alternatives)
+struct RecognitionAlternative {
+    std::string_view text;
+    float confidence;
+    size_t first_word; // Index into RecognitionResult::alternative_words
+    size_t word_count;
+};
+
+struct RecognitionResult {
+    std::string_view text;   // "text" of a final result, or "partial" of a partial result
+    bool is_partial;
+    std::vector<RecognizedWord> words;                     // Top-level "result"/"partial_result"
+    std::vector<RecognitionAlternative> alternatives;
+    std::vector<RecognizedWord> alternative_words;         // Flat word storage for all alternatives
+    std::vector<float> speaker_vector; // "spk" x-vector of a final result (recognizers with a speaker model)
+    float speaker_frames;              // "spk_frames": frames the x-vector was computed from
+
+    // Backing storage for strings that contained JSON escapes and had to be decoded
+    std::string unescaped;
+
+    RecognitionResult();
+
+    // Resets all fields while keeping allocated capacity
+    void clear();
+
+    // Text of the best hypothesis: "text", or the first alternative's text
+    std::string_view best_text() const;
+};
+
+class RecognitionResultDecoder {
+public:
+    // Parses a Vosk JSON result into 'result'. Returns false on malformed input,
+    // in which case 'result' holds whatever was parsed before the error.
+    bool decode(std::string_view json, RecognitionResult& result);
+
+private:
+    const char* m_pos = nullptr;
+    const char* m_end = nullptr;
+    RecognitionResult* m_result = nullptr;
+
+    // Parses '{ "key": value, ... }', calling on_key(key) to parse each value
+    template <typename KeyHandler>
+    bool parse_object(KeyHandler&& on_key);
+
+    void skip_whitespace();
+    bool consume(char c);
+    bool parse_string(std::string_view& out);
+    bool parse_number(float& out);
+    bool skip_value();
+    bool parse_numbers(std::vector<float>& numbers);
+    bool parse_words(std::vector<RecognizedWord>& words);
+    bool parse_word(RecognizedWord& word);
+    bool parse_alternatives();
+    bool parse_alternative(RecognitionAlternative& alternative);
+};
+
+#endif // RECOGNITION_RESULT_H
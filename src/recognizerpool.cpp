@@ -0,0 +1,477 @@
+// recognizerpool.cpp
+// Implementation file for the RecognizerPool class.
+
+#include "recognizerpool.h"
+#include "audioconverter.h"
+#include "audioringbuffer.h"
+#include "batchrecognizer.h"
+#include "modelcache.h"
+#include "logger.h"
+#include <algorithm> // For std::find, std::min_element
+#include <chrono>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+
+// Include Vosk API header
+#include <vosk_api.h>
+
+struct RecognizerPool::Stream {
+    StreamId id = 0;
+    unsigned worker = 0;
+    ResultCallback on_final;
+    ResultCallback on_partial;
+    EndCallback on_end;
+
+    // Capture side (capture thread only while it runs)
+    std::unique_ptr<AudioSource> source;
+    AudioConverter converter;
+    std::vector<int16_t> capture_buffer; // Native-format period, unused when the source is passthrough
+    std::vector<int16_t> discard_buffer; // Sink for periods read while the ring is full
+    std::thread capture_thread;
+    std::atomic<bool> capture_requested { false };
+    std::atomic<bool> capture_active { false }; // Cleared by the capture thread when it exits
+    bool wait_for_ring = false; // Source isn't paced (file/socket): wait for the worker instead of dropping
+
+    std::unique_ptr<AudioRingBuffer> ring;
+
+    // Decode side (the assigned worker only, or remove_stream() once it was taken off the worker)
+    VoskRecognizer* recognizer = nullptr;     // CPU decoding
+    std::unique_ptr<BatchRecognizer> batch;   // GPU decoding, instead of 'recognizer'
+    std::string last_partial;
+    std::string text;
+    std::atomic<bool> finished { false };
+
+    std::atomic<uint64_t> periods_captured { 0 };
+    std::atomic<uint64_t> periods_decoded { 0 };
+    std::atomic<uint64_t> ring_overruns { 0 };
+    std::atomic<uint64_t> source_overruns { 0 };
+    std::atomic<uint64_t> frames_decoded { 0 };
+};
+
+struct RecognizerPool::Worker {
+    size_t index = 0;
+    std::thread thread;
+    std::mutex mutex;             // Guards streams; held by the worker for a whole pass
+    std::vector<Stream*> streams;
+    size_t assigned = 0;          // streams.size() as seen by the scheduler (guarded by m_mutex)
+
+    // Result decoding state, reused for every result of every stream on this worker
+    RecognitionResultDecoder decoder;
+    RecognitionResult result;
+
+    std::atomic<uint64_t> periods_decoded { 0 };
+    std::atomic<uint64_t> busy_ns { 0 };
+};
+
+RecognizerPool::RecognizerPool()
+    : m_model(nullptr),
+      m_batch_model(nullptr),
+      m_model_sample_rate(16000),
+      m_running(false),
+      m_next_id(1)
+{
+}
+
+RecognizerPool::~RecognizerPool() {
+    shutdown();
+}
+
+bool RecognizerPool::init(const std::string& model_path, const Options& options) {
+    if (m_model) {
+        VK_LOG_ERROR("RecognizerPool: Already initialised.");
+        return false;
+    }
+    vosk_set_log_level(-1); // Disable Vosk logging to console
+
+    // One model for every recognizer in the pool (and for anything else using the cache)
+    m_model = ModelCache::instance().acquire(model_path);
+    if (!m_model) {
+        VK_LOG_ERROR("RecognizerPool: Failed to load model: " << model_path);
+        return false;
+    }
+    m_model_sample_rate = ModelCache::model_sample_rate(model_path);
+    m_options = options;
+    if (m_options.ring_depth == 0) {
+        m_options.ring_depth = 1;
+    }
+    if (m_options.gpu) {
+        BatchRecognizer::init_gpu();
+        m_batch_model = ModelCache::instance().acquire_batch(model_path);
+        if (!m_batch_model) {
+            VK_LOG_WARNING("RecognizerPool: No GPU available, decoding on the CPU.");
+        }
+    }
+
+    unsigned workers = m_options.workers;
+    if (workers == 0) {
+        workers = std::thread::hardware_concurrency();
+        workers = workers > 0 ? workers : 1;
+    }
+
+    // CPUs this process may run on, so pinning respects taskset/cgroup limits
+    std::vector<int> cpus;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (m_options.pin_workers && sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+
+    m_running = true;
+    for (unsigned i = 0; i < workers; ++i) {
+        auto worker = std::make_unique<Worker>();
+        worker->index = i;
+        worker->thread = std::thread(&RecognizerPool::worker_loop, this, worker.get());
+        if (!cpus.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[i % cpus.size()], &set);
+            if (pthread_setaffinity_np(worker->thread.native_handle(), sizeof(set), &set) != 0) {
+                VK_LOG_WARNING("RecognizerPool: Could not pin worker " << i << " to CPU " << cpus[i % cpus.size()]);
+            }
+        }
+        m_workers.push_back(std::move(worker));
+    }
+    VK_LOG_INFO("RecognizerPool: " << workers << " worker(s)" << (cpus.empty() ? "" : ", pinned")
+             << ", model at " << m_model_sample_rate << " Hz" << (m_batch_model ? ", GPU decoding" : "") << ".");
+    return true;
+}
+
+void RecognizerPool::shutdown() {
+    for (StreamId id : stream_ids()) {
+        remove_stream(id);
+    }
+    m_running = false;
+    for (auto& worker : m_workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    m_workers.clear();
+    if (m_batch_model) {
+        ModelCache::instance().release(m_batch_model);
+        m_batch_model = nullptr;
+    }
+    if (m_model) {
+        ModelCache::instance().release(m_model);
+        m_model = nullptr;
+    }
+}
+
+RecognizerPool::StreamId RecognizerPool::add_stream(const AudioSourceConfig& config, ResultCallback on_final,
+                                                    ResultCallback on_partial, EndCallback on_end) {
+    if (!m_model || m_workers.empty()) {
+        VK_LOG_ERROR("RecognizerPool: add_stream() before init().");
+        return 0;
+    }
+
+    auto stream = std::make_unique<Stream>();
+    stream->on_final = std::move(on_final);
+    stream->on_partial = std::move(on_partial);
+    stream->on_end = std::move(on_end);
+    stream->source = create_audio_source(config.backend);
+    if (!stream->source || !stream->source->open(config)) {
+        VK_LOG_ERROR("RecognizerPool: Cannot open " << config.backend << " source '" << config.device << "'.");
+        return 0;
+    }
+    AudioSource& source = *stream->source;
+    if (!stream->converter.configure(source.sample_rate(), source.channels(), m_model_sample_rate,
+                                     source.period_frames())) {
+        return 0;
+    }
+    size_t slot_frames = source.period_frames();
+    if (!stream->converter.passthrough()) {
+        stream->capture_buffer.assign(source.period_frames() * source.channels(), 0);
+        slot_frames = stream->converter.max_output_frames(source.period_frames());
+    }
+    stream->discard_buffer.assign(slot_frames, 0);
+    stream->wait_for_ring = !config.realtime;
+    stream->ring = std::make_unique<AudioRingBuffer>(m_options.ring_depth, slot_frames);
+
+    if (m_batch_model) {
+        stream->batch = std::make_unique<BatchRecognizer>();
+        if (!stream->batch->open(m_batch_model, static_cast<float>(m_model_sample_rate))) {
+            VK_LOG_WARNING("RecognizerPool: GPU stream unavailable, decoding on the CPU.");
+            stream->batch.reset();
+        }
+    }
+    if (!stream->batch) {
+        stream->recognizer = vosk_recognizer_new(m_model, static_cast<float>(m_model_sample_rate));
+    }
+    if (!stream->batch && !stream->recognizer) {
+        VK_LOG_ERROR("RecognizerPool: Failed to create Vosk recognizer.");
+        return 0;
+    }
+
+    Stream* raw = stream.get();
+    Worker* worker = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Least loaded worker first; ties go to the lowest index so streams fill cores in order
+        auto least_loaded = std::min_element(m_workers.begin(), m_workers.end(),
+            [](const std::unique_ptr<Worker>& a, const std::unique_ptr<Worker>& b) { return a->assigned < b->assigned; });
+        worker = least_loaded->get();
+        worker->assigned++;
+        raw->id = m_next_id++;
+        raw->worker = static_cast<unsigned>(worker->index);
+        m_streams[raw->id] = std::move(stream);
+    }
+
+    raw->capture_requested = true;
+    raw->capture_active = true;
+    raw->capture_thread = std::thread(&RecognizerPool::capture_loop, this, raw);
+    {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->streams.push_back(raw);
+    }
+    VK_LOG_INFO("RecognizerPool: Stream " << raw->id << " (" << source.name() << " '" << config.device
+             << "') on worker " << raw->worker << ".");
+    return raw->id;
+}
+
+void RecognizerPool::remove_stream(StreamId id) {
+    std::unique_ptr<Stream> stream;
+    Worker* worker = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_streams.find(id);
+        if (it == m_streams.end()) {
+            return;
+        }
+        stream = std::move(it->second);
+        m_streams.erase(it);
+        worker = m_workers[stream->worker].get();
+        worker->assigned--;
+    }
+
+    // Capture returns within one period once asked to stop, or right away from a source
+    // that is waiting for input (a pipe or client that has gone quiet) once interrupted; what
+    // the source already buffered is still read first
+    stream->capture_requested = false;
+    stream->source->interrupt();
+    if (stream->capture_thread.joinable()) {
+        stream->capture_thread.join();
+    }
+    {
+        // Waits for the worker's current pass, after which it never sees this stream again
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        auto& streams = worker->streams;
+        streams.erase(std::find(streams.begin(), streams.end(), stream.get()));
+    }
+
+    // The stream is ours alone now: decode what was still queued and deliver the last result
+    RecognitionResultDecoder decoder;
+    RecognitionResult result;
+    while (decode_period(*stream, decoder, result)) {
+    }
+    finish_stream(*stream, decoder, result);
+
+    if (stream->batch) {
+        stream->batch->close();
+    } else {
+        vosk_recognizer_free(stream->recognizer);
+    }
+    stream->source->close();
+    VK_LOG_INFO("RecognizerPool: Stream " << id << " removed.");
+}
+
+size_t RecognizerPool::stream_count() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_streams.size();
+}
+
+std::vector<RecognizerPool::StreamId> RecognizerPool::stream_ids() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<StreamId> ids;
+    for (const auto& entry : m_streams) {
+        ids.push_back(entry.first);
+    }
+    return ids;
+}
+
+bool RecognizerPool::get_stream_stats(StreamId id, StreamStats& stats) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_streams.find(id);
+    if (it == m_streams.end()) {
+        return false;
+    }
+    const Stream& stream = *it->second;
+    stats.worker = stream.worker;
+    stats.finished = stream.finished.load(std::memory_order_acquire);
+    stats.periods_captured = stream.periods_captured.load(std::memory_order_relaxed);
+    stats.periods_decoded = stream.periods_decoded.load(std::memory_order_relaxed);
+    stats.ring_overruns = stream.ring_overruns.load(std::memory_order_relaxed);
+    stats.source_overruns = stream.source_overruns.load(std::memory_order_relaxed);
+    stats.audio_seconds = static_cast<double>(stream.frames_decoded.load(std::memory_order_relaxed))
+                        / m_model_sample_rate;
+    return true;
+}
+
+RecognizerPool::WorkerStats RecognizerPool::get_worker_stats(size_t worker) const {
+    WorkerStats stats { 0, 0, 0 };
+    if (worker >= m_workers.size()) {
+        return stats;
+    }
+    const Worker& w = *m_workers[worker];
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        stats.streams = w.assigned;
+    }
+    stats.periods_decoded = w.periods_decoded.load(std::memory_order_relaxed);
+    stats.busy_ns = w.busy_ns.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void RecognizerPool::capture_loop(Stream* stream) {
+    using ReadStatus = AudioSource::ReadStatus;
+    AudioSource& source = *stream->source;
+    bool converting = !stream->converter.passthrough();
+
+    while (stream->capture_requested.load(std::memory_order_acquire)) {
+        // Same scheme as SpeechToTextService: read (or convert) straight into the next ring
+        // slot, and keep draining the source into the discard buffer while the ring is full.
+        // A source that isn't paced (a file, a client socket) waits for a slot instead.
+        int16_t* slot = stream->ring->acquire_write_slot();
+        if (!slot && stream->wait_for_ring) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        bool dropping = (slot == nullptr);
+        int16_t* target = dropping ? stream->discard_buffer.data() : slot;
+
+        size_t frames = 0;
+        ReadStatus status = source.read(converting ? stream->capture_buffer.data() : target, frames);
+        if (status == ReadStatus::Overrun) {
+            stream->source_overruns.fetch_add(1, std::memory_order_relaxed);
+            stream->converter.reset();
+            continue;
+        } else if (status == ReadStatus::EndOfStream) {
+            break;
+        } else if (status != ReadStatus::Ok) {
+            VK_LOG_ERROR("RecognizerPool: Stream " << stream->id << " capture failed.");
+            break;
+        }
+        if (converting) {
+            frames = stream->converter.process(stream->capture_buffer.data(), frames, target);
+        }
+
+        if (dropping) {
+            stream->ring_overruns.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        stream->ring->commit_write_slot(frames);
+        stream->periods_captured.fetch_add(1, std::memory_order_relaxed);
+    }
+    stream->capture_active.store(false, std::memory_order_release);
+}
+
+void RecognizerPool::worker_loop(Worker* worker) {
+    // Poll at a fraction of a period so an idle worker adds little latency
+    const auto idle_wait = std::chrono::milliseconds(5);
+    if (m_batch_model) {
+        BatchRecognizer::init_thread();
+    }
+
+    while (m_running) {
+        bool decoded_any = false;
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            // One period per stream per pass keeps a busy stream from starving the others
+            for (Stream* stream : worker->streams) {
+                auto start = std::chrono::steady_clock::now();
+                if (decode_period(*stream, worker->decoder, worker->result)) {
+                    decoded_any = true;
+                    worker->periods_decoded.fetch_add(1, std::memory_order_relaxed);
+                    worker->busy_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+                } else if (!stream->capture_active.load(std::memory_order_acquire) && !stream->finished) {
+                    // The source ended (e.g. end of file). Capture may have committed its last
+                    // period between the empty ring above and this check, so decode whatever
+                    // is queued now before the final result and the end of the stream go out.
+                    while (decode_period(*stream, worker->decoder, worker->result)) {
+                        decoded_any = true;
+                        worker->periods_decoded.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    finish_stream(*stream, worker->decoder, worker->result);
+                }
+            }
+        }
+        if (!decoded_any) {
+            std::this_thread::sleep_for(idle_wait);
+        }
+    }
+}
+
+bool RecognizerPool::decode_period(Stream& stream, RecognitionResultDecoder& decoder, RecognitionResult& result) {
+    size_t samples = 0;
+    const int16_t* period = stream.ring->acquire_read_slot(samples);
+    if (!period) {
+        return false;
+    }
+
+    if (stream.batch) {
+        // Queued for the GPU; whatever results it has finished come back here
+        stream.batch->accept_waveform(period, samples);
+        stream.ring->release_read_slot();
+        stream.frames_decoded.fetch_add(samples, std::memory_order_relaxed);
+        stream.periods_decoded.fetch_add(1, std::memory_order_relaxed);
+        while (const char* result_json = stream.batch->next_result()) {
+            deliver_result(stream, result_json, decoder, result);
+        }
+        return true;
+    }
+
+    int rec_res = vosk_recognizer_accept_waveform(stream.recognizer, reinterpret_cast<const char*>(period),
+                                                  static_cast<int>(samples * sizeof(int16_t)));
+    stream.ring->release_read_slot();
+    stream.frames_decoded.fetch_add(samples, std::memory_order_relaxed);
+    stream.periods_decoded.fetch_add(1, std::memory_order_relaxed);
+
+    if (rec_res == 1) { // Final result
+        stream.last_partial.clear();
+        deliver_result(stream, vosk_recognizer_result(stream.recognizer), decoder, result);
+    } else if (stream.on_partial) {
+        // Only forwarded when it changes
+        const char* partial_json = vosk_recognizer_partial_result(stream.recognizer);
+        if (decoder.decode(partial_json, result) && result.text != stream.last_partial) {
+            stream.last_partial.assign(result.text.data(), result.text.size());
+            stream.on_partial(stream.id, stream.last_partial);
+        }
+    }
+    return true;
+}
+
+void RecognizerPool::finish_stream(Stream& stream, RecognitionResultDecoder& decoder, RecognitionResult& result) {
+    if (stream.finished.exchange(true)) {
+        return;
+    }
+    stream.last_partial.clear();
+    if (stream.batch) {
+        stream.batch->finish();
+        while (const char* result_json = stream.batch->next_result()) {
+            deliver_result(stream, result_json, decoder, result);
+        }
+    } else {
+        deliver_result(stream, vosk_recognizer_final_result(stream.recognizer), decoder, result);
+    }
+    if (stream.on_end) {
+        stream.on_end(stream.id);
+    }
+}
+
+void RecognizerPool::deliver_result(Stream& stream, const char* result_json, RecognitionResultDecoder& decoder,
+                                    RecognitionResult& result) {
+    if (!decoder.decode(result_json, result)) {
+        VK_LOG_WARNING("Could not parse Vosk result JSON: " << result_json);
+        return;
+    }
+    std::string_view text = result.best_text();
+    if (!text.empty() && text != " " && stream.on_final) {
+        stream.text.assign(text.data(), text.size());
+        stream.on_final(stream.id, stream.text);
+    }
+}
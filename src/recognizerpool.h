@@ -0,0 +1,116 @@
+// recognizerpool.h
+// Header file for the RecognizerPool class.
+// Live recognition of several capture streams at once (e.g. two microphones, or the mic
+// plus a monitor/loopback source) on one shared model from the ModelCache. Each stream has
+// its own AudioSource, capture thread, ring and VoskRecognizer. The recognizers are driven
+// by a fixed set of worker threads, one per core and pinned to it; a new stream is handed
+// to the worker with the fewest streams and stays there, so its recognizer is only ever
+// touched by that one thread. Results are delivered tagged with the stream id.
+// With Options::gpu, streams are decoded by a shared GPU batch model instead (no partial
+// results); the pool falls back to CPU recognizers when no GPU can be used.
+
+#ifndef RECOGNIZER_POOL_H
+#define RECOGNIZER_POOL_H
+
+#include "audiosource.h"
+#include "recognitionresult.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct VoskModel;
+struct VoskBatchModel;
+
+class RecognizerPool {
+public:
+    using StreamId = unsigned; // 0 is never a valid id
+
+    // Called from the stream's worker thread (or from remove_stream()'s caller for the last result)
+    using ResultCallback = std::function<void(StreamId stream, const std::string& text)>;
+    // Called once after a stream's last result, from the same threads as ResultCallback
+    using EndCallback = std::function<void(StreamId stream)>;
+
+    struct Options {
+        unsigned workers = 0;    // Decode threads; 0 = hardware concurrency
+        bool pin_workers = true; // Pin worker i to the i-th CPU the process may run on
+        size_t ring_depth = 40;  // Periods queued per stream before its capture drops audio
+        bool gpu = false;        // Decode on the GPU (init() must then run on the main thread)
+    };
+
+    struct StreamStats {
+        unsigned worker;           // Worker the stream is assigned to
+        bool finished;             // Source ended and the final result was delivered
+        uint64_t periods_captured;
+        uint64_t periods_decoded;
+        uint64_t ring_overruns;    // Periods dropped because the worker fell behind
+        uint64_t source_overruns;  // Overruns reported by the audio source
+        double audio_seconds;      // Audio decoded so far
+    };
+
+    struct WorkerStats {
+        size_t streams;
+        uint64_t periods_decoded;
+        uint64_t busy_ns; // Time spent inside the recognizer
+    };
+
+    RecognizerPool();
+    ~RecognizerPool();
+
+    RecognizerPool(const RecognizerPool&) = delete;
+    RecognizerPool& operator=(const RecognizerPool&) = delete;
+
+    // Acquires the model and starts the worker threads
+    bool init(const std::string& model_path, const Options& options);
+    bool init(const std::string& model_path) { return init(model_path, Options()); }
+    // Removes every stream, stops the workers and releases the model
+    void shutdown();
+
+    // Opens a source for 'config' and starts recognizing it. Returns the stream id, or 0 on failure.
+    StreamId add_stream(const AudioSourceConfig& config, ResultCallback on_final,
+                        ResultCallback on_partial = ResultCallback(), EndCallback on_end = EndCallback());
+    // Stops the stream, decodes what it had queued and delivers its last result
+    void remove_stream(StreamId id);
+
+    size_t worker_count() const { return m_workers.size(); }
+    size_t stream_count() const;
+    std::vector<StreamId> stream_ids() const;
+    bool get_stream_stats(StreamId id, StreamStats& stats) const;
+    WorkerStats get_worker_stats(size_t worker) const;
+    unsigned model_sample_rate() const { return m_model_sample_rate; }
+    bool gpu_decoding() const { return m_batch_model != nullptr; }
+
+private:
+    struct Stream;
+    struct Worker;
+
+    // Reads periods from the stream's source into its ring (one thread per stream)
+    void capture_loop(Stream* stream);
+    // Round-robins over the worker's streams, one period per stream per pass
+    void worker_loop(Worker* worker);
+    // Decodes one queued period; false if the stream had none
+    bool decode_period(Stream& stream, RecognitionResultDecoder& decoder, RecognitionResult& result);
+    // Delivers the final result of a stream whose capture has ended
+    void finish_stream(Stream& stream, RecognitionResultDecoder& decoder, RecognitionResult& result);
+    void deliver_result(Stream& stream, const char* result_json, RecognitionResultDecoder& decoder,
+                        RecognitionResult& result);
+
+    Options m_options;
+    VoskModel* m_model;
+    VoskBatchModel* m_batch_model; // Set when streams decode on the GPU
+    unsigned m_model_sample_rate;
+    std::atomic<bool> m_running; // Workers run while set
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    mutable std::mutex m_mutex; // Guards m_streams and m_next_id
+    std::map<StreamId, std::unique_ptr<Stream>> m_streams;
+    StreamId m_next_id;
+};
+
+#endif // RECOGNIZER_POOL_H
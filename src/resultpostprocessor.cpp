@@ -0,0 +1,185 @@
+// resultpostprocessor.cpp
+// Implementation file for the ResultPostProcessor class.
+
+#include "resultpostprocessor.h"
+#include "logger.h"
+#include <vosk_api.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib> // For std::getenv, std::atof, std::atoi
+#include <fstream>
+#include <sstream>
+
+ResultPostProcessor::ResultPostProcessor()
+    : m_config { 0.5f, 3, 10.0f, std::string() },
+      m_speaker_filter(false),
+      m_words_dropped(0),
+      m_results_dropped(0),
+      m_alternatives_rescored(0),
+      m_results_ungated(0)
+{
+}
+
+void ResultPostProcessor::set_config(const Config& config) {
+    m_config = config;
+}
+
+void ResultPostProcessor::load_from_environment() {
+    if (const char* conf_env = std::getenv("VK_MIN_WORD_CONF")) {
+        m_config.min_word_conf = static_cast<float>(std::atof(conf_env));
+    }
+    if (const char* alternatives_env = std::getenv("VK_MAX_ALTERNATIVES")) {
+        m_config.max_alternatives = std::max(0, std::atoi(alternatives_env));
+    }
+    if (const char* vocabulary_env = std::getenv("VK_VOCABULARY")) {
+        m_config.vocabulary_path = vocabulary_env;
+    }
+    if (const char* bonus_env = std::getenv("VK_VOCABULARY_BONUS")) {
+        m_config.vocabulary_bonus = static_cast<float>(std::atof(bonus_env));
+    }
+}
+
+size_t ResultPostProcessor::load_vocabulary(VoskModel* model) {
+    m_vocabulary.clear();
+    if (m_config.vocabulary_path.empty()) {
+        return 0;
+    }
+    std::ifstream file(m_config.vocabulary_path);
+    if (!file) {
+        VK_LOG_ERROR("ResultPostProcessor: Cannot open vocabulary " << m_config.vocabulary_path);
+        return 0;
+    }
+    size_t unknown = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream words(line);
+        std::string word;
+        while (words >> word) {
+            std::transform(word.begin(), word.end(), word.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            // A word outside the model's lexicon can never be recognized, so it can't help rescoring
+            if (model && vosk_model_find_word(model, word.c_str()) < 0) {
+                unknown++;
+                VK_LOG_DEBUG("ResultPostProcessor: '" << word << "' is not in the model's vocabulary.");
+                continue;
+            }
+            m_vocabulary.push_back(word);
+        }
+    }
+    std::sort(m_vocabulary.begin(), m_vocabulary.end());
+    m_vocabulary.erase(std::unique(m_vocabulary.begin(), m_vocabulary.end()), m_vocabulary.end());
+    VK_LOG_INFO("ResultPostProcessor: " << m_vocabulary.size() << " vocabulary words"
+                << (unknown ? " (" + std::to_string(unknown) + " unknown to the model skipped)" : std::string()) << ".");
+    if (!m_vocabulary.empty() && m_config.max_alternatives > 0 && m_speaker_filter) {
+        VK_LOG_WARNING("ResultPostProcessor: Vocabulary rescoring is off while the speaker filter is on "
+                       "(alternatives carry no x-vector).");
+    } else if (alternatives_enabled() && m_config.min_word_conf > 0.0f) {
+        VK_LOG_WARNING("ResultPostProcessor: Word confidence gate is off while rescoring alternatives "
+                       "(Vosk reports no word confidences for them); set VK_MAX_ALTERNATIVES=0 to keep it.");
+    }
+    return m_vocabulary.size();
+}
+
+void ResultPostProcessor::set_speaker_filter(bool enabled) {
+    m_speaker_filter = enabled;
+}
+
+bool ResultPostProcessor::alternatives_enabled() const {
+    return !m_vocabulary.empty() && m_config.max_alternatives > 0 && !m_speaker_filter;
+}
+
+void ResultPostProcessor::configure(VoskRecognizer* recognizer) const {
+    if (!recognizer) {
+        return;
+    }
+    vosk_recognizer_set_words(recognizer, 1);
+    vosk_recognizer_set_max_alternatives(recognizer, alternatives_enabled() ? m_config.max_alternatives : 0);
+}
+
+bool ResultPostProcessor::in_vocabulary(std::string_view word) const {
+    auto it = std::lower_bound(m_vocabulary.begin(), m_vocabulary.end(), word,
+                               [](const std::string& entry, std::string_view value) { return entry < value; });
+    return it != m_vocabulary.end() && *it == word;
+}
+
+size_t ResultPostProcessor::pick_alternative(const RecognitionResult& result) {
+    size_t best = 0;
+    float best_score = 0.0f;
+    for (size_t i = 0; i < result.alternatives.size(); ++i) {
+        const RecognitionAlternative& alternative = result.alternatives[i];
+        size_t hits = 0;
+        for (size_t w = 0; w < alternative.word_count; ++w) {
+            if (in_vocabulary(result.alternative_words[alternative.first_word + w].word)) {
+                hits++;
+            }
+        }
+        float score = alternative.confidence + m_config.vocabulary_bonus * static_cast<float>(hits);
+        if (i == 0 || score > best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+    if (best != 0) {
+        m_alternatives_rescored.fetch_add(1, std::memory_order_relaxed);
+        VK_LOG_DEBUG("ResultPostProcessor: Alternative " << best << " ('" << result.alternatives[best].text
+                     << "') outscored '" << result.alternatives[0].text << "'.");
+    }
+    return best;
+}
+
+size_t ResultPostProcessor::append_confident_words(const RecognizedWord* words, size_t count, float min_conf,
+                                                   std::string& text, std::vector<RecognizedWord>* kept_words) {
+    size_t kept = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const RecognizedWord& word = words[i];
+        if (word.conf < min_conf || word.word == "[unk]") {
+            m_words_dropped.fetch_add(1, std::memory_order_relaxed);
+            VK_LOG_DEBUG("ResultPostProcessor: Dropped '" << word.word << "' (conf " << word.conf << ").");
+            continue;
+        }
+        if (!text.empty()) {
+            text += ' ';
+        }
+        text.append(word.word.data(), word.word.size());
+        if (kept_words) {
+            kept_words->push_back(word);
+        }
+        kept++;
+    }
+    return kept;
+}
+
+bool ResultPostProcessor::process(const RecognitionResult& result, std::string& text,
+                                  std::vector<RecognizedWord>* kept_words) {
+    text.clear();
+    if (kept_words) {
+        kept_words->clear();
+    }
+    if (!result.alternatives.empty()) {
+        // Alternatives have no word confidences (they would all read 1.0): don't pretend to gate
+        const RecognitionAlternative& alternative = result.alternatives[pick_alternative(result)];
+        if (alternative.word_count > 0) {
+            append_confident_words(&result.alternative_words[alternative.first_word], alternative.word_count, 0.0f,
+                                   text, kept_words);
+        } else {
+            text.assign(alternative.text.data(), alternative.text.size());
+        }
+        if (m_config.min_word_conf > 0.0f && !text.empty()) {
+            m_results_ungated.fetch_add(1, std::memory_order_relaxed);
+        }
+    } else if (!result.words.empty()) {
+        append_confident_words(result.words.data(), result.words.size(), m_config.min_word_conf, text, kept_words);
+    } else {
+        // No word results (e.g. the GPU batch recognizer): nothing to gate on
+        text.assign(result.text.data(), result.text.size());
+    }
+
+    if (text.empty() || text == " " || text == "[unk]") {
+        if (!result.best_text().empty()) {
+            m_results_dropped.fetch_add(1, std::memory_order_relaxed);
+            VK_LOG_INFO("ResultPostProcessor: Dropped low-confidence result '" << result.best_text() << "'.");
+        }
+        return false;
+    }
+    return true;
+}
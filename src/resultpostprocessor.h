@@ -0,0 +1,88 @@
+// resultpostprocessor.h
+// Header file for the ResultPostProcessor class.
+// Turns a decoded final dictation result into the text that gets typed. Words Vosk is
+// unsure about (word confidence below min_word_conf) are dropped, and a result with nothing
+// left is dropped as a whole: typing junk only to have the user backspace it out costs far
+// more than not typing it. With a domain vocabulary, the recognizer also reports n-best
+// alternatives and the one with the most vocabulary words (weighted against its lattice
+// confidence) wins.
+//
+// Vosk only reports per-word confidences (and the speaker x-vector) for the single best
+// result, not for alternatives, so alternatives are requested only when there is a
+// vocabulary to rescore them with, and never while the speaker filter needs x-vectors.
+// Rescored results can't be confidence gated: they are typed whole (only "[unk]" is
+// dropped) and counted in results_ungated().
+
+#ifndef RESULT_POST_PROCESSOR_H
+#define RESULT_POST_PROCESSOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "recognitionresult.h"
+
+struct VoskModel;
+struct VoskRecognizer;
+
+class ResultPostProcessor {
+public:
+    struct Config {
+        float min_word_conf;        // Words below this confidence are dropped (0 keeps everything)
+        int max_alternatives;       // N-best size requested when a vocabulary is loaded
+        float vocabulary_bonus;     // Added to an alternative's confidence per vocabulary word
+        std::string vocabulary_path; // One word (or phrase) per line; empty for none
+    };
+
+    ResultPostProcessor();
+
+    void set_config(const Config& config);
+    const Config& config() const { return m_config; }
+    // Reads VK_MIN_WORD_CONF, VK_MAX_ALTERNATIVES, VK_VOCABULARY and VK_VOCABULARY_BONUS
+    void load_from_environment();
+
+    // Reads the vocabulary file, keeping the words 'model' can recognize (vosk_model_find_word).
+    // Returns the number of words kept.
+    size_t load_vocabulary(VoskModel* model);
+    size_t vocabulary_size() const { return m_vocabulary.size(); }
+
+    // The speaker filter is on: results must carry an x-vector, so no alternatives.
+    // Call before load_vocabulary(), which logs what rescoring will do.
+    void set_speaker_filter(bool enabled);
+    // Alternatives are requested: there is a vocabulary and nothing rules them out
+    bool alternatives_enabled() const;
+
+    // Turns on word results (and alternatives, if enabled) on a dictation recognizer
+    void configure(VoskRecognizer* recognizer) const;
+
+    // Writes the text to type for 'result' into 'text' (reusing its capacity), and the words
+    // it was made of into 'kept_words' if given (empty when the result had no word list).
+    // Returns false if nothing worth typing is left.
+    bool process(const RecognitionResult& result, std::string& text,
+                 std::vector<RecognizedWord>* kept_words = nullptr);
+
+    uint64_t words_dropped() const { return m_words_dropped.load(std::memory_order_relaxed); }
+    uint64_t results_dropped() const { return m_results_dropped.load(std::memory_order_relaxed); }
+    uint64_t alternatives_rescored() const { return m_alternatives_rescored.load(std::memory_order_relaxed); }
+    // Results typed without the confidence gate because they came as alternatives
+    uint64_t results_ungated() const { return m_results_ungated.load(std::memory_order_relaxed); }
+
+private:
+    // Index of the alternative to use: highest confidence + vocabulary_bonus per vocabulary word
+    size_t pick_alternative(const RecognitionResult& result);
+    bool in_vocabulary(std::string_view word) const;
+    // Appends the words at or above 'min_conf' to 'text' (and 'kept_words'); returns how many were kept
+    size_t append_confident_words(const RecognizedWord* words, size_t count, float min_conf, std::string& text,
+                                  std::vector<RecognizedWord>* kept_words);
+
+    Config m_config;
+    bool m_speaker_filter;
+    std::vector<std::string> m_vocabulary; // Sorted, lower case; searched without allocating
+    std::atomic<uint64_t> m_words_dropped;
+    std::atomic<uint64_t> m_results_dropped;
+    std::atomic<uint64_t> m_alternatives_rescored;
+    std::atomic<uint64_t> m_results_ungated;
+};
+
+#endif // RESULT_POST_PROCESSOR_H
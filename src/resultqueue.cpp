@@ -0,0 +1,174 @@
+// resultqueue.cpp
+// Implementation file for the ResultQueue class.
+
+#include "resultqueue.h"
+#include "latencytracer.h"
+#include "runtimestats.h"
+#include "logger.h"
+#include <glibmm/main.h> // For Glib::signal_io, Glib::IOCondition
+#include <chrono>
+#include <cstdlib> // For std::getenv, std::strtol
+#include <thread>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+
+// How long a final result waits for room before it is dropped (the main loop is stuck)
+constexpr auto kFullQueueTimeout = std::chrono::milliseconds(500);
+
+size_t round_up_to_power_of_two(size_t value) {
+    size_t power = 2;
+    while (power < value) {
+        power <<= 1;
+    }
+    return power;
+}
+
+} // namespace
+
+ResultQueue::ResultQueue(size_t capacity)
+    : m_capacity(round_up_to_power_of_two(capacity)),
+      m_mask(m_capacity - 1),
+      m_cells(new Cell[m_capacity]),
+      m_enqueue_pos(0),
+      m_dequeue_pos(0),
+      m_signalled(false),
+      m_dropped(0),
+      m_event_fd(-1)
+{
+    for (size_t i = 0; i < m_capacity; ++i) {
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+ResultQueue::~ResultQueue() {
+    detach();
+}
+
+int ResultQueue::priority_from_environment() {
+    if (const char* priority_env = std::getenv("VK_RESULT_PRIORITY")) {
+        char* end = nullptr;
+        long priority = std::strtol(priority_env, &end, 10);
+        if (end != priority_env) {
+            return static_cast<int>(priority);
+        }
+    }
+    return Glib::PRIORITY_DEFAULT; // Ahead of redraws and idle handlers
+}
+
+bool ResultQueue::attach(std::function<void()> on_ready, int priority) {
+    detach();
+    m_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_event_fd < 0) {
+        VK_LOG_ERROR("ResultQueue: eventfd() failed.");
+        return false;
+    }
+    m_on_ready = std::move(on_ready);
+    m_consumer_thread = std::this_thread::get_id();
+    m_io_connection = Glib::signal_io().connect([this](Glib::IOCondition) { return on_io(); },
+                                                m_event_fd, Glib::IO_IN, priority);
+    return true;
+}
+
+void ResultQueue::detach() {
+    m_io_connection.disconnect();
+    if (m_event_fd >= 0) {
+        close(m_event_fd);
+        m_event_fd = -1;
+    }
+}
+
+bool ResultQueue::try_push(Kind kind, const std::string& text, uint64_t origin_ns, uint64_t posted_ns) {
+    // Bounded MPSC ring: a producer claims a position with a CAS, fills the cell and then
+    // publishes it through the cell's sequence number
+    size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &m_cells[pos & m_mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false; // Full: the consumer hasn't released this cell yet
+        } else {
+            pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    cell->entry.kind = kind;
+    cell->entry.text.assign(text); // Reuses the cell's capacity
+    cell->entry.origin_ns = origin_ns;
+    cell->entry.posted_ns = posted_ns;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool ResultQueue::push(Kind kind, const std::string& text, uint64_t origin_ns) {
+    uint64_t posted_ns = LatencyTracer::enabled() ? LatencyTracer::now_ns() : 0;
+    bool queued = try_push(kind, text, origin_ns, posted_ns);
+    if (!queued && kind != Kind::Partial && std::this_thread::get_id() != m_consumer_thread) {
+        // Waiting on the consumer from its own thread would never end
+        auto deadline = std::chrono::steady_clock::now() + kFullQueueTimeout;
+        while (!queued && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            queued = try_push(kind, text, origin_ns, posted_ns);
+        }
+    }
+    if (!queued) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        if (kind != Kind::Partial) {
+            VK_LOG_WARNING("ResultQueue: Main loop is not draining results; dropped '" << text << "'.");
+        }
+        return false;
+    }
+
+    // One eventfd write per dispatch is enough; the dispatch drains everything
+    if (m_event_fd >= 0 && !m_signalled.exchange(true, std::memory_order_acq_rel)) {
+        uint64_t one = 1;
+        if (write(m_event_fd, &one, sizeof(one)) != static_cast<ssize_t>(sizeof(one))) {
+            VK_LOG_WARNING("ResultQueue: eventfd write failed.");
+        }
+    }
+    return true;
+}
+
+size_t ResultQueue::drain(const std::function<void(const Entry&)>& handler) {
+    // Backlog this dispatch found (claimed positions; one may not be published yet)
+    RuntimeStats::instance().queue_depth.store(m_enqueue_pos.load(std::memory_order_relaxed) - m_dequeue_pos,
+                                               std::memory_order_relaxed);
+    size_t count = 0;
+    while (true) {
+        Cell& cell = m_cells[m_dequeue_pos & m_mask];
+        if (cell.sequence.load(std::memory_order_acquire) != m_dequeue_pos + 1) {
+            break; // Empty (or the next producer hasn't published yet; its eventfd write follows)
+        }
+        bool stale = false;
+        if (cell.entry.kind == Kind::Partial) {
+            const Cell& next = m_cells[(m_dequeue_pos + 1) & m_mask];
+            stale = next.sequence.load(std::memory_order_acquire) == m_dequeue_pos + 2 &&
+                    next.entry.kind == Kind::Partial;
+        }
+        if (!stale) {
+            handler(cell.entry);
+            count++;
+        }
+        cell.sequence.store(m_dequeue_pos + m_capacity, std::memory_order_release);
+        m_dequeue_pos++;
+    }
+    return count;
+}
+
+bool ResultQueue::on_io() {
+    uint64_t value;
+    while (read(m_event_fd, &value, sizeof(value)) == static_cast<ssize_t>(sizeof(value))) {
+    }
+    // Cleared before draining: a push that lands after this writes the eventfd again
+    m_signalled.store(false, std::memory_order_release);
+    if (m_on_ready) {
+        m_on_ready();
+    }
+    return true; // Keep watching
+}
@@ -0,0 +1,87 @@
+// resultqueue.h
+// Header file for the ResultQueue class.
+// Hands recognition results (finals, partials, commands) from the decoder thread to the GTK
+// main loop. Producers copy the text into a preallocated slot of a bounded lock-free MPSC
+// ring and kick an eventfd; the main loop watches the eventfd through Glib::signal_io and
+// one dispatch drains everything queued, so a burst of results costs one wakeup instead of
+// one idle source per result. Slots keep their string capacity, so once warmed up pushing
+// doesn't allocate.
+
+#ifndef RESULT_QUEUE_H
+#define RESULT_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <sigc++/sigc++.h> // For sigc::connection
+
+class ResultQueue {
+public:
+    enum class Kind {
+        Final,   // Dictation transcript
+        Partial, // Live preview hypothesis
+        Command  // Phrase recognized in command mode
+    };
+
+    struct Entry {
+        Kind kind = Kind::Final;
+        std::string text;
+        uint64_t origin_ns = 0; // Capture timestamp of the audio it came from (latency tracing)
+        uint64_t posted_ns = 0; // When it was pushed (0 when tracing is off)
+    };
+
+    // capacity is rounded up to a power of two
+    explicit ResultQueue(size_t capacity = 64);
+    ~ResultQueue();
+
+    ResultQueue(const ResultQueue&) = delete;
+    ResultQueue& operator=(const ResultQueue&) = delete;
+
+    // Watches the eventfd from the default main context at 'priority' (Glib::PRIORITY_*;
+    // lower runs first) and calls on_ready on the main thread whenever results are queued.
+    // on_ready is expected to call drain(). Returns false if the eventfd can't be created.
+    bool attach(std::function<void()> on_ready, int priority);
+    void detach();
+
+    // Any thread. A full queue drops a partial (the next one supersedes it anyway) and makes
+    // finals and commands wait for the main loop to catch up. Returns false if it was dropped.
+    bool push(Kind kind, const std::string& text, uint64_t origin_ns);
+
+    // Main thread only: calls 'handler' for every queued entry in order and returns the count.
+    // A partial directly followed by another queued partial is skipped as stale.
+    size_t drain(const std::function<void(const Entry&)>& handler);
+
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    // Priority from VK_RESULT_PRIORITY (a number, as Glib::PRIORITY_*), default Glib::PRIORITY_DEFAULT
+    static int priority_from_environment();
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        Entry entry;
+    };
+
+    bool try_push(Kind kind, const std::string& text, uint64_t origin_ns, uint64_t posted_ns);
+    // eventfd readable: clears it and runs m_on_ready
+    bool on_io();
+
+    size_t m_capacity;
+    size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+    alignas(64) std::atomic<size_t> m_enqueue_pos; // Shared by producers
+    alignas(64) size_t m_dequeue_pos;              // Consumer (main thread) only
+    std::atomic<bool> m_signalled; // eventfd written since the last dispatch
+    std::atomic<uint64_t> m_dropped;
+
+    int m_event_fd;
+    std::function<void()> m_on_ready;
+    std::thread::id m_consumer_thread; // Thread that attach()ed, i.e. the main loop
+    sigc::connection m_io_connection;
+};
+
+#endif // RESULT_QUEUE_H
@@ -0,0 +1,73 @@
+// runtimestats.cpp
+// Implementation of the RuntimeStats struct.
+
+#include "runtimestats.h"
+#include "nlohmann/json.hpp"
+
+RuntimeStats& RuntimeStats::instance() {
+    static RuntimeStats stats;
+    return stats;
+}
+
+void RuntimeStats::record_injection(uint64_t latency_ns) {
+    injections.fetch_add(1, std::memory_order_relaxed);
+    injection_ns_total.fetch_add(latency_ns, std::memory_order_relaxed);
+    injection_ns_last.store(latency_ns, std::memory_order_relaxed);
+    // Single worker thread in practice, but stay correct if there are more
+    uint64_t max = injection_ns_max.load(std::memory_order_relaxed);
+    while (latency_ns > max && !injection_ns_max.compare_exchange_weak(max, latency_ns, std::memory_order_relaxed)) {
+    }
+}
+
+RuntimeStats::Snapshot RuntimeStats::snapshot() const {
+    Snapshot s;
+    s.frames_captured = frames_captured.load(std::memory_order_relaxed);
+    s.capture_overruns = capture_overruns.load(std::memory_order_relaxed);
+    s.frames_decoded = frames_decoded.load(std::memory_order_relaxed);
+    s.decode_ns = decode_ns.load(std::memory_order_relaxed);
+    s.decoded_audio_ns = decoded_audio_ns.load(std::memory_order_relaxed);
+    s.ring_depth = ring_depth.load(std::memory_order_relaxed);
+    s.chunk_ms = chunk_ms.load(std::memory_order_relaxed);
+    s.results_emitted = results_emitted.load(std::memory_order_relaxed);
+    s.queue_depth = queue_depth.load(std::memory_order_relaxed);
+    s.keystrokes_sent = keystrokes_sent.load(std::memory_order_relaxed);
+    s.injections = injections.load(std::memory_order_relaxed);
+    s.injection_ns_total = injection_ns_total.load(std::memory_order_relaxed);
+    s.injection_ns_last = injection_ns_last.load(std::memory_order_relaxed);
+    s.injection_ns_max = injection_ns_max.load(std::memory_order_relaxed);
+    return s;
+}
+
+double RuntimeStats::Snapshot::decode_rtf(const Snapshot& since) const {
+    if (decoded_audio_ns <= since.decoded_audio_ns) {
+        return 0.0;
+    }
+    return static_cast<double>(decode_ns - since.decode_ns) / static_cast<double>(decoded_audio_ns - since.decoded_audio_ns);
+}
+
+double RuntimeStats::Snapshot::decode_rtf() const {
+    return decoded_audio_ns > 0 ? static_cast<double>(decode_ns) / static_cast<double>(decoded_audio_ns) : 0.0;
+}
+
+double RuntimeStats::Snapshot::injection_mean_ms() const {
+    return injections > 0 ? static_cast<double>(injection_ns_total) / injections / 1e6 : 0.0;
+}
+
+std::string RuntimeStats::Snapshot::to_json() const {
+    nlohmann::json json = {
+        { "frames_captured", frames_captured },
+        { "capture_overruns", capture_overruns },
+        { "frames_decoded", frames_decoded },
+        { "decode_rtf", decode_rtf() },
+        { "ring_depth", ring_depth },
+        { "chunk_ms", chunk_ms },
+        { "results_emitted", results_emitted },
+        { "queue_depth", queue_depth },
+        { "keystrokes_sent", keystrokes_sent },
+        { "injections", injections },
+        { "injection_ms_mean", injection_mean_ms() },
+        { "injection_ms_last", injection_ns_last / 1e6 },
+        { "injection_ms_max", injection_ns_max / 1e6 }
+    };
+    return json.dump();
+}
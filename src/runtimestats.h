@@ -0,0 +1,72 @@
+// runtimestats.h
+// Header file for the RuntimeStats struct.
+// Always-on, process-wide counters for the path from the microphone to the last key event,
+// shared by the capture, decoder, main and injection threads and read by the stats overlay
+// and the control socket. Every field is a relaxed atomic; the fields each stage writes sit
+// on their own cache line, so the capture and decoder threads never bounce a line between
+// them. SpeechToTextService::CaptureStats stays per service instance, for the benchmarks.
+
+#ifndef RUNTIME_STATS_H
+#define RUNTIME_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+struct RuntimeStats {
+    static RuntimeStats& instance();
+
+    // Capture thread
+    alignas(64) std::atomic<uint64_t> frames_captured{0}; // Model-rate frames queued for decoding
+    std::atomic<uint64_t> capture_overruns{0};            // Periods lost: ring full or source overrun
+
+    // Decoder thread
+    alignas(64) std::atomic<uint64_t> frames_decoded{0};  // Frames handed to the recognizer
+    std::atomic<uint64_t> decode_ns{0};                   // Time spent decoding them
+    std::atomic<uint64_t> decoded_audio_ns{0};            // ... and the audio time they cover
+    std::atomic<uint64_t> ring_depth{0};                  // Periods left in the capture ring after the last chunk
+    std::atomic<uint64_t> chunk_ms{0};                    // Size of the last decoded chunk
+    std::atomic<uint64_t> results_emitted{0};             // Finals and commands that passed every filter
+
+    // Result queue: pushed by the decoder thread, drained by the main loop
+    alignas(64) std::atomic<uint64_t> queue_depth{0};     // Results the last main-loop dispatch found waiting
+
+    // Key injection (worker thread, main thread for on-screen keys)
+    alignas(64) std::atomic<uint64_t> keystrokes_sent{0}; // Key presses flushed to the X server
+    std::atomic<uint64_t> injections{0};                  // Transcript jobs typed to the end
+    std::atomic<uint64_t> injection_ns_total{0};          // Submitted -> last key event flushed, summed
+    std::atomic<uint64_t> injection_ns_last{0};
+    std::atomic<uint64_t> injection_ns_max{0};
+
+    // One finished injection job (worker thread)
+    void record_injection(uint64_t latency_ns);
+
+    // Plain copy of the counters, with the derived figures the readers show
+    struct Snapshot {
+        uint64_t frames_captured;
+        uint64_t capture_overruns;
+        uint64_t frames_decoded;
+        uint64_t decode_ns;
+        uint64_t decoded_audio_ns;
+        uint64_t ring_depth;
+        uint64_t chunk_ms;
+        uint64_t results_emitted;
+        uint64_t queue_depth;
+        uint64_t keystrokes_sent;
+        uint64_t injections;
+        uint64_t injection_ns_total;
+        uint64_t injection_ns_last;
+        uint64_t injection_ns_max;
+
+        // Decode time / audio time since 'since' (1.0 = decoding only just keeps up), 0 without audio
+        double decode_rtf(const Snapshot& since) const;
+        double decode_rtf() const;
+        // Mean submitted -> typed latency in milliseconds, 0 before the first job
+        double injection_mean_ms() const;
+        // One JSON object with every counter and the derived figures
+        std::string to_json() const;
+    };
+    Snapshot snapshot() const;
+};
+
+#endif // RUNTIME_STATS_H
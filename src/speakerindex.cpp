@@ -0,0 +1,183 @@
+// speakerindex.cpp
+// Implementation file for the SpeakerIndex class and SpeakerFilterConfig.
+
+#include "speakerindex.h"
+#include "logger.h"
+#include <cctype>  // For std::isspace
+#include <cmath>
+#include <cstdlib> // For std::getenv, std::atof
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+SpeakerFilterConfig::SpeakerFilterConfig()
+    : threshold(0.5f)
+{
+}
+
+void SpeakerFilterConfig::load_from_environment() {
+    if (const char* model_env = std::getenv("VK_SPEAKER_MODEL")) {
+        model_path = model_env;
+    }
+    if (const char* profiles_env = std::getenv("VK_SPEAKER_PROFILES")) {
+        profiles_path = profiles_env;
+    }
+    if (const char* enroll_env = std::getenv("VK_SPEAKER_ENROLL")) {
+        enroll_name = enroll_env;
+        for (char& c : enroll_name) {
+            if (std::isspace(static_cast<unsigned char>(c))) {
+                c = '_'; // Names are whitespace-separated fields in the profiles file
+            }
+        }
+    }
+    if (const char* threshold_env = std::getenv("VK_SPEAKER_THRESHOLD")) {
+        threshold = static_cast<float>(std::atof(threshold_env));
+    }
+}
+
+SpeakerIndex::SpeakerIndex()
+    : m_dimensions(0)
+{
+}
+
+void SpeakerIndex::clear() {
+    m_dimensions = 0;
+    m_names.clear();
+    m_counts.clear();
+    m_sums.clear();
+    m_centroids.clear();
+}
+
+bool SpeakerIndex::enroll(const std::string& name, const std::vector<float>& xvector) {
+    if (xvector.empty() || (m_dimensions != 0 && xvector.size() != m_dimensions)) {
+        VK_LOG_WARNING("SpeakerIndex: Cannot enroll an x-vector of " << xvector.size()
+                       << " components (profiles have " << m_dimensions << ").");
+        return false;
+    }
+    m_dimensions = xvector.size();
+
+    size_t profile = 0;
+    while (profile < m_names.size() && m_names[profile] != name) {
+        profile++;
+    }
+    if (profile == m_names.size()) {
+        m_names.push_back(name);
+        m_counts.push_back(0);
+        m_sums.resize(m_sums.size() + m_dimensions, 0.0f);
+        m_centroids.resize(m_centroids.size() + m_dimensions, 0.0f);
+    }
+
+    float* sum = &m_sums[profile * m_dimensions];
+    for (size_t i = 0; i < m_dimensions; ++i) {
+        sum[i] += xvector[i];
+    }
+    m_counts[profile]++;
+    update_centroid(profile);
+    return true;
+}
+
+void SpeakerIndex::update_centroid(size_t profile) {
+    const float* sum = &m_sums[profile * m_dimensions];
+    float* centroid = &m_centroids[profile * m_dimensions];
+    double norm = 0.0;
+    for (size_t i = 0; i < m_dimensions; ++i) {
+        norm += static_cast<double>(sum[i]) * sum[i];
+    }
+    float scale = norm > 0.0 ? static_cast<float>(1.0 / std::sqrt(norm)) : 0.0f;
+    for (size_t i = 0; i < m_dimensions; ++i) {
+        centroid[i] = sum[i] * scale;
+    }
+}
+
+SpeakerIndex::Match SpeakerIndex::best_match(const std::vector<float>& xvector) const {
+    Match best { -1, -1.0f };
+    if (m_names.empty() || xvector.size() != m_dimensions) {
+        return best;
+    }
+    double norm = 0.0;
+    for (float component : xvector) {
+        norm += static_cast<double>(component) * component;
+    }
+    if (norm <= 0.0) {
+        return best;
+    }
+    float scale = static_cast<float>(1.0 / std::sqrt(norm));
+
+    // Centroids are unit length, so the cosine similarity is a dot product
+    for (size_t profile = 0; profile < m_names.size(); ++profile) {
+        const float* centroid = &m_centroids[profile * m_dimensions];
+        float dot = 0.0f;
+        for (size_t i = 0; i < m_dimensions; ++i) {
+            dot += centroid[i] * xvector[i];
+        }
+        float similarity = dot * scale;
+        if (similarity > best.similarity) {
+            best = Match { static_cast<int>(profile), similarity };
+        }
+    }
+    return best;
+}
+
+bool SpeakerIndex::load_file(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    SpeakerIndex loaded;
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        std::istringstream fields(line);
+        std::string name;
+        uint32_t count = 0;
+        if (!(fields >> name) || name[0] == '#') {
+            continue; // Blank line or comment
+        }
+        for (const std::string& existing : loaded.m_names) {
+            if (existing == name) {
+                VK_LOG_ERROR("SpeakerIndex: " << path << ":" << line_number << ": duplicate speaker " << name << ".");
+                return false;
+            }
+        }
+        std::vector<float> mean;
+        float component;
+        if (!(fields >> count) || count == 0) {
+            VK_LOG_ERROR("SpeakerIndex: " << path << ":" << line_number << ": missing utterance count.");
+            return false;
+        }
+        while (fields >> component) {
+            mean.push_back(component);
+        }
+        if (mean.empty() || (loaded.m_dimensions != 0 && mean.size() != loaded.m_dimensions)) {
+            VK_LOG_ERROR("SpeakerIndex: " << path << ":" << line_number << ": bad x-vector.");
+            return false;
+        }
+        // Stored as the mean; enrolling more utterances continues from the sum
+        for (float& value : mean) {
+            value *= static_cast<float>(count);
+        }
+        loaded.enroll(name, mean);
+        loaded.m_counts.back() = count;
+    }
+    *this = std::move(loaded);
+    VK_LOG_INFO("SpeakerIndex: Loaded " << size() << " speaker profile(s) from " << path << ".");
+    return true;
+}
+
+bool SpeakerIndex::save_file(const std::string& path) const {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        VK_LOG_ERROR("SpeakerIndex: Cannot write " << path);
+        return false;
+    }
+    for (size_t profile = 0; profile < m_names.size(); ++profile) {
+        file << m_names[profile] << ' ' << m_counts[profile];
+        const float* sum = &m_sums[profile * m_dimensions];
+        for (size_t i = 0; i < m_dimensions; ++i) {
+            file << ' ' << sum[i] / static_cast<float>(m_counts[profile]);
+        }
+        file << '\n';
+    }
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,73 @@
+// speakerindex.h
+// Header file for the SpeakerIndex class and SpeakerFilterConfig.
+// On a shared terminal, only the people enrolled on it should be able to type by voice.
+// With a speaker model, Vosk attaches an x-vector ("spk") to each final result; the index
+// holds one unit-length centroid per enrolled speaker in a contiguous array and matches a
+// result's x-vector by cosine similarity, so results from anyone else (or a TV in the
+// background) can be dropped before they are typed.
+//
+// Profiles file: one speaker per line, "<name> <utterances> <x-vector components...>",
+// the components being the mean of the speaker's enrolled x-vectors.
+
+#ifndef SPEAKER_INDEX_H
+#define SPEAKER_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Settings for dropping dictation from speakers that aren't enrolled
+struct SpeakerFilterConfig {
+    std::string model_path;    // Speaker model directory (vosk-model-spk); empty disables the filter
+    std::string profiles_path; // Enrolled profiles, read at init and rewritten after enrolling
+    std::string enroll_name;   // When set, every utterance is enrolled as this speaker and passes
+    float threshold;           // Minimum cosine similarity to a profile for a result to pass
+
+    SpeakerFilterConfig();
+
+    // VK_SPEAKER_MODEL, VK_SPEAKER_PROFILES, VK_SPEAKER_ENROLL and VK_SPEAKER_THRESHOLD
+    void load_from_environment();
+
+    bool enabled() const { return !model_path.empty(); }
+};
+
+class SpeakerIndex {
+public:
+    struct Match {
+        int profile;      // Index of the closest profile, -1 if there are none
+        float similarity; // Cosine similarity to it
+    };
+
+    SpeakerIndex();
+
+    // Adds an x-vector to the named profile, creating it if needed. Returns false if the
+    // vector is empty or its length doesn't match the enrolled profiles.
+    bool enroll(const std::string& name, const std::vector<float>& xvector);
+
+    // Closest enrolled profile to 'xvector'
+    Match best_match(const std::vector<float>& xvector) const;
+
+    size_t size() const { return m_names.size(); }
+    bool empty() const { return m_names.empty(); }
+    const std::string& name(size_t profile) const { return m_names[profile]; }
+    size_t dimensions() const { return m_dimensions; }
+
+    void clear();
+
+    // Replaces the profiles with those in 'path'. Returns false if it can't be read or is malformed.
+    bool load_file(const std::string& path);
+    bool save_file(const std::string& path) const;
+
+private:
+    // Recomputes the unit-length centroid of 'profile' from its running sum
+    void update_centroid(size_t profile);
+
+    size_t m_dimensions; // x-vector length, fixed by the first profile
+    std::vector<std::string> m_names;
+    std::vector<uint32_t> m_counts; // Enrolled utterances per profile
+    std::vector<float> m_sums;      // size() x m_dimensions running sums of enrolled x-vectors
+    std::vector<float> m_centroids; // size() x m_dimensions unit-length means, scanned by best_match()
+};
+
+#endif // SPEAKER_INDEX_H
@@ -1,21 +1,22 @@
 // speechtotextservice.cpp
 // Implementation file for the SpeechToTextService class.
 // This class manages speech-to-text functionality using the Vosk C++ API.
-// It captures audio directly using ALSA and feeds it to Vosk for transcription.
+// It captures audio from an AudioSource (ALSA by default) and feeds it to Vosk for transcription.
 
 #include "speechtotextservice.h"
-#include <iostream>
+#include "modelcache.h"
+#include "latencytracer.h"
+#include "runtimestats.h"
+#include "logger.h"
 #include <vector>
 #include <stdexcept> // For std::runtime_error
 #include <numeric>   // For std::accumulate (used for simple audio check)
 #include <algorithm> // For std::all_of (used for simple audio check)
 #include <cmath>     // For std::abs (used for simple audio check)
+#include <chrono>
 // Removed <queue> and <json-c/json.h> as they are not needed for offline-only
 // Removed nlohmann/json as it's not needed for offline-only
 
-// Include ALSA header for audio capture
-#include <alsa/asoundlib.h>
-
 // Include Vosk API header
 #include <vosk_api.h>
 
@@ -28,257 +29,1049 @@
 
 SpeechToTextService::SpeechToTextService(TranscribedTextCallback callback)
     : m_transcribed_text_callback(callback),
+      m_partial_forwarded(false),
       m_model(nullptr),
       m_recognizer(nullptr),
-      m_alsa_handle(nullptr),
+      m_command_recognizer(nullptr),
+      m_decoder_backend(DecoderBackend::Cpu),
+      m_batch_model(nullptr),
+      m_speaker_model(nullptr),
+      m_results_rejected_speaker(0),
+      m_command_mode(false),
+      m_decoding_commands(false),
+      m_grammar_changed(false),
+      m_model_ready(false),
+      m_model_sample_rate(16000),
       m_listening(false),
-      m_should_run_audio_thread(false)
+      m_live_preview(false),
+      m_should_run_audio_thread(false),
+      m_capture_active(false),
+      m_hot_standby(false),
+      m_audio_threads_running(false),
+      m_capture_requested(false),
+      m_capture_parked(false),
+      m_decoder_parked(false),
+      m_ring_depth(40), // 40 x 20ms periods = 800ms of slack for the decoder
+      m_period_frames(320),
+      m_chunk_fill(0),
+      m_chunk_periods(0),
+      m_chunk_first_ns(0),
+      m_chunk_last_ns(0),
+      m_chunk_ms(0),
+      m_decode_load(0.0f),
+      m_chunk_adjustments(0),
+      m_periods_captured(0),
+      m_periods_decoded(0),
+      m_ring_overruns(0),
+      m_ring_underruns(0),
+      m_alsa_xruns(0),
+      m_frames_gated(0),
+      m_frames_decoded(0),
+      m_vad_enabled(false),
+      m_vad_config(m_vad.config()),
+      m_chunk_config(m_chunk_policy.config()),
+      m_tuning_changed(false),
+      m_stream_sample_rate(16000),
+      m_last_period_ns(0)
 {
-    std::cout << "SpeechToTextService: Constructor called." << std::endl;
+    VK_LOG_INFO("SpeechToTextService: Constructor called.");
 }
 
 SpeechToTextService::~SpeechToTextService() {
-    std::cout << "SpeechToTextService: Destructor called." << std::endl;
+    VK_LOG_INFO("SpeechToTextService: Destructor called.");
+    // A background model load can't be cancelled; wait for it before tearing down
+    if (m_init_thread.joinable()) {
+        m_init_thread.join();
+    }
     stop_listening(); // Ensure all threads are stopped and resources are freed
+    shutdown_audio_threads(); // Threads parked in hot standby
     
     // Clean up Vosk resources
     if (m_recognizer) {
         vosk_recognizer_free(m_recognizer);
         m_recognizer = nullptr;
     }
+    if (m_command_recognizer) {
+        vosk_recognizer_free(m_command_recognizer);
+        m_command_recognizer = nullptr;
+    }
+    m_batch_recognizer.close();
+    if (m_batch_model) {
+        ModelCache::instance().release(m_batch_model);
+        m_batch_model = nullptr;
+    }
+    if (m_speaker_model) {
+        ModelCache::instance().release(m_speaker_model);
+        m_speaker_model = nullptr;
+    }
     if (m_model) {
-        vosk_model_free(m_model);
+        ModelCache::instance().release(m_model); // Shared models stay loaded for other users
         m_model = nullptr;
     }
-    std::cout << "SpeechToTextService: Vosk resources freed." << std::endl;
+    VK_LOG_INFO("SpeechToTextService: Vosk resources freed.");
 }
 
 bool SpeechToTextService::init(const std::string& model_path) {
     if (!std::filesystem::exists(model_path)) {
-        std::cerr << "ERROR: Vosk model path does not exist: " << model_path << std::endl;
+        VK_LOG_ERROR("Vosk model path does not exist: " << model_path);
+        return false;
+    }
+
+    if (m_listening) {
+        VK_LOG_ERROR("Cannot change the Vosk model while listening.");
         return false;
     }
 
     vosk_set_log_level(-1); // Disable Vosk logging to console
 
-    m_model = vosk_model_new(model_path.c_str());
-    if (!m_model) {
-        std::cerr << "ERROR: Failed to create Vosk model from path: " << model_path << std::endl;
+    // Shared through the cache: a model another recognizer already uses is not loaded again
+    VoskModel* model = ModelCache::instance().acquire(model_path);
+    if (!model) {
+        VK_LOG_ERROR("Failed to create Vosk model from path: " << model_path);
         return false;
     }
-    std::cout << "SpeechToTextService: Vosk model loaded successfully." << std::endl;
+
+    m_model_ready = false;
+    shutdown_audio_threads(); // Standby threads hold the old recognizer
+    if (m_recognizer) {
+        vosk_recognizer_free(m_recognizer); // Belongs to the previous model
+        m_recognizer = nullptr;
+    }
+    if (m_command_recognizer) {
+        vosk_recognizer_free(m_command_recognizer);
+        m_command_recognizer = nullptr;
+        m_grammar_changed = true; // Rebuilt on the new model when listening starts
+    }
+    if (m_model) {
+        ModelCache::instance().release(m_model);
+    }
+    m_model = model;
+    m_model_sample_rate = ModelCache::model_sample_rate(model_path);
+    // Alternatives carry no x-vector, so the speaker filter rules them out
+    m_post_processor.set_speaker_filter(m_speaker_config.enabled());
+    m_post_processor.load_vocabulary(m_model); // Checked against this model's lexicon
+
+    m_batch_recognizer.close(); // Belongs to the previous batch model
+    if (m_batch_model) {
+        ModelCache::instance().release(m_batch_model);
+        m_batch_model = nullptr;
+    }
+    if (m_speaker_model) {
+        ModelCache::instance().release(m_speaker_model);
+        m_speaker_model = nullptr;
+    }
+    if (m_speaker_config.enabled()) {
+        m_speaker_model = ModelCache::instance().acquire_speaker(m_speaker_config.model_path);
+        if (!m_speaker_model) {
+            VK_LOG_ERROR("SpeechToTextService: Speaker model failed to load; dictation is disabled.");
+        }
+        // A missing profiles file is fine when enrolling: it is created by the first utterance
+        m_speakers.clear();
+        if (!m_speaker_config.profiles_path.empty() && !m_speakers.load_file(m_speaker_config.profiles_path) &&
+            m_speaker_config.enroll_name.empty()) {
+            VK_LOG_WARNING("SpeechToTextService: Cannot read speaker profiles " << m_speaker_config.profiles_path);
+        }
+        if (m_speaker_model && m_speaker_config.enroll_name.empty() && m_speakers.empty()) {
+            VK_LOG_WARNING("SpeechToTextService: No enrolled speakers; every result will be dropped "
+                           "(set VK_SPEAKER_ENROLL=<name> to enroll).");
+        }
+    }
+
+    if (m_decoder_backend == DecoderBackend::Gpu && m_speaker_config.enabled()) {
+        VK_LOG_WARNING("SpeechToTextService: GPU results carry no speaker x-vectors, decoding on the CPU.");
+    } else if (m_decoder_backend == DecoderBackend::Gpu) {
+        m_batch_model = ModelCache::instance().acquire_batch(model_path);
+        if (!m_batch_model) {
+            VK_LOG_WARNING("SpeechToTextService: No GPU available, decoding on the CPU.");
+        }
+    }
+    m_model_ready = true;
+    VK_LOG_INFO("SpeechToTextService: Vosk model loaded successfully (" << m_model_sample_rate << " Hz"
+             << (m_batch_model ? ", GPU dictation" : "") << ").");
 
     // Recognizer is created when listening starts, as it's tied to audio format.
     return true;
 }
 
+void SpeechToTextService::init_async(const std::string& model_path, std::function<void(bool)> on_done) {
+    if (m_init_thread.joinable()) {
+        m_init_thread.join(); // Only one load at a time
+    }
+    m_init_thread = std::thread([this, model_path, on_done]() {
+        bool ok = init(model_path);
+        if (on_done) {
+            on_done(ok);
+        }
+    });
+}
+
+bool SpeechToTextService::is_ready() const {
+    return m_model_ready;
+}
+
+unsigned SpeechToTextService::model_sample_rate() const {
+    return m_model_sample_rate;
+}
+
 bool SpeechToTextService::start_listening() {
     if (m_listening) {
-        std::cout << "SpeechToTextService: Already listening." << std::endl;
+        VK_LOG_INFO("SpeechToTextService: Already listening.");
+        return true;
+    }
+
+    if (!m_model_ready) {
+        VK_LOG_ERROR("Vosk model is not loaded yet. Cannot start listening.");
+        return false;
+    }
+
+    // Warm start: PCM device and recognizer are still set up, only the parked threads need waking
+    if (m_audio_threads_running) {
+        auto wake_start = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(m_state_mutex);
+            m_last_partial_text.clear();
+            m_vad.reset(m_period_frames, m_model_sample_rate); // Decoder is parked, safe to touch its state
+            m_converter.reset(); // Capture is parked too; don't filter across the gap
+            m_listening = true;
+            m_capture_requested = true;
+        }
+        m_state_cv.notify_all();
+        auto wake_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - wake_start).count();
+        VK_LOG_INFO("SpeechToTextService: Listening resumed from hot standby (" << wake_us << " us).");
         return true;
     }
 
-    std::cout << "SpeechToTextService: Starting listening..." << std::endl;
+    VK_LOG_INFO("SpeechToTextService: Starting listening...");
 
-    // Initialize ALSA capture
-    if (!open_alsa_capture()) {
-        std::cerr << "ERROR: Failed to open ALSA capture. Cannot start listening." << std::endl;
+    // Open the capture device
+    if (!open_audio_source()) {
+        VK_LOG_ERROR("Failed to open audio capture (" << m_source_config.backend << "). Cannot start listening.");
         return false;
     }
 
-    // Create Vosk recognizer (needs to be done after ALSA setup to get sample rate)
+    // Create Vosk recognizer at the rate it will actually be fed (the converter's output)
     if (m_recognizer) {
         vosk_recognizer_free(m_recognizer); // Free old one if exists
     }
-    m_recognizer = vosk_recognizer_new(m_model, 16000.0f); // Vosk expects float sample rate
+    m_recognizer = new_dictation_recognizer(static_cast<float>(m_model_sample_rate)); // Vosk expects float sample rate
     if (!m_recognizer) {
-        std::cerr << "ERROR: Failed to create Vosk recognizer." << std::endl;
-        close_alsa_capture();
+        VK_LOG_ERROR("Failed to create Vosk recognizer.");
+        close_audio_source();
         return false;
     }
 
+    // Command recognizer on the same model and rate; the decoder applies later grammar changes
+    if (m_command_recognizer) {
+        vosk_recognizer_free(m_command_recognizer); // Tied to the old rate like m_recognizer
+        m_command_recognizer = nullptr;
+    }
+    m_grammar_changed = false;
+    apply_command_grammar();
+    m_decoding_commands = m_command_mode && m_command_recognizer;
+
+    // GPU dictation stream; the CPU recognizer above takes over if it can't be created
+    if (m_batch_model && !m_batch_recognizer.open(m_batch_model, static_cast<float>(m_model_sample_rate))) {
+        VK_LOG_WARNING("SpeechToTextService: GPU stream unavailable, decoding on the CPU.");
+    }
+
+    // Preallocate the capture ring and the overflow sink for the negotiated period size,
+    // so the capture thread never allocates while running.
+    if (!m_ring || m_ring->depth() != m_ring_depth || m_ring->period_samples() != m_period_frames) {
+        m_ring = std::make_unique<AudioRingBuffer>(m_ring_depth, m_period_frames);
+    } else {
+        m_ring->reset();
+    }
+    m_discard_buffer.assign(m_period_frames, 0);
+    m_vad.reset(m_period_frames, m_model_sample_rate);
+
+    // Chunks never take more than half the ring, so gathering one can't overrun capture.
+    // The buffer takes the largest chunk any config could ask for, so live tuning can't outgrow it.
+    unsigned period_ms = static_cast<unsigned>(m_period_frames * 1000 / m_model_sample_rate);
+    size_t max_chunk_periods = std::max<size_t>(1, m_ring_depth / 2);
+    m_chunk_policy.reset(period_ms, max_chunk_periods);
+    m_chunk_buffer.assign(m_period_frames * max_chunk_periods, 0);
+    m_chunk_fill = 0;
+    m_chunk_periods = 0;
+    m_chunk_ms = m_chunk_policy.chunk_ms();
+    m_chunk_adjustments = 0;
+    m_stream_sample_rate = m_model_sample_rate;
+
+    m_last_partial_text.clear();
     m_listening = true;
     m_should_run_audio_thread = true;
-    m_audio_processing_thread = std::thread(&SpeechToTextService::audio_processing_loop, this);
+    m_capture_requested = true;
+    m_capture_active = true;
+    m_capture_parked = false;
+    m_decoder_parked = false;
+    m_audio_threads_running = true;
+    m_decoder_thread = std::thread(&SpeechToTextService::audio_decoding_loop, this);
+    m_capture_thread = std::thread(&SpeechToTextService::audio_capture_loop, this);
     
-    std::cout << "SpeechToTextService: Listening started." << std::endl;
+    VK_LOG_INFO("SpeechToTextService: Listening started.");
     return true;
 }
 
 void SpeechToTextService::stop_listening() {
     if (!m_listening) {
-        std::cout << "SpeechToTextService: Not currently listening." << std::endl;
+        VK_LOG_INFO("SpeechToTextService: Not currently listening.");
         return;
     }
 
-    std::cout << "SpeechToTextService: Stopping listening..." << std::endl;
+    VK_LOG_INFO("SpeechToTextService: Stopping listening...");
 
-    m_should_run_audio_thread = false;
-    if (m_audio_processing_thread.joinable()) {
-        m_audio_processing_thread.join();
-        std::cout << "SpeechToTextService: Audio processing thread joined." << std::endl;
+    bool parked = false;
+    if (m_hot_standby) {
+        // Park instead of stopping. Capture stops the device after its current read,
+        // the decoder parks once it has drained everything capture queued.
+        std::unique_lock<std::mutex> lock(m_state_mutex);
+        m_capture_requested = false;
+        m_state_cv.wait(lock, [this] {
+            return (m_capture_parked && m_decoder_parked) || !m_capture_active;
+        });
+        parked = m_capture_active; // Otherwise capture hit a device error (or end of file) and exited
+    }
+    if (!parked) {
+        // Stop capture first so the decoder can drain whatever is still queued in the ring
+        shutdown_audio_threads();
     }
 
-    // Get final result from Vosk recognizer on stop
-    if (m_recognizer) {
-        char* final_result_cstr = const_cast<char*>(vosk_recognizer_final_result(m_recognizer));
-        std::string final_result_json_str(final_result_cstr);
-        std::cout << "DEBUG: Vosk final result JSON (on stop): " << final_result_json_str << std::endl;
-        
-        // Simple JSON parsing for "text" field
-        // This is a basic parser. For robust parsing, consider a JSON library.
-        size_t text_pos = final_result_json_str.find("\"text\" : \"");
-        if (text_pos != std::string::npos) {
-            text_pos += std::string("\"text\" : \"").length();
-            size_t end_pos = final_result_json_str.find("\"", text_pos);
-            if (end_pos != std::string::npos) {
-                std::string text = final_result_json_str.substr(text_pos, end_pos - text_pos);
-                if (!text.empty() && text != " ") {
-                    m_transcribed_text_callback(text);
-                }
-            }
+    // Get final result from Vosk recognizer on stop. Both threads are parked or joined,
+    // so the recognizer is safe to use from this thread.
+    if (decoding_on_gpu()) {
+        m_batch_recognizer.finish(); // Leaves a fresh stream for the next utterance
+        deliver_batch_results(m_last_period_ns);
+    } else if (VoskRecognizer* recognizer = active_recognizer()) {
+        const char* final_result_json = vosk_recognizer_final_result(recognizer);
+        VK_LOG_DEBUG("Vosk final result JSON (on stop): " << final_result_json);
+        LatencyTracer::set_current_origin(m_last_period_ns); // Stop ends the utterance at the last period
+        deliver_final_result(final_result_json);
+        if (parked) {
+            vosk_recognizer_reset(recognizer); // Ready for the next utterance without reallocating
         }
     }
 
-    close_alsa_capture();
     m_listening = false;
-    std::cout << "SpeechToTextService: Listening stopped." << std::endl;
+    VK_LOG_INFO("SpeechToTextService: Listening stopped (decode chunk " << m_chunk_policy.chunk_ms()
+                << " ms, load " << m_chunk_policy.load() << ").");
+}
+
+bool SpeechToTextService::begin_offline_stream(float sample_rate, size_t chunk_samples) {
+    if (m_listening) {
+        VK_LOG_ERROR("Cannot start an offline stream while listening.");
+        return false;
+    }
+    if (!m_model_ready) {
+        VK_LOG_ERROR("Vosk model is not loaded yet. Cannot start an offline stream.");
+        return false;
+    }
+    shutdown_audio_threads(); // Standby threads share the recognizer
+    if (m_recognizer) {
+        vosk_recognizer_free(m_recognizer);
+    }
+    m_recognizer = new_dictation_recognizer(sample_rate);
+    if (!m_recognizer) {
+        VK_LOG_ERROR("Failed to create Vosk recognizer.");
+        return false;
+    }
+    m_vad.reset(chunk_samples, static_cast<unsigned>(sample_rate));
+    // The caller already picked the chunk size; decode each one as it comes
+    m_chunk_policy.reset(static_cast<unsigned>(chunk_samples * 1000 / sample_rate), 1);
+    m_chunk_fill = 0;
+    m_stream_sample_rate = static_cast<unsigned>(sample_rate);
+    m_chunk_periods = 0;
+    m_last_partial_text.clear();
+    m_decoding_commands = false; // Offline streams are always dictation
+    if (m_batch_model) {
+        BatchRecognizer::init_thread(); // The caller's thread feeds the stream
+        if (!m_batch_recognizer.open(m_batch_model, sample_rate)) {
+            VK_LOG_WARNING("SpeechToTextService: GPU stream unavailable, decoding on the CPU.");
+        }
+    }
+    return true;
+}
+
+void SpeechToTextService::process_audio(const int16_t* samples, size_t count) {
+    if (m_recognizer && !m_listening) {
+        decode_period(samples, count, 0);
+    }
+}
+
+void SpeechToTextService::end_offline_stream() {
+    if (m_recognizer && !m_listening) {
+        flush_chunk();
+        if (decoding_on_gpu()) {
+            m_batch_recognizer.finish();
+            deliver_batch_results(0);
+            return;
+        }
+        deliver_final_result(vosk_recognizer_final_result(m_recognizer));
+    }
 }
 
 bool SpeechToTextService::is_listening() const {
     return m_listening;
 }
 
-bool SpeechToTextService::open_alsa_capture() {
-    int err;
-    std::string pcm_device = "default"; // Or "plughw:1,0" etc.
+void SpeechToTextService::set_hot_standby(bool enabled) {
+    m_hot_standby = enabled;
+    if (!enabled && !m_listening) {
+        shutdown_audio_threads(); // Release the device kept open for standby
+    }
+}
+
+bool SpeechToTextService::hot_standby() const {
+    return m_hot_standby;
+}
 
-    // Open PCM device for recording
-    if ((err = snd_pcm_open(&m_alsa_handle, pcm_device.c_str(), SND_PCM_STREAM_CAPTURE, 0)) < 0) {
-        std::cerr << "ERROR: Cannot open audio device " << pcm_device << ": " << snd_strerror(err) << std::endl;
-        return false;
+void SpeechToTextService::shutdown_audio_threads() {
+    {
+        std::lock_guard<std::mutex> lock(m_state_mutex);
+        m_should_run_audio_thread = false;
+        m_capture_requested = false;
+    }
+    m_state_cv.notify_all(); // Wake threads parked in hot standby
+    if (m_source) {
+        m_source->interrupt(); // A file source on stdin or a pipe may be waiting for input
+    }
+    if (m_capture_thread.joinable()) {
+        m_capture_thread.join();
+        VK_LOG_INFO("SpeechToTextService: Audio capture thread joined.");
+    }
+    if (m_decoder_thread.joinable()) {
+        m_decoder_thread.join();
+        VK_LOG_INFO("SpeechToTextService: Audio decoder thread joined.");
+    }
+    m_audio_threads_running = false;
+    close_audio_source();
+}
+
+void SpeechToTextService::notify_capture_exit() {
+    {
+        std::lock_guard<std::mutex> lock(m_state_mutex);
+        m_capture_active.store(false, std::memory_order_release);
+    }
+    m_state_cv.notify_all();
+}
+
+void SpeechToTextService::set_command_callback(TranscribedTextCallback callback) {
+    m_command_callback = callback; // Set before start_listening(); read by the decoder thread
+}
+
+void SpeechToTextService::set_command_grammar(const std::string& grammar_json) {
+    {
+        std::lock_guard<std::mutex> lock(m_grammar_mutex);
+        m_command_grammar = grammar_json;
+    }
+    m_grammar_changed.store(true, std::memory_order_release);
+}
+
+void SpeechToTextService::set_command_mode(bool enabled) {
+    m_command_mode.store(enabled, std::memory_order_release);
+    VK_LOG_INFO("SpeechToTextService: " << (enabled ? "Command" : "Dictation") << " mode.");
+}
+
+bool SpeechToTextService::command_mode() const {
+    return m_command_mode.load(std::memory_order_acquire);
+}
+
+VoskRecognizer* SpeechToTextService::active_recognizer() const {
+    return m_decoding_commands ? m_command_recognizer : m_recognizer;
+}
+
+bool SpeechToTextService::decoding_on_gpu() const {
+    return !m_decoding_commands && m_batch_recognizer.is_open();
+}
+
+void SpeechToTextService::set_decoder_backend(DecoderBackend backend) {
+    if (backend == DecoderBackend::Gpu) {
+        BatchRecognizer::init_gpu(); // Must happen on the main thread, before any model loads
+    }
+    m_decoder_backend = backend;
+}
+
+bool SpeechToTextService::gpu_decoding() const {
+    return m_model_ready && m_batch_model != nullptr;
+}
+
+void SpeechToTextService::set_speaker_filter(const SpeakerFilterConfig& config) {
+    m_speaker_config = config;
+}
+
+bool SpeechToTextService::speaker_filtering() const {
+    return m_model_ready && m_speaker_model != nullptr;
+}
+
+void SpeechToTextService::set_post_processor_config(const ResultPostProcessor::Config& config) {
+    m_post_processor.set_config(config);
+}
+
+bool SpeechToTextService::set_transcript_journal(const TranscriptJournalConfig& config) {
+    if (!config.enabled()) {
+        m_journal.close();
+        return true;
+    }
+    return m_journal.open(config.path, config.reserve_records);
+}
+
+VoskRecognizer* SpeechToTextService::new_dictation_recognizer(float sample_rate) {
+    VoskRecognizer* recognizer = m_speaker_model ? vosk_recognizer_new_spk(m_model, sample_rate, m_speaker_model)
+                                                 : vosk_recognizer_new(m_model, sample_rate);
+    m_post_processor.configure(recognizer); // Word confidences (and alternatives) for post-processing
+    return recognizer;
+}
+
+void SpeechToTextService::apply_command_grammar() {
+    std::string grammar;
+    {
+        std::lock_guard<std::mutex> lock(m_grammar_mutex);
+        grammar = m_command_grammar;
+    }
+    if (grammar.empty()) {
+        if (m_command_recognizer) {
+            vosk_recognizer_free(m_command_recognizer);
+            m_command_recognizer = nullptr;
+        }
+        return;
+    }
+    if (m_command_recognizer) {
+        // Recompiles only the small grammar graph; the model stays as it is
+        vosk_recognizer_set_grm(m_command_recognizer, grammar.c_str());
+    } else if (m_model_ready) {
+        m_command_recognizer = vosk_recognizer_new_grm(m_model, static_cast<float>(m_model_sample_rate), grammar.c_str());
+        if (!m_command_recognizer) {
+            VK_LOG_ERROR("Failed to create Vosk grammar recognizer; command mode is unavailable.");
+        } else if (m_speaker_model) {
+            vosk_recognizer_set_spk_model(m_command_recognizer, m_speaker_model); // Commands are filtered too
+        }
+    }
+}
+
+void SpeechToTextService::sync_recognition_mode() {
+    if (m_grammar_changed.exchange(false, std::memory_order_acq_rel)) {
+        flush_chunk(); // Audio gathered so far belongs to the old phrase set
+        if (m_decoding_commands && m_command_recognizer) {
+            vosk_recognizer_reset(m_command_recognizer); // Same mode, new phrases: start the utterance over
+        }
+        apply_command_grammar();
+        if (!m_command_recognizer) {
+            m_decoding_commands = false;
+        }
+    }
+    bool commands = m_command_mode.load(std::memory_order_acquire) && m_command_recognizer;
+    if (commands != m_decoding_commands) {
+        flush_chunk(); // ... and to the old mode
+        // The utterance in progress belongs to the old mode; drop it so the old recognizer
+        // is clean when we come back to it
+        if (decoding_on_gpu()) {
+            m_batch_recognizer.reset();
+        } else {
+            vosk_recognizer_reset(active_recognizer());
+        }
+        m_decoding_commands = commands;
+        m_last_partial_text.clear();
+    }
+}
+
+void SpeechToTextService::set_partial_text_callback(PartialTextCallback callback) {
+    m_partial_text_callback = callback; // Set before start_listening(); read by the decoder thread
+}
+
+void SpeechToTextService::set_live_preview(bool enabled) {
+    m_live_preview = enabled;
+}
+
+bool SpeechToTextService::live_preview() const {
+    return m_live_preview;
+}
+
+void SpeechToTextService::set_vad_enabled(bool enabled) {
+    m_vad_enabled = enabled;
+}
+
+bool SpeechToTextService::vad_enabled() const {
+    return m_vad_enabled;
+}
+
+void SpeechToTextService::set_vad_config(const VoiceActivityDetector::Config& config) {
+    std::lock_guard<std::mutex> lock(m_tuning_mutex);
+    m_vad_config = config;
+    if (m_audio_threads_running) {
+        m_tuning_changed.store(true, std::memory_order_release);
+    } else {
+        m_vad.set_config(config);
     }
+}
+
+VoiceActivityDetector::Config SpeechToTextService::vad_config() const {
+    std::lock_guard<std::mutex> lock(m_tuning_mutex);
+    return m_vad_config;
+}
+
+void SpeechToTextService::set_ring_depth(size_t periods) {
+    m_ring_depth = periods > 0 ? periods : 1;
+}
+
+void SpeechToTextService::set_audio_source_config(const AudioSourceConfig& config) {
+    m_source_config = config;
+}
 
-    // Set PCM parameters
-    snd_pcm_hw_params_t *hw_params;
-    snd_pcm_hw_params_alloca(&hw_params);
-    snd_pcm_hw_params_any(m_alsa_handle, hw_params);
+const AudioSourceConfig& SpeechToTextService::audio_source_config() const {
+    return m_source_config;
+}
 
-    // Set interleaved mode
-    snd_pcm_hw_params_set_access(m_alsa_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED);
+size_t SpeechToTextService::ring_depth() const {
+    return m_ring_depth;
+}
 
-    // Set sample format (Vosk expects 16-bit signed integers)
-    snd_pcm_hw_params_set_format(m_alsa_handle, hw_params, SND_PCM_FORMAT_S16_LE);
+void SpeechToTextService::set_chunk_policy_config(const ChunkSizePolicy::Config& config) {
+    std::lock_guard<std::mutex> lock(m_tuning_mutex);
+    m_chunk_config = config;
+    if (m_audio_threads_running) {
+        m_tuning_changed.store(true, std::memory_order_release);
+    } else {
+        m_chunk_policy.set_config(config);
+    }
+}
 
-    // Set channels (Vosk expects mono)
-    unsigned int channels = 1;
-    snd_pcm_hw_params_set_channels(m_alsa_handle, hw_params, channels);
+ChunkSizePolicy::Config SpeechToTextService::chunk_policy_config() const {
+    std::lock_guard<std::mutex> lock(m_tuning_mutex);
+    return m_chunk_config;
+}
 
-    // Set sample rate
-    unsigned int rate = 16000; // 16kHz
-    snd_pcm_hw_params_set_rate_near(m_alsa_handle, hw_params, &rate, 0);
+void SpeechToTextService::apply_pending_tuning() {
+    if (!m_tuning_changed.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+    VoiceActivityDetector::Config vad_config;
+    ChunkSizePolicy::Config chunk_config;
+    {
+        std::lock_guard<std::mutex> lock(m_tuning_mutex);
+        vad_config = m_vad_config;
+        chunk_config = m_chunk_config;
+    }
+    // Thresholds are read per period; resetting the gate would reallocate its pre-roll and
+    // lose the noise floor, so hangover and pre-roll wait for the next cold start
+    m_vad.set_config(vad_config);
 
-    // Set period size (buffer chunk size)
-    snd_pcm_uframes_t period_size = 800; // About 50ms of 16kHz 16-bit mono audio (800 frames * 2 bytes/frame = 1600 bytes)
-    snd_pcm_hw_params_set_period_size_near(m_alsa_handle, hw_params, &period_size, 0);
+    // What was gathered goes out at the old size; the policy then starts over within the
+    // chunk buffer allocated when listening started
+    flush_chunk();
+    m_chunk_policy.set_config(chunk_config);
+    unsigned period_ms = static_cast<unsigned>(m_period_frames * 1000 / m_stream_sample_rate);
+    m_chunk_policy.reset(period_ms, std::max<size_t>(1, m_chunk_buffer.size() / m_period_frames));
+    m_chunk_ms.store(m_chunk_policy.chunk_ms(), std::memory_order_relaxed);
+    m_chunk_adjustments.store(0, std::memory_order_relaxed);
+    VK_LOG_INFO("SpeechToTextService: Tuning applied (decode chunk " << m_chunk_policy.chunk_ms()
+                << " ms, VAD min RMS " << vad_config.min_rms << ").");
+}
 
-    // Set buffer size
-    snd_pcm_uframes_t buffer_size = 4000; // 250ms buffer (4000 frames * 2 bytes/frame = 8000 bytes)
-    snd_pcm_hw_params_set_buffer_size_near(m_alsa_handle, hw_params, &buffer_size);
+SpeechToTextService::CaptureStats SpeechToTextService::get_capture_stats() const {
+    CaptureStats stats;
+    stats.periods_captured = m_periods_captured.load(std::memory_order_relaxed);
+    stats.periods_decoded = m_periods_decoded.load(std::memory_order_relaxed);
+    stats.ring_overruns = m_ring_overruns.load(std::memory_order_relaxed);
+    stats.ring_underruns = m_ring_underruns.load(std::memory_order_relaxed);
+    stats.alsa_xruns = m_alsa_xruns.load(std::memory_order_relaxed);
+    stats.frames_gated = m_frames_gated.load(std::memory_order_relaxed);
+    stats.frames_decoded = m_frames_decoded.load(std::memory_order_relaxed);
+    stats.chunk_ms = m_chunk_ms.load(std::memory_order_relaxed);
+    stats.decode_load = m_decode_load.load(std::memory_order_relaxed);
+    stats.chunk_adjustments = m_chunk_adjustments.load(std::memory_order_relaxed);
+    stats.results_rejected_speaker = m_results_rejected_speaker.load(std::memory_order_relaxed);
+    stats.words_dropped_low_conf = m_post_processor.words_dropped();
+    stats.results_dropped_low_conf = m_post_processor.results_dropped();
+    stats.alternatives_rescored = m_post_processor.alternatives_rescored();
+    stats.results_ungated_conf = m_post_processor.results_ungated();
+    stats.results_journaled = m_journal.entries_written();
+    return stats;
+}
 
-    // Apply parameters
-    if ((err = snd_pcm_hw_params(m_alsa_handle, hw_params)) < 0) {
-        std::cerr << "ERROR: Cannot set parameters: " << snd_strerror(err) << std::endl;
-        close_alsa_capture();
+bool SpeechToTextService::open_audio_source() {
+    close_audio_source();
+    m_source = create_audio_source(m_source_config.backend);
+    if (!m_source || !m_source->open(m_source_config)) {
+        m_source.reset();
+        return false;
+    }
+    // Whatever the device delivers is converted to model-rate mono on the capture thread
+    if (!m_converter.configure(m_source->sample_rate(), m_source->channels(), m_model_sample_rate,
+                               m_source->period_frames())) {
+        m_source->close();
+        m_source.reset();
         return false;
     }
+    if (m_converter.passthrough()) {
+        m_capture_buffer.clear();
+        m_period_frames = m_source->period_frames();
+    } else {
+        m_capture_buffer.assign(m_source->period_frames() * m_source->channels(), 0);
+        m_period_frames = m_converter.max_output_frames(m_source->period_frames());
+    }
+    return true;
+}
+
+void SpeechToTextService::close_audio_source() {
+    if (m_source) {
+        m_source->close();
+        m_source.reset();
+        VK_LOG_INFO("SpeechToTextService: Audio source closed.");
+    }
+}
+
+void SpeechToTextService::deliver_final_result(const char* result_json) {
+    bool previewed = m_partial_forwarded; // Partials of this utterance are on screen
+    m_partial_forwarded = false;
+    if (!m_result_decoder.decode(result_json, m_result)) {
+        VK_LOG_WARNING("Could not parse Vosk result JSON: " << result_json);
+        drop_final_result(previewed);
+        return;
+    }
+    if (m_decoding_commands) {
+        // Grammar results are whole phrases; there are no word confidences to gate on
+        std::string_view text = m_result.best_text();
+        if (text.empty() || text == " " || text == "[unk]") {
+            return;
+        }
+        // Reuse the same string so steady-state delivery doesn't allocate
+        m_result_text.assign(text.data(), text.size());
+    } else if (!m_post_processor.process(m_result, m_result_text, &m_result_words)) {
+        drop_final_result(previewed); // Nothing confident enough to type
+        return;
+    }
+    if (m_speaker_config.enabled() && !accept_speaker()) {
+        m_results_rejected_speaker.fetch_add(1, std::memory_order_relaxed);
+        drop_final_result(previewed);
+        return;
+    }
+    RuntimeStats::instance().results_emitted.fetch_add(1, std::memory_order_relaxed);
+    if (m_decoding_commands) {
+        if (m_command_callback) {
+            m_command_callback(m_result_text);
+        }
+    } else {
+        // Journaled before typing: if the text lands in the wrong window it can still be retyped
+        if (m_journal.is_open()) {
+            m_journal.append(m_result_text, m_result_words.data(), m_result_words.size());
+        }
+        m_transcribed_text_callback(m_result_text);
+    }
+}
+
+void SpeechToTextService::drop_final_result(bool previewed) {
+    if (previewed && !m_decoding_commands) {
+        m_result_text.clear();
+        m_transcribed_text_callback(m_result_text);
+    }
+}
 
-    // Get actual parameters (optional, for verification)
-    unsigned int actual_rate;
-    snd_pcm_hw_params_get_rate(hw_params, &actual_rate, 0);
-    unsigned int actual_channels;
-    snd_pcm_hw_params_get_channels(hw_params, &actual_channels);
-    snd_pcm_uframes_t actual_buffer_size;
-    snd_pcm_hw_params_get_buffer_size(hw_params, &actual_buffer_size);
-    snd_pcm_uframes_t actual_period_size;
-    snd_pcm_hw_params_get_period_size(hw_params, &actual_period_size, 0);
-
-    std::cout << "SpeechToTextService: ALSA params - Requested Rate: 16000Hz, Actual Rate: " << actual_rate
-              << "Hz, Requested Channels: 1, Actual Channels: " << actual_channels
-              << ", Buffer Size (frames): " << actual_buffer_size
-              << ", Period Size (frames): " << actual_period_size << std::endl;
-
-    // Prepare PCM device
-    if ((err = snd_pcm_prepare(m_alsa_handle)) < 0) {
-        std::cerr << "ERROR: Cannot prepare audio interface for use: " << snd_strerror(err) << std::endl;
-        close_alsa_capture();
+bool SpeechToTextService::accept_speaker() {
+    if (!m_speaker_model) {
+        return false; // The filter was asked for but can't run: type nothing rather than everything
+    }
+    const std::vector<float>& xvector = m_result.speaker_vector;
+    if (xvector.empty()) {
+        VK_LOG_DEBUG("SpeechToTextService: Result without an x-vector dropped.");
         return false;
     }
+    if (!m_speaker_config.enroll_name.empty()) {
+        if (m_speakers.enroll(m_speaker_config.enroll_name, xvector) && !m_speaker_config.profiles_path.empty()) {
+            m_speakers.save_file(m_speaker_config.profiles_path);
+        }
+        VK_LOG_INFO("SpeechToTextService: Enrolled an utterance (" << m_result.speaker_frames
+                    << " frames) as " << m_speaker_config.enroll_name << ".");
+        return true;
+    }
+    SpeakerIndex::Match match = m_speakers.best_match(xvector);
+    if (match.profile >= 0 && match.similarity >= m_speaker_config.threshold) {
+        VK_LOG_DEBUG("SpeechToTextService: Speaker " << m_speakers.name(match.profile)
+                     << " (similarity " << match.similarity << ").");
+        return true;
+    }
+    VK_LOG_INFO("SpeechToTextService: Dropped a result from an unknown speaker (best similarity "
+                << match.similarity << ").");
+    return false;
+}
 
-    return true;
+void SpeechToTextService::decode_period(const int16_t* samples, size_t count, uint64_t origin_ns) {
+    using Decision = VoiceActivityDetector::Decision;
+    Decision decision = m_vad_enabled ? m_vad.process(samples, count) : Decision::Decode;
+    switch (decision) {
+        case Decision::Skip:
+            m_frames_gated.fetch_add(count, std::memory_order_relaxed);
+            flush_chunk();
+            break;
+        case Decision::Close:
+            // Vosk never sees the trailing silence, so end the utterance ourselves
+            m_frames_gated.fetch_add(count, std::memory_order_relaxed);
+            flush_chunk();
+            flush_final_result(origin_ns);
+            break;
+        case Decision::Open:
+            // Replay the audio just before the onset; it was counted as gated when skipped
+            flush_chunk();
+            m_vad.for_each_preroll([this, origin_ns](const int16_t* preroll, size_t preroll_count) {
+                m_frames_gated.fetch_sub(preroll_count, std::memory_order_relaxed);
+                feed_recognizer(preroll, preroll_count, origin_ns);
+            });
+            queue_for_decode(samples, count, origin_ns);
+            break;
+        case Decision::Decode:
+            queue_for_decode(samples, count, origin_ns);
+            break;
+    }
+}
+
+void SpeechToTextService::queue_for_decode(const int16_t* samples, size_t count, uint64_t origin_ns) {
+    if (m_chunk_periods == 0 && m_chunk_policy.periods_per_chunk() <= 1) {
+        decode_chunk(samples, count, 1, origin_ns, origin_ns); // Straight from the ring slot, no copy
+        return;
+    }
+    if (m_chunk_fill + count > m_chunk_buffer.size()) {
+        flush_chunk();
+        if (count > m_chunk_buffer.size()) {
+            decode_chunk(samples, count, 1, origin_ns, origin_ns);
+            return;
+        }
+    }
+    if (m_chunk_periods == 0) {
+        m_chunk_first_ns = origin_ns;
+    }
+    std::copy(samples, samples + count, m_chunk_buffer.begin() + m_chunk_fill);
+    m_chunk_fill += count;
+    m_chunk_periods++;
+    m_chunk_last_ns = origin_ns;
+    if (m_chunk_periods >= m_chunk_policy.periods_per_chunk()) {
+        flush_chunk();
+    }
+}
+
+void SpeechToTextService::flush_chunk() {
+    if (m_chunk_periods == 0) {
+        return;
+    }
+    size_t fill = m_chunk_fill;
+    size_t periods = m_chunk_periods;
+    m_chunk_fill = 0;
+    m_chunk_periods = 0;
+    decode_chunk(m_chunk_buffer.data(), fill, periods, m_chunk_first_ns, m_chunk_last_ns);
+}
+
+void SpeechToTextService::decode_chunk(const int16_t* samples, size_t count, size_t periods,
+                                       uint64_t first_ns, uint64_t last_ns) {
+    uint64_t start_ns = LatencyTracer::now_ns();
+    if (first_ns != 0) {
+        LatencyTracer::instance().record(TraceStage::ChunkGather, first_ns, start_ns - first_ns);
+    }
+    // Final results are traced from the newest period: that is where the utterance ended
+    feed_recognizer(samples, count, last_ns);
+    uint64_t decode_ns = LatencyTracer::now_ns() - start_ns;
+
+    size_t queued = (m_listening && m_ring) ? m_ring->size() : 0;
+    RuntimeStats& stats = RuntimeStats::instance();
+    stats.frames_decoded.fetch_add(count, std::memory_order_relaxed);
+    stats.decode_ns.fetch_add(decode_ns, std::memory_order_relaxed);
+    stats.decoded_audio_ns.fetch_add(count * 1000000000ull / m_stream_sample_rate, std::memory_order_relaxed);
+    stats.ring_depth.store(queued, std::memory_order_relaxed);
+    stats.chunk_ms.store(count * 1000 / m_stream_sample_rate, std::memory_order_relaxed);
+    if (m_chunk_policy.record(periods, decode_ns, queued)) {
+        VK_LOG_DEBUG("SpeechToTextService: Decode chunk now " << m_chunk_policy.chunk_ms() << " ms (load "
+                     << m_chunk_policy.load() << ", " << queued << " periods queued).");
+        m_chunk_ms.store(m_chunk_policy.chunk_ms(), std::memory_order_relaxed);
+        m_chunk_adjustments.store(m_chunk_policy.adjustments(), std::memory_order_relaxed);
+    }
+    m_decode_load.store(m_chunk_policy.load(), std::memory_order_relaxed);
+}
+
+void SpeechToTextService::feed_recognizer(const int16_t* samples, size_t count, uint64_t origin_ns) {
+    if (decoding_on_gpu()) {
+        {
+            ScopedTrace trace(TraceStage::AcceptWaveform);
+            m_batch_recognizer.accept_waveform(samples, count); // Only queues it for the GPU
+        }
+        m_frames_decoded.fetch_add(count, std::memory_order_relaxed);
+        deliver_batch_results(origin_ns);
+        return;
+    }
+    VoskRecognizer* recognizer = active_recognizer();
+    int rec_res;
+    {
+        ScopedTrace trace(TraceStage::AcceptWaveform);
+        rec_res = vosk_recognizer_accept_waveform(recognizer, reinterpret_cast<const char*>(samples),
+                                                  static_cast<int>(count * sizeof(int16_t)));
+    }
+    m_frames_decoded.fetch_add(count, std::memory_order_relaxed);
+
+    if (rec_res == 1) { // Final result
+        m_last_partial_text.clear();
+        const char* final_result_json = vosk_recognizer_result(recognizer);
+        VK_LOG_DEBUG("Vosk result JSON (Final): " << final_result_json);
+        trace_final_result(origin_ns);
+        deliver_final_result(final_result_json);
+    } else if (m_live_preview && m_partial_text_callback && !m_decoding_commands && !m_speaker_model) {
+        // Partial hypotheses are only fetched in live preview mode, and only forwarded when they change
+        const char* partial_result_json = vosk_recognizer_partial_result(recognizer);
+        if (m_result_decoder.decode(partial_result_json, m_result) && m_result.text != m_last_partial_text) {
+            m_last_partial_text.assign(m_result.text.data(), m_result.text.size());
+            m_partial_forwarded = true;
+            m_partial_text_callback(m_last_partial_text);
+        }
+    }
+}
+
+void SpeechToTextService::flush_final_result(uint64_t origin_ns) {
+    m_last_partial_text.clear();
+    if (decoding_on_gpu()) {
+        m_batch_recognizer.finish();
+        deliver_batch_results(origin_ns);
+        return;
+    }
+    const char* final_result_json = vosk_recognizer_final_result(active_recognizer());
+    VK_LOG_DEBUG("Vosk final result JSON (gate closed): " << final_result_json);
+    trace_final_result(origin_ns);
+    deliver_final_result(final_result_json);
+}
+
+void SpeechToTextService::deliver_batch_results(uint64_t origin_ns) {
+    while (const char* result_json = m_batch_recognizer.next_result()) {
+        VK_LOG_DEBUG("Vosk batch result JSON: " << result_json);
+        trace_final_result(origin_ns);
+        deliver_final_result(result_json);
+    }
 }
 
-void SpeechToTextService::close_alsa_capture() {
-    if (m_alsa_handle) {
-        std::cout << "SpeechToTextService: Closing ALSA capture device." << std::endl;
-        snd_pcm_close(m_alsa_handle);
-        m_alsa_handle = nullptr;
-        std::cout << "SpeechToTextService: ALSA capture device closed." << std::endl;
+void SpeechToTextService::trace_final_result(uint64_t origin_ns) {
+    // The transcription callback runs on this thread and picks the origin up from here
+    LatencyTracer::set_current_origin(origin_ns);
+    if (origin_ns != 0 && LatencyTracer::enabled()) {
+        LatencyTracer::instance().record(TraceStage::FinalResult, origin_ns, LatencyTracer::now_ns() - origin_ns);
     }
 }
 
-void SpeechToTextService::audio_processing_loop() {
-    const int buffer_size_bytes = 1600; // 800 frames * 2 bytes/frame (S16_LE)
-    std::vector<char> buffer(buffer_size_bytes);
-    int err;
+void SpeechToTextService::audio_capture_loop() {
+    LatencyTracer::instance().set_thread_name("capture");
+    AudioSource* source = m_source.get();
+    using ReadStatus = AudioSource::ReadStatus;
 
     while (m_should_run_audio_thread) {
-        if (!m_alsa_handle) {
-            std::cerr << "ERROR: ALSA handle is null in audio_processing_loop." << std::endl;
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (!source) {
+            VK_LOG_ERROR("No audio source in audio_capture_loop.");
+            break;
+        }
+
+        if (!m_capture_requested.load(std::memory_order_acquire)) {
+            // Hot standby: stop the stream without closing the device, then wait to be woken
+            source->pause();
+            {
+                std::unique_lock<std::mutex> lock(m_state_mutex);
+                m_capture_parked = true;
+                m_state_cv.notify_all();
+                m_state_cv.wait(lock, [this] { return m_capture_requested || !m_should_run_audio_thread; });
+                m_capture_parked = false;
+            }
+            if (!m_should_run_audio_thread) {
+                break;
+            }
+            if (!source->resume()) {
+                break;
+            }
             continue;
         }
 
-        err = snd_pcm_readi(m_alsa_handle, buffer.data(), buffer_size_bytes / 2); // Read frames (buffer_size_bytes / 2)
-        if (err == -EPIPE) {
-            std::cerr << "WARNING: ALSA overrun occurred, attempting to recover." << std::endl;
-            snd_pcm_prepare(m_alsa_handle);
+        // Read straight into the next ring slot (or convert into it from the native-format capture
+        // buffer). If the decoder has fallen behind and the ring is full, keep draining the source
+        // into the discard buffer so the device never overruns.
+        int16_t* slot = m_ring->acquire_write_slot();
+        bool dropping = (slot == nullptr);
+        int16_t* target = dropping ? m_discard_buffer.data() : slot;
+        bool converting = !m_converter.passthrough();
+
+        size_t frames = 0;
+        ReadStatus status = source->read(converting ? m_capture_buffer.data() : target, frames);
+        if (status == ReadStatus::Overrun) {
+            m_alsa_xruns.fetch_add(1, std::memory_order_relaxed);
+            RuntimeStats::instance().capture_overruns.fetch_add(1, std::memory_order_relaxed);
+            m_converter.reset(); // Audio is missing; don't filter across the gap
             continue;
-        } else if (err < 0) {
-            std::cerr << "ERROR: Error from ALSA read: " << snd_strerror(err) << std::endl;
+        } else if (status == ReadStatus::EndOfStream) {
+            VK_LOG_INFO("SpeechToTextService: End of audio input.");
+            break;
+        } else if (status != ReadStatus::Ok) {
             break;
-        } else if (err != buffer_size_bytes / 2) {
-            std::cerr << "WARNING: Short read from ALSA, expected " << buffer_size_bytes / 2 << " frames, got " << err << std::endl;
+        }
+        if (converting) {
+            // Keeps the filter history continuous even for periods that are dropped
+            frames = m_converter.process(m_capture_buffer.data(), frames, target);
         }
 
-        if (m_recognizer) {
-            int rec_res = vosk_recognizer_accept_waveform(m_recognizer, buffer.data(), buffer_size_bytes);
-            
-            // Log partial results for debugging, but DO NOT send them to callback for global typing
-            char* partial_result_cstr = const_cast<char*>(vosk_recognizer_partial_result(m_recognizer));
-            std::string partial_result_json_str(partial_result_cstr);
-            // std::cout << "DEBUG: Vosk result JSON (Partial): " << partial_result_json_str << std::endl;
-
-            if (rec_res == 1) { // Final result
-                char* final_result_cstr = const_cast<char*>(vosk_recognizer_result(m_recognizer));
-                std::string final_result_json_str(final_result_cstr);
-                std::cout << "DEBUG: Vosk result JSON (Final): " << final_result_json_str << std::endl;
-
-                // Simple JSON parsing for "text" field
-                size_t text_pos = final_result_json_str.find("\"text\" : \"");
-                if (text_pos != std::string::npos) {
-                    text_pos += std::string("\"text\" : \"").length();
-                    size_t end_pos = final_result_json_str.find("\"", text_pos);
-                    if (end_pos != std::string::npos) {
-                        std::string text = final_result_json_str.substr(text_pos, end_pos - text_pos);
-                        if (!text.empty() && text != " ") {
-                            m_transcribed_text_callback(text);
-                        }
-                    }
+        if (dropping) {
+            m_ring_overruns.fetch_add(1, std::memory_order_relaxed);
+            RuntimeStats::instance().capture_overruns.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        uint64_t period_end_ns = 0;
+        if (LatencyTracer::enabled()) {
+            period_end_ns = source->last_period_end_ns();
+            LatencyTracer::instance().record(TraceStage::CaptureArrival, period_end_ns,
+                                             LatencyTracer::now_ns() - period_end_ns);
+        }
+        m_ring->commit_write_slot(frames, period_end_ns);
+        m_periods_captured.fetch_add(1, std::memory_order_relaxed);
+        RuntimeStats::instance().frames_captured.fetch_add(frames, std::memory_order_relaxed);
+    }
+    notify_capture_exit(); // Lets the decoder drain and exit
+    VK_LOG_INFO("SpeechToTextService: Audio capture loop finished.");
+}
+
+void SpeechToTextService::audio_decoding_loop() {
+    LatencyTracer::instance().set_thread_name("decoder");
+    if (m_batch_model) {
+        BatchRecognizer::init_thread();
+    }
+    // Poll at a fraction of the period so an empty ring adds little latency
+    const auto idle_wait = std::chrono::milliseconds(5);
+
+    while (true) {
+        size_t samples = 0;
+        uint64_t period_end_ns = 0;
+        const int16_t* period = m_ring->acquire_read_slot(samples, &period_end_ns);
+        if (!period) {
+            // Keep running until capture has stopped and everything it queued has been decoded
+            if (!m_capture_active.load(std::memory_order_acquire)) {
+                flush_chunk();
+                break;
+            }
+            if (!m_capture_requested.load(std::memory_order_acquire)) {
+                flush_chunk(); // stop_listening() takes the final result once we are parked
+                // Hot standby: park once capture has parked and everything it queued has been decoded
+                std::unique_lock<std::mutex> lock(m_state_mutex);
+                if (m_capture_parked && !m_capture_requested && m_ring->size() == 0) {
+                    m_decoder_parked = true;
+                    m_state_cv.notify_all();
+                    m_state_cv.wait(lock, [this] {
+                        return m_capture_requested || !m_should_run_audio_thread || !m_capture_active;
+                    });
+                    m_decoder_parked = false;
+                    continue;
                 }
             }
+            m_ring_underruns.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::sleep_for(idle_wait);
+            continue;
+        }
+
+        if (period_end_ns != 0) {
+            LatencyTracer::instance().record(TraceStage::RingWait, period_end_ns, LatencyTracer::now_ns() - period_end_ns);
         }
+        m_last_period_ns = period_end_ns;
+
+        apply_pending_tuning();
+        sync_recognition_mode(); // Dictation/command switches take effect between periods
+        if (m_recognizer) {
+            decode_period(period, samples, period_end_ns);
+        }
+        m_ring->release_read_slot();
+        m_periods_decoded.fetch_add(1, std::memory_order_relaxed);
     }
-    std::cout << "SpeechToTextService: Audio processing loop finished." << std::endl;
+    VK_LOG_INFO("SpeechToTextService: Audio decoder loop finished.");
 }
-
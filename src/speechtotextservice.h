@@ -12,21 +12,36 @@
 #include <mutex>
 #include <vector>
 #include <filesystem> // Include for std::filesystem::exists
-// Removed <condition_variable> as it's not needed for offline-only
-
-// Include ALSA header here, as it defines snd_pcm_t used in member declaration
-#include <alsa/asoundlib.h> 
+#include <memory>
+#include <cstdint>
+#include <condition_variable> // Parks the audio threads in hot standby
 
 // Removed CURL includes as online mode is removed
 
+#include "audioconverter.h"
+#include "audiosource.h"
+#include "audioringbuffer.h"
+#include "batchrecognizer.h"
+#include "chunksizepolicy.h"
+#include "recognitionresult.h"
+#include "resultpostprocessor.h"
+#include "speakerindex.h"
+#include "transcriptjournal.h"
+#include "voiceactivitydetector.h"
+
 // Forward declarations for Vosk C++ API classes
 struct VoskModel;
 struct VoskRecognizer;
+struct VoskSpkModel;
 
 // Define a callback function type that the service will use to send transcribed text
 // back to the main application (e.g., your Gtkmm Keyboard).
 using TranscribedTextCallback = std::function<void(const std::string&)>;
 
+// Callback for in-progress (partial) hypotheses, used by the live preview mode.
+// Invoked from the decoder thread each time the partial text changes.
+using PartialTextCallback = std::function<void(const std::string&)>;
+
 class SpeechToTextService {
 public:
     // Constructor: Takes a callback function that will be invoked with transcribed text.
@@ -38,34 +53,292 @@ public:
     // Initializes the Vosk model and recognizer
     bool init(const std::string& model_path);
 
+    // Loads the model on a background thread and calls on_done(success) from that thread
+    // when finished. start_listening() fails until the model is ready.
+    void init_async(const std::string& model_path, std::function<void(bool)> on_done);
+
+    // True once a model has been loaded
+    bool is_ready() const;
+
+    // Sample rate the model was trained at (from its conf/mfcc.conf, 16000 when absent).
+    // Captured audio is converted to this rate and the recognizer is created with it.
+    unsigned model_sample_rate() const;
+
     // Starts audio capture and speech recognition
     bool start_listening();
 
     // Stops audio capture and speech recognition
     void stop_listening();
 
+    // Offline decoding through the same pipeline as the decoder thread (VAD gate, recognizer,
+    // result decoding and callbacks), fed by the caller instead of the audio source. Used by the benchmark.
+    // Only while not listening; process_audio() runs synchronously on the calling thread.
+    bool begin_offline_stream(float sample_rate, size_t chunk_samples);
+    void process_audio(const int16_t* samples, size_t count);
+    void end_offline_stream(); // Delivers the final result
+
     // Checks if the service is currently listening
     bool is_listening() const;
 
+    // Hot standby: stop_listening() keeps the capture device open (the source is paused),
+    // resets the recognizer instead of freeing it and parks both audio threads, so the next
+    // start_listening() only has to wake them. Disabling it while idle releases everything.
+    void set_hot_standby(bool enabled);
+    bool hot_standby() const;
+
+    // Live preview: when enabled, partial hypotheses are forwarded to the partial callback.
+    // The callback must be set before listening starts. If the final result of an utterance
+    // whose partials were forwarded is then dropped (low confidence, unknown speaker), the
+    // transcription callback gets an empty text, so whatever the preview typed is taken back.
+    void set_partial_text_callback(PartialTextCallback callback);
+    void set_live_preview(bool enabled);
+    bool live_preview() const;
+
+    // Voice activity gate: silent periods are not decoded at all. Enabling/disabling and the
+    // thresholds (min_rms, noise_ratio, max_zcr) apply from the next period, also while
+    // listening; hangover and pre-roll are sized when listening next starts cold.
+    void set_vad_enabled(bool enabled);
+    bool vad_enabled() const;
+    void set_vad_config(const VoiceActivityDetector::Config& config);
+    VoiceActivityDetector::Config vad_config() const;
+
+    // Command mode: decode against a small grammar (a JSON array of phrases, as taken by
+    // vosk_recognizer_new_grm) instead of the full language model, and report results through
+    // the command callback instead of the transcription callback. Both recognizers stay
+    // allocated, so switching takes effect at the next period; the utterance in progress is
+    // dropped. A new grammar is applied with vosk_recognizer_set_grm by the decoder thread.
+    // The callback must be set before listening starts.
+    void set_command_callback(TranscribedTextCallback callback);
+    void set_command_grammar(const std::string& grammar_json);
+    void set_command_mode(bool enabled);
+    bool command_mode() const;
+
+    // Dictation on the CPU (default) or on the GPU through a Vosk batch model, falling back to
+    // the CPU when none can be loaded. Call from the main thread before init(); command mode
+    // always decodes on the CPU. The GPU has no partial results, so live preview shows nothing.
+    void set_decoder_backend(DecoderBackend backend);
+    // True once init() has loaded a GPU batch model for dictation
+    bool gpu_decoding() const;
+
+    // Speaker filter: with a speaker model, recognizers report an x-vector per utterance and
+    // only results matching an enrolled profile reach the transcription and command callbacks
+    // (or, with config.enroll_name set, every result is enrolled as that speaker). The model is
+    // shared through ModelCache. Call before init(). Partial hypotheses carry no x-vector, so
+    // live preview forwards nothing while the filter is on, and dictation stays on the CPU.
+    void set_speaker_filter(const SpeakerFilterConfig& config);
+    // True once init() has loaded the speaker model
+    bool speaker_filtering() const;
+
+    // Confidence gating and n-best rescoring of dictation results (see ResultPostProcessor).
+    // Call before init(), which loads the vocabulary against the model. Rescoring stays off
+    // while the speaker filter is on.
+    void set_post_processor_config(const ResultPostProcessor::Config& config);
+
+    // Transcript journal: every final dictation result that passes the filters is appended,
+    // with its word timings, to the memory-mapped journal at config.path before it is handed
+    // to the transcription callback (see TranscriptJournal). Opens the file right away; call
+    // before listening starts. Returns false if the journal can't be opened (results are
+    // then only typed).
+    bool set_transcript_journal(const TranscriptJournalConfig& config);
+
+    // Capture backend, device, period and buffer size (see AudioSourceConfig).
+    // Takes effect the next time the device is opened (the next start without hot standby).
+    void set_audio_source_config(const AudioSourceConfig& config);
+    const AudioSourceConfig& audio_source_config() const;
+
+    // Number of capture periods the capture ring can hold before capture starts dropping audio.
+    // Takes effect the next time listening starts.
+    void set_ring_depth(size_t periods);
+    size_t ring_depth() const;
+
+    // Bounds (or a fixed size) for the chunks the decoder hands to the recognizer, see
+    // ChunkSizePolicy. While listening the decoder picks it up before its next period and
+    // starts adapting over from the new bounds; chunks never exceed half the ring.
+    void set_chunk_policy_config(const ChunkSizePolicy::Config& config);
+    ChunkSizePolicy::Config chunk_policy_config() const;
+
+    // Capture/decode pipeline counters (cumulative since construction)
+    struct CaptureStats {
+        uint64_t periods_captured; // Periods read from the audio source and queued for decoding
+        uint64_t periods_decoded;  // Periods consumed by the decoder thread
+        uint64_t ring_overruns;    // Periods dropped because the ring was full (decoder too slow)
+        uint64_t ring_underruns;   // Times the decoder found the ring empty and had to wait
+        uint64_t alsa_xruns;       // Source-level overruns (ALSA -EPIPE) recovered by the capture thread
+        uint64_t frames_gated;     // Frames the voice activity gate kept from the recognizer
+        uint64_t frames_decoded;   // Frames passed to vosk_recognizer_accept_waveform (including pre-roll)
+        unsigned chunk_ms;         // Current decode chunk size chosen by the chunk policy
+        float decode_load;         // Smoothed decode time / audio time of recent chunks
+        uint64_t chunk_adjustments; // Chunk size changes since listening last started cold
+        uint64_t results_rejected_speaker; // Results dropped by the speaker filter
+        uint64_t words_dropped_low_conf;   // Words below the confidence threshold
+        uint64_t results_dropped_low_conf; // Results with no confident word left
+        uint64_t alternatives_rescored;    // Results where the vocabulary picked another alternative
+        uint64_t results_ungated_conf;     // Results typed unchecked: alternatives have no word confidences
+        uint64_t results_journaled;        // Results appended to the transcript journal
+    };
+    CaptureStats get_capture_stats() const;
+
     // Removed set_online_mode and is_online_mode
 
 private:
     TranscribedTextCallback m_transcribed_text_callback; // Callback for transcribed text
+    TranscribedTextCallback m_command_callback; // Callback for recognized commands (command mode)
+    PartialTextCallback m_partial_text_callback; // Callback for partial hypotheses (live preview)
+    std::string m_last_partial_text; // Last partial forwarded, used to suppress duplicates (decoder thread only)
+    bool m_partial_forwarded; // A partial of the utterance in progress reached the partial callback (decoder thread only)
+
+    // Result decoding state, reused for every result (decoder thread, or caller after it is joined)
+    RecognitionResultDecoder m_result_decoder;
+    RecognitionResult m_result;
+    std::string m_result_text; // Text handed to the transcription callback
+    std::vector<RecognizedWord> m_result_words; // Words of m_result_text, for the journal
+    ResultPostProcessor m_post_processor; // Dictation results only
+    TranscriptJournal m_journal; // Appended to by the decoder thread (or caller after it is joined)
 
     VoskModel* m_model;       // Vosk model
     VoskRecognizer* m_recognizer; // Vosk recognizer
+    VoskRecognizer* m_command_recognizer; // Grammar recognizer for command mode, nullptr without a grammar
+
+    // GPU dictation. m_batch_recognizer is open while it replaces m_recognizer for dictation;
+    // m_recognizer is still created as the fallback and for switching back from command mode.
+    DecoderBackend m_decoder_backend;
+    VoskBatchModel* m_batch_model;
+    BatchRecognizer m_batch_recognizer;
+
+    // Speaker filter. m_speakers is used by the decoder thread (or the caller while it is
+    // parked/joined), like the result decoder.
+    SpeakerFilterConfig m_speaker_config;
+    VoskSpkModel* m_speaker_model; // Shared through ModelCache, nullptr when the filter is off
+    SpeakerIndex m_speakers;
+    std::atomic<uint64_t> m_results_rejected_speaker;
+
+    // Command mode state. m_command_mode is the requested mode; m_decoding_commands is the
+    // recognizer actually in use (decoder thread, or caller while the threads are parked/joined).
+    std::atomic<bool> m_command_mode;
+    bool m_decoding_commands;
+    std::mutex m_grammar_mutex; // Guards m_command_grammar
+    std::string m_command_grammar;
+    std::atomic<bool> m_grammar_changed; // m_command_grammar not yet applied to m_command_recognizer
 
-    snd_pcm_t* m_alsa_handle; // ALSA audio capture handle
+    std::atomic<bool> m_model_ready; // Set once m_model may be used
+    unsigned m_model_sample_rate; // Rate the recognizer is created with
+    std::thread m_init_thread; // Background model loading (init_async)
+
+    AudioSourceConfig m_source_config;
+    std::unique_ptr<AudioSource> m_source; // Open capture device, owned by the capture thread while it runs
     std::atomic<bool> m_listening; // Flag to control audio capture loop
-    std::atomic<bool> m_should_run_audio_thread; // Flag to control audio processing thread
-    std::thread m_audio_processing_thread; // Thread for audio capture and processing
+    std::atomic<bool> m_live_preview; // Forward partial hypotheses while decoding
+    std::atomic<bool> m_should_run_audio_thread; // Flag to control capture and decoder threads
+    std::atomic<bool> m_capture_active; // Cleared by the capture thread when it exits
+    std::thread m_capture_thread; // Thread reading periods from m_source into m_ring
+    std::thread m_decoder_thread; // Thread draining m_ring into the Vosk recognizer
+
+    // Hot standby state. m_capture_requested and the parked flags are only changed with
+    // m_state_mutex held; m_state_cv is notified whenever one of them changes.
+    bool m_hot_standby;
+    bool m_audio_threads_running; // Capture/decoder threads exist (caller thread only)
+    std::mutex m_state_mutex;
+    std::condition_variable m_state_cv;
+    std::atomic<bool> m_capture_requested; // Cleared to park the threads instead of stopping them
+    bool m_capture_parked;
+    bool m_decoder_parked;
+
+    // Lock-free hand-off between the capture and decoder threads
+    std::unique_ptr<AudioRingBuffer> m_ring;
+    size_t m_ring_depth;
+    size_t m_period_frames; // Ring slot size in model-rate mono samples
+    std::vector<int16_t> m_discard_buffer; // Sink for periods read while the ring is full
+
+    // Native-format capture: the source is read into m_capture_buffer and m_converter writes
+    // model-rate mono straight into the ring slot. Unused when the source already delivers it.
+    AudioConverter m_converter;
+    std::vector<int16_t> m_capture_buffer;
+
+    // Periods gathered into one accept_waveform call (decoder thread, or caller while it is
+    // parked/joined). With a one-period chunk the ring slot is fed directly and this stays empty.
+    ChunkSizePolicy m_chunk_policy;
+    std::vector<int16_t> m_chunk_buffer;
+    size_t m_chunk_fill;         // Samples gathered so far
+    size_t m_chunk_periods;      // Periods gathered so far
+    uint64_t m_chunk_first_ns;   // Capture timestamp of the oldest gathered period
+    uint64_t m_chunk_last_ns;    // ... and of the newest
+    std::atomic<unsigned> m_chunk_ms;
+    std::atomic<float> m_decode_load;
+    std::atomic<uint64_t> m_chunk_adjustments;
+
+    std::atomic<uint64_t> m_periods_captured;
+    std::atomic<uint64_t> m_periods_decoded;
+    std::atomic<uint64_t> m_ring_overruns;
+    std::atomic<uint64_t> m_ring_underruns;
+    std::atomic<uint64_t> m_alsa_xruns;
+    std::atomic<uint64_t> m_frames_gated;
+    std::atomic<uint64_t> m_frames_decoded;
+
+    // Voice activity gate (decoder thread only while listening)
+    VoiceActivityDetector m_vad;
+    std::atomic<bool> m_vad_enabled;
+
+    // Live tuning: the latest requested configs, copied into m_vad and m_chunk_policy by the
+    // decoder thread (or directly by the caller while the audio threads don't exist)
+    mutable std::mutex m_tuning_mutex; // Guards m_vad_config and m_chunk_config
+    VoiceActivityDetector::Config m_vad_config;
+    ChunkSizePolicy::Config m_chunk_config;
+    std::atomic<bool> m_tuning_changed; // Requested configs not yet applied by the decoder
+    unsigned m_stream_sample_rate; // Rate of the audio being decoded, for RuntimeStats
+
+    uint64_t m_last_period_ns; // Capture timestamp of the last decoded period (latency tracing)
+
+    // Opens m_source from m_source_config and sets up m_converter for its format
+    bool open_audio_source();
+    void close_audio_source();
+
+    // Stops and joins the audio threads and closes the PCM device
+    void shutdown_audio_threads();
+    // Clears m_capture_active and wakes everyone waiting on m_state_cv
+    void notify_capture_exit();
+
+    // Decodes a Vosk result JSON and passes its text to the transcription (or command) callback
+    void deliver_final_result(const char* result_json);
+    // A dictation final was dropped: tells the transcription callback if live preview showed it
+    void drop_final_result(bool previewed);
+    // Speaker filter verdict on m_result (enrolls it in enrollment mode)
+    bool accept_speaker();
+    // Dictation recognizer at 'sample_rate', reporting x-vectors when the speaker model is loaded
+    VoskRecognizer* new_dictation_recognizer(float sample_rate);
+
+    // Recognizer for the mode being decoded
+    VoskRecognizer* active_recognizer() const;
+    // Dictation is being decoded by m_batch_recognizer
+    bool decoding_on_gpu() const;
+    // Passes every result the GPU has returned so far to the transcription callback
+    void deliver_batch_results(uint64_t origin_ns);
+    // Applies a changed grammar and switches recognizers if the mode changed (decoder side)
+    void sync_recognition_mode();
+    // Copies changed tuning into m_vad and m_chunk_policy between periods (decoder side)
+    void apply_pending_tuning();
+    // Creates or reconfigures m_command_recognizer from m_command_grammar
+    void apply_command_grammar();
 
-    // Private methods for ALSA audio capture
-    bool open_alsa_capture();
-    void close_alsa_capture();
+    // Runs one period through the VAD gate and the recognizer
+    void decode_period(const int16_t* samples, size_t count, uint64_t origin_ns);
+    // Gathers a gated-open period into the current chunk, decoding it once it is full
+    void queue_for_decode(const int16_t* samples, size_t count, uint64_t origin_ns);
+    // Decodes whatever has been gathered, e.g. before the gate closes or the decoder parks
+    void flush_chunk();
+    // Feeds one chunk, times it and lets the chunk policy pick the next chunk size
+    void decode_chunk(const int16_t* samples, size_t count, size_t periods, uint64_t first_ns, uint64_t last_ns);
+    // Feeds one chunk to the recognizer and reports final/partial results (decoder thread)
+    // origin_ns is the capture timestamp of the period, for latency tracing (0 = untraced).
+    void feed_recognizer(const int16_t* samples, size_t count, uint64_t origin_ns);
+    // Flushes the utterance in progress as a final result, e.g. when the gate closes
+    void flush_final_result(uint64_t origin_ns);
+    // Records the FinalResult stage and hands origin_ns to the transcription callback
+    void trace_final_result(uint64_t origin_ns);
 
-    // Audio processing loop (offline mode)
-    void audio_processing_loop();
+    // Capture loop: reads source periods into the ring, never waits on the recognizer
+    void audio_capture_loop();
+    // Decoder loop: feeds queued periods to Vosk and reports final results
+    void audio_decoding_loop();
 
     // Removed all online mode related members and methods
 };
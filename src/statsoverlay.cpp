@@ -0,0 +1,69 @@
+// statsoverlay.cpp
+// Implementation file for the StatsOverlay class.
+
+#include "statsoverlay.h"
+#include <glibmm/main.h> // For Glib::signal_timeout
+#include <iomanip>
+#include <sstream>
+
+StatsOverlay::StatsOverlay(unsigned refresh_ms)
+    : m_refresh_ms(refresh_ms > 0 ? refresh_ms : 500),
+      m_last(RuntimeStats::instance().snapshot()),
+      m_last_time(std::chrono::steady_clock::now())
+{
+    set_halign(Gtk::ALIGN_START);
+    set_margin_left(10);
+    set_margin_right(10);
+    set_margin_bottom(5);
+    get_style_context()->add_class("stats-overlay");
+    set_no_show_all(true); // show_all() on the window leaves it alone
+    hide();
+}
+
+StatsOverlay::~StatsOverlay() {
+    m_refresh_connection.disconnect();
+}
+
+void StatsOverlay::set_active(bool active) {
+    if (active == this->active()) {
+        return;
+    }
+    if (!active) {
+        m_refresh_connection.disconnect();
+        hide();
+        return;
+    }
+    // The first refresh already shows rates, over a short interval
+    m_last = RuntimeStats::instance().snapshot();
+    m_last_time = std::chrono::steady_clock::now();
+    set_text("Collecting stats...");
+    show();
+    m_refresh_connection = Glib::signal_timeout().connect(sigc::mem_fun(*this, &StatsOverlay::on_refresh), m_refresh_ms);
+}
+
+bool StatsOverlay::on_refresh() {
+    RuntimeStats::Snapshot now = RuntimeStats::instance().snapshot();
+    auto now_time = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now_time - m_last_time).count();
+    set_text(format(now, m_last, seconds));
+    m_last = now;
+    m_last_time = now_time;
+    return true; // Keep refreshing until set_active(false)
+}
+
+std::string StatsOverlay::format(const RuntimeStats::Snapshot& now, const RuntimeStats::Snapshot& before, double seconds) {
+    if (seconds <= 0.0) {
+        seconds = 1.0;
+    }
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(0)
+         << "capture " << (now.frames_captured - before.frames_captured) / seconds << " frames/s, "
+         << now.capture_overruns << " overruns  |  decode RTF " << std::setprecision(2) << now.decode_rtf(before)
+         << ", chunk " << now.chunk_ms << " ms, ring " << now.ring_depth << '\n'
+         << "results " << now.results_emitted << ", queue " << now.queue_depth
+         << "  |  keys " << now.keystrokes_sent << std::setprecision(0)
+         << " (" << (now.keystrokes_sent - before.keystrokes_sent) / seconds << "/s)"
+         << "  |  inject " << std::setprecision(1) << now.injection_ns_last / 1e6 << " ms, mean "
+         << now.injection_mean_ms() << ", max " << now.injection_ns_max / 1e6;
+    return text.str();
+}
@@ -0,0 +1,39 @@
+// statsoverlay.h
+// Header file for the StatsOverlay class.
+// Label under the keys that shows RuntimeStats while it is active: capture rate and overruns,
+// decode real-time factor, chunk size and ring depth, results and result queue backlog,
+// keystrokes and injection latency. Rates cover the last refresh interval. Toggled with a
+// "stats" layout key or the control socket (VK_STATS_OVERLAY=1 starts with it shown);
+// nothing is sampled while it is hidden.
+
+#ifndef STATS_OVERLAY_H
+#define STATS_OVERLAY_H
+
+#include <gtkmm/label.h>
+#include <sigc++/sigc++.h>
+#include <chrono>
+#include <string>
+#include "runtimestats.h"
+
+class StatsOverlay : public Gtk::Label {
+public:
+    explicit StatsOverlay(unsigned refresh_ms = 500);
+    virtual ~StatsOverlay();
+
+    // Shows the overlay and starts refreshing it, or hides it and stops
+    void set_active(bool active);
+    bool active() const { return m_refresh_connection.connected(); }
+
+    // The overlay text for 'now' against 'before', taken 'seconds' apart
+    static std::string format(const RuntimeStats::Snapshot& now, const RuntimeStats::Snapshot& before, double seconds);
+
+private:
+    bool on_refresh();
+
+    unsigned m_refresh_ms;
+    sigc::connection m_refresh_connection;
+    RuntimeStats::Snapshot m_last;
+    std::chrono::steady_clock::time_point m_last_time;
+};
+
+#endif // STATS_OVERLAY_H
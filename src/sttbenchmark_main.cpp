@@ -0,0 +1,375 @@
+// sttbenchmark_main.cpp
+// Entry point of vk-stt-bench, the speech-to-text pipeline benchmark.
+// Replays a recorded fixture through SpeechToTextService's offline stream API, i.e. the same
+// VAD gate, recognizer feeding and result decoding the decoder thread runs, with ALSA capture
+// replaced by the file. For each chunk size it reports the real-time factor, the per-chunk
+// decode latency distribution, peak RSS and heap allocations per second, so regressions show
+// up before a new model or build is deployed.
+//
+// Fixtures may be WAV/raw files or the base64 forms kept in the repository
+// (test_audio.base64, and test_audio_payload.json's "audio_chunk_base64" field).
+//
+// Usage: vk-stt-bench [--model DIR] [--chunks N,N,...] [--repeat N] [--vad]
+//                     [--raw-rate HZ] [--raw-channels N] [--json] [FIXTURE]
+
+#include "speechtotextservice.h"
+#include "audiofilereader.h"
+#include "logger.h"
+#include <algorithm> // For std::sort
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>   // For std::getenv, std::atoi, std::malloc, std::free
+#include <cstring>   // For std::memcmp
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/resource.h> // For getrusage
+
+// Same default as the keyboard; VK_MODEL_PATH or --model override it
+static const char* DEFAULT_MODEL_PATH = "/home/android/dev/gtkmm-virtual-keyboard/vosk-linux-x86_64-0.3.45/model";
+static const char* DEFAULT_FIXTURE = "test_audio_payload.json";
+
+// --- Allocation counting: every operator new in the process goes through here ---
+
+static std::atomic<uint64_t> g_allocations(0);
+
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+// --- Fixture loading ---
+
+static bool decode_base64(const std::string& text, std::vector<unsigned char>& out) {
+    static const auto value_of = [](unsigned char c) -> int {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if (c >= '0' && c <= '9') return c - '0' + 52;
+        if (c == '+' || c == '-') return 62;
+        if (c == '/' || c == '_') return 63;
+        return -1;
+    };
+    out.clear();
+    out.reserve(text.size() / 4 * 3);
+    uint32_t accumulator = 0;
+    int bits = 0;
+    for (unsigned char c : text) {
+        if (c == '=') {
+            break;
+        }
+        int value = value_of(c);
+        if (value < 0) {
+            if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+                continue;
+            }
+            return false;
+        }
+        accumulator = (accumulator << 6) | static_cast<uint32_t>(value);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<unsigned char>((accumulator >> bits) & 0xFF));
+        }
+    }
+    return !out.empty();
+}
+
+// Returns the fixture's audio bytes: the file itself, its base64 decoding, or the base64
+// string value of "audio_chunk_base64" when it is a JSON payload.
+static bool load_fixture_bytes(const std::string& path, std::vector<unsigned char>& bytes) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "ERROR: Cannot open fixture: " << path << std::endl;
+        return false;
+    }
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (content.size() >= 4 && std::memcmp(content.data(), "RIFF", 4) == 0) {
+        bytes.assign(content.begin(), content.end());
+        return true;
+    }
+
+    size_t first = content.find_first_not_of(" \t\r\n");
+    if (first != std::string::npos && content[first] == '{') {
+        // The payload is a flat object; a full JSON parse isn't needed to find one string value
+        static const std::string key = "\"audio_chunk_base64\"";
+        size_t key_pos = content.find(key);
+        size_t open_quote = key_pos == std::string::npos ? key_pos : content.find('"', content.find(':', key_pos + key.size()));
+        size_t close_quote = open_quote == std::string::npos ? open_quote : content.find('"', open_quote + 1);
+        if (close_quote == std::string::npos) {
+            std::cerr << "ERROR: No \"audio_chunk_base64\" string in " << path << std::endl;
+            return false;
+        }
+        content = content.substr(open_quote + 1, close_quote - open_quote - 1);
+    }
+
+    if (decode_base64(content, bytes)) {
+        return true;
+    }
+    bytes.assign(content.begin(), content.end()); // Raw S16LE
+    return true;
+}
+
+static bool load_fixture(const std::string& path, unsigned raw_rate, unsigned raw_channels,
+                         std::vector<int16_t>& samples, unsigned& sample_rate) {
+    std::vector<unsigned char> bytes;
+    if (!load_fixture_bytes(path, bytes)) {
+        return false;
+    }
+    FILE* stream = fmemopen(bytes.data(), bytes.size(), "rb");
+    if (!stream) {
+        std::cerr << "ERROR: fmemopen failed for " << path << std::endl;
+        return false;
+    }
+    AudioFileReader reader;
+    if (!reader.open_stream(stream, path, true, raw_rate, raw_channels)) {
+        return false;
+    }
+    samples.clear();
+    std::vector<int16_t> block(4096);
+    while (size_t frames = reader.read(block.data(), block.size())) {
+        samples.insert(samples.end(), block.begin(), block.begin() + frames);
+    }
+    sample_rate = reader.sample_rate();
+    return !samples.empty();
+}
+
+// --- Measurement ---
+
+static long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // Kilobytes on Linux
+}
+
+struct RunReport {
+    size_t chunk_frames = 0;
+    size_t chunks = 0;
+    double audio_seconds = 0.0;
+    double wall_seconds = 0.0;
+    double p50_us = 0.0, p90_us = 0.0, p99_us = 0.0, max_us = 0.0, mean_us = 0.0;
+    uint64_t allocations = 0;
+    long peak_rss_kb = 0;
+    size_t results = 0;
+    std::string transcript;
+};
+
+static double percentile(const std::vector<double>& sorted, double q) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(q * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static std::vector<size_t> parse_chunk_list(const std::string& text) {
+    std::vector<size_t> chunks;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        int value = std::atoi(item.c_str());
+        if (value > 0) {
+            chunks.push_back(static_cast<size_t>(value));
+        }
+    }
+    return chunks;
+}
+
+static void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--model DIR] [--chunks N,N,...] [--repeat N] [--vad]\n"
+              << "       [--raw-rate HZ] [--raw-channels N] [--json] [FIXTURE]\n"
+              << "Chunk sizes are in frames at the fixture's rate (default 320,800,1600; 800 is the live period).\n"
+              << "FIXTURE defaults to " << DEFAULT_FIXTURE << "." << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (!std::getenv("VK_LOG_LEVEL")) {
+        Logger::instance().set_level(LogLevel::Warning);
+    }
+
+    const char* model_env = std::getenv("VK_MODEL_PATH");
+    std::string model_path = model_env ? model_env : DEFAULT_MODEL_PATH;
+    std::string fixture = DEFAULT_FIXTURE;
+    std::vector<size_t> chunk_sizes = { 320, 800, 1600 };
+    int repeat = 3;
+    bool use_vad = false;
+    bool json = false;
+    unsigned raw_rate = 16000;
+    unsigned raw_channels = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg == "--model" && has_value) {
+            model_path = argv[++i];
+        } else if (arg == "--chunks" && has_value) {
+            chunk_sizes = parse_chunk_list(argv[++i]);
+        } else if (arg == "--repeat" && has_value) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--raw-rate" && has_value) {
+            raw_rate = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--raw-channels" && has_value) {
+            raw_channels = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--vad") {
+            use_vad = true;
+        } else if (arg == "--json") {
+            json = true;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "ERROR: Unknown or incomplete option: " << arg << std::endl;
+            print_usage(argv[0]);
+            return 2;
+        } else {
+            fixture = arg;
+        }
+    }
+    if (chunk_sizes.empty()) {
+        std::cerr << "ERROR: No valid chunk size given." << std::endl;
+        return 2;
+    }
+
+    std::vector<int16_t> samples;
+    unsigned sample_rate = 0;
+    if (!load_fixture(fixture, raw_rate, raw_channels, samples, sample_rate)) {
+        std::cerr << "ERROR: Could not read audio from " << fixture << std::endl;
+        return 1;
+    }
+    double audio_seconds = static_cast<double>(samples.size()) / sample_rate;
+
+    size_t results = 0;
+    std::string transcript;
+    SpeechToTextService service([&](const std::string& text) {
+        ++results;
+        if (!transcript.empty()) {
+            transcript += ' ';
+        }
+        transcript += text;
+    });
+    service.set_vad_enabled(use_vad);
+    service.set_decoder_backend(decoder_backend_from_environment()); // VK_DECODER=gpu
+    ResultPostProcessor post_processor; // VK_MIN_WORD_CONF, VK_VOCABULARY, ... as in the keyboard
+    post_processor.load_from_environment();
+    service.set_post_processor_config(post_processor.config());
+    TranscriptJournalConfig journal_config; // VK_JOURNAL puts journaling on the measured decode path
+    journal_config.load_from_environment();
+    if (journal_config.enabled() && !service.set_transcript_journal(journal_config)) {
+        return 1;
+    }
+    auto load_start = std::chrono::steady_clock::now();
+    if (!service.init(model_path)) {
+        std::cerr << "ERROR: Could not load the model from " << model_path << std::endl;
+        return 1;
+    }
+    double load_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - load_start).count();
+    long model_rss_kb = peak_rss_kb();
+
+    std::vector<RunReport> reports;
+    std::vector<double> latencies_us;
+    for (size_t chunk_frames : chunk_sizes) {
+        RunReport report;
+        report.chunk_frames = chunk_frames;
+        latencies_us.clear();
+        latencies_us.reserve((samples.size() / chunk_frames + 1) * repeat);
+
+        for (int run = 0; run < repeat; ++run) {
+            results = 0;
+            transcript.clear();
+            if (!service.begin_offline_stream(static_cast<float>(sample_rate), chunk_frames)) {
+                return 1;
+            }
+            uint64_t allocations_before = g_allocations.load(std::memory_order_relaxed);
+            auto run_start = std::chrono::steady_clock::now();
+            for (size_t offset = 0; offset < samples.size(); offset += chunk_frames) {
+                size_t count = std::min(chunk_frames, samples.size() - offset);
+                auto chunk_start = std::chrono::steady_clock::now();
+                service.process_audio(samples.data() + offset, count);
+                auto chunk_end = std::chrono::steady_clock::now();
+                latencies_us.push_back(std::chrono::duration<double, std::micro>(chunk_end - chunk_start).count());
+            }
+            service.end_offline_stream();
+            report.wall_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - run_start).count();
+            report.allocations += g_allocations.load(std::memory_order_relaxed) - allocations_before;
+            report.audio_seconds += audio_seconds;
+        }
+
+        std::sort(latencies_us.begin(), latencies_us.end());
+        report.chunks = latencies_us.size();
+        double sum_us = 0.0;
+        for (double latency : latencies_us) {
+            sum_us += latency;
+        }
+        report.mean_us = report.chunks ? sum_us / report.chunks : 0.0;
+        report.p50_us = percentile(latencies_us, 0.50);
+        report.p90_us = percentile(latencies_us, 0.90);
+        report.p99_us = percentile(latencies_us, 0.99);
+        report.max_us = latencies_us.empty() ? 0.0 : latencies_us.back();
+        report.peak_rss_kb = peak_rss_kb(); // Process-wide high-water mark so far
+        report.results = results;
+        report.transcript = transcript;
+        reports.push_back(report);
+    }
+
+    SpeechToTextService::CaptureStats stats = service.get_capture_stats();
+    if (json) {
+        std::cout << "{\"fixture\":\"" << fixture << "\",\"sample_rate\":" << sample_rate
+                  << ",\"audio_seconds\":" << audio_seconds << ",\"repeat\":" << repeat
+                  << ",\"vad\":" << (use_vad ? "true" : "false")
+                  << ",\"gpu\":" << (service.gpu_decoding() ? "true" : "false") << ",\"model_load_seconds\":" << load_seconds
+                  << ",\"model_rss_kb\":" << model_rss_kb << ",\"frames_gated\":" << stats.frames_gated
+                  << ",\"words_dropped_low_conf\":" << stats.words_dropped_low_conf
+                  << ",\"results_ungated_conf\":" << stats.results_ungated_conf
+                  << ",\"results_journaled\":" << stats.results_journaled
+                  << ",\"runs\":[";
+        for (size_t i = 0; i < reports.size(); ++i) {
+            const RunReport& r = reports[i];
+            double rtf = r.audio_seconds > 0.0 ? r.wall_seconds / r.audio_seconds : 0.0;
+            std::cout << (i ? "," : "") << "{\"chunk_frames\":" << r.chunk_frames << ",\"chunks\":" << r.chunks
+                      << ",\"rtf\":" << rtf << ",\"mean_us\":" << r.mean_us << ",\"p50_us\":" << r.p50_us
+                      << ",\"p90_us\":" << r.p90_us << ",\"p99_us\":" << r.p99_us << ",\"max_us\":" << r.max_us
+                      << ",\"allocations_per_second\":" << (r.wall_seconds > 0.0 ? r.allocations / r.wall_seconds : 0.0)
+                      << ",\"allocations_per_chunk\":" << (r.chunks ? static_cast<double>(r.allocations) / r.chunks : 0.0)
+                      << ",\"peak_rss_kb\":" << r.peak_rss_kb << ",\"results\":" << r.results << '}';
+        }
+        std::cout << "]}" << std::endl;
+        return 0;
+    }
+
+    std::cout << "Fixture: " << fixture << " (" << audio_seconds << " s at " << sample_rate << " Hz, "
+              << repeat << " run(s) per chunk size, VAD " << (use_vad ? "on" : "off") << ")\n"
+              << "Model: " << model_path << " (loaded in " << load_seconds << " s, peak RSS " << model_rss_kb
+              << " KiB after load" << (service.gpu_decoding() ? ", GPU dictation" : "") << ")\n\n";
+    std::printf("%8s %8s %8s %10s %10s %10s %10s %12s %10s %11s\n", "chunk", "chunks", "rtf", "p50_us",
+                "p90_us", "p99_us", "max_us", "allocs/s", "allocs/ch", "rss_kib");
+    for (const RunReport& r : reports) {
+        std::printf("%8zu %8zu %8.3f %10.1f %10.1f %10.1f %10.1f %12.0f %10.2f %11ld\n", r.chunk_frames, r.chunks,
+                    r.audio_seconds > 0.0 ? r.wall_seconds / r.audio_seconds : 0.0, r.p50_us, r.p90_us, r.p99_us,
+                    r.max_us, r.wall_seconds > 0.0 ? r.allocations / r.wall_seconds : 0.0,
+                    r.chunks ? static_cast<double>(r.allocations) / r.chunks : 0.0, r.peak_rss_kb);
+    }
+    std::fflush(stdout);
+    // The transcript must not depend on the chunk size; print it once per size so a diff shows drift
+    for (const RunReport& r : reports) {
+        std::cout << "\n[" << r.chunk_frames << "] " << r.transcript;
+    }
+    std::cout << std::endl;
+    return 0;
+}
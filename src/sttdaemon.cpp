@@ -0,0 +1,422 @@
+// sttdaemon.cpp
+// Implementation file for the SttDaemon class.
+
+#include "sttdaemon.h"
+#include "logger.h"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib> // For std::getenv
+#include <cstring>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h> // For umask
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t MAX_HEADER_BYTES = 1024;
+
+void append_json_string(std::string& json, const std::string& text) {
+    json += '"';
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            json += '\\';
+            json += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            json += escaped;
+        } else {
+            json += static_cast<char>(c);
+        }
+    }
+    json += '"';
+}
+
+std::string result_line(const char* type, RecognizerPool::StreamId stream, const std::string& text) {
+    std::string line = "{\"type\":\"";
+    line += type;
+    line += "\",\"stream\":" + std::to_string(stream) + ",\"text\":";
+    append_json_string(line, text);
+    line += "}\n";
+    return line;
+}
+
+bool fill_address(const std::string& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        VK_LOG_ERROR("SttDaemon: Socket path too long: " << path);
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+void set_receive_timeout(int fd, int timeout_ms) {
+    timeval timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+}
+
+} // namespace
+
+SttDaemon::SttDaemon()
+    : m_listen_fd(-1),
+      m_wake_fd(-1)
+{
+}
+
+SttDaemon::~SttDaemon() {
+    shutdown();
+}
+
+std::string SttDaemon::default_socket_path() {
+    if (const char* socket_env = std::getenv("VK_STTD_SOCKET")) {
+        return socket_env;
+    }
+    if (const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR")) {
+        return std::string(runtime_dir) + "/vk-stt.sock";
+    }
+    return "/tmp/vk-stt-" + std::to_string(getuid()) + ".sock";
+}
+
+bool SttDaemon::init(const std::string& model_path, const Options& options) {
+    m_options = options;
+    m_socket_path = options.socket_path.empty() ? default_socket_path() : options.socket_path;
+    m_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_wake_fd < 0) {
+        VK_LOG_ERROR("SttDaemon: eventfd failed: " << std::strerror(errno));
+        return false;
+    }
+    if (!open_socket()) {
+        return false;
+    }
+    if (!m_pool.init(model_path, m_options.pool)) {
+        return false;
+    }
+    VK_LOG_INFO("SttDaemon: Serving " << m_socket_path << " (model at " << m_pool.model_sample_rate() << " Hz, "
+                << m_pool.worker_count() << " worker(s)).");
+    return true;
+}
+
+bool SttDaemon::open_socket() {
+    sockaddr_un address;
+    if (!fill_address(m_socket_path, address)) {
+        return false;
+    }
+    // Refuse to take over the socket of a daemon that is still running; replace a stale one
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe >= 0) {
+        bool in_use = connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        ::close(probe);
+        if (in_use) {
+            VK_LOG_ERROR("SttDaemon: Another daemon is already serving " << m_socket_path << ".");
+            return false;
+        }
+    }
+    unlink(m_socket_path.c_str());
+
+    m_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (m_listen_fd < 0) {
+        VK_LOG_ERROR("SttDaemon: socket failed: " << std::strerror(errno));
+        return false;
+    }
+    mode_t old_mask = umask(0077); // Owner-only: transcripts are private
+    int bound = bind(m_listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    umask(old_mask);
+    if (bound != 0 || listen(m_listen_fd, 16) != 0) {
+        VK_LOG_ERROR("SttDaemon: Cannot listen on " << m_socket_path << ": " << std::strerror(errno));
+        ::close(m_listen_fd);
+        m_listen_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+void SttDaemon::run(const std::atomic<bool>& stop) {
+    pollfd fds[2] = {
+        { m_listen_fd, POLLIN, 0 },
+        { m_wake_fd, POLLIN, 0 },
+    };
+    while (!stop.load(std::memory_order_relaxed)) {
+        int ready = poll(fds, 2, 200);
+        if (ready < 0 && errno != EINTR) {
+            VK_LOG_ERROR("SttDaemon: poll failed: " << std::strerror(errno));
+            break;
+        }
+        reap_setups(false);
+        if (ready <= 0) {
+            continue;
+        }
+        if (fds[1].revents & POLLIN) {
+            uint64_t count;
+            while (read(m_wake_fd, &count, sizeof(count)) == sizeof(count)) {
+            }
+            reap_finished();
+        }
+        if (fds[0].revents & POLLIN) {
+            accept_client();
+        }
+    }
+}
+
+void SttDaemon::shutdown() {
+    {
+        // Clients still being set up see their connection end and give up
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& setup : m_setups) {
+            if (setup->fd >= 0) {
+                ::shutdown(setup->fd, SHUT_RDWR);
+            }
+        }
+    }
+    reap_setups(true);
+    {
+        // New audio stops arriving; what was sent is still decoded and answered
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& entry : m_clients) {
+            ::shutdown(entry.second->fd, SHUT_RD);
+        }
+    }
+    m_pool.shutdown(); // Delivers every stream's last result and end message
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& entry : m_clients) {
+            ::close(entry.second->fd);
+        }
+        m_clients.clear();
+        m_finished.clear();
+    }
+    if (m_listen_fd >= 0) {
+        ::close(m_listen_fd);
+        m_listen_fd = -1;
+        unlink(m_socket_path.c_str());
+    }
+    if (m_wake_fd >= 0) {
+        ::close(m_wake_fd);
+        m_wake_fd = -1;
+    }
+}
+
+size_t SttDaemon::client_count() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_clients.size();
+}
+
+bool SttDaemon::read_header(int fd, std::string& line) {
+    line.clear();
+    char c;
+    while (line.size() < MAX_HEADER_BYTES) {
+        ssize_t got = recv(fd, &c, 1, 0);
+        if (got <= 0) {
+            return false; // Closed, or timed out
+        }
+        if (c == '\n') {
+            return true;
+        }
+        line += c;
+    }
+    return false;
+}
+
+void SttDaemon::send_error(int fd, const std::string& message) {
+    std::string line = "{\"type\":\"error\",\"message\":";
+    append_json_string(line, message);
+    line += "}\n";
+    send(fd, line.data(), line.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+void SttDaemon::send_line(Client& client, const std::string& line) {
+    std::lock_guard<std::mutex> lock(client.write_mutex);
+    if (client.dead) {
+        return;
+    }
+    // Never block the decode worker: results are small, so a full socket buffer means the
+    // client isn't reading at all
+    size_t sent = 0;
+    while (sent < line.size()) {
+        ssize_t n = send(client.fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            VK_LOG_WARNING("SttDaemon: Stream " << client.stream << " is not reading its results; disconnecting.");
+            client.dead = true;
+            ::shutdown(client.fd, SHUT_RDWR); // Its capture sees the end of the stream
+            return;
+        }
+        sent += static_cast<size_t>(n);
+    }
+}
+
+void SttDaemon::accept_client() {
+    int fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            VK_LOG_WARNING("SttDaemon: accept failed: " << std::strerror(errno));
+        }
+        return;
+    }
+    if (client_count() + m_setups.size() >= m_options.max_clients) {
+        send_error(fd, "too many clients");
+        ::close(fd);
+        return;
+    }
+    auto setup = std::make_unique<Setup>();
+    setup->fd = fd;
+    Setup& raw = *setup;
+    m_setups.push_back(std::move(setup));
+    raw.thread = std::thread(&SttDaemon::setup_client, this, std::ref(raw));
+}
+
+void SttDaemon::setup_client(Setup& setup) {
+    int fd = setup.fd; // Only this thread closes it until it is handed over
+    // A client only gets a bounded time for its header
+    set_receive_timeout(fd, m_options.setup_timeout_ms);
+    std::string header;
+    if (!read_header(fd, header)) {
+        abandon_setup(setup, "expected a JSON header line");
+        return;
+    }
+    AudioSourceConfig config;
+    config.backend = "file";
+    config.realtime = false; // The client paces the audio; the socket applies backpressure
+    bool partial = false;
+    try {
+        nlohmann::json json = header.empty() ? nlohmann::json::object() : nlohmann::json::parse(header);
+        config.sample_rate = json.value("sample_rate", 16000u);
+        config.channels = json.value("channels", 1u);
+        partial = json.value("partial", false);
+    } catch (const nlohmann::json::exception& e) {
+        abandon_setup(setup, std::string("bad header: ") + e.what());
+        return;
+    }
+    if (config.sample_rate < 8000 || config.sample_rate > 192000 || config.channels < 1 || config.channels > 8) {
+        abandon_setup(setup, "unsupported sample_rate or channels");
+        return;
+    }
+    set_receive_timeout(fd, 0); // The capture thread may wait for audio as long as it likes
+    // Opening the source reads the first bytes to tell WAV from raw PCM
+    pollfd first_audio = { fd, POLLIN, 0 };
+    if (poll(&first_audio, 1, m_options.setup_timeout_ms) <= 0) {
+        abandon_setup(setup, "no audio after the header");
+        return;
+    }
+    config.fd = fd;
+    config.period_frames = config.sample_rate / 50; // 20 ms
+    config.device = "client";
+
+    auto client = std::make_unique<Client>();
+    client->fd = fd;
+    Client* raw = client.get();
+    RecognizerPool::ResultCallback on_partial;
+    if (partial) {
+        on_partial = [raw](RecognizerPool::StreamId stream, const std::string& text) {
+            send_line(*raw, result_line("partial", stream, text));
+        };
+    }
+    RecognizerPool::StreamId id = 0;
+    {
+        // Held until "ready" is sent, so no result can overtake it
+        std::lock_guard<std::mutex> lock(raw->write_mutex);
+        id = m_pool.add_stream(config,
+            [raw](RecognizerPool::StreamId stream, const std::string& text) {
+                send_line(*raw, result_line("final", stream, text));
+            },
+            on_partial,
+            [this, raw](RecognizerPool::StreamId stream) {
+                send_line(*raw, "{\"type\":\"end\",\"stream\":" + std::to_string(stream) + "}\n");
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_finished.push_back(stream);
+                }
+                uint64_t one = 1;
+                if (write(m_wake_fd, &one, sizeof(one)) < 0) {
+                    VK_LOG_WARNING("SttDaemon: Cannot signal the end of stream " << stream);
+                }
+            });
+        if (id == 0) {
+            abandon_setup(setup, "cannot decode this audio");
+            return;
+        }
+        raw->stream = id;
+        std::string ready = "{\"type\":\"ready\",\"stream\":" + std::to_string(id) + ",\"sample_rate\":"
+                          + std::to_string(m_pool.model_sample_rate()) + "}\n";
+        send(fd, ready.data(), ready.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_clients[id] = std::move(client);
+        setup.fd = -1;
+        // A stream that ended before it was registered here was passed over by reap_finished()
+        if (std::find(m_finished.begin(), m_finished.end(), id) != m_finished.end()) {
+            uint64_t one = 1;
+            if (write(m_wake_fd, &one, sizeof(one)) < 0) {
+                VK_LOG_WARNING("SttDaemon: Cannot signal the end of stream " << id);
+            }
+        }
+    }
+    VK_LOG_INFO("SttDaemon: Client connected as stream " << id << " (" << config.sample_rate << " Hz, "
+                << config.channels << " channel(s)" << (partial ? ", partials" : "") << ").");
+    setup.done = true;
+}
+
+void SttDaemon::abandon_setup(Setup& setup, const std::string& message) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    send_error(setup.fd, message);
+    ::close(setup.fd);
+    setup.fd = -1;
+    setup.done = true;
+}
+
+void SttDaemon::reap_setups(bool all) {
+    for (auto it = m_setups.begin(); it != m_setups.end();) {
+        if (!all && !(*it)->done) {
+            ++it;
+            continue;
+        }
+        (*it)->thread.join();
+        it = m_setups.erase(it);
+    }
+}
+
+void SttDaemon::reap_finished() {
+    std::vector<RecognizerPool::StreamId> finished;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        finished.swap(m_finished);
+    }
+    for (RecognizerPool::StreamId id : finished) {
+        {
+            // Still being registered by its setup thread, which wakes the loop again after it
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_clients.find(id) == m_clients.end()) {
+                m_finished.push_back(id);
+                continue;
+            }
+        }
+        m_pool.remove_stream(id); // Capture has already ended; this only joins and frees it
+        release_client(id);
+    }
+}
+
+void SttDaemon::release_client(RecognizerPool::StreamId stream) {
+    std::unique_ptr<Client> client;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_clients.find(stream);
+        if (it == m_clients.end()) {
+            return;
+        }
+        client = std::move(it->second);
+        m_clients.erase(it);
+    }
+    ::close(client->fd);
+    VK_LOG_INFO("SttDaemon: Stream " << stream << " closed.");
+}
@@ -0,0 +1,111 @@
+// sttdaemon.h
+// Header file for the SttDaemon class.
+// Serves speech recognition to local clients over a Unix domain socket, so every program on
+// the desktop shares one loaded model and one RecognizerPool instead of loading its own.
+// Each connection is one stream: the client sends a single JSON header line, then raw audio
+// (S16LE at the header's rate and channels, or a WAV stream) until it shuts down its write
+// side. Results are pushed back on the same connection as they are recognized, one JSON
+// object per line; there is nothing to poll.
+//
+//   client -> daemon: {"sample_rate": 16000, "channels": 1, "partial": true}\n <PCM...>
+//   daemon -> client: {"type":"ready","stream":3,"sample_rate":16000}
+//                     {"type":"partial","stream":3,"text":"hello"}
+//                     {"type":"final","stream":3,"text":"hello world"}
+//                     {"type":"end","stream":3}               (then the daemon closes)
+//                     {"type":"error","message":"..."}        (bad header; then closed)
+//
+// All header fields are optional. Each new connection is set up on a thread of its own and
+// gets Options::setup_timeout_ms for its header and first audio; the accept loop never waits
+// on a client. Results are written without blocking the decode worker: a client that stops
+// reading them is disconnected. The socket is created owner-only.
+
+#ifndef STT_DAEMON_H
+#define STT_DAEMON_H
+
+#include "recognizerpool.h"
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class SttDaemon {
+public:
+    struct Options {
+        std::string socket_path;      // Empty: default_socket_path()
+        RecognizerPool::Options pool;
+        size_t max_clients = 64;      // Further connections are refused with an error message
+        int setup_timeout_ms = 2000;  // Time a new client has to send its header and first audio
+    };
+
+    SttDaemon();
+    ~SttDaemon();
+
+    SttDaemon(const SttDaemon&) = delete;
+    SttDaemon& operator=(const SttDaemon&) = delete;
+
+    // VK_STTD_SOCKET, else $XDG_RUNTIME_DIR/vk-stt.sock, else /tmp/vk-stt-<uid>.sock
+    static std::string default_socket_path();
+
+    // Loads the model into the pool and starts listening. Fails if another daemon is
+    // already serving the socket; a stale socket file is replaced.
+    bool init(const std::string& model_path, const Options& options);
+    // Accepts clients and reaps finished streams until 'stop' is set (checked every 200 ms)
+    void run(const std::atomic<bool>& stop);
+    // Disconnects every client (delivering their last results), stops the pool and
+    // removes the socket
+    void shutdown();
+
+    size_t client_count() const;
+    const std::string& socket_path() const { return m_socket_path; }
+
+private:
+    struct Client {
+        int fd = -1;
+        RecognizerPool::StreamId stream = 0;
+        std::mutex write_mutex;     // Results of one stream can come from two threads at its end
+        bool dead = false;          // Guarded by write_mutex: a write failed, nothing more is sent
+    };
+
+    // A connection that has not sent its header and first audio yet. Each one is set up on a
+    // short-lived thread of its own, so a slow client never holds up the accept loop.
+    struct Setup {
+        int fd = -1;                   // Guarded by m_mutex; -1 once it is a stream or closed
+        std::thread thread;
+        std::atomic<bool> done{false}; // The thread is about to return
+    };
+
+    bool open_socket();
+    void accept_client();
+    // Reads the header, waits for the first audio and adds the stream (setup thread)
+    void setup_client(Setup& setup);
+    // Sends 'message' and closes the connection of a setup that failed (setup thread)
+    void abandon_setup(Setup& setup, const std::string& message);
+    // Joins the setup threads that are done, or all of them
+    void reap_setups(bool all);
+    // Reads the header line byte by byte, so none of the audio after it is consumed
+    bool read_header(int fd, std::string& line);
+    // Removes the streams whose end was signalled and closes their connections
+    void reap_finished();
+    void release_client(RecognizerPool::StreamId stream);
+
+    // Sends one message line; marks the client dead (and shuts the socket) if it can't take it
+    static void send_line(Client& client, const std::string& line);
+    static void send_error(int fd, const std::string& message);
+
+    Options m_options;
+    std::string m_socket_path;
+    int m_listen_fd;
+    int m_wake_fd; // eventfd: a stream ended
+    RecognizerPool m_pool;
+
+    mutable std::mutex m_mutex; // Guards m_clients, m_finished and every Setup::fd
+    std::map<RecognizerPool::StreamId, std::unique_ptr<Client>> m_clients;
+    std::vector<RecognizerPool::StreamId> m_finished; // Ended streams not yet reaped
+    std::list<std::unique_ptr<Setup>> m_setups;       // Accept loop and shutdown() only
+};
+
+#endif // STT_DAEMON_H
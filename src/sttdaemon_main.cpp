@@ -0,0 +1,77 @@
+// sttdaemon_main.cpp
+// Entry point of vk-sttd, the local speech recognition daemon.
+// Loads the model once and serves any number of clients on a Unix domain socket through a
+// shared RecognizerPool (see sttdaemon.h for the protocol, vk_stt_client.py for a client).
+// Runs until interrupted.
+//
+// Usage: vk-sttd [--model DIR] [--socket PATH] [--workers N] [--no-pin] [--gpu] [--max-clients N]
+
+#include "sttdaemon.h"
+#include "batchrecognizer.h"
+#include "logger.h"
+#include <atomic>
+#include <csignal>
+#include <cstdlib> // For std::getenv, std::atoi
+#include <iostream>
+#include <string>
+
+// Same default as the keyboard; VK_MODEL_PATH or --model override it
+static const char* DEFAULT_MODEL_PATH = "/home/android/dev/gtkmm-virtual-keyboard/vosk-linux-x86_64-0.3.45/model";
+
+static std::atomic<bool> g_interrupted(false);
+
+static void on_signal(int) {
+    g_interrupted = true;
+}
+
+static void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--model DIR] [--socket PATH] [--workers N] [--no-pin] [--gpu]"
+              << " [--max-clients N]\n"
+              << "The socket defaults to $VK_STTD_SOCKET, else $XDG_RUNTIME_DIR/vk-stt.sock.\n"
+              << "--gpu decodes on the GPU (as does VK_DECODER=gpu), or on the CPU if there is none."
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    const char* model_env = std::getenv("VK_MODEL_PATH");
+    std::string model_path = model_env ? model_env : DEFAULT_MODEL_PATH;
+    SttDaemon::Options options;
+    options.pool.gpu = decoder_backend_from_environment() == DecoderBackend::Gpu;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg == "--model" && has_value) {
+            model_path = argv[++i];
+        } else if (arg == "--socket" && has_value) {
+            options.socket_path = argv[++i];
+        } else if (arg == "--workers" && has_value) {
+            options.pool.workers = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--no-pin") {
+            options.pool.pin_workers = false;
+        } else if (arg == "--gpu") {
+            options.pool.gpu = true;
+        } else if (arg == "--max-clients" && has_value) {
+            int max_clients = std::atoi(argv[++i]);
+            options.max_clients = max_clients > 0 ? static_cast<size_t>(max_clients) : options.max_clients;
+        } else {
+            std::cerr << "ERROR: Unknown or incomplete option: " << arg << std::endl;
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+
+    SttDaemon daemon;
+    if (!daemon.init(model_path, options)) {
+        return 1;
+    }
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+    std::cerr << "vk-sttd: listening on " << daemon.socket_path() << std::endl;
+    daemon.run(g_interrupted);
+    daemon.shutdown(); // Finishes every connected stream
+    return 0;
+}
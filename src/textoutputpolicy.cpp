@@ -0,0 +1,76 @@
+// textoutputpolicy.cpp
+// Implementation file for the TextOutputPolicy class.
+
+#include "textoutputpolicy.h"
+#include "logger.h"
+#include <cstdlib> // For std::getenv, std::strtoul
+
+TextOutputPolicy::TextOutputPolicy()
+    : m_paste_threshold(64),
+      m_default_paste_mode(TextOutputMode::PasteCtrlV)
+{
+}
+
+void TextOutputPolicy::set_paste_threshold(size_t characters) {
+    m_paste_threshold = characters;
+}
+
+void TextOutputPolicy::set_default_paste_mode(TextOutputMode mode) {
+    if (mode == TextOutputMode::PasteCtrlV || mode == TextOutputMode::PasteShiftInsert) {
+        m_default_paste_mode = mode;
+    }
+}
+
+void TextOutputPolicy::set_mode_for_window_class(const std::string& window_class, TextOutputMode mode) {
+    m_window_class_modes[window_class] = mode;
+}
+
+TextOutputMode TextOutputPolicy::choose(const std::string& window_class, size_t characters) const {
+    TextOutputMode mode = TextOutputMode::Auto;
+    auto it = m_window_class_modes.find(window_class);
+    if (it != m_window_class_modes.end()) {
+        mode = it->second;
+    }
+    if (mode != TextOutputMode::Auto) {
+        return mode;
+    }
+    return characters > m_paste_threshold ? m_default_paste_mode : TextOutputMode::Type;
+}
+
+bool TextOutputPolicy::parse_mode(const std::string& name, TextOutputMode& mode) {
+    if (name == "auto") mode = TextOutputMode::Auto;
+    else if (name == "type") mode = TextOutputMode::Type;
+    else if (name == "ctrl-v") mode = TextOutputMode::PasteCtrlV;
+    else if (name == "shift-insert") mode = TextOutputMode::PasteShiftInsert;
+    else return false;
+    return true;
+}
+
+void TextOutputPolicy::load_from_environment() {
+    const char* threshold_env = std::getenv("VK_PASTE_THRESHOLD");
+    if (threshold_env) {
+        m_paste_threshold = std::strtoul(threshold_env, nullptr, 10);
+    }
+
+    const char* modes_env = std::getenv("VK_OUTPUT_MODES");
+    if (!modes_env) {
+        return;
+    }
+    std::string modes(modes_env);
+    size_t start = 0;
+    while (start < modes.size()) {
+        size_t end = modes.find(',', start);
+        if (end == std::string::npos) {
+            end = modes.size();
+        }
+        std::string entry = modes.substr(start, end - start);
+        size_t colon = entry.rfind(':');
+        TextOutputMode mode;
+        if (colon != std::string::npos && parse_mode(entry.substr(colon + 1), mode)) {
+            set_mode_for_window_class(entry.substr(0, colon), mode);
+        } else if (!entry.empty()) {
+            VK_LOG_WARNING("Ignoring invalid VK_OUTPUT_MODES entry: " << entry);
+        }
+        start = end + 1;
+    }
+}
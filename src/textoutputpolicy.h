@@ -0,0 +1,51 @@
+// textoutputpolicy.h
+// Header file for the TextOutputPolicy class.
+// Decides how a transcript reaches the focused application: typed key by key through
+// XTest, or pasted through the CLIPBOARD/PRIMARY selection with one Ctrl+V or
+// Shift+Insert. Short texts are typed; texts longer than the paste threshold are pasted,
+// unless the target window's class has its own mode configured.
+
+#ifndef TEXT_OUTPUT_POLICY_H
+#define TEXT_OUTPUT_POLICY_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+enum class TextOutputMode {
+    Auto,            // Type below the paste threshold, paste (with the default paste keys) above it
+    Type,            // Always type key by key
+    PasteCtrlV,      // Paste with Ctrl+V (CLIPBOARD)
+    PasteShiftInsert // Paste with Shift+Insert (PRIMARY in terminals, CLIPBOARD in most toolkits)
+};
+
+class TextOutputPolicy {
+public:
+    TextOutputPolicy();
+
+    // Characters above which Auto mode pastes instead of typing
+    void set_paste_threshold(size_t characters);
+    size_t paste_threshold() const { return m_paste_threshold; }
+
+    // Paste keys used when Auto mode decides to paste
+    void set_default_paste_mode(TextOutputMode mode);
+
+    // Per-window-class override (matched against WM_CLASS class name, e.g. "XTerm")
+    void set_mode_for_window_class(const std::string& window_class, TextOutputMode mode);
+
+    // Resolves to Type, PasteCtrlV or PasteShiftInsert for a text of 'characters' length
+    TextOutputMode choose(const std::string& window_class, size_t characters) const;
+
+    // Reads VK_PASTE_THRESHOLD (characters) and VK_OUTPUT_MODES
+    // ("Class:mode,Class:mode" with mode one of auto, type, ctrl-v, shift-insert)
+    void load_from_environment();
+
+    static bool parse_mode(const std::string& name, TextOutputMode& mode);
+
+private:
+    size_t m_paste_threshold;
+    TextOutputMode m_default_paste_mode;
+    std::map<std::string, TextOutputMode> m_window_class_modes;
+};
+
+#endif // TEXT_OUTPUT_POLICY_H
@@ -0,0 +1,116 @@
+// transcribe_main.cpp
+// Entry point of vk-transcribe, the headless offline transcription tool.
+// Transcribes WAV or raw S16LE files (or stdin) with the same Vosk model the keyboard uses
+// and prints one line of text per input.
+//
+// Usage: vk-transcribe [--model DIR] [--jobs N] [--backend auto|batch|cpu]
+//                      [--raw-rate HZ] [--raw-channels N] [--chunk-ms MS] [FILE|-]...
+
+#include "batchtranscriber.h"
+#include "logger.h"
+#include <iostream>
+#include <chrono>
+#include <cstdlib> // For std::getenv, std::atoi
+#include <string>
+#include <vector>
+
+// Same default as the keyboard; VK_MODEL_PATH or --model override it
+static const char* DEFAULT_MODEL_PATH = "/home/android/dev/gtkmm-virtual-keyboard/vosk-linux-x86_64-0.3.45/model";
+
+static void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--model DIR] [--jobs N] [--backend auto|batch|cpu]\n"
+              << "       [--raw-rate HZ] [--raw-channels N] [--chunk-ms MS] [FILE|-]...\n"
+              << "Reads stdin when no file is given. WAV headers are detected; other input is raw S16LE."
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    // stdout carries the transcripts: keep informational log lines out of it unless asked for
+    if (!std::getenv("VK_LOG_LEVEL")) {
+        Logger::instance().set_level(LogLevel::Warning);
+    }
+
+    BatchTranscriber::Options options;
+    const char* model_env = std::getenv("VK_MODEL_PATH");
+    options.model_path = model_env ? model_env : DEFAULT_MODEL_PATH;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg == "--model" && has_value) {
+            options.model_path = argv[++i];
+        } else if (arg == "--jobs" && has_value) {
+            options.jobs = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--raw-rate" && has_value) {
+            options.raw_rate = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--raw-channels" && has_value) {
+            options.raw_channels = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--chunk-ms" && has_value) {
+            int chunk_ms = std::atoi(argv[++i]);
+            options.chunk_ms = chunk_ms > 0 ? static_cast<unsigned>(chunk_ms) : options.chunk_ms;
+        } else if (arg == "--backend" && has_value) {
+            std::string backend = argv[++i];
+            if (backend == "auto") {
+                options.backend = BatchTranscriber::Backend::Auto;
+            } else if (backend == "batch") {
+                options.backend = BatchTranscriber::Backend::Batch;
+            } else if (backend == "cpu") {
+                options.backend = BatchTranscriber::Backend::CpuThreads;
+            } else {
+                std::cerr << "ERROR: Unknown backend: " << backend << std::endl;
+                return 2;
+            }
+        } else if (arg.size() > 1 && arg[0] == '-' && arg != "-") {
+            std::cerr << "ERROR: Unknown or incomplete option: " << arg << std::endl;
+            print_usage(argv[0]);
+            return 2;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    if (inputs.empty()) {
+        inputs.push_back("-");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    BatchTranscriber transcriber(options);
+    std::vector<BatchTranscriber::StreamResult> results;
+    if (!transcriber.run(inputs, results)) {
+        return 1;
+    }
+    double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int exit_code = 0;
+    double audio_seconds = 0.0;
+    for (const auto& result : results) {
+        if (!result.ok) {
+            exit_code = 1;
+            continue;
+        }
+        audio_seconds += result.audio_seconds;
+        std::string text;
+        for (const auto& segment : result.segments) {
+            if (!text.empty()) {
+                text += ' ';
+            }
+            text += segment;
+        }
+        // Prefix with the input name only when there is more than one
+        if (results.size() > 1) {
+            std::cout << result.path << ": ";
+        }
+        std::cout << text << '\n';
+    }
+    std::cout.flush();
+
+    std::cerr << "vk-transcribe: " << results.size() << " stream(s), " << audio_seconds << " s of audio in "
+              << wall_seconds << " s ("
+              << (wall_seconds > 0.0 ? audio_seconds / wall_seconds : 0.0) << "x real-time, "
+              << (transcriber.backend_used() == BatchTranscriber::Backend::Batch ? "batch" : "cpu")
+              << " backend)" << std::endl;
+    return exit_code;
+}
@@ -0,0 +1,336 @@
+// transcriptjournal.cpp
+// Implementation file for the TranscriptJournal and TranscriptJournalReader classes.
+
+#include "transcriptjournal.h"
+#include "logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib> // For std::getenv, std::atol
+#include <cstring>
+#include <ctime>   // For clock_gettime
+#include <fcntl.h>
+#include <sys/file.h> // For flock
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace journal_format;
+
+namespace {
+
+const char JOURNAL_MAGIC[8] = { 'V', 'K', 'J', 'R', 'N', 'L', '\0', '\0' };
+
+// Checks a mapped header; 'capacity' is the number of records the mapping holds
+bool valid_header(const Header* header, uint64_t capacity, const std::string& path) {
+    if (std::memcmp(header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0) {
+        VK_LOG_ERROR("TranscriptJournal: " << path << " is not a transcript journal.");
+        return false;
+    }
+    if (header->version != VERSION || header->record_size != RECORD_SIZE) {
+        VK_LOG_ERROR("TranscriptJournal: " << path << " has version " << header->version
+                     << " with " << header->record_size << "-byte records (expected " << VERSION
+                     << ", " << RECORD_SIZE << ").");
+        return false;
+    }
+    if (header->record_count.load(std::memory_order_acquire) > capacity) {
+        VK_LOG_ERROR("TranscriptJournal: " << path << " is truncated.");
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+TranscriptJournalConfig::TranscriptJournalConfig()
+    : reserve_records(4096) // 4 MiB, a few thousand utterances
+{
+}
+
+void TranscriptJournalConfig::load_from_environment() {
+    if (const char* path_env = std::getenv("VK_JOURNAL")) {
+        path = path_env;
+    }
+    if (const char* records_env = std::getenv("VK_JOURNAL_RECORDS")) {
+        long records = std::atol(records_env);
+        reserve_records = static_cast<size_t>(std::max(16L, records));
+    }
+}
+
+TranscriptJournal::TranscriptJournal()
+    : m_fd(-1),
+      m_map(nullptr),
+      m_map_size(0),
+      m_header(nullptr),
+      m_capacity(0),
+      m_next_sequence(0),
+      m_reserve_records(0),
+      m_entries_written(0)
+{
+}
+
+TranscriptJournal::~TranscriptJournal() {
+    close();
+}
+
+bool TranscriptJournal::open(const std::string& path, size_t reserve_records) {
+    close();
+    m_reserve_records = std::max<size_t>(1, reserve_records);
+
+    // Transcripts are private: owner-only, like a shell history
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (m_fd < 0) {
+        VK_LOG_ERROR("TranscriptJournal: Cannot open " << path << ": " << std::strerror(errno));
+        return false;
+    }
+    // A second writer would interleave its records with ours
+    if (flock(m_fd, LOCK_EX | LOCK_NB) != 0) {
+        VK_LOG_ERROR("TranscriptJournal: " << path << " is already being written by another process.");
+        close();
+        return false;
+    }
+    struct stat st;
+    if (fstat(m_fd, &st) != 0) {
+        VK_LOG_ERROR("TranscriptJournal: Cannot stat " << path << ": " << std::strerror(errno));
+        close();
+        return false;
+    }
+    size_t file_size = static_cast<size_t>(st.st_size);
+    bool fresh = (file_size == 0);
+    if (fresh) {
+        file_size = (m_reserve_records + 1) * RECORD_SIZE;
+        if (ftruncate(m_fd, static_cast<off_t>(file_size)) != 0) {
+            VK_LOG_ERROR("TranscriptJournal: Cannot size " << path << ": " << std::strerror(errno));
+            close();
+            return false;
+        }
+    } else if (file_size < 2 * RECORD_SIZE || file_size % RECORD_SIZE != 0) {
+        VK_LOG_ERROR("TranscriptJournal: " << path << " is not a transcript journal.");
+        close();
+        return false;
+    }
+
+    m_map = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (m_map == MAP_FAILED) {
+        m_map = nullptr;
+        VK_LOG_ERROR("TranscriptJournal: Cannot map " << path << ": " << std::strerror(errno));
+        close();
+        return false;
+    }
+    m_map_size = file_size;
+    m_header = static_cast<Header*>(m_map);
+    m_capacity = file_size / RECORD_SIZE - 1;
+
+    // A writer killed between sizing the file and writing the header leaves it all zeros
+    static const char ZERO_MAGIC[8] = {};
+    if (!fresh && std::memcmp(m_header->magic, ZERO_MAGIC, sizeof(ZERO_MAGIC)) == 0) {
+        fresh = true;
+    }
+    if (fresh) {
+        std::memcpy(m_header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        m_header->version = VERSION;
+        m_header->record_size = RECORD_SIZE;
+        m_header->record_count.store(0, std::memory_order_release);
+    } else if (!valid_header(m_header, m_capacity, path)) {
+        close();
+        return false;
+    }
+
+    uint64_t count = m_header->record_count.load(std::memory_order_acquire);
+    m_next_sequence = count > 0 ? record(count - 1)->sequence + 1 : 0;
+    VK_LOG_INFO("TranscriptJournal: Journaling to " << path << " (" << m_next_sequence << " entries, room for "
+                << m_capacity - count << " more records).");
+    return true;
+}
+
+void TranscriptJournal::close() {
+    if (m_map) {
+        munmap(m_map, m_map_size); // Dirty pages stay in the page cache and are written back
+        m_map = nullptr;
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd); // Also releases the flock
+        m_fd = -1;
+    }
+    m_header = nullptr;
+    m_map_size = 0;
+    m_capacity = 0;
+}
+
+Record* TranscriptJournal::record(uint64_t index) const {
+    return reinterpret_cast<Record*>(static_cast<char*>(m_map) + (index + 1) * RECORD_SIZE);
+}
+
+bool TranscriptJournal::grow(size_t records) {
+    uint64_t capacity = m_capacity + std::max(records, m_reserve_records);
+    size_t size = static_cast<size_t>((capacity + 1) * RECORD_SIZE);
+    if (ftruncate(m_fd, static_cast<off_t>(size)) != 0) {
+        VK_LOG_ERROR("TranscriptJournal: Cannot grow the journal: " << std::strerror(errno));
+        return false;
+    }
+    void* map = mremap(m_map, m_map_size, size, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED) {
+        VK_LOG_ERROR("TranscriptJournal: Cannot remap the journal: " << std::strerror(errno));
+        return false;
+    }
+    m_map = map;
+    m_map_size = size;
+    m_header = static_cast<Header*>(m_map);
+    m_capacity = capacity;
+    VK_LOG_DEBUG("TranscriptJournal: Grown to " << m_capacity << " records.");
+    return true;
+}
+
+bool TranscriptJournal::append(std::string_view text, const RecognizedWord* words, size_t word_count) {
+    if (!m_header) {
+        return false;
+    }
+    size_t records = std::max<size_t>(1, std::max((text.size() + TEXT_PER_RECORD - 1) / TEXT_PER_RECORD,
+                                                  (word_count + WORDS_PER_RECORD - 1) / WORDS_PER_RECORD));
+    uint64_t count = m_header->record_count.load(std::memory_order_relaxed); // Only this thread writes it
+    if (count + records > m_capacity && !grow(records)) {
+        return false;
+    }
+
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t wall_time_ns = static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+
+    size_t text_offset = 0;
+    size_t word_offset = 0;
+    for (size_t part = 0; part < records; ++part) {
+        Record* out = record(count + part);
+        size_t text_length = std::min(TEXT_PER_RECORD, text.size() - text_offset);
+        size_t words_here = std::min(WORDS_PER_RECORD, word_count - word_offset);
+        out->sequence = m_next_sequence;
+        out->wall_time_ns = wall_time_ns;
+        out->text_length = static_cast<uint16_t>(text_length);
+        out->word_count = static_cast<uint16_t>(words_here);
+        out->flags = (part + 1 < records) ? CONTINUED : 0;
+        out->part = static_cast<uint16_t>(part);
+        std::memcpy(out->text, text.data() + text_offset, text_length);
+        for (size_t i = 0; i < words_here; ++i) {
+            out->words[i] = JournalWordTiming { words[word_offset + i].start, words[word_offset + i].end };
+        }
+        text_offset += text_length;
+        word_offset += words_here;
+    }
+    // Publishes the entry: readers never look past record_count
+    m_header->record_count.store(count + records, std::memory_order_release);
+    m_next_sequence++;
+    m_entries_written.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+TranscriptJournalReader::TranscriptJournalReader()
+    : m_fd(-1),
+      m_map(nullptr),
+      m_map_size(0),
+      m_header(nullptr),
+      m_capacity(0)
+{
+}
+
+TranscriptJournalReader::~TranscriptJournalReader() {
+    close();
+}
+
+bool TranscriptJournalReader::open(const std::string& path) {
+    close();
+    m_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_fd < 0) {
+        VK_LOG_ERROR("TranscriptJournal: Cannot open " << path << ": " << std::strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(m_fd, &st) != 0 || st.st_size < static_cast<off_t>(2 * RECORD_SIZE)) {
+        VK_LOG_ERROR("TranscriptJournal: " << path << " is not a transcript journal.");
+        close();
+        return false;
+    }
+    size_t file_size = static_cast<size_t>(st.st_size);
+    void* map = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, m_fd, 0);
+    if (map == MAP_FAILED) {
+        VK_LOG_ERROR("TranscriptJournal: Cannot map " << path << ": " << std::strerror(errno));
+        close();
+        return false;
+    }
+    m_map = map;
+    m_map_size = file_size;
+    m_header = static_cast<const Header*>(m_map);
+    m_capacity = file_size / RECORD_SIZE - 1;
+    if (!valid_header(m_header, m_capacity, path)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void TranscriptJournalReader::close() {
+    if (m_map) {
+        munmap(const_cast<void*>(m_map), m_map_size);
+        m_map = nullptr;
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_header = nullptr;
+    m_map_size = 0;
+    m_capacity = 0;
+}
+
+const Record* TranscriptJournalReader::record(uint64_t index) const {
+    return reinterpret_cast<const Record*>(static_cast<const char*>(m_map) + (index + 1) * RECORD_SIZE);
+}
+
+bool TranscriptJournalReader::read_entry(uint64_t first, uint64_t last, JournalEntry& entry) const {
+    const Record* head = record(first);
+    entry.sequence = head->sequence;
+    entry.wall_time_ns = head->wall_time_ns;
+    entry.text.clear();
+    entry.words.clear();
+    for (uint64_t index = first; index <= last; ++index) {
+        const Record* part = record(index);
+        if (part->sequence != head->sequence || part->part != index - first ||
+            part->text_length > TEXT_PER_RECORD || part->word_count > WORDS_PER_RECORD) {
+            VK_LOG_ERROR("TranscriptJournal: Malformed record " << index << ".");
+            return false;
+        }
+        entry.text.append(part->text, part->text_length);
+        entry.words.insert(entry.words.end(), part->words, part->words + part->word_count);
+    }
+    return true;
+}
+
+bool TranscriptJournalReader::read_last(size_t count, std::vector<JournalEntry>& entries) const {
+    entries.clear();
+    if (!m_header) {
+        return false;
+    }
+    // Records appended after the file outgrew our mapping are out of reach until reopened
+    uint64_t published = m_header->record_count.load(std::memory_order_acquire);
+    uint64_t end = std::min(published, m_capacity);
+    if (end < published) {
+        while (end > 0 && (record(end - 1)->flags & CONTINUED)) {
+            end--; // The rest of that entry lies past the mapping
+        }
+    }
+    while (end > 0 && entries.size() < count) {
+        uint64_t last = end - 1;
+        if (record(last)->flags & CONTINUED) {
+            VK_LOG_ERROR("TranscriptJournal: Entry at record " << last << " is unterminated.");
+            return false;
+        }
+        uint64_t first = last;
+        while (first > 0 && (record(first - 1)->flags & CONTINUED)) {
+            first--;
+        }
+        entries.emplace_back();
+        if (!read_entry(first, last, entries.back())) {
+            return false;
+        }
+        end = first;
+    }
+    std::reverse(entries.begin(), entries.end());
+    return true;
+}
@@ -0,0 +1,151 @@
+// transcriptjournal.h
+// Header file for the TranscriptJournal and TranscriptJournalReader classes.
+// Opt-in (VK_JOURNAL=<path>) record of every final dictation result, so text that went to
+// the wrong window (or nowhere) can be read back or retyped instead of spoken again.
+// The journal is an append-only file of fixed-size records, memory-mapped by the writer:
+// appending an entry is a memcpy into the mapping and a release store of the record count
+// in the file header, with no system call (the wall clock is read through the vDSO). The
+// file is grown by another reservation of records when it fills up. The kernel writes the
+// pages back, so entries survive the process crashing; an entry whose records were not
+// all written before the count was updated is never seen.
+//
+// File layout (native byte order): a RECORD_SIZE header ("VKJRNL", version, record size,
+// record count), then the records. An entry whose text or word timings don't fit one
+// record continues in the following records, all flagged CONTINUED but the last.
+
+#ifndef TRANSCRIPT_JOURNAL_H
+#define TRANSCRIPT_JOURNAL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "recognitionresult.h"
+
+// Settings for journaling final results
+struct TranscriptJournalConfig {
+    std::string path;       // Journal file; empty disables journaling
+    size_t reserve_records; // Records the file is created with, and grown by when full
+
+    TranscriptJournalConfig();
+
+    // VK_JOURNAL and VK_JOURNAL_RECORDS
+    void load_from_environment();
+
+    bool enabled() const { return !path.empty(); }
+};
+
+// Start and end of one word, in seconds from the start of the recognizer's stream
+struct JournalWordTiming {
+    float start;
+    float end;
+};
+
+// One journaled result, as read back by TranscriptJournalReader
+struct JournalEntry {
+    uint64_t sequence;     // Entry number, counting from 0 over the life of the file
+    int64_t wall_time_ns;  // CLOCK_REALTIME when it was journaled
+    std::string text;
+    std::vector<JournalWordTiming> words; // The i-th space-separated word of 'text'; empty if not reported
+};
+
+namespace journal_format {
+
+constexpr size_t RECORD_SIZE = 1024;
+constexpr size_t WORDS_PER_RECORD = 64;
+constexpr size_t TEXT_PER_RECORD = 488;
+constexpr uint32_t VERSION = 1;
+constexpr uint16_t CONTINUED = 1; // Record flag: the entry goes on in the next record
+
+struct Header {
+    char magic[8]; // "VKJRNL\0\0"
+    uint32_t version;
+    uint32_t record_size;
+    std::atomic<uint64_t> record_count; // Records holding complete entries
+    char reserved[RECORD_SIZE - 24];
+};
+
+struct Record {
+    uint64_t sequence;
+    int64_t wall_time_ns;
+    uint16_t text_length; // Bytes of 'text' used by this record
+    uint16_t word_count;  // Entries of 'words' used by this record
+    uint16_t flags;
+    uint16_t part;        // Index of this record within its entry
+    JournalWordTiming words[WORDS_PER_RECORD];
+    char text[TEXT_PER_RECORD];
+};
+
+static_assert(sizeof(Header) == RECORD_SIZE, "journal header must fill one record");
+static_assert(sizeof(Record) == RECORD_SIZE, "journal records must be RECORD_SIZE bytes");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "record_count is shared through the mapping");
+
+} // namespace journal_format
+
+class TranscriptJournal {
+public:
+    TranscriptJournal();
+    ~TranscriptJournal();
+
+    TranscriptJournal(const TranscriptJournal&) = delete;
+    TranscriptJournal& operator=(const TranscriptJournal&) = delete;
+
+    // Opens (creating it if needed) and maps the journal. An existing file is appended to;
+    // one that isn't a journal is left alone and false is returned.
+    bool open(const std::string& path, size_t reserve_records);
+    void close();
+    bool is_open() const { return m_header != nullptr; }
+
+    // Appends one entry. 'words' are the timings of the space-separated words of 'text'
+    // (may be empty). Only grows the file (ftruncate + mremap) when it is full.
+    bool append(std::string_view text, const RecognizedWord* words, size_t word_count);
+
+    uint64_t entries_written() const { return m_entries_written.load(std::memory_order_relaxed); }
+
+private:
+    // Extends the file and the mapping to hold at least 'records' more records
+    bool grow(size_t records);
+    journal_format::Record* record(uint64_t index) const;
+
+    int m_fd;
+    void* m_map;
+    size_t m_map_size;
+    journal_format::Header* m_header; // Start of m_map, nullptr while closed
+    uint64_t m_capacity;              // Records the mapping holds
+    uint64_t m_next_sequence;
+    size_t m_reserve_records;
+    std::atomic<uint64_t> m_entries_written;
+};
+
+class TranscriptJournalReader {
+public:
+    TranscriptJournalReader();
+    ~TranscriptJournalReader();
+
+    TranscriptJournalReader(const TranscriptJournalReader&) = delete;
+    TranscriptJournalReader& operator=(const TranscriptJournalReader&) = delete;
+
+    // Maps the journal read-only. Entries appended later by a running writer are seen as
+    // long as they fit in the part of the file that existed at open().
+    bool open(const std::string& path);
+    void close();
+
+    // The last 'count' complete entries, oldest first (all of them for SIZE_MAX).
+    // Returns false if the journal is not open or a record chain is malformed.
+    bool read_last(size_t count, std::vector<JournalEntry>& entries) const;
+
+private:
+    const journal_format::Record* record(uint64_t index) const;
+    // Joins records [first, last] into one entry
+    bool read_entry(uint64_t first, uint64_t last, JournalEntry& entry) const;
+
+    int m_fd;
+    const void* m_map;
+    size_t m_map_size;
+    const journal_format::Header* m_header;
+    uint64_t m_capacity;
+};
+
+#endif // TRANSCRIPT_JOURNAL_H
@@ -0,0 +1,430 @@
+// typebenchmark_main.cpp
+// Entry point of vk-type-bench, the typing-throughput benchmark for the X11 injection layer.
+// Types a corpus of mixed ASCII, symbol and non-Latin text through XKeyInjector (the code the
+// keyboard sends transcripts with) and checks what the server received with an XRecord
+// listener. Each output strategy is reported as one JSON object: characters per second,
+// flushes of key events, X round-trips (XSync and requests that wait for a reply), and
+// dropped, mis-shifted, wrong and extra characters.
+//
+// Strategies:
+//   per-key      one XFlush per key event (no batching)
+//   batched      one XFlush per line, as the keyboard types transcripts
+//   sync         batched, with an XSync barrier (VK_XSYNC_BARRIER=1)
+//   xlib-lookup  batched, resolving every character with XKeysymToKeycode instead of the
+//                keycode table (no spare-keycode remapping)
+//   clipboard    own CLIPBOARD, send Ctrl+V and fetch the selection as the paste target would
+//
+// The benchmark types into whatever has the focus, so it refuses to run without an explicit
+// display; start a private server first, e.g.  Xvfb :99 &  vk-type-bench --display :99
+//
+// Usage: vk-type-bench --display NAME [--corpus FILE] [--repeat N]
+//                      [--strategies NAME,NAME,...] [--idle-timeout-ms MS]
+
+#include "xkeyinjector.h"
+#include "xrecordlistener.h"
+#include "keycodetable.h"
+#include "logger.h"
+#include <X11/XKBlib.h> // For XkbKeycodeToKeysym
+#include <X11/Xatom.h>
+#include <X11/keysym.h>
+#include <algorithm> // For std::sort, std::min
+#include <chrono>
+#include <cstdlib>   // For std::getenv, std::atoi
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// Mixed corpus used when no --corpus file is given: plain words, every ASCII symbol
+// (Shift level), Latin-1 (AltGr or remapped), and characters on no layout (remapped)
+static const char* DEFAULT_CORPUS[] = {
+    "the quick brown fox jumps over the lazy dog 0123456789",
+    "THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG",
+    "!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~",
+    "Mixed Case, punctuation; and (brackets) [like] {these}: 50% of $20 = $10!",
+    "caf\xc3\xa9 na\xc3\xafve \xc3\xbc" "ber stra\xc3\x9f" "e \xc3\xa5ngstr\xc3\xb6m",
+    "\xce\xa9 \xcf\x80 \xe2\x86\x92 \xe2\x82\xac \xe2\x80\x94 \xe2\x80\x9cquoted\xe2\x80\x9d",
+    "\xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 \xe4\xbd\xa0\xe5\xa5\xbd \xf0\x9f\x98\x80",
+};
+
+struct StrategyReport {
+    std::string name;
+    size_t characters = 0;  // Characters in the corpus (times repeat)
+    size_t received = 0;    // Characters the listener decoded
+    double seconds = 0.0;   // Sum over lines of first send to last key event
+    uint64_t flushes = 0;     // XFlush/XSync calls that sent key events
+    uint64_t round_trips = 0; // XSync calls and replies waited for (injector and clipboard probe)
+    uint64_t key_events = 0;
+    size_t untyped = 0;     // Characters the injector had no key for
+    size_t dropped = 0;
+    size_t mis_shifted = 0; // Right key, wrong Shift/AltGr level
+    size_t wrong = 0;
+    size_t extra = 0;
+    size_t timeouts = 0;    // Lines that did not arrive completely before the idle timeout
+    int stuck_modifiers = 0;
+    std::vector<double> line_ms;
+};
+
+// Aligns what was received against what was typed (edit distance) and classifies the errors
+static void compare(const std::vector<unsigned long>& expected, const std::vector<unsigned long>& got,
+                    const KeycodeTable& table, StrategyReport& report) {
+    size_t n = expected.size(), m = got.size();
+    std::vector<unsigned> cost((n + 1) * (m + 1));
+    auto at = [&](size_t i, size_t j) -> unsigned& { return cost[i * (m + 1) + j]; };
+    for (size_t i = 0; i <= n; ++i) at(i, 0) = static_cast<unsigned>(i);
+    for (size_t j = 0; j <= m; ++j) at(0, j) = static_cast<unsigned>(j);
+    for (size_t i = 1; i <= n; ++i) {
+        for (size_t j = 1; j <= m; ++j) {
+            unsigned substitute = at(i - 1, j - 1) + (expected[i - 1] == got[j - 1] ? 0 : 1);
+            at(i, j) = std::min({ substitute, at(i - 1, j) + 1, at(i, j - 1) + 1 });
+        }
+    }
+    for (size_t i = n, j = m; i > 0 || j > 0;) {
+        if (i > 0 && j > 0 && at(i, j) == at(i - 1, j - 1) + (expected[i - 1] == got[j - 1] ? 0 : 1)) {
+            if (expected[i - 1] != got[j - 1]) {
+                KeyStroke want, have;
+                bool same_key = table.lookup_char(expected[i - 1], want) && table.lookup_char(got[j - 1], have) &&
+                                want.keycode == have.keycode;
+                (same_key ? report.mis_shifted : report.wrong)++;
+            }
+            --i;
+            --j;
+        } else if (i > 0 && at(i, j) == at(i - 1, j) + 1) {
+            report.dropped++;
+            --i;
+        } else {
+            report.extra++;
+            --j;
+        }
+    }
+}
+
+// Types a line with Xlib lookups per character, as before the keycode table existed
+static size_t type_with_xlib_lookup(XKeyInjector& injector, const std::vector<unsigned long>& code_points) {
+    Display* display = injector.display();
+    size_t untyped = 0;
+    injector.begin_batch();
+    for (unsigned long code_point : code_points) {
+        KeySym keysym = code_point_to_keysym(code_point);
+        KeyCode keycode = XKeysymToKeycode(display, keysym);
+        if (keycode == 0) {
+            untyped++;
+            continue;
+        }
+        KeyStroke stroke { keycode, KeyStroke::NONE };
+        if (XkbKeycodeToKeysym(display, keycode, 0, 0) != keysym) {
+            stroke.modifiers = XkbKeycodeToKeysym(display, keycode, 0, 1) == keysym ? KeyStroke::SHIFT
+                             : XkbKeycodeToKeysym(display, keycode, 0, 2) == keysym ? KeyStroke::ALTGR
+                             : KeyStroke::SHIFT | KeyStroke::ALTGR;
+        }
+        injector.send_stroke(stroke);
+    }
+    injector.end_batch();
+    return untyped;
+}
+
+// Owns CLIPBOARD on one connection and fetches it as the paste target on another
+class ClipboardProbe {
+public:
+    bool open(const char* display_name) {
+        if (m_owner && m_target) {
+            return true;
+        }
+        m_owner = XOpenDisplay(display_name);
+        m_target = XOpenDisplay(display_name);
+        if (!m_owner || !m_target) {
+            return false;
+        }
+        m_owner_window = XCreateSimpleWindow(m_owner, DefaultRootWindow(m_owner), 0, 0, 1, 1, 0, 0, 0);
+        m_target_window = XCreateSimpleWindow(m_target, DefaultRootWindow(m_target), 0, 0, 1, 1, 0, 0, 0);
+        m_clipboard = XInternAtom(m_owner, "CLIPBOARD", False);
+        m_utf8 = XInternAtom(m_owner, "UTF8_STRING", False);
+        m_property = XInternAtom(m_target, "VK_BENCH_PASTE", False);
+        XSync(m_owner, False);
+        XSync(m_target, False);
+        return true;
+    }
+
+    ~ClipboardProbe() {
+        if (m_owner) XCloseDisplay(m_owner);
+        if (m_target) XCloseDisplay(m_target);
+    }
+
+    // Takes ownership of CLIPBOARD with 'text'; one round-trip, like the keyboard's Gdk sync
+    void own(const std::string& text, uint64_t& round_trips) {
+        m_text = text;
+        XSetSelectionOwner(m_owner, m_clipboard, m_owner_window, CurrentTime);
+        XSync(m_owner, False);
+        round_trips++;
+    }
+
+    // Converts the selection into the target window and returns its contents. The request
+    // itself is only flushed; reading the property back is the round-trip.
+    bool fetch(std::string& text, std::chrono::milliseconds timeout, uint64_t& round_trips) {
+        XConvertSelection(m_target, m_clipboard, m_utf8, m_property, m_target_window, CurrentTime);
+        XFlush(m_target);
+        auto deadline = Clock::now() + timeout;
+        while (Clock::now() < deadline) {
+            serve_requests();
+            while (XPending(m_target) > 0) {
+                XEvent event;
+                XNextEvent(m_target, &event);
+                if (event.type == SelectionNotify && event.xselection.property != None) {
+                    return read_property(text, round_trips);
+                }
+                if (event.type == SelectionNotify) {
+                    return false; // Refused
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        return false;
+    }
+
+private:
+    void serve_requests() {
+        while (XPending(m_owner) > 0) {
+            XEvent event;
+            XNextEvent(m_owner, &event);
+            if (event.type != SelectionRequest) {
+                continue;
+            }
+            const XSelectionRequestEvent& request = event.xselectionrequest;
+            XSelectionEvent reply {};
+            reply.type = SelectionNotify;
+            reply.display = m_owner;
+            reply.requestor = request.requestor;
+            reply.selection = request.selection;
+            reply.target = request.target;
+            reply.time = request.time;
+            reply.property = None;
+            if (request.target == m_utf8 && request.property != None) {
+                XChangeProperty(m_owner, request.requestor, request.property, m_utf8, 8, PropModeReplace,
+                                reinterpret_cast<const unsigned char*>(m_text.data()), static_cast<int>(m_text.size()));
+                reply.property = request.property;
+            }
+            XSendEvent(m_owner, request.requestor, False, 0, reinterpret_cast<XEvent*>(&reply));
+            XFlush(m_owner);
+        }
+    }
+
+    bool read_property(std::string& text, uint64_t& round_trips) {
+        Atom type;
+        int format;
+        unsigned long items, bytes_after;
+        unsigned char* data = nullptr;
+        round_trips++;
+        if (XGetWindowProperty(m_target, m_target_window, m_property, 0, 1 << 20, True, AnyPropertyType,
+                               &type, &format, &items, &bytes_after, &data) != Success || !data) {
+            return false;
+        }
+        text.assign(reinterpret_cast<char*>(data), items);
+        XFree(data);
+        return true;
+    }
+
+    Display* m_owner = nullptr;
+    Display* m_target = nullptr;
+    Window m_owner_window = None;
+    Window m_target_window = None;
+    Atom m_clipboard = None;
+    Atom m_utf8 = None;
+    Atom m_property = None;
+    std::string m_text;
+};
+
+static std::vector<std::string> split_list(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+static void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " --display NAME [--corpus FILE] [--repeat N]\n"
+              << "       [--strategies per-key,batched,sync,xlib-lookup,clipboard] [--idle-timeout-ms MS]\n"
+              << "Types into the given display; use a private Xvfb server, not your desktop." << std::endl;
+}
+
+static void print_report(const StrategyReport& r, bool last) {
+    std::vector<double> sorted = r.line_ms;
+    std::sort(sorted.begin(), sorted.end());
+    double p50 = sorted.empty() ? 0.0 : sorted[sorted.size() / 2];
+    double max = sorted.empty() ? 0.0 : sorted.back();
+    std::cout << "    {\"strategy\":\"" << r.name << "\",\"characters\":" << r.characters
+              << ",\"received\":" << r.received << ",\"seconds\":" << r.seconds
+              << ",\"chars_per_second\":" << (r.seconds > 0.0 ? r.characters / r.seconds : 0.0)
+              << ",\"flushes\":" << r.flushes
+              << ",\"flushes_per_char\":" << (r.characters ? static_cast<double>(r.flushes) / r.characters : 0.0)
+              << ",\"round_trips\":" << r.round_trips
+              << ",\"round_trips_per_char\":" << (r.characters ? static_cast<double>(r.round_trips) / r.characters : 0.0)
+              << ",\"key_events\":" << r.key_events << ",\"untyped\":" << r.untyped << ",\"dropped\":" << r.dropped
+              << ",\"mis_shifted\":" << r.mis_shifted << ",\"wrong\":" << r.wrong << ",\"extra\":" << r.extra
+              << ",\"timeouts\":" << r.timeouts << ",\"stuck_modifiers\":" << r.stuck_modifiers
+              << ",\"line_ms_p50\":" << p50 << ",\"line_ms_max\":" << max << '}' << (last ? "\n" : ",\n");
+}
+
+int main(int argc, char* argv[]) {
+    if (!std::getenv("VK_LOG_LEVEL")) {
+        Logger::instance().set_level(LogLevel::Warning);
+    }
+
+    std::string display_name;
+    std::string corpus_path;
+    int repeat = 5;
+    std::vector<std::string> strategies = { "per-key", "batched", "sync", "xlib-lookup", "clipboard" };
+    std::chrono::milliseconds idle_timeout(500);
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg == "--display" && has_value) {
+            display_name = argv[++i];
+        } else if (arg == "--corpus" && has_value) {
+            corpus_path = argv[++i];
+        } else if (arg == "--repeat" && has_value) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--strategies" && has_value) {
+            strategies = split_list(argv[++i]);
+        } else if (arg == "--idle-timeout-ms" && has_value) {
+            idle_timeout = std::chrono::milliseconds(std::max(1, std::atoi(argv[++i])));
+        } else {
+            std::cerr << "ERROR: Unknown or incomplete option: " << arg << std::endl;
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (display_name.empty()) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<std::string> corpus;
+    if (corpus_path.empty()) {
+        corpus.assign(std::begin(DEFAULT_CORPUS), std::end(DEFAULT_CORPUS));
+    } else {
+        std::ifstream file(corpus_path);
+        if (!file) {
+            std::cerr << "ERROR: Cannot open corpus: " << corpus_path << std::endl;
+            return 1;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            if (!line.empty()) {
+                corpus.push_back(line);
+            }
+        }
+    }
+
+    XKeyInjector injector;
+    if (!injector.open(display_name.c_str()) || !injector.available()) {
+        std::cerr << "ERROR: Cannot inject keys into " << display_name << " (display or XTest missing)." << std::endl;
+        return 1;
+    }
+    XRecordListener listener;
+    if (!listener.start(display_name.c_str())) {
+        std::cerr << "ERROR: Cannot record key events on " << display_name << " (RECORD missing?)." << std::endl;
+        return 1;
+    }
+    ClipboardProbe clipboard;
+
+    std::vector<StrategyReport> reports;
+    std::vector<unsigned long> expected, got;
+    for (const std::string& strategy : strategies) {
+        StrategyReport report;
+        report.name = strategy;
+        if (strategy != "per-key" && strategy != "batched" && strategy != "sync" &&
+            strategy != "xlib-lookup" && strategy != "clipboard") {
+            std::cerr << "ERROR: Unknown strategy: " << strategy << std::endl;
+            return 2;
+        }
+        if (strategy == "clipboard" && !clipboard.open(display_name.c_str())) {
+            std::cerr << "ERROR: Cannot open connections for the clipboard strategy." << std::endl;
+            return 1;
+        }
+        KeyEventBatch& batch = injector.key_batch();
+        batch.set_max_pending(strategy == "per-key" ? 1 : 256);
+        batch.set_sync_barrier(strategy == "sync");
+        uint64_t events_before = listener.key_events();
+
+        for (int run = 0; run < repeat; ++run) {
+            for (const std::string& line : corpus) {
+                decode_utf8(line, expected);
+                report.characters += expected.size();
+                listener.clear();
+                uint64_t flushes_before = batch.flush_count();
+                uint64_t syncs_before = batch.sync_count() + injector.remap_sync_count();
+                uint64_t chords_before = listener.chords();
+
+                auto start = Clock::now();
+                Clock::time_point end = start;
+                if (strategy == "clipboard") {
+                    std::string pasted;
+                    clipboard.own(line, report.round_trips);
+                    KeyStroke v_stroke;
+                    injector.begin_batch();
+                    injector.send_keysym(XK_Control_L, true);
+                    if (injector.keycode_table().lookup_char('v', v_stroke)) {
+                        injector.send_stroke(v_stroke);
+                    }
+                    injector.send_keysym(XK_Control_L, false);
+                    injector.end_batch();
+                    bool ok = listener.wait_for_chords(chords_before + 1, idle_timeout) &&
+                              clipboard.fetch(pasted, idle_timeout, report.round_trips);
+                    end = Clock::now();
+                    report.timeouts += ok ? 0 : 1;
+                    decode_utf8(pasted, got);
+                } else {
+                    size_t untyped = strategy == "xlib-lookup" ? type_with_xlib_lookup(injector, expected)
+                                                               : injector.type_text(line);
+                    report.untyped += untyped;
+                    if (!listener.wait_for_characters(expected.size() - untyped, idle_timeout)) {
+                        report.timeouts++;
+                    }
+                    listener.take(got, end);
+                    if (end < start) {
+                        end = Clock::now(); // Nothing arrived
+                    }
+                }
+                report.flushes += batch.flush_count() - flushes_before;
+                report.round_trips += batch.sync_count() + injector.remap_sync_count() - syncs_before;
+                report.received += got.size();
+                double line_seconds = std::chrono::duration<double>(end - start).count();
+                report.seconds += line_seconds;
+                report.line_ms.push_back(line_seconds * 1000.0);
+                compare(expected, got, injector.keycode_table(), report);
+            }
+        }
+        report.key_events = listener.key_events() - events_before;
+        report.stuck_modifiers = listener.held_modifiers();
+        reports.push_back(report);
+        std::cerr << "vk-type-bench: " << strategy << " done." << std::endl;
+    }
+    listener.stop();
+
+    size_t corpus_characters = 0;
+    for (const std::string& line : corpus) {
+        decode_utf8(line, expected);
+        corpus_characters += expected.size();
+    }
+    std::cout << "{\n  \"display\":\"" << display_name << "\",\"corpus_lines\":" << corpus.size()
+              << ",\"corpus_characters\":" << corpus_characters << ",\"repeat\":" << repeat
+              << ",\"keymap_changes\":" << listener.mapping_changes() << ",\n  \"results\":[\n";
+    for (size_t i = 0; i < reports.size(); ++i) {
+        print_report(reports[i], i + 1 == reports.size());
+    }
+    std::cout << "  ]\n}" << std::endl;
+    return 0;
+}
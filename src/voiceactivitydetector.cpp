@@ -0,0 +1,143 @@
+// voiceactivitydetector.cpp
+// Implementation file for the VoiceActivityDetector class.
+
+#include "voiceactivitydetector.h"
+#include <algorithm> // For std::copy_n, std::max
+#include <cmath>     // For std::sqrt
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+VoiceActivityDetector::VoiceActivityDetector()
+    : m_config{300.0f, 3.0f, 0.45f, 400, 300},
+      m_period_samples(0),
+      m_hangover_periods(0),
+      m_hangover_left(0),
+      m_open(false),
+      m_noise_floor(0.0f),
+      m_preroll_next(0),
+      m_preroll_count(0)
+{
+}
+
+void VoiceActivityDetector::set_config(const Config& config) {
+    m_config = config;
+}
+
+void VoiceActivityDetector::reset(size_t period_samples, unsigned sample_rate) {
+    m_period_samples = period_samples;
+    unsigned period_ms = (period_samples > 0 && sample_rate > 0)
+        ? static_cast<unsigned>(period_samples * 1000 / sample_rate) : 50;
+    if (period_ms == 0) {
+        period_ms = 1;
+    }
+    // Round up so short windows still cover at least one period
+    m_hangover_periods = (m_config.hangover_ms + period_ms - 1) / period_ms;
+    size_t preroll_periods = (m_config.preroll_ms + period_ms - 1) / period_ms;
+
+    m_preroll.assign(preroll_periods * period_samples, 0);
+    m_preroll_slot_samples.assign(preroll_periods, 0);
+    m_preroll_next = 0;
+    m_preroll_count = 0;
+    m_hangover_left = 0;
+    m_open = false;
+    m_noise_floor = 0.0f;
+}
+
+VoiceActivityDetector::Decision VoiceActivityDetector::process(const int16_t* samples, size_t count) {
+    Features features = analyze(samples, count);
+    bool speech = is_speech(features);
+
+    if (!speech) {
+        // Track the room noise slowly so a door slam doesn't raise the threshold for long
+        m_noise_floor = (m_noise_floor == 0.0f) ? features.rms : 0.95f * m_noise_floor + 0.05f * features.rms;
+    }
+
+    if (m_open) {
+        if (speech) {
+            m_hangover_left = m_hangover_periods;
+            return Decision::Decode;
+        }
+        if (m_hangover_left > 0) {
+            --m_hangover_left;
+            return Decision::Decode;
+        }
+        m_open = false;
+        push_preroll(samples, count);
+        return Decision::Close;
+    }
+
+    if (speech) {
+        m_open = true;
+        m_hangover_left = m_hangover_periods;
+        return Decision::Open;
+    }
+    push_preroll(samples, count);
+    return Decision::Skip;
+}
+
+bool VoiceActivityDetector::is_speech(const Features& features) const {
+    float threshold = std::max(m_config.min_rms, m_noise_floor * m_config.noise_ratio);
+    return features.rms >= threshold && features.zcr <= m_config.max_zcr;
+}
+
+void VoiceActivityDetector::push_preroll(const int16_t* samples, size_t count) {
+    size_t slots = m_preroll_slot_samples.size();
+    if (slots == 0) {
+        return;
+    }
+    count = std::min(count, m_period_samples);
+    std::copy_n(samples, count, m_preroll.data() + m_preroll_next * m_period_samples);
+    m_preroll_slot_samples[m_preroll_next] = count;
+    m_preroll_next = (m_preroll_next + 1) % slots;
+    if (m_preroll_count < slots) {
+        ++m_preroll_count; // Otherwise the oldest period was just overwritten
+    }
+}
+
+VoiceActivityDetector::Features VoiceActivityDetector::analyze(const int16_t* samples, size_t count) {
+    Features features { 0.0f, 0.0f };
+    if (count == 0) {
+        return features;
+    }
+
+    uint64_t sum_squares = 0;
+    size_t crossings = 0;
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    // Eight samples per step. madd squares and adds pairs; the pair sum is at most 2^31,
+    // which fits an unsigned 32-bit lane, so zero-extend to 64 bits before accumulating.
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128(); // Two 64-bit lanes
+    for (; i + 8 < count; i += 8) {
+        __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+        __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i + 1));
+
+        __m128i squares = _mm_madd_epi16(cur, cur);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(squares, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(squares, zero));
+
+        // Sign bits differ between neighbours -> one crossing per set lane
+        __m128i differ = _mm_srai_epi16(_mm_xor_si128(cur, next), 15);
+        crossings += __builtin_popcount(_mm_movemask_epi8(_mm_packs_epi16(differ, zero)));
+    }
+    alignas(16) uint64_t lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    sum_squares = lanes[0] + lanes[1];
+#endif
+
+    // Scalar tail (or the whole buffer without SSE2)
+    for (; i < count; ++i) {
+        int32_t s = samples[i];
+        sum_squares += static_cast<uint64_t>(s * s);
+        if (i + 1 < count && ((samples[i] ^ samples[i + 1]) < 0)) {
+            ++crossings;
+        }
+    }
+
+    features.rms = static_cast<float>(std::sqrt(static_cast<double>(sum_squares) / count));
+    features.zcr = static_cast<float>(crossings) / count;
+    return features;
+}
@@ -0,0 +1,86 @@
+// voiceactivitydetector.h
+// Header file for the VoiceActivityDetector class.
+// A cheap energy/zero-crossing gate that runs on each captured period before it reaches
+// the recognizer. Silent periods are kept in a short pre-roll buffer instead of being decoded;
+// when speech starts the pre-roll is fed first so word onsets aren't clipped, and the gate
+// stays open for a hangover window after the last speech period.
+
+#ifndef VOICE_ACTIVITY_DETECTOR_H
+#define VOICE_ACTIVITY_DETECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class VoiceActivityDetector {
+public:
+    struct Config {
+        float min_rms;       // Absolute speech threshold (S16 RMS); ~300 is about -40 dBFS
+        float noise_ratio;   // Speech must also be this many times louder than the noise floor
+        float max_zcr;       // Zero-crossing rate (crossings per sample) above which loud audio is treated as noise
+        unsigned hangover_ms; // Gate stays open this long after the last speech period
+        unsigned preroll_ms;  // Audio replayed in front of a speech onset
+    };
+
+    // What the caller should do with the period just passed to process()
+    enum class Decision {
+        Skip,   // Silence: don't decode (the period went into the pre-roll)
+        Open,   // Speech onset: feed the pre-roll (for_each_preroll), then this period
+        Decode, // Speech or hangover: decode this period
+        Close   // Hangover expired: don't decode, flush the recognizer's final result
+    };
+
+    // Signal features of one period
+    struct Features {
+        float rms;
+        float zcr;
+    };
+
+    VoiceActivityDetector();
+
+    void set_config(const Config& config);
+    const Config& config() const { return m_config; }
+
+    // Sizes the pre-roll for the capture format and closes the gate. Allocates, so call it
+    // before streaming starts, not from the decoder loop.
+    void reset(size_t period_samples, unsigned sample_rate);
+
+    // Classifies one period and updates the gate
+    Decision process(const int16_t* samples, size_t count);
+
+    // Calls fn(samples, count) for each buffered pre-roll period, oldest first, and empties it
+    template <typename Fn>
+    void for_each_preroll(Fn&& fn) {
+        size_t slots = m_preroll_slot_samples.size();
+        for (size_t i = 0; i < m_preroll_count; ++i) {
+            size_t slot = (m_preroll_next + slots - m_preroll_count + i) % slots;
+            fn(m_preroll.data() + slot * m_period_samples, m_preroll_slot_samples[slot]);
+        }
+        m_preroll_count = 0;
+    }
+
+    bool is_open() const { return m_open; }
+    float noise_floor() const { return m_noise_floor; }
+
+    // RMS and zero-crossing rate of 'count' samples (SSE2 when available)
+    static Features analyze(const int16_t* samples, size_t count);
+
+private:
+    Config m_config;
+    size_t m_period_samples;
+    unsigned m_hangover_periods;
+    unsigned m_hangover_left;
+    bool m_open;
+    float m_noise_floor; // Running RMS estimate of the room noise, updated on silent periods
+
+    // Circular pre-roll of the most recent silent periods
+    std::vector<int16_t> m_preroll;
+    std::vector<size_t> m_preroll_slot_samples;
+    size_t m_preroll_next;
+    size_t m_preroll_count;
+
+    bool is_speech(const Features& features) const;
+    void push_preroll(const int16_t* samples, size_t count);
+};
+
+#endif // VOICE_ACTIVITY_DETECTOR_H
@@ -0,0 +1,187 @@
+// xkeyinjector.cpp
+// Implementation file for the XKeyInjector class.
+
+#include "xkeyinjector.h"
+#include "logger.h"
+#include <cstdlib> // For std::getenv
+#include <string>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+
+static std::string keysym_name(KeySym keysym) {
+    const char* name = XKeysymToString(keysym);
+    return name ? name : "UNKNOWN_KEYSYM";
+}
+
+XKeyInjector::XKeyInjector()
+    : m_display(nullptr),
+      m_xtest_available(false),
+      m_batch_depth(0),
+      m_remap_sync_count(0)
+{
+}
+
+XKeyInjector::~XKeyInjector() {
+    close();
+}
+
+bool XKeyInjector::open(const char* display_name) {
+    close();
+    m_display = XOpenDisplay(display_name);
+    if (!m_display) {
+        VK_LOG_ERROR("Could not open X display. Global key events will not work.");
+        return false;
+    }
+
+    int major_opcode, first_event, first_error;
+    if (!XQueryExtension(m_display, "XTEST", &major_opcode, &first_event, &first_error)) {
+        VK_LOG_WARNING("XTest extension not available. Global key events may not work as expected.");
+        m_xtest_available = false;
+    } else {
+        m_xtest_available = true;
+        VK_LOG_DEBUG("XTest extension available.");
+    }
+
+    m_key_batch.set_display(m_display);
+    m_keycode_table.build(m_display);
+    m_keysym_remapper.find_spare_keycodes(m_display);
+    // VK_XSYNC_BARRIER=1 waits for the server to process each batch before returning
+    const char* sync_env = std::getenv("VK_XSYNC_BARRIER");
+    m_key_batch.set_sync_barrier(sync_env && std::string(sync_env) == "1");
+    return true;
+}
+
+void XKeyInjector::close() {
+    if (!m_display) {
+        return;
+    }
+    m_key_batch.flush();
+    m_keysym_remapper.restore(m_display);
+    m_key_batch.set_display(nullptr);
+    XCloseDisplay(m_display);
+    m_display = nullptr;
+    m_xtest_available = false;
+    m_batch_depth = 0;
+    VK_LOG_DEBUG("X display closed.");
+}
+
+void XKeyInjector::send_keysym(KeySym keysym, bool is_press) {
+    if (!available()) {
+        VK_LOG_ERROR("Cannot send global key event - XTest not available or display not open.");
+        return;
+    }
+
+    // Convert KeySym to KeyCode, falling back to Xlib if the table doesn't know the KeySym
+    KeyStroke stroke;
+    KeyCode keycode = m_keycode_table.lookup_keysym(keysym, stroke) ? stroke.keycode : XKeysymToKeycode(m_display, keysym);
+    if (keycode == 0) {
+        VK_LOG_WARNING("No KeyCode for KeySym: " << keysym_name(keysym));
+        return;
+    }
+
+    send_keycode(keycode, is_press);
+    VK_LOG_DEBUG("Sent global key event: " << keysym_name(keysym) << " (KeyCode: " << (int)keycode << "), " << (is_press ? "Press" : "Release"));
+}
+
+void XKeyInjector::send_keycode(KeyCode keycode, bool is_press) {
+    if (!available()) {
+        return;
+    }
+    // Queue the event; outside a batch it is sent immediately
+    m_key_batch.queue(keycode, is_press);
+    if (m_batch_depth == 0) {
+        m_key_batch.flush();
+    }
+}
+
+void XKeyInjector::send_stroke(const KeyStroke& stroke) {
+    if (stroke.modifiers & KeyStroke::ALTGR) {
+        send_keysym(XK_ISO_Level3_Shift, true);
+    }
+    if (stroke.modifiers & KeyStroke::SHIFT) {
+        send_keysym(XK_Shift_L, true);
+    }
+    send_keycode(stroke.keycode, true);
+    send_keycode(stroke.keycode, false);
+    if (stroke.modifiers & KeyStroke::SHIFT) {
+        send_keysym(XK_Shift_L, false);
+    }
+    if (stroke.modifiers & KeyStroke::ALTGR) {
+        send_keysym(XK_ISO_Level3_Shift, false);
+    }
+}
+
+void XKeyInjector::begin_batch() {
+    if (m_batch_depth++ == 0) {
+        // Pick up keymap changes (MappingNotify) before resolving any keycodes for this batch
+        if (m_keycode_table.refresh_if_changed(m_display)) {
+            m_keysym_remapper.find_spare_keycodes(m_display);
+        }
+    }
+}
+
+void XKeyInjector::end_batch() {
+    if (m_batch_depth > 0 && --m_batch_depth == 0) {
+        m_key_batch.flush();
+        if (m_keysym_remapper.active()) {
+            // Let the server process every event that uses a remapped keycode, then free the spares
+            XSync(m_display, False);
+            m_remap_sync_count++;
+            m_keysym_remapper.restore(m_display);
+            XFlush(m_display);
+        }
+    }
+}
+
+size_t XKeyInjector::type_text(const std::string& text) {
+    // Decode once; multi-byte characters from non-English models are typed as whole code points
+    decode_utf8(text, m_code_points);
+    size_t untyped = 0;
+    begin_batch();
+    for (size_t i = 0; i < m_code_points.size(); ++i) {
+        unsigned long code_point = m_code_points[i];
+        KeyStroke stroke;
+        if (m_keycode_table.lookup_char(code_point, stroke) || m_keysym_remapper.lookup(code_point, stroke)) {
+            send_stroke(stroke);
+        } else if (remap_upcoming_characters(i) && m_keysym_remapper.lookup(code_point, stroke)) {
+            send_stroke(stroke);
+        } else {
+            VK_LOG_WARNING("Unhandled transcribed character: U+" << std::hex << code_point << std::dec);
+            untyped++;
+        }
+    }
+    end_batch();
+    return untyped;
+}
+
+bool XKeyInjector::remap_upcoming_characters(size_t from) {
+    if (!m_display || m_keysym_remapper.capacity() == 0) {
+        return false;
+    }
+    // Events queued for the previous assignment must reach the server before the mapping changes,
+    // and, as in end_batch(), be processed by it before spares in use are rebound
+    m_key_batch.flush();
+    if (m_keysym_remapper.active()) {
+        XSync(m_display, False);
+        m_remap_sync_count++;
+    }
+
+    // Bind this character and the next unmapped ones in the text, one spare keycode each
+    m_keysym_remapper.begin_batch();
+    for (size_t i = from; i < m_code_points.size() && !m_keysym_remapper.full(); ++i) {
+        KeyStroke stroke;
+        if (!m_keycode_table.lookup_char(m_code_points[i], stroke)) {
+            m_keysym_remapper.assign(m_code_points[i]);
+        }
+    }
+    return m_keysym_remapper.commit(m_display);
+}
+
+void XKeyInjector::erase_chars(size_t count) {
+    begin_batch();
+    for (size_t i = 0; i < count; ++i) {
+        send_keysym(XK_BackSpace, true);
+        send_keysym(XK_BackSpace, false);
+    }
+    end_batch();
+}
@@ -0,0 +1,74 @@
+// xkeyinjector.h
+// Header file for the XKeyInjector class.
+// Owns the X display connection used for synthetic input and everything needed to turn
+// text into XTest key events: the keycode table, the spare-keycode remapper for characters
+// missing from the keymap, and the event batch. The Keyboard widget adds its latched
+// modifier buttons on top; the typing benchmark drives it directly without GTK.
+
+#ifndef X_KEY_INJECTOR_H
+#define X_KEY_INJECTOR_H
+
+#include <X11/Xlib.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "keyeventbatch.h"
+#include "keycodetable.h"
+#include "keysymremapper.h"
+
+class XKeyInjector {
+public:
+    XKeyInjector();
+    ~XKeyInjector(); // Closes the display
+
+    XKeyInjector(const XKeyInjector&) = delete;
+    XKeyInjector& operator=(const XKeyInjector&) = delete;
+
+    // Opens the display (nullptr = $DISPLAY), checks for XTest and builds the keycode table.
+    // Returns false if no display could be opened; XTest may still be missing afterwards.
+    bool open(const char* display_name = nullptr);
+    void close();
+
+    Display* display() const { return m_display; }
+    bool available() const { return m_display && m_xtest_available; }
+
+    // Raw key events. Outside a batch each one is flushed immediately.
+    void send_keysym(KeySym keysym, bool is_press);
+    void send_keycode(KeyCode keycode, bool is_press);
+
+    // Press and release a stroke with only the Shift/AltGr level it needs
+    void send_stroke(const KeyStroke& stroke);
+
+    // Events sent between begin_batch() and the matching end_batch() go out together.
+    // Calls may nest; the outermost begin picks up keymap changes and the outermost end
+    // flushes and releases any remapped spare keycodes.
+    void begin_batch();
+    void end_batch();
+
+    // Types UTF-8 text key by key, remapping spare keycodes for characters not on the keymap.
+    // Returns the number of characters that could not be typed.
+    size_t type_text(const std::string& text);
+
+    // Sends 'count' BackSpaces
+    void erase_chars(size_t count);
+
+    const KeycodeTable& keycode_table() const { return m_keycode_table; }
+    KeyEventBatch& key_batch() { return m_key_batch; }
+    // XSync round-trips made before remapped keycodes were rebound or released
+    uint64_t remap_sync_count() const { return m_remap_sync_count; }
+
+private:
+    // Binds spare keycodes to the unmapped characters of m_code_points starting at 'from'
+    bool remap_upcoming_characters(size_t from);
+
+    Display* m_display;
+    bool m_xtest_available;
+    KeycodeTable m_keycode_table;     // Character/KeySym -> KeyCode + level, rebuilt on MappingNotify
+    KeysymRemapper m_keysym_remapper; // Spare keycodes bound to characters missing from the keymap
+    KeyEventBatch m_key_batch;        // Pending XTest events for the current batch
+    int m_batch_depth;                // Nesting depth of begin_batch()
+    uint64_t m_remap_sync_count;
+    std::vector<unsigned long> m_code_points; // Decoded text being typed (reused buffer)
+};
+
+#endif // X_KEY_INJECTOR_H
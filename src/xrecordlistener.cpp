@@ -0,0 +1,228 @@
+// xrecordlistener.cpp
+// Implementation file for the XRecordListener class.
+
+#include "xrecordlistener.h"
+#include "keycodetable.h" // For keysym_to_code_point
+#include "logger.h"
+#include <algorithm> // For std::max
+#include <X11/Xutil.h>  // For XConvertCase
+#include <X11/keysym.h>
+#include <X11/Xproto.h> // For xEvent, xChangeKeyboardMappingReq
+
+XRecordListener::XRecordListener()
+    : m_control_display(nullptr),
+      m_data_display(nullptr),
+      m_context(0),
+      m_min_keycode(0),
+      m_max_keycode(0),
+      m_keysyms_per_keycode(0),
+      m_shift_down(0),
+      m_level3_down(0),
+      m_control_down(0),
+      m_last_event(std::chrono::steady_clock::now()),
+      m_key_events(0),
+      m_chords(0),
+      m_mapping_changes(0)
+{
+}
+
+XRecordListener::~XRecordListener() {
+    stop();
+}
+
+bool XRecordListener::start(const char* display_name) {
+    stop();
+    m_control_display = XOpenDisplay(display_name);
+    m_data_display = XOpenDisplay(display_name);
+    if (!m_control_display || !m_data_display) {
+        VK_LOG_ERROR("XRecordListener: Could not open X display.");
+        stop();
+        return false;
+    }
+    int major = 0, minor = 0;
+    if (!XRecordQueryVersion(m_control_display, &major, &minor)) {
+        VK_LOG_ERROR("XRecordListener: RECORD extension not available.");
+        stop();
+        return false;
+    }
+
+    XDisplayKeycodes(m_control_display, &m_min_keycode, &m_max_keycode);
+    KeySym* keysyms = XGetKeyboardMapping(m_control_display, static_cast<KeyCode>(m_min_keycode),
+                                          m_max_keycode - m_min_keycode + 1, &m_keysyms_per_keycode);
+    if (!keysyms) {
+        VK_LOG_ERROR("XRecordListener: XGetKeyboardMapping failed.");
+        stop();
+        return false;
+    }
+    m_keymap.assign(keysyms, keysyms + (m_max_keycode - m_min_keycode + 1) * m_keysyms_per_keycode);
+    XFree(keysyms);
+
+    // Key events as the server processes them, and keymap changes made by any client
+    XRecordRange* range = XRecordAllocRange();
+    range->device_events.first = KeyPress;
+    range->device_events.last = KeyRelease;
+    range->core_requests.first = X_ChangeKeyboardMapping;
+    range->core_requests.last = X_ChangeKeyboardMapping;
+    XRecordClientSpec clients = XRecordAllClients;
+    m_context = XRecordCreateContext(m_control_display, 0, &clients, 1, &range, 1);
+    XFree(range);
+    if (!m_context) {
+        VK_LOG_ERROR("XRecordListener: XRecordCreateContext failed.");
+        stop();
+        return false;
+    }
+    // The context must exist on the server before the data connection enables it
+    XSync(m_control_display, False);
+
+    m_thread = std::thread([this]() {
+        // Blocks, calling intercept() for every recorded datum, until the context is disabled
+        XRecordEnableContext(m_data_display, m_context, &XRecordListener::intercept, reinterpret_cast<XPointer>(this));
+    });
+    VK_LOG_DEBUG("XRecordListener: Recording key events (RECORD " << major << "." << minor << ").");
+    return true;
+}
+
+void XRecordListener::stop() {
+    if (m_thread.joinable()) {
+        XRecordDisableContext(m_control_display, m_context);
+        XSync(m_control_display, False);
+        m_thread.join();
+    }
+    if (m_context) {
+        XRecordFreeContext(m_control_display, m_context);
+        m_context = 0;
+    }
+    if (m_data_display) {
+        XCloseDisplay(m_data_display);
+        m_data_display = nullptr;
+    }
+    if (m_control_display) {
+        XCloseDisplay(m_control_display);
+        m_control_display = nullptr;
+    }
+}
+
+void XRecordListener::intercept(XPointer closure, XRecordInterceptData* data) {
+    XRecordListener* self = reinterpret_cast<XRecordListener*>(closure);
+    size_t length = static_cast<size_t>(data->data_len) * 4; // data_len is in 4-byte units
+    if (data->category == XRecordFromServer && length >= sizeof(xEvent)) {
+        const xEvent* event = reinterpret_cast<const xEvent*>(data->data);
+        int type = event->u.u.type & 0x7f;
+        if (type == KeyPress || type == KeyRelease) {
+            self->on_key(event->u.u.detail, type == KeyPress);
+        }
+    } else if (data->category == XRecordFromClient && length >= sz_xChangeKeyboardMappingReq) {
+        self->on_mapping_request(data->data, length);
+    }
+    XRecordFreeData(data);
+}
+
+void XRecordListener::on_mapping_request(const unsigned char* request, size_t length) {
+    const xChangeKeyboardMappingReq* header = reinterpret_cast<const xChangeKeyboardMappingReq*>(request);
+    if (header->reqType != X_ChangeKeyboardMapping) {
+        return;
+    }
+    int first = header->firstKeyCode;
+    int count = header->keyCodes;
+    int per_keycode = header->keySymsPerKeyCode;
+    if (length < sz_xChangeKeyboardMappingReq + static_cast<size_t>(count * per_keycode) * 4) {
+        return;
+    }
+    const CARD32* keysyms = reinterpret_cast<const CARD32*>(request + sz_xChangeKeyboardMappingReq);
+    for (int i = 0; i < count; ++i) {
+        int keycode = first + i;
+        if (keycode < m_min_keycode || keycode > m_max_keycode) {
+            continue;
+        }
+        // Like the server, pad levels the request doesn't cover with NoSymbol
+        KeySym* row = &m_keymap[(keycode - m_min_keycode) * m_keysyms_per_keycode];
+        for (int level = 0; level < m_keysyms_per_keycode; ++level) {
+            row[level] = level < per_keycode ? keysyms[i * per_keycode + level] : NoSymbol;
+        }
+    }
+    m_mapping_changes.fetch_add(1, std::memory_order_relaxed);
+}
+
+KeySym XRecordListener::keysym_at(KeyCode keycode, int index) const {
+    if (keycode < m_min_keycode || keycode > m_max_keycode || index >= m_keysyms_per_keycode) {
+        return NoSymbol;
+    }
+    return m_keymap[(keycode - m_min_keycode) * m_keysyms_per_keycode + index];
+}
+
+void XRecordListener::on_key(KeyCode keycode, bool is_press) {
+    m_key_events.fetch_add(1, std::memory_order_relaxed);
+    KeySym base = keysym_at(keycode, 0);
+    std::atomic<int>* modifier = nullptr;
+    switch (base) {
+        case XK_Shift_L: case XK_Shift_R: modifier = &m_shift_down; break;
+        case XK_ISO_Level3_Shift: modifier = &m_level3_down; break;
+        case XK_Control_L: case XK_Control_R: case XK_Alt_L: case XK_Alt_R: modifier = &m_control_down; break;
+        default: break;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_last_event = std::chrono::steady_clock::now();
+    if (modifier) {
+        int held = modifier->load(std::memory_order_relaxed) + (is_press ? 1 : -1);
+        modifier->store(held > 0 ? held : 0, std::memory_order_relaxed);
+    } else if (is_press) {
+        // Same level positions as KeycodeTable: 0/1 plain and Shift, 4/5 with AltGr
+        bool shift = m_shift_down.load(std::memory_order_relaxed) > 0;
+        bool level3 = m_level3_down.load(std::memory_order_relaxed) > 0;
+        int index = (shift ? 1 : 0) + (level3 ? 4 : 0);
+        KeySym keysym = keysym_at(keycode, index);
+        if (keysym == NoSymbol && shift) {
+            // Core protocol rule: a missing level 2 is level 1, upper-cased for letters
+            KeySym lower, upper;
+            XConvertCase(keysym_at(keycode, index - 1), &lower, &upper);
+            keysym = upper;
+        }
+        unsigned long code_point = keysym_to_code_point(keysym);
+        if (m_control_down.load(std::memory_order_relaxed) > 0) {
+            m_chords.fetch_add(1, std::memory_order_relaxed); // Shortcuts don't type anything
+        } else {
+            m_characters.push_back(code_point ? code_point : 0xFFFD);
+        }
+    }
+    m_cv.notify_all();
+}
+
+void XRecordListener::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_characters.clear();
+}
+
+bool XRecordListener::wait_until(std::chrono::milliseconds idle_timeout, const std::function<bool()>& done) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto start = std::chrono::steady_clock::now();
+    while (!done()) {
+        // Idle since the later of the call and the last key event
+        auto deadline = std::max(m_last_event, start) + idle_timeout;
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        m_cv.wait_until(lock, deadline);
+    }
+    return true;
+}
+
+bool XRecordListener::wait_for_characters(size_t characters, std::chrono::milliseconds idle_timeout) {
+    return wait_until(idle_timeout, [&]() { return m_characters.size() >= characters; });
+}
+
+bool XRecordListener::wait_for_chords(uint64_t chords, std::chrono::milliseconds idle_timeout) {
+    return wait_until(idle_timeout, [&]() { return m_chords.load(std::memory_order_relaxed) >= chords; });
+}
+
+void XRecordListener::take(std::vector<unsigned long>& characters, std::chrono::steady_clock::time_point& last_event) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    characters.swap(m_characters);
+    m_characters.clear();
+    last_event = m_last_event;
+}
+
+int XRecordListener::held_modifiers() const {
+    return m_shift_down.load(std::memory_order_relaxed) + m_level3_down.load(std::memory_order_relaxed) +
+           m_control_down.load(std::memory_order_relaxed);
+}
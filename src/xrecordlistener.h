@@ -0,0 +1,87 @@
+// xrecordlistener.h
+// Header file for the XRecordListener class.
+// Watches the key events the X server actually processes, through the RECORD extension,
+// and turns them back into characters the way a client would see them: Shift and AltGr
+// levels are tracked from the recorded modifier keys, and keymap changes are replayed from
+// recorded ChangeKeyboardMapping requests so remapped spare keycodes decode correctly.
+// Used by the typing benchmark to check what reached the server; it needs two extra
+// display connections (RECORD delivers data on its own connection).
+
+#ifndef X_RECORD_LISTENER_H
+#define X_RECORD_LISTENER_H
+
+#include <X11/Xlib.h>
+#include <X11/extensions/record.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class XRecordListener {
+public:
+    XRecordListener();
+    ~XRecordListener();
+
+    XRecordListener(const XRecordListener&) = delete;
+    XRecordListener& operator=(const XRecordListener&) = delete;
+
+    // Connects to the display, snapshots its keymap and starts recording on a thread
+    bool start(const char* display_name);
+    void stop();
+
+    // Forgets the characters decoded so far (counters keep running)
+    void clear();
+
+    // Waits until 'characters' characters have been decoded, or until no key event has arrived
+    // for 'idle_timeout'. Returns true when the count was reached.
+    bool wait_for_characters(size_t characters, std::chrono::milliseconds idle_timeout);
+    // Same for Control/Alt chords (e.g. the Ctrl+V of a paste), counted since start()
+    bool wait_for_chords(uint64_t chords, std::chrono::milliseconds idle_timeout);
+
+    // Characters decoded since the last clear(), and when the last key event arrived
+    void take(std::vector<unsigned long>& characters, std::chrono::steady_clock::time_point& last_event);
+
+    uint64_t key_events() const { return m_key_events.load(std::memory_order_relaxed); }
+    uint64_t chords() const { return m_chords.load(std::memory_order_relaxed); }
+    uint64_t mapping_changes() const { return m_mapping_changes.load(std::memory_order_relaxed); }
+    // Modifier keys currently held down, e.g. left pressed by a lost release
+    int held_modifiers() const;
+
+private:
+    static void intercept(XPointer closure, XRecordInterceptData* data);
+    void on_key(KeyCode keycode, bool is_press);
+    void on_mapping_request(const unsigned char* request, size_t length);
+    KeySym keysym_at(KeyCode keycode, int index) const;
+    bool wait_until(std::chrono::milliseconds idle_timeout, const std::function<bool()>& done);
+
+    Display* m_control_display; // Creates and disables the context
+    Display* m_data_display;    // Blocks in XRecordEnableContext on the recording thread
+    XRecordContext m_context;
+    std::thread m_thread;
+
+    // Keymap as the server has it (recording thread only after start())
+    int m_min_keycode;
+    int m_max_keycode;
+    int m_keysyms_per_keycode;
+    std::vector<KeySym> m_keymap;
+
+    // Modifier keys held, by kind (recording thread writes, held_modifiers() reads)
+    std::atomic<int> m_shift_down;
+    std::atomic<int> m_level3_down;
+    std::atomic<int> m_control_down; // Control or Alt
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<unsigned long> m_characters;
+    std::chrono::steady_clock::time_point m_last_event;
+
+    std::atomic<uint64_t> m_key_events;
+    std::atomic<uint64_t> m_chords;
+    std::atomic<uint64_t> m_mapping_changes;
+};
+
+#endif // X_RECORD_LISTENER_H
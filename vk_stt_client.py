@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""Streams audio to vk-sttd over its Unix socket and prints the results as they arrive.
+
+Replaces the old Flask backend: no second model, no base64, no polling. Audio is sent as
+raw S16LE (or a WAV stream) after one JSON header line; results come back as JSON lines.
+
+Usage: vk_stt_client.py [--socket PATH] [--rate HZ] [--channels N] [--partial] [FILE|-]
+"""
+
+import argparse
+import json
+import os
+import socket
+import sys
+import threading
+
+
+def default_socket_path():
+    if "VK_STTD_SOCKET" in os.environ:
+        return os.environ["VK_STTD_SOCKET"]
+    if "XDG_RUNTIME_DIR" in os.environ:
+        return os.path.join(os.environ["XDG_RUNTIME_DIR"], "vk-stt.sock")
+    return "/tmp/vk-stt-%d.sock" % os.getuid()
+
+
+def send_audio(sock, source):
+    try:
+        while True:
+            chunk = source.read(6400)  # 200 ms of 16 kHz mono
+            if not chunk:
+                break
+            sock.sendall(chunk)
+    except OSError:
+        pass  # The daemon closed the connection; the reader reports why
+    finally:
+        try:
+            sock.shutdown(socket.SHUT_WR)  # End of stream: the daemon sends the last result
+        except OSError:
+            pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--socket", default=default_socket_path())
+    parser.add_argument("--rate", type=int, default=16000, help="sample rate of raw input")
+    parser.add_argument("--channels", type=int, default=1, help="channels of raw input")
+    parser.add_argument("--partial", action="store_true", help="print partial results to stderr")
+    parser.add_argument("input", nargs="?", default="-", help="WAV or raw S16LE file, - for stdin")
+    args = parser.parse_args()
+
+    source = sys.stdin.buffer if args.input == "-" else open(args.input, "rb")
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(args.socket)
+    header = {"sample_rate": args.rate, "channels": args.channels, "partial": args.partial}
+    sock.sendall((json.dumps(header) + "\n").encode())
+
+    sender = threading.Thread(target=send_audio, args=(sock, source), daemon=True)
+    sender.start()
+
+    status = 0
+    for line in sock.makefile("r", encoding="utf-8"):
+        message = json.loads(line)
+        kind = message.get("type")
+        if kind == "final":
+            print(message["text"], flush=True)
+        elif kind == "partial":
+            print("... " + message["text"], file=sys.stderr, flush=True)
+        elif kind == "error":
+            print("vk-sttd: " + message["message"], file=sys.stderr)
+            status = 1
+        elif kind == "end":
+            break
+    sock.close()
+    return status
+
+
+if __name__ == "__main__":
+    sys.exit(main())